@@ -0,0 +1,189 @@
+// fcon 微基准测试：cmake -DFCON_BUILD_BENCH=ON 后运行 fcon_bench [名称过滤]
+#include "BitOps.h"
+#include "BitmapKernels.h"
+#include "BlockAllocator.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool failed = false;
+
+struct Benchmark {
+    std::string name;
+    std::function<uint64_t()> run;   // 返回处理的单位数（块）
+};
+
+uint64_t lcg(uint64_t& state) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// 位图中置位的数量必须与分配器记录的已用块数一致
+bool consistent(const BlockAllocator& allocator) {
+    uint64_t bits = 0;
+    for (uint64_t word : allocator.bitmap()) {
+        bits += BitOps::popcount(word);
+    }
+    return bits == allocator.usedCount();
+}
+
+// 按给定方式分配 files 个文件（大小 1~2*meanBlocks 块），返回分配的块数
+uint64_t allocateFiles(BlockAllocator::Policy policy, BlockAllocator::Fit fit, double churn,
+                       size_t files, uint64_t meanBlocks) {
+    BlockAllocator allocator;
+    allocator.setBlockSize(4096);
+    allocator.setPolicy(policy);
+    allocator.setFit(fit);
+    allocator.setChurn(churn);
+    std::vector<int> blocks;
+    uint64_t state = 42;
+    uint64_t total = 0;
+    for (size_t i = 0; i < files; i++) {
+        blocks.clear();
+        allocator.allocate(1 + lcg(state) % (2 * meanBlocks), blocks);
+        total += blocks.size();
+    }
+    allocator.settle();
+    if (!consistent(allocator)) {
+        std::fprintf(stderr, "  错误: 位图与已用块计数不一致\n");
+        failed = true;
+    }
+    return total;
+}
+
+// 先制造大量单块空洞（每隔一块释放一块），再用链接分配填满这些空洞
+uint64_t scatterIntoHoles(BlockAllocator::Policy policy) {
+    const size_t holes = 4000000;
+    BlockAllocator allocator;
+    allocator.setPolicy(BlockAllocator::Policy::Continuous);
+    std::vector<int> all;
+    allocator.allocate(holes * 2, all);
+    std::vector<int> odd;
+    odd.reserve(holes);
+    for (size_t i = 1; i < all.size(); i += 2) {
+        odd.push_back(all[i]);
+    }
+    allocator.release(odd);
+
+    allocator.setPolicy(policy);
+    std::vector<int> blocks;
+    uint64_t total = 0;
+    while (total < holes) {
+        blocks.clear();
+        allocator.allocate(256, blocks);
+        total += blocks.size();
+    }
+    if (!consistent(allocator) || allocator.usedCount() != allocator.highWater()) {
+        std::fprintf(stderr, "  错误: 空洞没有被完全复用\n");
+        failed = true;
+    }
+    return total;
+}
+
+// 随机位图：按给定密度逐段生成已用/空闲段，段长覆盖字内和跨字的情况
+std::vector<uint64_t> randomBitmap(uint64_t& state, size_t count, unsigned density) {
+    std::vector<uint64_t> words(count, 0);
+    uint64_t b = 0;
+    while (b < count * 64) {
+        uint64_t length = 1 + lcg(state) % (lcg(state) % 4 == 0 ? 700 : 12);
+        bool used = lcg(state) % 100 < density;
+        for (uint64_t i = b; i < b + length && i < count * 64; i++) {
+            if (used) {
+                words[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+        b += length;
+    }
+    return words;
+}
+
+// 在 level 级别上对 64M 块的位图（约一半为碎片区域）重复运行内核，返回处理的块数
+uint64_t runKernel(BitmapKernels::Level level, const std::string& kernel) {
+    static std::vector<uint64_t> words;
+    static std::vector<int> blocks;
+    if (words.empty()) {
+        uint64_t state = 11;
+        words = randomBitmap(state, 1 << 20, 97);
+        blocks.resize(1 << 22);
+        for (size_t i = 0; i < blocks.size(); i++) {
+            blocks[i] = static_cast<int>(i + i / 5000);
+        }
+    }
+    BitmapKernels::Level original = BitmapKernels::active();
+    BitmapKernels::setLevel(level);
+    const int rounds = 20;
+    uint64_t sink = 0;
+    uint64_t units = 0;
+    for (int r = 0; r < rounds; r++) {
+        if (kernel == "popcount") {
+            sink += BitmapKernels::popcount(words.data(), words.size(), 0, words.size() * 64);
+            units += words.size() * 64;
+        } else if (kernel == "runs") {
+            sink += BitmapKernels::countRuns(words.data(), words.size());
+            units += words.size() * 64;
+        } else if (kernel == "freerun") {
+            // 逐个寻找长度 >= 512 的空闲段，直到位图末尾
+            for (uint64_t b = 0; b < words.size() * 64; b += 512) {
+                b = BitmapKernels::findFreeRun(words.data(), words.size(), b, 512);
+                sink++;
+            }
+            units += words.size() * 64;
+        } else {
+            size_t breaks = 0;
+            for (size_t i = 0; i < blocks.size(); i += breaks) {
+                breaks = BitmapKernels::firstBreak(blocks.data() + i, blocks.size() - i);
+                sink++;
+            }
+            sink += BitmapKernels::countBreaks(blocks.data(), blocks.size());
+            units += blocks.size() * 2;
+        }
+    }
+    BitmapKernels::setLevel(original);
+    return sink ? units : 0;
+}
+
+std::vector<Benchmark> benchmarks() {
+    using Policy = BlockAllocator::Policy;
+    using Fit = BlockAllocator::Fit;
+    std::vector<Benchmark> list = {
+        {"alloc/continuous/first", [] { return allocateFiles(Policy::Continuous, Fit::First, 0.0, 1000000, 16); }},
+        {"alloc/continuous/first/churn", [] { return allocateFiles(Policy::Continuous, Fit::First, 0.3, 200000, 16); }},
+        {"alloc/continuous/next/churn", [] { return allocateFiles(Policy::Continuous, Fit::Next, 0.3, 200000, 16); }},
+        {"alloc/continuous/best/churn", [] { return allocateFiles(Policy::Continuous, Fit::Best, 0.3, 200000, 16); }},
+        {"alloc/linked/next/churn", [] { return allocateFiles(Policy::Linked, Fit::Next, 0.3, 1000000, 16); }},
+        {"alloc/indexed/first/churn", [] { return allocateFiles(Policy::Indexed, Fit::First, 0.3, 1000000, 16); }},
+        {"alloc/linked/holes", [] { return scatterIntoHoles(Policy::Linked); }},
+        {"alloc/indexed/holes", [] { return scatterIntoHoles(Policy::Indexed); }},
+    };
+    for (int l = 0; l <= static_cast<int>(BitmapKernels::supported()); l++) {
+        auto level = static_cast<BitmapKernels::Level>(l);
+        for (const char* kernel : {"popcount", "runs", "freerun", "breaks"}) {
+            list.push_back({std::string("kernels/") + BitmapKernels::levelName(level) + "/" + kernel,
+                            [level, kernel] { return runKernel(level, kernel); }});
+        }
+    }
+    return list;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    std::printf("%-32s %14s %10s %14s\n", "benchmark", "blocks", "seconds", "Mblocks/s");
+    for (const auto& benchmark : benchmarks()) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        uint64_t units = benchmark.run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-32s %14llu %10.3f %14.1f\n", benchmark.name.c_str(), static_cast<unsigned long long>(units),
+                    seconds, seconds > 0 ? static_cast<double>(units) / seconds / 1e6 : 0.0);
+    }
+    return failed ? 1 : 0;
+}
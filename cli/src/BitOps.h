@@ -0,0 +1,89 @@
+#ifndef BIT_OPS_H
+#define BIT_OPS_H
+
+#include <cstdint>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// 可移植的位操作：GCC/Clang 使用内建函数，MSVC 使用 _BitScanForward64 等内部函数，
+// 其余编译器退回逐位循环。位图内核、块分配器和 extent 索引都经由这里，不直接调用 __builtin_*。
+// 强制内联，使带 target 属性的内核（如 SSE4.2 版本）展开时继承调用者的指令集
+#if defined(__GNUC__) || defined(__clang__)
+#define FCON_BITOPS_INLINE inline __attribute__((always_inline))
+#else
+#define FCON_BITOPS_INLINE inline
+#endif
+
+namespace BitOps {
+
+// 最低置位的下标（v 不能为 0）
+FCON_BITOPS_INLINE unsigned countTrailingZeros(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(v));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return static_cast<unsigned>(index);
+#else
+    unsigned n = 0;
+    while ((v & 1) == 0) {
+        v >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// 最高置位之上的零位数（v 不能为 0）
+FCON_BITOPS_INLINE unsigned countLeadingZeros(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_clzll(v));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return 63 - static_cast<unsigned>(index);
+#else
+    unsigned n = 0;
+    while ((v & (uint64_t(1) << 63)) == 0) {
+        v <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+FCON_BITOPS_INLINE unsigned popcount(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_popcountll(v));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<unsigned>(__popcnt64(v));
+#else
+    // SWAR：每 2、4、8 位分组求和，再用乘法把各字节累加到最高字节
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<unsigned>((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// 与 ffs 相同：最低置位的下标加 1，v 为 0 时返回 0
+FCON_BITOPS_INLINE unsigned findFirstSet(uint64_t v) {
+    return v == 0 ? 0 : countTrailingZeros(v) + 1;
+}
+
+// 预取到缓存（只读）；编译器不支持时什么也不做
+FCON_BITOPS_INLINE void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+} // namespace BitOps
+
+#endif // BIT_OPS_H
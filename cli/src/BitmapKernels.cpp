@@ -0,0 +1,437 @@
+#include "BitmapKernels.h"
+#include "BitOps.h"
+#include <atomic>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FCON_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FCON_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define FCON_ALWAYS_INLINE inline
+#endif
+
+namespace {
+
+// 各级别的实现表
+struct KernelTable {
+    uint64_t (*popcountWords)(const uint64_t* words, size_t count);
+    uint64_t (*countRuns)(const uint64_t* words, size_t count);
+    uint64_t (*findFreeRun)(const uint64_t* words, size_t count, uint64_t from, uint64_t length);
+    size_t (*firstBreak)(const int* blocks, size_t count);
+    size_t (*countBreaks)(const int* blocks, size_t count);
+};
+
+// 以下内联模板被各级别的实现展开，编译时继承调用者的目标指令集
+// （例如 SSE4.2 版本中的 BitOps::popcount 会编译为 popcnt 指令）
+
+template <typename Skip>
+FCON_ALWAYS_INLINE uint64_t findFreeRunGeneric(const uint64_t* words, size_t count, uint64_t from,
+                                               uint64_t length, Skip skipWhile) {
+    const uint64_t total = static_cast<uint64_t>(count) * 64;
+    if (length == 0) {
+        length = 1;
+    }
+    if (from >= total) {
+        return from;
+    }
+
+    size_t w = static_cast<size_t>(from / 64);
+    uint64_t word = words[w] | ((uint64_t(1) << (from % 64)) - 1);   // from 之前的位视为已用
+    uint64_t runStart = 0;
+    uint64_t run = 0;
+    for (;;) {
+        if (run == 0 && word == ~uint64_t(0)) {
+            // 跳过整字已用的区域
+            w = skipWhile(words, w + 1, count, ~uint64_t(0));
+            if (w >= count) {
+                return total;
+            }
+            word = words[w];
+            continue;
+        }
+        if (word == 0) {
+            // 跨过整字空闲的区域
+            if (run == 0) {
+                runStart = static_cast<uint64_t>(w) * 64;
+            }
+            size_t end = skipWhile(words, w + 1, count, 0);
+            run += static_cast<uint64_t>(end - w) * 64;
+            if (run >= length || end >= count) {
+                return runStart;
+            }
+            w = end;
+            word = words[w];
+            continue;
+        }
+        for (uint64_t bit = 0; bit < 64;) {
+            uint64_t rest = word >> bit;
+            if ((rest & 1) == 0) {
+                uint64_t n = rest == 0 ? 64 - bit : static_cast<uint64_t>(BitOps::countTrailingZeros(rest));
+                if (run == 0) {
+                    runStart = static_cast<uint64_t>(w) * 64 + bit;
+                }
+                run += n;
+                if (run >= length) {
+                    return runStart;
+                }
+                bit += n;
+            } else {
+                uint64_t n = ~rest == 0 ? 64 - bit : static_cast<uint64_t>(BitOps::countTrailingZeros(~rest));
+                run = 0;
+                bit += n;
+            }
+        }
+        if (++w >= count) {
+            return run > 0 ? runStart : total;   // 末尾的空闲段与位图之后的区域相连
+        }
+        word = words[w];
+    }
+}
+
+FCON_ALWAYS_INLINE uint64_t popcountWordsGeneric(const uint64_t* words, size_t count) {
+    uint64_t a = 0, b = 0, c = 0, d = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        a += static_cast<uint64_t>(BitOps::popcount(words[i]));
+        b += static_cast<uint64_t>(BitOps::popcount(words[i + 1]));
+        c += static_cast<uint64_t>(BitOps::popcount(words[i + 2]));
+        d += static_cast<uint64_t>(BitOps::popcount(words[i + 3]));
+    }
+    for (; i < count; i++) {
+        a += static_cast<uint64_t>(BitOps::popcount(words[i]));
+    }
+    return a + b + c + d;
+}
+
+FCON_ALWAYS_INLINE uint64_t countRunsGeneric(const uint64_t* words, size_t begin, size_t count) {
+    uint64_t runs = 0;
+    uint64_t carry = begin > 0 ? words[begin - 1] >> 63 : 0;   // 上一个字的最高位
+    for (size_t i = begin; i < count; i++) {
+        uint64_t word = words[i];
+        // 段起点：当前位为 1 且前一位为 0
+        runs += static_cast<uint64_t>(BitOps::popcount(word & ~((word << 1) | carry)));
+        carry = word >> 63;
+    }
+    return runs;
+}
+
+// 块号按 32 位无符号数比较，与向量实现的回绕语义一致
+FCON_ALWAYS_INLINE bool consecutive(const int* blocks, size_t i) {
+    return static_cast<uint32_t>(blocks[i]) == static_cast<uint32_t>(blocks[i - 1]) + 1;
+}
+
+FCON_ALWAYS_INLINE size_t firstBreakGeneric(const int* blocks, size_t begin, size_t count) {
+    for (size_t i = begin > 0 ? begin : 1; i < count; i++) {
+        if (!consecutive(blocks, i)) {
+            return i;
+        }
+    }
+    return count;
+}
+
+FCON_ALWAYS_INLINE size_t countBreaksGeneric(const int* blocks, size_t begin, size_t count) {
+    size_t breaks = 0;
+    for (size_t i = begin > 0 ? begin : 1; i < count; i++) {
+        breaks += consecutive(blocks, i) ? 0 : 1;
+    }
+    return breaks;
+}
+
+// ---- 标量实现 ----
+
+size_t skipWhileScalar(const uint64_t* words, size_t i, size_t count, uint64_t value) {
+    while (i < count && words[i] == value) {
+        i++;
+    }
+    return i;
+}
+
+uint64_t popcountWordsScalar(const uint64_t* words, size_t count) {
+    return popcountWordsGeneric(words, count);
+}
+
+uint64_t countRunsScalar(const uint64_t* words, size_t count) {
+    return countRunsGeneric(words, 0, count);
+}
+
+uint64_t findFreeRunScalar(const uint64_t* words, size_t count, uint64_t from, uint64_t length) {
+    return findFreeRunGeneric(words, count, from, length, skipWhileScalar);
+}
+
+size_t firstBreakScalar(const int* blocks, size_t count) {
+    return firstBreakGeneric(blocks, 1, count);
+}
+
+size_t countBreaksScalar(const int* blocks, size_t count) {
+    return countBreaksGeneric(blocks, 1, count);
+}
+
+const KernelTable scalarTable = {popcountWordsScalar, countRunsScalar, findFreeRunScalar, firstBreakScalar,
+                                 countBreaksScalar};
+
+#ifdef FCON_X86_KERNELS
+
+// ---- SSE4.2 实现：每次比较 2 个字 / 4 个块号，位计数使用 popcnt 指令 ----
+
+#define FCON_SSE42 __attribute__((target("sse4.2,popcnt")))
+
+FCON_SSE42 size_t skipWhileSse42(const uint64_t* words, size_t i, size_t count, uint64_t value) {
+    const __m128i target = _mm_set1_epi64x(static_cast<long long>(value));
+    for (; i + 2 <= count; i += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(v, target)));
+        if (mask != 0x3) {
+            return i + static_cast<size_t>(BitOps::countTrailingZeros(static_cast<uint32_t>(~mask)));
+        }
+    }
+    return skipWhileScalar(words, i, count, value);
+}
+
+FCON_SSE42 uint64_t popcountWordsSse42(const uint64_t* words, size_t count) {
+    return popcountWordsGeneric(words, count);
+}
+
+FCON_SSE42 uint64_t countRunsSse42(const uint64_t* words, size_t count) {
+    return countRunsGeneric(words, 0, count);
+}
+
+FCON_SSE42 uint64_t findFreeRunSse42(const uint64_t* words, size_t count, uint64_t from, uint64_t length) {
+    return findFreeRunGeneric(words, count, from, length, skipWhileSse42);
+}
+
+FCON_SSE42 size_t firstBreakSse42(const int* blocks, size_t count) {
+    const __m128i one = _mm_set1_epi32(1);
+    size_t i = 1;
+    for (; i + 4 <= count; i += 4) {
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i));
+        __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i - 1));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(current, _mm_add_epi32(previous, one))));
+        if (mask != 0xF) {
+            return i + static_cast<size_t>(BitOps::countTrailingZeros(static_cast<uint32_t>(~mask)));
+        }
+    }
+    return firstBreakGeneric(blocks, i, count);
+}
+
+FCON_SSE42 size_t countBreaksSse42(const int* blocks, size_t count) {
+    const __m128i one = _mm_set1_epi32(1);
+    size_t breaks = 0;
+    size_t i = 1;
+    for (; i + 4 <= count; i += 4) {
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i));
+        __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i - 1));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(current, _mm_add_epi32(previous, one))));
+        breaks += 4 - static_cast<size_t>(BitOps::popcount(static_cast<uint32_t>(mask)));
+    }
+    return breaks + countBreaksGeneric(blocks, i, count);
+}
+
+const KernelTable sse42Table = {popcountWordsSse42, countRunsSse42, findFreeRunSse42, firstBreakSse42,
+                                countBreaksSse42};
+
+// ---- AVX2 实现：每次处理 4 个字 / 8 个块号，位计数使用 pshufb 查表 ----
+
+#define FCON_AVX2 __attribute__((target("avx2,popcnt")))
+
+// 每个 64 位通道中置位的数量
+FCON_AVX2 inline __m256i popcountLanes(__m256i v) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    __m256i low = _mm256_and_si256(v, lowNibble);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibble);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, low), _mm256_shuffle_epi8(table, high));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+FCON_AVX2 inline uint64_t sumLanes(__m256i v) {
+    return static_cast<uint64_t>(_mm256_extract_epi64(v, 0)) + static_cast<uint64_t>(_mm256_extract_epi64(v, 1)) +
+           static_cast<uint64_t>(_mm256_extract_epi64(v, 2)) + static_cast<uint64_t>(_mm256_extract_epi64(v, 3));
+}
+
+FCON_AVX2 size_t skipWhileAvx2(const uint64_t* words, size_t i, size_t count, uint64_t value) {
+    const __m256i target = _mm256_set1_epi64x(static_cast<long long>(value));
+    for (; i + 4 <= count; i += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, target)));
+        if (mask != 0xF) {
+            return i + static_cast<size_t>(BitOps::countTrailingZeros(static_cast<uint32_t>(~mask)));
+        }
+    }
+    return skipWhileScalar(words, i, count, value);
+}
+
+FCON_AVX2 uint64_t popcountWordsAvx2(const uint64_t* words, size_t count) {
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i + 4));
+        sum = _mm256_add_epi64(sum, _mm256_add_epi64(popcountLanes(a), popcountLanes(b)));
+    }
+    return sumLanes(sum) + popcountWordsGeneric(words + i, count - i);
+}
+
+FCON_AVX2 uint64_t countRunsAvx2(const uint64_t* words, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t runs = countRunsGeneric(words, 0, 1);
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 1;
+    for (; i + 4 <= count; i += 4) {
+        __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i - 1));
+        __m256i before = _mm256_or_si256(_mm256_slli_epi64(current, 1), _mm256_srli_epi64(previous, 63));
+        sum = _mm256_add_epi64(sum, popcountLanes(_mm256_andnot_si256(before, current)));
+    }
+    return runs + sumLanes(sum) + countRunsGeneric(words, i, count);
+}
+
+FCON_AVX2 uint64_t findFreeRunAvx2(const uint64_t* words, size_t count, uint64_t from, uint64_t length) {
+    return findFreeRunGeneric(words, count, from, length, skipWhileAvx2);
+}
+
+FCON_AVX2 size_t firstBreakAvx2(const int* blocks, size_t count) {
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t i = 1;
+    for (; i + 8 <= count; i += 8) {
+        __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks + i));
+        __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks + i - 1));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(current, _mm256_add_epi32(previous, one))));
+        if (mask != 0xFF) {
+            return i + static_cast<size_t>(BitOps::countTrailingZeros(static_cast<uint32_t>(~mask)));
+        }
+    }
+    return firstBreakGeneric(blocks, i, count);
+}
+
+FCON_AVX2 size_t countBreaksAvx2(const int* blocks, size_t count) {
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t breaks = 0;
+    size_t i = 1;
+    for (; i + 8 <= count; i += 8) {
+        __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks + i));
+        __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks + i - 1));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(current, _mm256_add_epi32(previous, one))));
+        breaks += 8 - static_cast<size_t>(BitOps::popcount(static_cast<uint32_t>(mask)));
+    }
+    return breaks + countBreaksGeneric(blocks, i, count);
+}
+
+const KernelTable avx2Table = {popcountWordsAvx2, countRunsAvx2, findFreeRunAvx2, firstBreakAvx2,
+                               countBreaksAvx2};
+
+#endif // FCON_X86_KERNELS
+
+const KernelTable& tableFor(BitmapKernels::Level level) {
+#ifdef FCON_X86_KERNELS
+    switch (level) {
+        case BitmapKernels::Level::Avx2:
+            return avx2Table;
+        case BitmapKernels::Level::Sse42:
+            return sse42Table;
+        default:
+            break;
+    }
+#else
+    (void)level;
+#endif
+    return scalarTable;
+}
+
+std::atomic<const KernelTable*> currentTable{nullptr};
+std::atomic<int> currentLevel{-1};
+
+const KernelTable& table() {
+    const KernelTable* kernels = currentTable.load(std::memory_order_acquire);
+    if (!kernels) {
+        // 并发的首次调用会得到相同的结果，无需加锁
+        BitmapKernels::Level level = BitmapKernels::supported();
+        kernels = &tableFor(level);
+        currentLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+        currentTable.store(kernels, std::memory_order_release);
+    }
+    return *kernels;
+}
+
+} // namespace
+
+BitmapKernels::Level BitmapKernels::supported() {
+#ifdef FCON_X86_KERNELS
+    static const Level level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return Level::Avx2;
+        }
+        if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+            return Level::Sse42;
+        }
+        return Level::Scalar;
+    }();
+    return level;
+#else
+    return Level::Scalar;
+#endif
+}
+
+BitmapKernels::Level BitmapKernels::active() {
+    table();
+    return static_cast<Level>(currentLevel.load(std::memory_order_relaxed));
+}
+
+bool BitmapKernels::setLevel(Level level) {
+    if (static_cast<int>(level) > static_cast<int>(supported())) {
+        return false;
+    }
+    currentLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+    currentTable.store(&tableFor(level), std::memory_order_release);
+    return true;
+}
+
+const char* BitmapKernels::levelName(Level level) {
+    switch (level) {
+        case Level::Avx2:
+            return "avx2";
+        case Level::Sse42:
+            return "sse4.2";
+        default:
+            return "scalar";
+    }
+}
+
+uint64_t BitmapKernels::popcount(const uint64_t* words, size_t count, uint64_t first, uint64_t last) {
+    last = last < static_cast<uint64_t>(count) * 64 ? last : static_cast<uint64_t>(count) * 64;
+    if (first >= last) {
+        return 0;
+    }
+    size_t firstWord = static_cast<size_t>(first / 64);
+    size_t lastWord = static_cast<size_t>((last - 1) / 64);
+    uint64_t headMask = ~uint64_t(0) << (first % 64);
+    uint64_t tailMask = last % 64 == 0 ? ~uint64_t(0) : ~uint64_t(0) >> (64 - last % 64);
+    if (firstWord == lastWord) {
+        return static_cast<uint64_t>(BitOps::popcount(words[firstWord] & headMask & tailMask));
+    }
+    return static_cast<uint64_t>(BitOps::popcount(words[firstWord] & headMask)) +
+           table().popcountWords(words + firstWord + 1, lastWord - firstWord - 1) +
+           static_cast<uint64_t>(BitOps::popcount(words[lastWord] & tailMask));
+}
+
+uint64_t BitmapKernels::countRuns(const uint64_t* words, size_t count) {
+    return table().countRuns(words, count);
+}
+
+uint64_t BitmapKernels::findFreeRun(const uint64_t* words, size_t count, uint64_t from, uint64_t length) {
+    return table().findFreeRun(words, count, from, length);
+}
+
+size_t BitmapKernels::firstBreak(const int* blocks, size_t count) {
+    return table().firstBreak(blocks, count);
+}
+
+size_t BitmapKernels::countBreaks(const int* blocks, size_t count) {
+    return table().countBreaks(blocks, count);
+}
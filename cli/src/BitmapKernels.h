@@ -0,0 +1,36 @@
+#ifndef BITMAP_KERNELS_H
+#define BITMAP_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 块位图和块号数组上的热点循环（位 = 1 表示已用块，块 b 位于 words[b / 64] 的第 b % 64 位）。
+// 每个内核有标量、SSE4.2 和 AVX2 三种实现，首次使用时按 CPU 能力选择一次；
+// 非 x86 平台或非 GCC/Clang 编译器只有标量实现。标量实现同时作为其他实现的参考。
+class BitmapKernels {
+public:
+    enum class Level { Scalar, Sse42, Avx2 };
+
+    static Level supported();                 // CPU 支持的最高级别
+    static Level active();                    // 当前使用的级别
+    // 切换实现（用于交叉校验和基准测试），超过 CPU 支持的级别时返回 false
+    static bool setLevel(Level level);
+    static const char* levelName(Level level);
+
+    // 块范围 [first, last) 内已用块的数量，last 不超过 count * 64
+    static uint64_t popcount(const uint64_t* words, size_t count, uint64_t first, uint64_t last);
+
+    // 已用块连续段的数量，即 0→1 跳变的次数（位图开头之前视为空闲）
+    static uint64_t countRuns(const uint64_t* words, size_t count);
+
+    // 起点 >= from、长度 >= length 的第一个空闲段的起点；位图之后视为无限长的空闲区域，
+    // 因此总有结果（可能 >= count * 64）
+    static uint64_t findFreeRun(const uint64_t* words, size_t count, uint64_t from, uint64_t length);
+
+    // 块号数组中第一个满足 blocks[i] != blocks[i - 1] + 1 的下标 i，全部连续时返回 count
+    static size_t firstBreak(const int* blocks, size_t count);
+    // 块号数组中相邻块不连续的次数（extent 数量 - 1）
+    static size_t countBreaks(const int* blocks, size_t count);
+};
+
+#endif // BITMAP_KERNELS_H
@@ -0,0 +1,573 @@
+#include "BlockAllocator.h"
+#include "BitOps.h"
+#include <algorithm>
+
+namespace {
+
+const uint64_t NO_RUN = ~uint64_t(0);
+const size_t MAX_GHOSTS = 64;          // churn 模式中同时存在的临时文件数上限
+const size_t MIN_CAPACITY_WORDS = 1024;
+
+} // namespace
+
+BlockAllocator::BlockAllocator()
+    : policy_(Policy::Continuous)
+    , fit_(Fit::First)
+    , pointersPerBlock_(1024)
+    , used_(0)
+    , highWater_(0)
+    , cursor_(0)
+    , churn_(0.0)
+    , random_(0)
+{
+}
+
+bool BlockAllocator::parsePolicy(const std::string& name, Policy& policy) {
+    if (name == "continuous") {
+        policy = Policy::Continuous;
+    } else if (name == "linked") {
+        policy = Policy::Linked;
+    } else if (name == "indexed") {
+        policy = Policy::Indexed;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool BlockAllocator::parseFit(const std::string& name, Fit& fit) {
+    if (name == "first") {
+        fit = Fit::First;
+    } else if (name == "next") {
+        fit = Fit::Next;
+    } else if (name == "best") {
+        fit = Fit::Best;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* BlockAllocator::policyName(Policy policy) {
+    switch (policy) {
+    case Policy::Linked:
+        return "linked";
+    case Policy::Indexed:
+        return "indexed";
+    default:
+        return "continuous";
+    }
+}
+
+void BlockAllocator::setBlockSize(size_t blockSize) {
+    pointersPerBlock_ = std::max<uint64_t>(1, blockSize / 4);
+}
+
+void BlockAllocator::setChurn(double ratio, uint64_t seed) {
+    churn_ = std::min(1.0, std::max(0.0, ratio));
+    random_ = seed;
+}
+
+uint64_t BlockAllocator::nextRandom() {
+    // splitmix64
+    uint64_t z = (random_ += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void BlockAllocator::allocate(size_t count, std::vector<int>& out) {
+    if (count == 0) {
+        return;
+    }
+
+    // churn：先创建一个大小相近的临时文件，临时文件过多时随机删除一个，
+    // 删除留下的空洞会被后续分配复用
+    if (churn_ > 0.0 && static_cast<double>(nextRandom() >> 11) * (1.0 / 9007199254740992.0) < churn_) {
+        double scale = 0.5 + 1.5 * static_cast<double>(nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+        size_t ghostBlocks = std::max<size_t>(1, static_cast<size_t>(static_cast<double>(count) * scale));
+        ghosts_.emplace_back();
+        allocateRuns(ghostBlocks, ghosts_.back());
+        if (ghosts_.size() > MAX_GHOSTS) {
+            size_t victim = static_cast<size_t>(nextRandom() % ghosts_.size());
+            releaseRuns(ghosts_[victim]);
+            ghosts_[victim] = std::move(ghosts_.back());
+            ghosts_.pop_back();
+        }
+    }
+
+    std::vector<Run> runs;
+    allocateRuns(count, runs);
+    size_t base = out.size();
+    for (const Run& run : runs) {
+        for (uint64_t b = run.start; b < run.start + run.length; b++) {
+            out.push_back(static_cast<int>(b));
+        }
+    }
+    // 索引块先于数据块分配（位置靠前），输出时放在数据块之后，使 blocks 前部与文件内容一一对应
+    if (policy_ == Policy::Indexed) {
+        size_t indexBlocks = out.size() - base - count;
+        std::rotate(out.begin() + static_cast<std::ptrdiff_t>(base),
+                    out.begin() + static_cast<std::ptrdiff_t>(base + indexBlocks), out.end());
+    }
+}
+
+void BlockAllocator::allocateRuns(size_t count, std::vector<Run>& runs) {
+    if (policy_ == Policy::Continuous) {
+        uint64_t start = findRun(count);
+        markRange(start, count, true);
+        runs.push_back({start, count});
+        cursor_ = start + count;
+        return;
+    }
+
+    uint64_t total = count;
+    if (policy_ == Policy::Indexed) {
+        total += (count + pointersPerBlock_ - 1) / pointersPerBlock_;
+    }
+    uint64_t from = 0;
+    if (fit_ == Fit::Next) {
+        from = cursor_;
+    } else if (fit_ == Fit::Best) {
+        // 有能容纳整个文件的空洞时放进最小的那个，否则从头依次填充
+        uint64_t best = bestRun(total);
+        from = best != NO_RUN ? best : 0;
+    }
+    gather(from, total, runs);
+    cursor_ = runs.back().start + runs.back().length;
+}
+
+uint64_t BlockAllocator::findRun(uint64_t count) {
+    switch (fit_) {
+    case Fit::Next: {
+        // 从上次分配的结尾向后找，落到已用区域之外时再从头找一遍（回绕）
+        uint64_t start = searchRun(cursor_, count);
+        return start < highWater_ ? start : searchRun(0, count);
+    }
+    case Fit::Best: {
+        uint64_t start = bestRun(count);
+        return start != NO_RUN ? start : highWater_;
+    }
+    default:
+        return searchRun(0, count);
+    }
+}
+
+uint64_t BlockAllocator::searchRun(uint64_t from, uint64_t count) const {
+    if (words_.empty()) {
+        return from;
+    }
+    uint64_t carry = 0;
+    uint64_t start = searchNode(1, 0, capacity(), from, count, carry);
+    if (start != NO_RUN) {
+        return start;
+    }
+    // 位图末尾的空闲段与之后的无限空闲区域相连
+    return std::max(from, capacity() - carry);
+}
+
+uint64_t BlockAllocator::searchNode(size_t node, uint64_t low, uint64_t high, uint64_t from, uint64_t count,
+                                    uint64_t& carry) const {
+    // carry：紧接在 low 之前、起点 >= from 的空闲段长度
+    if (high <= from) {
+        return NO_RUN;
+    }
+    if (low >= from) {
+        if (carry + prefix_[node] >= count) {
+            return low - carry;
+        }
+        if (longest_[node] < count) {
+            carry = prefix_[node] == high - low ? carry + (high - low) : suffix_[node];
+            return NO_RUN;
+        }
+    }
+    if (node >= words_.size()) {
+        // 叶子：按段扫描，已用段和空闲段的长度都由 countTrailingZeros 一次求出
+        uint64_t free = ~words_[node - words_.size()];
+        uint64_t b = from > low ? from - low : 0;
+        while (b < 64) {
+            uint64_t rest = free >> b;
+            if ((rest & 1) == 0) {
+                carry = 0;
+                if (rest == 0) {
+                    return NO_RUN;
+                }
+                b += BitOps::countTrailingZeros(rest);
+                continue;
+            }
+            uint64_t length = ~rest == 0 ? 64 - b : BitOps::countTrailingZeros(~rest);
+            if (carry + length >= count) {
+                return low + b - carry;
+            }
+            carry += length;
+            b += length;
+        }
+        return NO_RUN;
+    }
+    uint64_t middle = low + (high - low) / 2;
+    uint64_t start = searchNode(node * 2, low, middle, from, count, carry);
+    return start != NO_RUN ? start : searchNode(node * 2 + 1, middle, high, from, count, carry);
+}
+
+uint64_t BlockAllocator::bestRun(uint64_t count) const {
+    // 依次取出已用区域内长度 >= count 的空闲段，保留最短的，遇到长度恰好相等的立即返回
+    uint64_t best = NO_RUN;
+    uint64_t bestLength = NO_RUN;
+    uint64_t position = 0;
+    while (position < highWater_) {
+        uint64_t start = searchRun(position, count);
+        if (start >= highWater_) {
+            break;
+        }
+        uint64_t length = nextUsed(start) - start;
+        if (length < bestLength) {
+            best = start;
+            bestLength = length;
+            if (length == count) {
+                break;
+            }
+        }
+        position = start + length;
+    }
+    return best;
+}
+
+void BlockAllocator::gather(uint64_t from, uint64_t count, std::vector<Run>& runs) {
+    // 依次取 [from, highWater_) 和 [0, from) 中的空闲块，仍不够时从末尾扩展。
+    // 按字批量占用：一个字中的空闲位一次取走，叶子立即更新；连续取用的字的祖先节点
+    // 在这一段结束时统一更新（期间祖先只会高估空闲空间，nextFree 仍以叶子的位图为准）
+    auto append = [&runs](uint64_t start, uint64_t length) {
+        if (!runs.empty() && runs.back().start + runs.back().length == start) {
+            runs.back().length += length;
+        } else {
+            runs.push_back({start, length});
+        }
+    };
+    uint64_t remaining = count;
+    size_t pendingFirst = 0;
+    size_t pendingLast = 0;
+    bool pending = false;
+    uint64_t ranges[2][2] = {{from, highWater_}, {0, std::min(from, highWater_)}};
+    for (const auto& range : ranges) {
+        uint64_t position = range[0];
+        while (remaining > 0 && position < range[1]) {
+            // 当前字还有空闲位时不必从根节点查找
+            size_t w = static_cast<size_t>(position / 64);
+            if (w >= words_.size() || (~words_[w] & (~uint64_t(0) << (position % 64))) == 0) {
+                position = nextFree(position);
+                if (position >= range[1]) {
+                    break;
+                }
+                w = static_cast<size_t>(position / 64);
+            }
+            uint64_t low = static_cast<uint64_t>(w) * 64;
+            uint64_t free = ~words_[w] & (~uint64_t(0) << (position - low));
+            if (range[1] - low < 64) {
+                free &= (uint64_t(1) << (range[1] - low)) - 1;
+            }
+            uint64_t taken = free;
+            if (static_cast<uint64_t>(BitOps::popcount(free)) > remaining) {
+                taken = 0;
+                for (uint64_t i = 0; i < remaining; i++) {
+                    uint64_t lowest = free & (~free + 1);
+                    taken |= lowest;
+                    free ^= lowest;
+                }
+            }
+            words_[w] |= taken;
+            used_ += static_cast<uint64_t>(BitOps::popcount(taken));
+            remaining -= static_cast<uint64_t>(BitOps::popcount(taken));
+            updateLeaf(w);
+            if (pending && w != pendingLast + 1) {
+                updateAncestors(pendingFirst, pendingLast);
+                pending = false;
+            }
+            pendingFirst = pending ? pendingFirst : w;
+            pendingLast = w;
+            pending = true;
+            // 取走的位按段输出
+            while (taken) {
+                unsigned start = static_cast<unsigned>(BitOps::countTrailingZeros(taken));
+                uint64_t shifted = ~(taken >> start);
+                unsigned length = shifted ? static_cast<unsigned>(BitOps::countTrailingZeros(shifted)) : 64 - start;
+                append(low + start, length);
+                taken &= length + start >= 64 ? 0 : ~uint64_t(0) << (start + length);
+            }
+            position = low + 64;
+        }
+    }
+    if (pending) {
+        updateAncestors(pendingFirst, pendingLast);
+    }
+    if (remaining > 0) {
+        uint64_t start = highWater_;
+        markRange(start, remaining, true);
+        append(start, remaining);
+    }
+}
+
+uint64_t BlockAllocator::nextFree(uint64_t from) const {
+    if (from >= capacity()) {
+        return from;  // 位图之外全部空闲
+    }
+    return nextMatching(1, 0, capacity(), from, false);
+}
+
+uint64_t BlockAllocator::nextUsed(uint64_t from) const {
+    if (from >= capacity()) {
+        return capacity();
+    }
+    return nextMatching(1, 0, capacity(), from, true);
+}
+
+uint64_t BlockAllocator::nextMatching(size_t node, uint64_t low, uint64_t high, uint64_t from, bool used) const {
+    // 跳过位于 from 之前的节点，以及全满（找空闲时）或全空（找已用时）的节点
+    if (high <= from || (used ? prefix_[node] == high - low : longest_[node] == 0)) {
+        return high;
+    }
+    if (node >= words_.size()) {
+        uint64_t word = used ? words_[node - words_.size()] : ~words_[node - words_.size()];
+        if (from > low) {
+            word &= ~uint64_t(0) << (from - low);
+        }
+        return word ? low + static_cast<uint64_t>(BitOps::countTrailingZeros(word)) : high;
+    }
+    uint64_t middle = low + (high - low) / 2;
+    uint64_t position = nextMatching(node * 2, low, middle, from, used);
+    return position < middle ? position : nextMatching(node * 2 + 1, middle, high, from, used);
+}
+
+void BlockAllocator::markRange(uint64_t start, uint64_t length, bool used) {
+    if (length == 0) {
+        return;
+    }
+    uint64_t end = start + length;
+    if (used) {
+        ensureCapacity(end);
+    } else {
+        end = std::min(end, capacity());
+        if (start >= end) {
+            return;
+        }
+        ensureCapacity(0);
+    }
+
+    size_t firstWord = static_cast<size_t>(start / 64);
+    size_t lastWord = static_cast<size_t>((end - 1) / 64);
+    for (size_t w = firstWord; w <= lastWord; w++) {
+        uint64_t mask = ~uint64_t(0);
+        if (w == firstWord) {
+            mask &= ~uint64_t(0) << (start % 64);
+        }
+        if (w == lastWord && end % 64 != 0) {
+            mask &= ~uint64_t(0) >> (64 - end % 64);
+        }
+        uint64_t before = words_[w];
+        uint64_t after = used ? (before | mask) : (before & ~mask);
+        words_[w] = after;
+        used_ += static_cast<uint64_t>(BitOps::popcount(after));
+        used_ -= static_cast<uint64_t>(BitOps::popcount(before));
+        updateLeaf(w);
+    }
+    updateAncestors(firstWord, lastWord);
+}
+
+void BlockAllocator::updateAncestors(size_t firstWord, size_t lastWord) {
+    // 自底向上逐层更新 [firstWord, lastWord] 对应叶子的祖先节点
+    size_t leaves = words_.size();
+    size_t low = (leaves + firstWord) / 2;
+    size_t high = (leaves + lastWord) / 2;
+    for (uint32_t half = 64; low >= 1; half *= 2, low /= 2, high /= 2) {
+        for (size_t node = low; node <= high; node++) {
+            updateNode(node, half);
+        }
+    }
+    // 已用区域的结尾 = 位图容量 - 末尾的空闲长度
+    highWater_ = capacity() - suffix_[1];
+}
+
+void BlockAllocator::ensureCapacity(uint64_t blocks) {
+    // 线段树要求字数为 2 的幂；adopt() 之后的位图在第一次修改时补齐并建树
+    size_t needed = static_cast<size_t>((blocks + 63) / 64);
+    size_t size = words_.size();
+    bool treeReady = prefix_.size() == size * 2 && size > 0;
+    if (treeReady && needed <= size) {
+        return;
+    }
+    size_t target = std::max({needed, size, MIN_CAPACITY_WORDS});
+    size_t rounded = 1;
+    while (rounded < target) {
+        rounded *= 2;
+    }
+    if (treeReady && needed > size) {
+        rounded = std::max(rounded, size * 2);
+    }
+    words_.resize(rounded, 0);
+    rebuildTree();
+}
+
+void BlockAllocator::rebuildTree() {
+    size_t leaves = words_.size();
+    prefix_.assign(leaves * 2, 0);
+    suffix_.assign(leaves * 2, 0);
+    longest_.assign(leaves * 2, 0);
+    for (size_t w = 0; w < leaves; w++) {
+        updateLeaf(w);
+    }
+    uint32_t half = 64;
+    for (size_t levelStart = leaves / 2; levelStart >= 1; levelStart /= 2, half *= 2) {
+        for (size_t node = levelStart; node < levelStart * 2; node++) {
+            updateNode(node, half);
+        }
+    }
+}
+
+void BlockAllocator::updateLeaf(size_t word) {
+    uint64_t bits = words_[word];
+    size_t node = words_.size() + word;
+    if (bits == 0) {
+        prefix_[node] = suffix_[node] = longest_[node] = 64;
+        return;
+    }
+    prefix_[node] = static_cast<uint32_t>(BitOps::countTrailingZeros(bits));
+    suffix_[node] = static_cast<uint32_t>(BitOps::countLeadingZeros(bits));
+    // 最长的 0 位段：runs[k] 标出长度 >= 2^k 的空闲段的起点，再从大到小逐位确定段长，
+    // 固定 11 次移位与运算，与空闲段的数量和长度无关
+    uint64_t runs[6];
+    runs[0] = ~bits;
+    for (int k = 1; k < 6; k++) {
+        runs[k] = runs[k - 1] & (runs[k - 1] >> (1u << (k - 1)));
+    }
+    uint32_t longest = 0;
+    uint64_t starts = ~uint64_t(0);   // 长度 >= longest 的空闲段的起点
+    for (int k = 5; k >= 0; k--) {
+        uint64_t longer = starts & (runs[k] >> longest);
+        if (longer != 0) {
+            starts = longer;
+            longest += 1u << k;
+        }
+    }
+    longest_[node] = longest;
+}
+
+void BlockAllocator::updateNode(size_t node, uint32_t half) {
+    size_t left = node * 2;
+    size_t right = left + 1;
+    prefix_[node] = prefix_[left] == half ? half + prefix_[right] : prefix_[left];
+    suffix_[node] = suffix_[right] == half ? half + suffix_[left] : suffix_[right];
+    longest_[node] = std::max({longest_[left], longest_[right], suffix_[left] + prefix_[right]});
+}
+
+template <typename NextRun>
+void BlockAllocator::releaseEach(NextRun nextRun) {
+    // 先清除位图，相邻或重叠的字区间合并后再统一更新祖先节点；
+    // 落在同一个字中的多个段（如逐块释放）只在离开该字时更新一次叶子
+    ensureCapacity(0);
+    size_t pendingFirst = 0;
+    size_t pendingLast = 0;
+    bool pending = false;
+    size_t dirtyLeaf = 0;
+    bool dirty = false;
+    Run run;
+    while (nextRun(run)) {
+        uint64_t end = std::min(run.start + run.length, capacity());
+        if (run.length == 0 || run.start >= end) {
+            continue;
+        }
+        size_t firstWord = static_cast<size_t>(run.start / 64);
+        size_t lastWord = static_cast<size_t>((end - 1) / 64);
+        for (size_t w = firstWord; w <= lastWord; w++) {
+            uint64_t mask = ~uint64_t(0);
+            if (w == firstWord) {
+                mask &= ~uint64_t(0) << (run.start % 64);
+            }
+            if (w == lastWord && end % 64 != 0) {
+                mask &= ~uint64_t(0) >> (64 - end % 64);
+            }
+            used_ -= static_cast<uint64_t>(BitOps::popcount(words_[w] & mask));
+            words_[w] &= ~mask;
+            if (dirty && dirtyLeaf != w) {
+                updateLeaf(dirtyLeaf);
+            }
+            dirtyLeaf = w;
+            dirty = true;
+        }
+        if (pending && firstWord <= pendingLast + 1 && lastWord + 1 >= pendingFirst) {
+            pendingFirst = std::min(pendingFirst, firstWord);
+            pendingLast = std::max(pendingLast, lastWord);
+            continue;
+        }
+        if (pending) {
+            updateAncestors(pendingFirst, pendingLast);
+        }
+        pendingFirst = firstWord;
+        pendingLast = lastWord;
+        pending = true;
+    }
+    if (dirty) {
+        updateLeaf(dirtyLeaf);
+    }
+    if (pending) {
+        updateAncestors(pendingFirst, pendingLast);
+    }
+}
+
+void BlockAllocator::releaseRuns(const std::vector<Run>& runs) {
+    size_t i = 0;
+    releaseEach([&runs, &i](Run& run) {
+        if (i >= runs.size()) {
+            return false;
+        }
+        run = runs[i++];
+        return true;
+    });
+}
+
+void BlockAllocator::release(const std::vector<int>& blocks) {
+    // 连续的块号边读边合并成段，不生成中间的段列表（逐块释放时可能有数百万段）
+    size_t i = 0;
+    releaseEach([&blocks, &i](Run& run) {
+        while (i < blocks.size() && blocks[i] < 0) {
+            i++;
+        }
+        if (i >= blocks.size()) {
+            return false;
+        }
+        run = {static_cast<uint64_t>(blocks[i]), 1};
+        for (i++; i < blocks.size() && blocks[i] >= 0 &&
+                  static_cast<uint64_t>(blocks[i]) == run.start + run.length; i++) {
+            run.length++;
+        }
+        return true;
+    });
+}
+
+void BlockAllocator::settle() {
+    for (const auto& ghost : ghosts_) {
+        releaseRuns(ghost);
+    }
+    ghosts_.clear();
+}
+
+size_t BlockAllocator::memoryBytes() const {
+    return words_.capacity() * sizeof(uint64_t)
+        + (prefix_.capacity() + suffix_.capacity() + longest_.capacity()) * sizeof(uint32_t)
+        + ghosts_.capacity() * (sizeof(std::vector<Run>) + sizeof(Run));
+}
+
+void BlockAllocator::adopt(std::vector<uint64_t>&& bitmap) {
+    words_ = std::move(bitmap);
+    prefix_.clear();
+    suffix_.clear();
+    longest_.clear();
+    used_ = 0;
+    highWater_ = 0;
+    for (size_t w = 0; w < words_.size(); w++) {
+        used_ += static_cast<uint64_t>(BitOps::popcount(words_[w]));
+        if (words_[w] != 0) {
+            highWater_ = w * 64 + 64 - static_cast<uint64_t>(BitOps::countLeadingZeros(words_[w]));
+        }
+    }
+    cursor_ = 0;
+    ghosts_.clear();
+}
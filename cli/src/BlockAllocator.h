@@ -0,0 +1,113 @@
+#ifndef BLOCK_ALLOCATOR_H
+#define BLOCK_ALLOCATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 模拟磁盘的块分配器：以位图管理空闲空间，并在位图的字之上维护一棵线段树，
+// 每个节点记录区间内的前缀空闲长度、后缀空闲长度和最长空闲段，
+// 首次/下次适配查找空闲段、查找下一个空闲/已用块都是 O(log n)。
+// 支持三种分配方式：
+//   - continuous：为整个文件寻找一段连续空闲块（首次/下次/最佳适配）
+//   - linked：    按适配策略的起点依次取空闲块，可分散在多个空洞中（FAT 式链接分配）
+//   - indexed：   与 linked 相同地放置数据块，另外按每块可容纳的指针数分配索引块
+// 磁盘没有固定大小：已用区域（highWater）之后视为无限长的空闲段。
+// 可选的 churn 模式在分配时穿插创建并随机删除临时文件，使空闲空间产生真实的碎片。
+// 非线程安全，由调用方加锁。
+class BlockAllocator {
+public:
+    enum class Policy { Continuous, Linked, Indexed };
+    enum class Fit { First, Next, Best };
+
+    BlockAllocator();
+
+    static bool parsePolicy(const std::string& name, Policy& policy);
+    static bool parseFit(const std::string& name, Fit& fit);
+    static const char* policyName(Policy policy);
+
+    void setPolicy(Policy policy) { policy_ = policy; }
+    void setFit(Fit fit) { fit_ = fit; }
+    Policy policy() const { return policy_; }
+    Fit fit() const { return fit_; }
+
+    // 块大小决定索引块能容纳的指针数（每个指针 4 字节）
+    void setBlockSize(size_t blockSize);
+
+    // ratio 为每次分配前创建一个临时文件的概率（0 关闭），临时文件随后被随机删除
+    void setChurn(double ratio, uint64_t seed = 0x9E3779B97F4A7C15ULL);
+
+    // 为 count 个数据块分配空间并按文件内顺序追加到 out；索引分配时索引块追加在数据块之后
+    void allocate(size_t count, std::vector<int>& out);
+
+    // 释放块（重复释放是安全的）
+    void release(const std::vector<int>& blocks);
+
+    // 删除 churn 模式中仍然存在的临时文件，留下空洞
+    void settle();
+
+    // 直接使用外部提供的分配位图（镜像模式）
+    void adopt(std::vector<uint64_t>&& bitmap);
+
+    bool isUsed(uint64_t block) const {
+        return block / 64 < words_.size() && (words_[block / 64] >> (block % 64)) & 1;
+    }
+    uint64_t usedCount() const { return used_; }
+    uint64_t highWater() const { return highWater_; }   // 最大已用块号 + 1
+    const std::vector<uint64_t>& bitmap() const { return words_; }
+
+    // 位图、线段树和 churn 临时文件占用的堆内存（估算，临时文件按每个一段计）
+    size_t memoryBytes() const;
+
+private:
+    struct Run {
+        uint64_t start;
+        uint64_t length;
+    };
+
+    void allocateRuns(size_t count, std::vector<Run>& runs);
+    uint64_t findRun(uint64_t count);
+    uint64_t bestRun(uint64_t count) const;
+    void gather(uint64_t from, uint64_t count, std::vector<Run>& runs);
+
+    // 起点 >= from、长度 >= count 的第一个空闲段（位图之外视为无限长的空闲区域）
+    uint64_t searchRun(uint64_t from, uint64_t count) const;
+    uint64_t searchNode(size_t node, uint64_t low, uint64_t high, uint64_t from, uint64_t count,
+                        uint64_t& carry) const;
+    // >= from 的第一个空闲/已用块（不存在时返回位图容量）
+    uint64_t nextFree(uint64_t from) const;
+    uint64_t nextUsed(uint64_t from) const;
+    uint64_t nextMatching(size_t node, uint64_t low, uint64_t high, uint64_t from, bool used) const;
+
+    void markRange(uint64_t start, uint64_t length, bool used);
+    void ensureCapacity(uint64_t blocks);
+    void rebuildTree();
+    void updateLeaf(size_t word);
+    void updateNode(size_t node, uint32_t half);
+    void updateAncestors(size_t firstWord, size_t lastWord);
+    void releaseRuns(const std::vector<Run>& runs);
+    // nextRun(Run&) 依次给出要释放的段，返回 false 表示结束（定义在 .cpp 中）
+    template <typename NextRun>
+    void releaseEach(NextRun nextRun);
+    uint64_t capacity() const { return static_cast<uint64_t>(words_.size()) * 64; }
+    uint64_t nextRandom();
+
+    Policy policy_;
+    Fit fit_;
+    uint64_t pointersPerBlock_;
+
+    std::vector<uint64_t> words_;      // 已用块位图，字数始终为 2 的幂
+    // 线段树（节点 1 为根，叶子 words_.size() + w 对应 words_[w]），单位为块
+    std::vector<uint32_t> prefix_;     // 区间开头的空闲长度
+    std::vector<uint32_t> suffix_;     // 区间结尾的空闲长度
+    std::vector<uint32_t> longest_;    // 区间内最长的空闲段
+    uint64_t used_;
+    uint64_t highWater_;
+    uint64_t cursor_;                  // 下次适配的起点
+
+    double churn_;
+    uint64_t random_;
+    std::vector<std::vector<Run>> ghosts_;   // churn 模式中尚未删除的临时文件
+};
+
+#endif // BLOCK_ALLOCATOR_H
@@ -0,0 +1,213 @@
+#include "ConcurrencyTuner.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#ifndef _WIN32
+#include <sched.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+// 读取文件第一行
+bool readFirstLine(const std::string& path, std::string& line) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        return false;
+    }
+    return static_cast<bool>(std::getline(in, line));
+}
+
+// cgroup v2: cpu.max 格式为 "<quota> <period>" 或 "max <period>"
+// 返回 quota/period，无限制时返回 0
+double readCgroupV2Limit(const std::string& dir) {
+    std::string line;
+    if (!readFirstLine(dir + "/cpu.max", line)) {
+        return 0.0;
+    }
+    std::istringstream iss(line);
+    std::string quota;
+    long long period = 0;
+    iss >> quota >> period;
+    if (quota == "max" || period <= 0) {
+        return 0.0;
+    }
+    try {
+        long long q = std::stoll(quota);
+        return q > 0 ? static_cast<double>(q) / period : 0.0;
+    } catch (const std::exception&) {
+        return 0.0;
+    }
+}
+
+// cgroup v1: cpu.cfs_quota_us / cpu.cfs_period_us，quota 为 -1 表示无限制
+double readCgroupV1Limit(const std::string& dir) {
+    std::string quotaLine, periodLine;
+    if (!readFirstLine(dir + "/cpu.cfs_quota_us", quotaLine) ||
+        !readFirstLine(dir + "/cpu.cfs_period_us", periodLine)) {
+        return 0.0;
+    }
+    try {
+        long long quota = std::stoll(quotaLine);
+        long long period = std::stoll(periodLine);
+        if (quota <= 0 || period <= 0) {
+            return 0.0;
+        }
+        return static_cast<double>(quota) / period;
+    } catch (const std::exception&) {
+        return 0.0;
+    }
+}
+
+// 取多个限制中最严格的一个（0 表示无限制）
+double tighter(double a, double b) {
+    if (a <= 0.0) return b;
+    if (b <= 0.0) return a;
+    return std::min(a, b);
+}
+
+// 解析 /proc/self/cgroup，计算 CPU 配额（沿 cgroup 层级向上取最严格的限制）
+double cgroupCpuLimit() {
+    std::ifstream in("/proc/self/cgroup");
+    if (!in.is_open()) {
+        return 0.0;
+    }
+
+    double limit = 0.0;
+    std::string line;
+    while (std::getline(in, line)) {
+        // 格式: hierarchy-ID:controller-list:cgroup-path
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string cgroupPath = line.substr(second + 1);
+
+        if (controllers.empty()) {
+            // cgroup v2 统一层级
+            std::string dir = "/sys/fs/cgroup" + (cgroupPath == "/" ? std::string() : cgroupPath);
+            while (true) {
+                limit = tighter(limit, readCgroupV2Limit(dir));
+                if (dir == "/sys/fs/cgroup") break;
+                dir = dir.substr(0, dir.rfind('/'));
+            }
+        } else {
+            std::istringstream list(controllers);
+            std::string controller;
+            bool hasCpu = false;
+            while (std::getline(list, controller, ',')) {
+                if (controller == "cpu") hasCpu = true;
+            }
+            if (!hasCpu) {
+                continue;
+            }
+            // 容器内 cgroup 路径可能是宿主机路径，而挂载点已被命名空间化，所以同时检查挂载根目录
+            for (const char* mount : {"/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu"}) {
+                limit = tighter(limit, readCgroupV1Limit(std::string(mount) + cgroupPath));
+                limit = tighter(limit, readCgroupV1Limit(mount));
+            }
+        }
+    }
+    return limit;
+}
+#endif
+
+} // namespace
+
+ConcurrencyTuner::ConcurrencyTuner(size_t initialWorkers, size_t minWorkers, size_t maxWorkers)
+    : target_(std::min(std::max(initialWorkers, minWorkers), maxWorkers))
+    , peak_(target_.load())
+    , minWorkers_(minWorkers)
+    , maxWorkers_(maxWorkers)
+    , ops_(0)
+    , latencyNs_(0)
+    , lastSample_(std::chrono::steady_clock::now())
+    , lastThroughput_(0.0)
+    , baselineLatency_(0.0)
+    , direction_(1)
+{
+}
+
+size_t ConcurrencyTuner::effectiveCpuCount() {
+    size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+#ifndef _WIN32
+    // cpuset / taskset 限制
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        int count = CPU_COUNT(&set);
+        if (count > 0) {
+            cpus = std::min(cpus, static_cast<size_t>(count));
+        }
+    }
+    // CFS 带宽配额（向上取整，配额 1.5 核时允许 2 个线程）
+    double quota = cgroupCpuLimit();
+    if (quota > 0.0) {
+        cpus = std::min(cpus, static_cast<size_t>(std::max(1.0, std::ceil(quota))));
+    }
+#endif
+    return cpus;
+}
+
+void ConcurrencyTuner::recordOperation(std::chrono::nanoseconds latency) {
+    ops_.fetch_add(1, std::memory_order_relaxed);
+    latencyNs_.fetch_add(static_cast<unsigned long long>(latency.count()), std::memory_order_relaxed);
+}
+
+size_t ConcurrencyTuner::adjust(size_t pendingWork) {
+    std::lock_guard<std::mutex> lock(adjustMutex_);
+
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - lastSample_).count();
+    unsigned long long ops = ops_.exchange(0);
+    unsigned long long latencyNs = latencyNs_.exchange(0);
+    lastSample_ = now;
+
+    size_t current = target_.load();
+    // 样本太少时数据噪声过大，不做调整
+    if (ops < 64 || seconds <= 0.0) {
+        return current;
+    }
+
+    double throughput = ops / seconds;
+    double latency = static_cast<double>(latencyNs) / ops;
+    if (baselineLatency_ == 0.0) {
+        baselineLatency_ = latency;
+    }
+
+    if (lastThroughput_ > 0.0) {
+        if (throughput < lastThroughput_ * 0.95) {
+            // 上一步使吞吐量下降，反向调整
+            direction_ = -direction_;
+        } else if (throughput <= lastThroughput_ * 1.05) {
+            // 吞吐量持平：若延迟明显上升说明新增线程只是在排队（如机械盘寻道），缩容；
+            // 否则继续向上试探（NVMe/网络文件系统需要更多并发请求）
+            direction_ = (latency > baselineLatency_ * 1.5) ? -1 : 1;
+        }
+    }
+
+    size_t step = std::max<size_t>(1, current / 8);
+    size_t next = current;
+    if (direction_ > 0) {
+        // 待处理工作不足以喂饱更多线程时不扩容
+        if (pendingWork > current) {
+            next = std::min(maxWorkers_, current + step);
+        }
+    } else {
+        next = (current > minWorkers_ + step) ? current - step : minWorkers_;
+    }
+
+    // 延迟基线取观测到的最小值，并缓慢上浮以适应长时间扫描中负载特征的变化
+    baselineLatency_ = std::min(latency, baselineLatency_ * 1.02);
+    lastThroughput_ = throughput;
+    target_.store(next);
+    if (next > peak_.load()) {
+        peak_.store(next);
+    }
+    return next;
+}
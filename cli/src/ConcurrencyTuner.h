@@ -0,0 +1,48 @@
+#ifndef CONCURRENCY_TUNER_H
+#define CONCURRENCY_TUNER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+// 并发度调节器：根据扫描过程中观测到的吞吐量和单次操作延迟，
+// 动态增减活跃工作线程数（爬山法）
+class ConcurrencyTuner {
+public:
+    ConcurrencyTuner(size_t initialWorkers, size_t minWorkers, size_t maxWorkers);
+
+    // 获取进程实际可用的 CPU 数量（考虑 cgroup CPU 配额和 cpuset/CPU 亲和性）
+    static size_t effectiveCpuCount();
+
+    // 工作线程每完成一次条目操作调用一次（无锁）
+    void recordOperation(std::chrono::nanoseconds latency);
+
+    // 由控制线程周期性调用，根据上一个采样周期的数据返回新的目标线程数
+    // pendingWork: 当前待处理的工作项数量（没有足够的工作时不扩容）
+    size_t adjust(size_t pendingWork);
+
+    size_t target() const { return target_.load(); }
+    size_t minWorkers() const { return minWorkers_; }
+    size_t maxWorkers() const { return maxWorkers_; }
+    size_t peakWorkers() const { return peak_.load(); }
+
+private:
+    std::atomic<size_t> target_;
+    std::atomic<size_t> peak_;
+    size_t minWorkers_;
+    size_t maxWorkers_;
+
+    // 当前采样周期的累计值
+    std::atomic<unsigned long long> ops_;
+    std::atomic<unsigned long long> latencyNs_;
+
+    // 控制状态（仅控制线程访问）
+    std::mutex adjustMutex_;
+    std::chrono::steady_clock::time_point lastSample_;
+    double lastThroughput_;
+    double baselineLatency_;
+    int direction_;  // +1 扩容, -1 缩容
+};
+
+#endif // CONCURRENCY_TUNER_H
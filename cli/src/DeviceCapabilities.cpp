@@ -0,0 +1,141 @@
+#include "DeviceCapabilities.h"
+#include <algorithm>
+#include <cstdio>
+#ifndef _WIN32
+#include <sys/sysmacros.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<uint64_t> nextInstance{1};
+
+#ifndef _WIN32
+struct KnownFileSystem {
+    uint32_t magic;
+    const char* name;
+    DeviceCapabilities::Strategy strategy;
+};
+
+// 网络/虚拟文件系统既没有 fiemap 也没有 bmap；FUSE 不转发 FIEMAP，但 fuseblk（如 ntfs-3g）支持 FIBMAP
+const KnownFileSystem KNOWN_FILE_SYSTEMS[] = {
+    {0x0000EF53, "ext4", DeviceCapabilities::Strategy::Unknown},
+    {0x58465342, "xfs", DeviceCapabilities::Strategy::Unknown},
+    {0x9123683E, "btrfs", DeviceCapabilities::Strategy::Unknown},
+    {0xF2F52010, "f2fs", DeviceCapabilities::Strategy::Unknown},
+    {0x00004D44, "vfat", DeviceCapabilities::Strategy::Unknown},
+    {0x2011BAB0, "exfat", DeviceCapabilities::Strategy::Unknown},
+    {0x5346544E, "ntfs", DeviceCapabilities::Strategy::Unknown},
+    {0x794C7630, "overlay", DeviceCapabilities::Strategy::Unknown},
+    {0x2FC12FC1, "zfs", DeviceCapabilities::Strategy::Unknown},
+    {0x65735546, "fuse", DeviceCapabilities::Strategy::NoFiemap},
+    {0x01021994, "tmpfs", DeviceCapabilities::Strategy::Simulated},
+    {0x858458F6, "ramfs", DeviceCapabilities::Strategy::Simulated},
+    {0x01021997, "9p", DeviceCapabilities::Strategy::Simulated},
+    {0x00006969, "nfs", DeviceCapabilities::Strategy::Simulated},
+    {0xFF534D42, "cifs", DeviceCapabilities::Strategy::Simulated},
+    {0xFE534D42, "smb2", DeviceCapabilities::Strategy::Simulated},
+    {0x0000517B, "smb", DeviceCapabilities::Strategy::Simulated},
+    {0x00C36400, "ceph", DeviceCapabilities::Strategy::Simulated},
+};
+#endif
+
+} // namespace
+
+DeviceCapabilities::DeviceCapabilities()
+#ifdef _WIN32
+    : privileged_(false)
+#else
+    : privileged_(geteuid() == 0)
+#endif
+    , instance_(nextInstance.fetch_add(1)) {
+}
+
+DeviceCapabilities::Device& DeviceCapabilities::lookup(unsigned long long deviceId, int fd) {
+    // 同一线程连续处理的文件几乎总在同一个设备上，命中时不加锁
+    thread_local uint64_t cachedInstance = 0;
+    thread_local unsigned long long cachedId = 0;
+    thread_local Device* cachedDevice = nullptr;
+    if (cachedInstance == instance_ && cachedId == deviceId) {
+        return *cachedDevice;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<Device>& slot = devices_[deviceId];
+    if (!slot) {
+        slot = std::make_unique<Device>();
+        slot->id = deviceId;
+        slot->strategy = static_cast<int>(identify(fd, slot->fileSystem));
+    }
+    cachedInstance = instance_;
+    cachedId = deviceId;
+    cachedDevice = slot.get();
+    return *slot;
+}
+
+void DeviceCapabilities::resolve(Device& device, Strategy from, Strategy to) {
+    int expected = static_cast<int>(from);
+    device.strategy.compare_exchange_strong(expected, static_cast<int>(to));
+}
+
+const char* DeviceCapabilities::name(Strategy strategy) {
+    switch (strategy) {
+        case Strategy::Fiemap:
+            return "fiemap";
+        case Strategy::Fibmap:
+            return "fibmap";
+        case Strategy::Simulated:
+            return "simulated";
+        default:
+            return "unknown";
+    }
+}
+
+std::vector<DeviceCapabilities::Report> DeviceCapabilities::report() const {
+    std::vector<std::pair<unsigned long long, Report>> sorted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& item : devices_) {
+            const Device& device = *item.second;
+#ifdef _WIN32
+            std::string id = std::to_string(device.id);
+#else
+            std::string id = std::to_string(major(device.id)) + ":" + std::to_string(minor(device.id));
+#endif
+            sorted.push_back({device.id, {id, device.fileSystem, name(strategyOf(device)), device.files.load()}});
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<Report> reports;
+    for (auto& item : sorted) {
+        reports.push_back(std::move(item.second));
+    }
+    return reports;
+}
+
+DeviceCapabilities::Strategy DeviceCapabilities::identify(int fd, std::string& fileSystem) {
+#ifdef _WIN32
+    (void)fd;
+    fileSystem = "unknown";
+    return Strategy::Unknown;
+#else
+    struct statfs info;
+    if (fstatfs(fd, &info) != 0) {
+        fileSystem = "unknown";
+        return Strategy::Unknown;
+    }
+    uint32_t magic = static_cast<uint32_t>(info.f_type);
+    for (const auto& known : KNOWN_FILE_SYSTEMS) {
+        if (known.magic == magic) {
+            fileSystem = known.name;
+            return known.strategy;
+        }
+    }
+    char hex[16];
+    std::snprintf(hex, sizeof(hex), "0x%x", magic);
+    fileSystem = hex;
+    return Strategy::Unknown;
+#endif
+}
@@ -0,0 +1,70 @@
+#ifndef DEVICE_CAPABILITIES_H
+#define DEVICE_CAPABILITIES_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 每个设备（st_dev）的 extent 探测能力缓存。不支持 FIEMAP 的文件系统（WSL2 的 9p、FUSE、
+// NFS/SMB、tmpfs 等）上逐个文件尝试 FIEMAP、再尝试 FIBMAP 会产生大量必然失败的系统调用：
+// 第一次遇到设备时按 statfs 的 magic 识别文件系统，已知不支持的直接定为模拟；
+// 其余设备由第一次探测的结果决定策略，之后该设备上的文件直接使用选定的策略。
+class DeviceCapabilities {
+public:
+    enum class Strategy {
+        Unknown,     // 尚未探测，先试 FIEMAP
+        NoFiemap,    // 已知不支持 FIEMAP，尚未试过 FIBMAP
+        Fiemap,
+        Fibmap,
+        Simulated    // 没有可用的 ioctl，直接使用模拟的 extent
+    };
+
+    struct Device {
+        unsigned long long id = 0;
+        std::string fileSystem;                  // statfs 识别出的文件系统名
+        std::atomic<int> strategy{0};
+        std::atomic<uint64_t> files{0};          // 在该设备上探测的文件数
+    };
+
+    struct Report {
+        std::string device;                      // "主:次"
+        std::string fileSystem;
+        std::string strategy;
+        uint64_t files;
+    };
+
+    DeviceCapabilities();
+
+    // 返回设备的记录；首次遇到该设备时在 fd 上 fstatfs 识别文件系统（线程安全）
+    Device& lookup(unsigned long long deviceId, int fd);
+
+    static Strategy strategyOf(const Device& device) {
+        return static_cast<Strategy>(device.strategy.load(std::memory_order_relaxed));
+    }
+
+    // 记录探测结果：只有设备仍处于 from 状态时才改为 to，并发的首次探测以先完成的为准
+    static void resolve(Device& device, Strategy from, Strategy to);
+
+    // 进程是否有 root 权限（FIBMAP 需要），构造时检查一次
+    bool privileged() const { return privileged_; }
+
+    static const char* name(Strategy strategy);
+
+    // 各设备最终选定的策略，按设备号排序
+    std::vector<Report> report() const;
+
+private:
+    // 按 statfs 的 magic 给出文件系统名和初始策略
+    static Strategy identify(int fd, std::string& fileSystem);
+
+    bool privileged_;
+    uint64_t instance_;                          // 区分线程缓存属于哪个实例
+    mutable std::mutex mutex_;
+    std::unordered_map<unsigned long long, std::unique_ptr<Device>> devices_;
+};
+
+#endif // DEVICE_CAPABILITIES_H
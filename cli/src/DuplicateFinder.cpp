@@ -0,0 +1,524 @@
+#include "DuplicateFinder.h"
+#include "SnapshotWriter.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint64_t EDGE_SIZE = 4096;            // 第 2 级读取的首尾长度
+const size_t READ_SIZE = 1 << 20;           // 完整读取时每次读 1MB
+
+// MurmurHash3 x64_128 的流式实现：按 16 字节分块，不足一块的部分留到下一次 update 或 finish
+class ContentHash {
+public:
+    void update(const char* data, size_t length) {
+        total_ += length;
+        if (pending_ > 0) {
+            size_t take = std::min(length, sizeof(tail_) - pending_);
+            std::memcpy(tail_ + pending_, data, take);
+            pending_ += take;
+            data += take;
+            length -= take;
+            if (pending_ < sizeof(tail_)) {
+                return;
+            }
+            block(tail_);
+            pending_ = 0;
+        }
+        for (; length >= 16; data += 16, length -= 16) {
+            block(data);
+        }
+        std::memcpy(tail_, data, length);
+        pending_ = length;
+    }
+
+    DuplicateFinder::Digest finish() {
+        uint64_t k1 = 0;
+        uint64_t k2 = 0;
+        const unsigned char* tail = reinterpret_cast<const unsigned char*>(tail_);
+        for (size_t i = pending_; i > 8; i--) {
+            k2 = (k2 << 8) | tail[i - 1];
+        }
+        for (size_t i = std::min<size_t>(pending_, 8); i > 0; i--) {
+            k1 = (k1 << 8) | tail[i - 1];
+        }
+        if (pending_ > 8) {
+            k2 *= C2;
+            k2 = rotl(k2, 33);
+            k2 *= C1;
+            h2_ ^= k2;
+        }
+        if (pending_ > 0) {
+            k1 *= C1;
+            k1 = rotl(k1, 31);
+            k1 *= C2;
+            h1_ ^= k1;
+        }
+
+        h1_ ^= total_;
+        h2_ ^= total_;
+        h1_ += h2_;
+        h2_ += h1_;
+        h1_ = mix(h1_);
+        h2_ = mix(h2_);
+        h1_ += h2_;
+        h2_ += h1_;
+        DuplicateFinder::Digest digest;
+        digest.high = h1_;
+        digest.low = h2_;
+        return digest;
+    }
+
+private:
+    static const uint64_t C1 = 0x87c37b91114253d5ULL;
+    static const uint64_t C2 = 0x4cf5ad432745937fULL;
+
+    static uint64_t rotl(uint64_t value, int shift) { return (value << shift) | (value >> (64 - shift)); }
+
+    static uint64_t mix(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    // 按小端序读取
+    static uint64_t load(const char* data) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; i--) {
+            value = (value << 8) | bytes[i];
+        }
+        return value;
+    }
+
+    void block(const char* data) {
+        uint64_t k1 = load(data);
+        uint64_t k2 = load(data + 8);
+        k1 *= C1;
+        k1 = rotl(k1, 31);
+        k1 *= C2;
+        h1_ ^= k1;
+        h1_ = rotl(h1_, 27);
+        h1_ += h2_;
+        h1_ = h1_ * 5 + 0x52dce729;
+        k2 *= C2;
+        k2 = rotl(k2, 33);
+        k2 *= C1;
+        h2_ ^= k2;
+        h2_ = rotl(h2_, 31);
+        h2_ += h1_;
+        h2_ = h2_ * 5 + 0x38495ab5;
+    }
+
+    uint64_t h1_ = 0;
+    uint64_t h2_ = 0;
+    uint64_t total_ = 0;
+    char tail_[16];
+    size_t pending_ = 0;
+};
+
+// 只读打开的输入文件；Linux 上不更新访问时间，并可向内核提示访问模式
+class InputFile {
+public:
+    explicit InputFile(const std::string& path) {
+#ifdef _WIN32
+        in_.open(path, std::ios::binary);
+#else
+        fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+        if (fd_ < 0 && errno == EPERM) {
+            fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+#endif
+    }
+
+    ~InputFile() {
+#ifndef _WIN32
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+#endif
+    }
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+#ifdef _WIN32
+    bool isOpen() const { return in_.is_open(); }
+#else
+    bool isOpen() const { return fd_ >= 0; }
+#endif
+
+    // 顺序读取整个文件：加大预读；读完后丢弃页缓存，避免挤掉其他进程的缓存
+    void adviseSequential() {
+#ifndef _WIN32
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    void adviseRandom() {
+#ifndef _WIN32
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_RANDOM);
+#endif
+    }
+    void dropCache() {
+#ifndef _WIN32
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    }
+
+    // 从 offset 读满 length 字节；文件变短或读取出错时返回 false
+    bool readAt(uint64_t offset, char* data, size_t length) {
+#ifdef _WIN32
+        in_.seekg(static_cast<std::streamoff>(offset));
+        return static_cast<bool>(in_.read(data, static_cast<std::streamsize>(length)));
+#else
+        while (length > 0) {
+            ssize_t count = pread(fd_, data, length, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            data += count;
+            offset += static_cast<uint64_t>(count);
+            length -= static_cast<size_t>(count);
+        }
+        return true;
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    std::ifstream in_;
+#else
+    int fd_ = -1;
+#endif
+};
+
+} // namespace
+
+DuplicateFinder::DuplicateFinder(size_t threads)
+    : threads_(std::max<size_t>(1, threads))
+    , bytesRead_(0) {
+}
+
+void DuplicateFinder::add(const FileEntry& entry) {
+    if (entry.type != EntryKind::File || entry.size == 0) {
+        return;
+    }
+    File file;
+    file.id = entry.id;
+    file.path = entry.physicalPath;
+    file.size = entry.size;
+    file.deviceId = entry.deviceId;
+    file.inode = entry.inode;
+    files_.push_back(std::move(file));
+}
+
+void DuplicateFinder::find() {
+    groups_.clear();
+    stats_ = Stats();
+    bytesRead_ = 0;
+
+    // 第 1 级：按大小分组，只使用已有的元数据；同一大小内同一 inode 的条目是硬链接
+    std::vector<uint32_t> order(files_.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        const File& x = files_[a];
+        const File& y = files_[b];
+        if (x.size != y.size) {
+            return x.size < y.size;
+        }
+        if (x.deviceId != y.deviceId) {
+            return x.deviceId < y.deviceId;
+        }
+        return x.inode != y.inode ? x.inode < y.inode : a < b;
+    });
+    std::vector<uint32_t> candidates;
+    for (size_t begin = 0, end = 0; begin < order.size(); begin = end) {
+        std::vector<uint32_t> sameSize;
+        for (end = begin; end < order.size() && files_[order[end]].size == files_[order[begin]].size; end++) {
+            const File& file = files_[order[end]];
+            if (!sameSize.empty()) {
+                const File& previous = files_[sameSize.back()];
+                if (file.inode != 0 && file.inode == previous.inode && file.deviceId == previous.deviceId) {
+                    stats_.hardLinks++;
+                    continue;
+                }
+            }
+            sameSize.push_back(order[end]);
+        }
+        if (sameSize.size() >= 2) {
+            candidates.insert(candidates.end(), sameSize.begin(), sameSize.end());
+        }
+    }
+    stats_.candidates = candidates.size();
+
+    // 第 2 级：首尾各 4KB
+    parallelFor(candidates, [this](File& file, std::vector<char>& buffer) { return hashEdges(file, buffer); });
+
+    // 不超过 8KB 的文件首尾已覆盖全部内容，其余的进入第 3 级完整读取
+    std::vector<std::vector<uint32_t>> finalGroups;
+    std::vector<uint32_t> remaining;
+    for (auto& group : partition(candidates)) {
+        if (files_[group[0]].size <= 2 * EDGE_SIZE) {
+            finalGroups.push_back(std::move(group));
+        } else {
+            remaining.insert(remaining.end(), group.begin(), group.end());
+        }
+    }
+    stats_.fullyHashed = remaining.size();
+    parallelFor(remaining, [this](File& file, std::vector<char>& buffer) { return hashContent(file, buffer); });
+    for (auto& group : partition(remaining)) {
+        finalGroups.push_back(std::move(group));
+    }
+
+    for (auto& members : finalGroups) {
+        std::sort(members.begin(), members.end(),
+                  [this](uint32_t a, uint32_t b) { return files_[a].path < files_[b].path; });
+        Group group;
+        group.size = files_[members[0]].size;
+        group.digest = files_[members[0]].digest;
+        group.files = std::move(members);
+        groups_.push_back(std::move(group));
+    }
+    std::sort(groups_.begin(), groups_.end(), [this](const Group& a, const Group& b) {
+        if (a.reclaimable() != b.reclaimable()) {
+            return a.reclaimable() > b.reclaimable();
+        }
+        return files_[a.files[0]].path < files_[b.files[0]].path;
+    });
+
+    for (const auto& file : files_) {
+        stats_.unreadable += file.failed ? 1 : 0;
+    }
+    stats_.bytesRead = bytesRead_.load();
+}
+
+void DuplicateFinder::parallelFor(std::vector<uint32_t>& indices, const Work& work) {
+    if (indices.empty()) {
+        return;
+    }
+    // 按物理位置的近似顺序（设备, inode）读取，机械盘上减少来回寻道
+    std::vector<uint32_t> order = indices;
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        const File& x = files_[a];
+        const File& y = files_[b];
+        return x.deviceId != y.deviceId ? x.deviceId < y.deviceId : x.inode < y.inode;
+    });
+
+    std::atomic<size_t> next(0);
+    auto run = [this, &order, &next, &work] {
+        std::vector<char> buffer;
+        for (size_t i = next++; i < order.size(); i = next++) {
+            File& file = files_[order[i]];
+            if (!work(file, buffer)) {
+                file.failed = true;
+            }
+        }
+    };
+    size_t count = std::min(threads_, order.size());
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < count; i++) {
+        pool.emplace_back(run);
+    }
+    run();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+bool DuplicateFinder::hashEdges(File& file, std::vector<char>& buffer) {
+    InputFile input(file.path);
+    if (!input.isOpen()) {
+        return false;
+    }
+    // 只读两小段，关闭预读以免把整个文件读进页缓存
+    input.adviseRandom();
+    ContentHash hash;
+    buffer.resize(2 * EDGE_SIZE);
+    if (file.size <= 2 * EDGE_SIZE) {
+        if (!input.readAt(0, buffer.data(), file.size)) {
+            return false;
+        }
+        hash.update(buffer.data(), file.size);
+    } else {
+        if (!input.readAt(0, buffer.data(), EDGE_SIZE) ||
+            !input.readAt(file.size - EDGE_SIZE, buffer.data() + EDGE_SIZE, EDGE_SIZE)) {
+            return false;
+        }
+        hash.update(buffer.data(), 2 * EDGE_SIZE);
+    }
+    bytesRead_ += std::min(file.size, 2 * EDGE_SIZE);
+    file.digest = hash.finish();
+    return true;
+}
+
+bool DuplicateFinder::hashContent(File& file, std::vector<char>& buffer) {
+    InputFile input(file.path);
+    if (!input.isOpen()) {
+        return false;
+    }
+    input.adviseSequential();
+    ContentHash hash;
+    buffer.resize(READ_SIZE);
+    for (uint64_t offset = 0; offset < file.size;) {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(READ_SIZE, file.size - offset));
+        if (!input.readAt(offset, buffer.data(), length)) {
+            return false;
+        }
+        hash.update(buffer.data(), length);
+        offset += length;
+        bytesRead_ += length;
+    }
+    input.dropCache();
+    file.digest = hash.finish();
+    return true;
+}
+
+std::vector<std::vector<uint32_t>> DuplicateFinder::partition(const std::vector<uint32_t>& indices) const {
+    std::vector<uint32_t> sorted;
+    for (uint32_t index : indices) {
+        if (!files_[index].failed) {
+            sorted.push_back(index);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [this](uint32_t a, uint32_t b) {
+        const File& x = files_[a];
+        const File& y = files_[b];
+        return x.size != y.size ? x.size < y.size : x.digest < y.digest;
+    });
+    std::vector<std::vector<uint32_t>> groups;
+    for (size_t begin = 0, end = 0; begin < sorted.size(); begin = end) {
+        const File& first = files_[sorted[begin]];
+        for (end = begin + 1; end < sorted.size() && files_[sorted[end]].size == first.size &&
+                              files_[sorted[end]].digest == first.digest;
+             end++) {
+        }
+        if (end - begin >= 2) {
+            groups.emplace_back(sorted.begin() + begin, sorted.begin() + end);
+        }
+    }
+    return groups;
+}
+
+uint64_t DuplicateFinder::reclaimableBytes() const {
+    uint64_t total = 0;
+    for (const auto& group : groups_) {
+        total += group.reclaimable();
+    }
+    return total;
+}
+
+size_t DuplicateFinder::redundantFileCount() const {
+    size_t total = 0;
+    for (const auto& group : groups_) {
+        total += group.files.size() - 1;
+    }
+    return total;
+}
+
+void DuplicateFinder::writeReport(const std::string& path) const {
+    SnapshotWriter writer(path, OutputCompressor::fromPath(path));
+    std::string& out = writer.buffer();
+
+    out += "{\n";
+    SnapshotWriter::appendKey(out, 1, "duplicateFiles");
+    SnapshotWriter::appendUnsigned(out, redundantFileCount());
+    out += ",\n";
+
+    SnapshotWriter::appendKey(out, 1, "groups");
+    out += groups_.empty() ? "[" : "[\n";
+    for (size_t g = 0; g < groups_.size(); g++) {
+        const Group& group = groups_[g];
+        if (g > 0) {
+            out += ",\n";
+        }
+        SnapshotWriter::appendIndent(out, 2);
+        out += "{\n";
+        SnapshotWriter::appendKey(out, 3, "files");
+        out += "[\n";
+        for (size_t i = 0; i < group.files.size(); i++) {
+            const File& file = files_[group.files[i]];
+            if (i > 0) {
+                out += ",\n";
+            }
+            SnapshotWriter::appendIndent(out, 4);
+            out += "{\n";
+            SnapshotWriter::appendKey(out, 5, "id");
+            SnapshotWriter::appendString(out, file.id);
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "path");
+            SnapshotWriter::appendString(out, file.path);
+            out += '\n';
+            SnapshotWriter::appendIndent(out, 4);
+            out += '}';
+        }
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 3);
+        out += "],\n";
+        char hash[33];
+        std::snprintf(hash, sizeof(hash), "%016llx%016llx", static_cast<unsigned long long>(group.digest.high),
+                      static_cast<unsigned long long>(group.digest.low));
+        SnapshotWriter::appendKey(out, 3, "hash");
+        SnapshotWriter::appendString(out, hash);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 3, "reclaimable");
+        SnapshotWriter::appendUnsigned(out, group.reclaimable());
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 3, "size");
+        SnapshotWriter::appendUnsigned(out, group.size);
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 2);
+        out += '}';
+        writer.flushIfNeeded();
+    }
+    if (!groups_.empty()) {
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 1);
+    }
+    out += "],\n";
+
+    SnapshotWriter::appendKey(out, 1, "reclaimableBytes");
+    SnapshotWriter::appendUnsigned(out, reclaimableBytes());
+    out += ",\n";
+
+    SnapshotWriter::appendKey(out, 1, "stats");
+    out += "{\n";
+    SnapshotWriter::appendKey(out, 2, "bytesRead");
+    SnapshotWriter::appendUnsigned(out, stats_.bytesRead);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 2, "candidates");
+    SnapshotWriter::appendUnsigned(out, stats_.candidates);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 2, "files");
+    SnapshotWriter::appendUnsigned(out, files_.size());
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 2, "fullyHashed");
+    SnapshotWriter::appendUnsigned(out, stats_.fullyHashed);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 2, "hardLinks");
+    SnapshotWriter::appendUnsigned(out, stats_.hardLinks);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 2, "unreadable");
+    SnapshotWriter::appendUnsigned(out, stats_.unreadable);
+    out += '\n';
+    SnapshotWriter::appendIndent(out, 1);
+    out += "}\n}";
+
+    writer.close();
+}
@@ -0,0 +1,95 @@
+#ifndef DUPLICATE_FINDER_H
+#define DUPLICATE_FINDER_H
+
+#include "FileEntry.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 扫描结束后按内容查找重复文件，分三级筛选，尽量少读磁盘：
+//   1. 按大小分组：大小唯一的文件不会被读取，同一 inode 的硬链接只算一个文件
+//   2. 大小相同的文件只读首尾各 4KB 计算部分哈希（不超过 8KB 的文件此时已读完整个内容）
+//   3. 部分哈希仍然相同的文件才完整读取（1MB 顺序读，posix_fadvise 提示顺序访问，读完丢弃页缓存）
+// 读取由独立的 I/O 线程池完成，每一级内按 (设备, inode) 排序分发以减少寻道。
+// 哈希为 128 位 MurmurHash3，用于识别重复内容而不是防篡改。
+class DuplicateFinder {
+public:
+    struct Digest {
+        uint64_t high = 0;
+        uint64_t low = 0;
+
+        bool operator==(const Digest& other) const { return high == other.high && low == other.low; }
+        bool operator<(const Digest& other) const {
+            return high != other.high ? high < other.high : low < other.low;
+        }
+    };
+
+    // 内容相同的一组文件
+    struct Group {
+        uint64_t size;
+        Digest digest;
+        std::vector<uint32_t> files;   // 按路径排序
+
+        // 每组保留一个副本时可回收的字节数
+        uint64_t reclaimable() const { return size * (files.size() - 1); }
+    };
+
+    struct Stats {
+        size_t candidates = 0;     // 大小与其他文件相同、读取了首尾的文件数
+        size_t fullyHashed = 0;    // 完整读取的文件数
+        uint64_t bytesRead = 0;
+        size_t hardLinks = 0;      // 与已有条目是同一 inode 而跳过的条目数
+        size_t unreadable = 0;     // 打开或读取失败而排除的文件数
+    };
+
+    explicit DuplicateFinder(size_t threads);
+
+    // 添加一个文件条目（find 之前调用；目录和空文件被忽略）
+    void add(const FileEntry& entry);
+
+    // 执行三级筛选
+    void find();
+
+    // 重复文件组，按可回收字节数从大到小排序
+    const std::vector<Group>& groups() const { return groups_; }
+    uint64_t reclaimableBytes() const;
+    // 除每组保留的一个之外的副本数
+    size_t redundantFileCount() const;
+    const Stats& stats() const { return stats_; }
+    const std::string& path(uint32_t file) const { return files_[file].path; }
+
+    // 写出 JSON 报告
+    void writeReport(const std::string& path) const;
+
+private:
+    struct File {
+        std::string id;
+        std::string path;
+        uint64_t size;
+        unsigned long long deviceId;
+        unsigned long long inode;
+        Digest digest;
+        bool failed = false;
+    };
+
+    using Work = std::function<bool(File&, std::vector<char>&)>;
+
+    // 在 I/O 线程池中对 indices 中的每个文件执行 work（work 返回 false 表示读取失败）
+    void parallelFor(std::vector<uint32_t>& indices, const Work& work);
+    // 首尾各 4KB 的哈希；不超过 8KB 的文件为整个内容的哈希
+    bool hashEdges(File& file, std::vector<char>& buffer);
+    // 整个内容的哈希
+    bool hashContent(File& file, std::vector<char>& buffer);
+    // 把 indices 按 (大小, 哈希) 划分，返回成员不少于 2 个的组（跳过读取失败的文件）
+    std::vector<std::vector<uint32_t>> partition(const std::vector<uint32_t>& indices) const;
+
+    size_t threads_;
+    std::vector<File> files_;
+    std::vector<Group> groups_;
+    Stats stats_;
+    std::atomic<uint64_t> bytesRead_;
+};
+
+#endif // DUPLICATE_FINDER_H
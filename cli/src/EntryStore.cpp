@@ -0,0 +1,369 @@
+#include "EntryStore.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+const char SPILL_MAGIC[8] = {'F', 'C', 'O', 'N', 'S', 'P', 'L', '3'};
+
+void putU64(std::string& out, uint64_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putU32(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(std::string& out, const std::string& value) {
+    putU32(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+bool getU64(std::istream& in, unsigned long long& value) {
+    uint64_t raw = 0;
+    if (!in.read(reinterpret_cast<char*>(&raw), sizeof(raw))) {
+        return false;
+    }
+    value = raw;
+    return true;
+}
+
+bool getU32(std::istream& in, uint32_t& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool getString(std::istream& in, std::string& value) {
+    uint32_t length = 0;
+    if (!getU32(in, length)) {
+        return false;
+    }
+    value.resize(length);
+    return length == 0 || static_cast<bool>(in.read(&value[0], length));
+}
+
+// 生成唯一的溢出文件名
+std::string makeSpillPath(const std::string& dir) {
+    static std::atomic<unsigned> counter(0);
+    static const unsigned long long token = std::random_device{}();
+    std::filesystem::path base = dir.empty() ? std::filesystem::temp_directory_path()
+                                             : std::filesystem::path(dir);
+    return (base / ("fcon-spill-" + std::to_string(token) + "-" +
+                    std::to_string(counter.fetch_add(1)) + ".bin")).string();
+}
+
+} // namespace
+
+EntryStore::EntryStore()
+    : firstSeq_(0)
+    , nextSeq_(0)
+    , memoryBytes_(0)
+    , memoryLimit_(0)
+    , addedBytes_(0)
+    , reservedBytes_(0)
+    , inFlightEntries_(0)
+{
+}
+
+EntryStore::~EntryStore() {
+    for (const auto& chunk : chunks_) {
+        std::error_code ec;
+        std::filesystem::remove(chunk.path, ec);
+    }
+}
+
+size_t EntryStore::estimateSize(const FileEntry& entry) {
+    return sizeof(FileEntry)
+        + entry.id.capacity() + entry.name.capacity()
+        + entry.parentId.capacity() + entry.createTime.capacity() + entry.physicalPath.capacity()
+        + entry.blocks.capacity() * sizeof(int)
+        + entry.extents.capacity() * sizeof(ExtentInfo);
+}
+
+size_t EntryStore::entryBudget() const {
+    unsigned long long averageEntry = nextSeq_ == 0 ? sizeof(FileEntry) : addedBytes_ / nextSeq_;
+    unsigned long long charged = reservedBytes_.load(std::memory_order_relaxed)
+        + inFlightEntries_.load(std::memory_order_relaxed) * averageEntry;
+    size_t floor = memoryLimit_ / 8;
+    return charged + floor >= memoryLimit_ ? floor : memoryLimit_ - static_cast<size_t>(charged);
+}
+
+void EntryStore::add(FileEntry entry) {
+    size_t entrySize = estimateSize(entry);
+    bool overBudget = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.push_back(std::move(entry));
+        nextSeq_++;
+        memoryBytes_ += entrySize;
+        addedBytes_ += entrySize;
+        // 一半预算留给正在写出的溢出块，保证内存中的条目总量不超过留给条目的预算
+        overBudget = memoryLimit_ > 0 && memoryBytes_ > entryBudget() / 2;
+    }
+    if (!overBudget) {
+        return;
+    }
+
+    // 同一时间只有一个溢出块在内存中等待写出；其他超出预算的线程在此等待（反压）
+    std::lock_guard<std::mutex> spillLock(spillMutex_);
+    std::vector<FileEntry> toSpill;
+    unsigned long long spillSeq = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (memoryBytes_ <= entryBudget() / 2) {
+            return;  // 其他线程已经完成了溢出
+        }
+        toSpill.swap(entries_);
+        spillSeq = firstSeq_;
+        firstSeq_ = nextSeq_;
+        memoryBytes_ = 0;
+    }
+    spill(toSpill, spillSeq);
+}
+
+void EntryStore::spill(std::vector<FileEntry>& entries, unsigned long long firstSeq) {
+    Chunk chunk;
+    chunk.path = makeSpillPath(spillDir_);
+    chunk.firstSeq = firstSeq;
+    chunk.count = entries.size();
+
+    std::ofstream out(chunk.path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("无法创建溢出文件: " + chunk.path);
+    }
+    out.write(SPILL_MAGIC, sizeof(SPILL_MAGIC));
+
+    // 条目在块内已按序号有序（插入顺序），逐条序列化并分批写出
+    std::string buffer;
+    buffer.reserve(1 << 20);
+    for (auto& entry : entries) {
+        serialize(buffer, entry);
+        entry = FileEntry();  // 尽早释放已写出条目的内存
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.close();
+    if (!out) {
+        throw std::runtime_error("写入溢出文件失败: " + chunk.path);
+    }
+    std::vector<FileEntry>().swap(entries);
+
+    std::lock_guard<std::mutex> lock(chunksMutex_);
+    chunks_.push_back(std::move(chunk));
+}
+
+void EntryStore::forEachBatch(size_t batchSize, const BatchVisitor& visitor) const {
+    batchSize = std::max<size_t>(1, batchSize);
+    bool inMemory = false;
+    {
+        std::lock_guard<std::mutex> chunksLock(chunksMutex_);
+        inMemory = chunks_.empty();
+    }
+
+    if (inMemory) {
+        // 没有溢出：批次直接引用内存中的条目，无需拷贝
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t start = 0; start < entries_.size(); start += batchSize) {
+            auto batch = std::make_shared<EntryBatch>();
+            size_t end = std::min(entries_.size(), start + batchSize);
+            batch->items.reserve(end - start);
+            for (size_t i = start; i < end; i++) {
+                batch->items.push_back(&entries_[i]);
+            }
+            visitor(batch);
+        }
+        return;
+    }
+
+    // 有溢出：归并结果拷贝到批次自有的存储中
+    auto batch = std::make_shared<EntryBatch>();
+    batch->owned.reserve(batchSize);
+    auto emit = [&]() {
+        for (const auto& entry : batch->owned) {
+            batch->items.push_back(&entry);
+        }
+        visitor(batch);
+        batch = std::make_shared<EntryBatch>();
+        batch->owned.reserve(batchSize);
+    };
+    forEach([&](const FileEntry& entry) {
+        batch->owned.push_back(entry);
+        if (batch->owned.size() >= batchSize) {
+            emit();
+        }
+    });
+    if (!batch->owned.empty()) {
+        emit();
+    }
+}
+
+void EntryStore::forEach(const Visitor& visitor) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::mutex> chunksLock(chunksMutex_);
+
+    if (chunks_.empty()) {
+        for (const auto& entry : entries_) {
+            visitor(entry);
+        }
+        return;
+    }
+
+    // k 路归并：每个溢出块是一个按序号递增的流，内存中的剩余条目是最后一个流
+    struct Source {
+        std::unique_ptr<std::ifstream> in;
+        std::unique_ptr<char[]> buffer;
+        unsigned long long seq;
+        size_t remaining;
+        FileEntry current;
+        size_t memoryIndex;  // 内存流的位置（in 为空时使用）
+    };
+    std::vector<Source> sources(chunks_.size() + 1);
+
+    auto advance = [this](Source& source) -> bool {
+        if (source.remaining == 0) {
+            return false;
+        }
+        if (source.in) {
+            if (!deserialize(*source.in, source.current)) {
+                throw std::runtime_error("溢出文件已损坏");
+            }
+        }
+        return true;
+    };
+
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        Source& source = sources[i];
+        const size_t bufferSize = 1 << 16;
+        source.buffer.reset(new char[bufferSize]);
+        source.in.reset(new std::ifstream());
+        source.in->rdbuf()->pubsetbuf(source.buffer.get(), bufferSize);
+        source.in->open(chunks_[i].path, std::ios::binary);
+        char magic[sizeof(SPILL_MAGIC)];
+        if (!source.in->is_open() || !source.in->read(magic, sizeof(magic)) ||
+            std::memcmp(magic, SPILL_MAGIC, sizeof(magic)) != 0) {
+            throw std::runtime_error("无法读取溢出文件: " + chunks_[i].path);
+        }
+        source.seq = chunks_[i].firstSeq;
+        source.remaining = chunks_[i].count;
+        source.memoryIndex = 0;
+        advance(source);
+    }
+    Source& memory = sources.back();
+    memory.seq = firstSeq_;
+    memory.remaining = entries_.size();
+    memory.memoryIndex = 0;
+
+    auto greater = [&sources](size_t a, size_t b) { return sources[a].seq > sources[b].seq; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i].remaining > 0) {
+            heap.push(i);
+        }
+    }
+
+    while (!heap.empty()) {
+        size_t index = heap.top();
+        heap.pop();
+        Source& source = sources[index];
+        if (source.in) {
+            visitor(source.current);
+        } else {
+            visitor(entries_[source.memoryIndex++]);
+        }
+        source.seq++;
+        source.remaining--;
+        if (advance(source)) {
+            heap.push(index);
+        }
+    }
+}
+
+size_t EntryStore::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(nextSeq_);
+}
+
+size_t EntryStore::spilledChunkCount() const {
+    std::lock_guard<std::mutex> lock(chunksMutex_);
+    return chunks_.size();
+}
+
+void EntryStore::serialize(std::string& out, const FileEntry& entry) {
+    putString(out, entry.id);
+    putString(out, entry.name);
+    out += static_cast<char>(entry.type);
+    putU64(out, entry.size);
+    out += static_cast<char>(entry.sparse ? 1 : 0);
+    putU64(out, entry.allocatedSize);
+    putU32(out, static_cast<uint32_t>(entry.blocks.size()));
+    out.append(reinterpret_cast<const char*>(entry.blocks.data()), entry.blocks.size() * sizeof(int));
+    putString(out, entry.parentId);
+    putString(out, entry.createTime);
+    out += static_cast<char>(entry.allocationAlgorithm);
+    putU64(out, entry.inode);
+    putU64(out, entry.deviceId);
+    putString(out, entry.physicalPath);
+    putU32(out, static_cast<uint32_t>(entry.extents.size()));
+    for (const auto& extent : entry.extents) {
+        putU64(out, extent.logicalOffset);
+        putU64(out, extent.physicalOffset);
+        putU64(out, extent.length);
+        out += static_cast<char>(extent.shared ? 1 : 0);
+    }
+    out += static_cast<char>(entry.simulatedExtents ? 1 : 0);
+}
+
+bool EntryStore::deserialize(std::istream& in, FileEntry& entry) {
+    unsigned long long value = 0;
+    uint32_t count = 0;
+    char kind = 0;
+    if (!getString(in, entry.id) || !getString(in, entry.name) || !in.get(kind) ||
+        static_cast<uint8_t>(kind) > static_cast<uint8_t>(EntryKind::Directory) || !getU64(in, value)) {
+        return false;
+    }
+    entry.type = static_cast<EntryKind>(kind);
+    entry.size = static_cast<size_t>(value);
+    char sparse = 0;
+    if (!in.get(sparse) || !getU64(in, value) || !getU32(in, count)) {
+        return false;
+    }
+    entry.sparse = sparse != 0;
+    entry.allocatedSize = static_cast<size_t>(value);
+    entry.blocks.resize(count);
+    if (count > 0 && !in.read(reinterpret_cast<char*>(entry.blocks.data()), count * sizeof(int))) {
+        return false;
+    }
+    char algorithm = 0;
+    if (!getString(in, entry.parentId) || !getString(in, entry.createTime) || !in.get(algorithm) ||
+        static_cast<uint8_t>(algorithm) > static_cast<uint8_t>(AllocationAlgorithm::Indexed) ||
+        !getU64(in, entry.inode) || !getU64(in, entry.deviceId) || !getString(in, entry.physicalPath) ||
+        !getU32(in, count)) {
+        return false;
+    }
+    entry.allocationAlgorithm = static_cast<AllocationAlgorithm>(algorithm);
+    entry.extents.resize(count);
+    for (auto& extent : entry.extents) {
+        char shared = 0;
+        if (!getU64(in, extent.logicalOffset) || !getU64(in, extent.physicalOffset) ||
+            !getU64(in, extent.length) || !in.get(shared)) {
+            return false;
+        }
+        extent.shared = shared != 0;
+    }
+    char simulated = 0;
+    if (!in.get(simulated)) {
+        return false;
+    }
+    entry.simulatedExtents = simulated != 0;
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef ENTRY_STORE_H
+#define ENTRY_STORE_H
+
+#include "FileEntry.h"
+#include <atomic>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 条目存储：按插入顺序保存扫描得到的 FileEntry。
+// 设置内存上限后，内存中的条目超过预算时会整块写入临时文件（每块按序号有序），
+// 遍历时对所有溢出块和内存中的剩余条目做 k 路归并，得到与不限内存时完全相同的顺序。
+// 一批连续的条目。items 按插入顺序排列；条目来自溢出文件时由 owned 持有
+struct EntryBatch {
+    std::vector<FileEntry> owned;
+    std::vector<const FileEntry*> items;
+};
+
+class EntryStore {
+public:
+    using Visitor = std::function<void(const FileEntry&)>;
+    using BatchVisitor = std::function<void(std::shared_ptr<const EntryBatch>)>;
+
+    EntryStore();
+    ~EntryStore();
+
+    EntryStore(const EntryStore&) = delete;
+    EntryStore& operator=(const EntryStore&) = delete;
+
+    // 内存上限（字节），0 表示不限制
+    void setMemoryLimit(size_t bytes) { memoryLimit_ = bytes; }
+    size_t getMemoryLimit() const { return memoryLimit_; }
+
+    // 扫描器其他结构（块分配器、子树汇总、目录表等）当前占用的字节数，从上限中扣除（线程安全，可随时更新）
+    void setReservedMemory(size_t bytes) { reservedBytes_.store(bytes, std::memory_order_relaxed); }
+
+    // 遍历时下游同时持有的条目数（如编码器的在途批次），按已添加条目的平均大小从上限中预先扣除
+    void setInFlightEntries(size_t count) { inFlightEntries_.store(count, std::memory_order_relaxed); }
+
+    // 溢出文件目录（默认为系统临时目录）
+    void setSpillDirectory(const std::string& dir) { spillDir_ = dir; }
+
+    // 添加条目（线程安全）
+    void add(FileEntry entry);
+
+    // 按插入顺序遍历所有条目（扫描结束后调用）
+    void forEach(const Visitor& visitor) const;
+    
+    // 按插入顺序分批遍历（每批最多 batchSize 个条目）。
+    // 批次在回调返回后仍然有效（内存中的条目在遍历期间不会移动），可交给其他线程处理
+    void forEachBatch(size_t batchSize, const BatchVisitor& visitor) const;
+
+    size_t size() const;
+    size_t spilledChunkCount() const;
+
+    // 估算条目占用的内存（包括字符串和数组的堆内存）
+    static size_t estimateSize(const FileEntry& entry);
+
+    // 二进制序列化（溢出文件格式）
+    static void serialize(std::string& out, const FileEntry& entry);
+    static bool deserialize(std::istream& in, FileEntry& entry);
+
+private:
+    struct Chunk {
+        std::string path;
+        unsigned long long firstSeq;  // 块中第一个条目的序号，块内序号连续递增
+        size_t count;
+    };
+
+    // 扣除其他结构后留给条目的预算（调用者持有 mutex_）。
+    // 其他结构本身超过上限时至少保留上限的 1/8，溢出仍能按块进行而不是逐条写出
+    size_t entryBudget() const;
+
+    // 将一批条目写入临时文件（调用者持有 spillMutex_）
+    void spill(std::vector<FileEntry>& entries, unsigned long long firstSeq);
+
+    mutable std::mutex mutex_;        // 保护 entries_ 及计数
+    std::vector<FileEntry> entries_;  // 内存中的条目
+    unsigned long long firstSeq_;     // entries_[0] 的序号
+    unsigned long long nextSeq_;      // 下一个条目的序号
+    size_t memoryBytes_;              // entries_ 估算占用
+    size_t memoryLimit_;
+    unsigned long long addedBytes_;   // 所有已添加条目的估算总量（用于平均条目大小）
+    std::atomic<size_t> reservedBytes_;
+    std::atomic<size_t> inFlightEntries_;
+    std::string spillDir_;
+
+    std::mutex spillMutex_;           // 同一时间只允许一个溢出块在内存中等待写出
+    mutable std::mutex chunksMutex_;  // 保护 chunks_
+    std::vector<Chunk> chunks_;
+};
+
+#endif // ENTRY_STORE_H
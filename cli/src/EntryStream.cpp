@@ -0,0 +1,81 @@
+#include "EntryStream.h"
+
+namespace {
+
+const size_t CHUNK_SIZE = 1 << 20;   // 线程缓冲区超过 1MB 时写出
+
+std::atomic<uint64_t> nextInstance{1};
+
+} // namespace
+
+EntryStream::EntryStream(const std::string& path, CompressionType compression)
+    : writer_(path, compression)
+    , instance_(nextInstance.fetch_add(1))
+    , records_(0) {
+}
+
+EntryStream::~EntryStream() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // 析构中忽略写出错误，正常路径应显式调用 close()
+    }
+}
+
+EntryStream::Shard& EntryStream::localShard() {
+    thread_local uint64_t cachedInstance = 0;
+    thread_local Shard* cachedShard = nullptr;
+    if (cachedInstance != instance_) {
+        std::lock_guard<std::mutex> lock(shardsMutex_);
+        shards_.push_back(std::make_unique<Shard>());
+        shards_.back()->buffer.reserve(CHUNK_SIZE + (CHUNK_SIZE >> 2));
+        cachedShard = shards_.back().get();
+        cachedInstance = instance_;
+    }
+    return *cachedShard;
+}
+
+void EntryStream::write(std::string& buffer) {
+    if (buffer.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        writer_.writeBuffers({&buffer});
+    }
+    buffer.clear();
+}
+
+void EntryStream::add(const FileEntry& entry) {
+    Shard& shard = localShard();
+    SnapshotWriter::encodeEntryCompact(shard.buffer, entry);
+    shard.buffer += '\n';
+    records_++;
+    if (shard.buffer.size() >= CHUNK_SIZE) {
+        write(shard.buffer);
+    }
+}
+
+void EntryStream::flushLocal() {
+    write(localShard().buffer);
+}
+
+void EntryStream::flushAll() {
+    std::lock_guard<std::mutex> lock(shardsMutex_);
+    for (auto& shard : shards_) {
+        write(shard->buffer);
+    }
+}
+
+void EntryStream::writeRecord(const std::string& line) {
+    flushAll();
+    std::string record = line + "\n";
+    write(record);
+    records_++;
+}
+
+void EntryStream::close() {
+    flushAll();
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    writer_.close();
+}
@@ -0,0 +1,57 @@
+#ifndef ENTRY_STREAM_H
+#define ENTRY_STREAM_H
+
+#include "FileEntry.h"
+#include "SnapshotWriter.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// --stream 模式的 NDJSON 输出：扫描线程每产生一个条目就编码为一行紧凑 JSON，
+// 先追加到本线程的缓冲区，缓冲区攒够一大块后才加锁写出，写出与扫描重叠进行。
+// 条目不在内存中保留，内存占用只与线程数和缓冲区大小有关。
+// 父目录的记录总是先于其子项写出：扫描器在把子目录放入工作队列之前调用 flushLocal()。
+class EntryStream {
+public:
+    // path 为 "-" 时写到标准输出
+    EntryStream(const std::string& path, CompressionType compression);
+    ~EntryStream();
+
+    EntryStream(const EntryStream&) = delete;
+    EntryStream& operator=(const EntryStream&) = delete;
+
+    // 编码一个条目到当前线程的缓冲区（线程安全）
+    void add(const FileEntry& entry);
+
+    // 写出当前线程缓冲区中的记录
+    void flushLocal();
+
+    // 追加一行尾部记录（不含换行）；调用前所有扫描线程必须已经结束
+    void writeRecord(const std::string& line);
+
+    // 写出所有线程的剩余记录并关闭输出
+    void close();
+
+    uint64_t recordCount() const { return records_.load(); }
+
+private:
+    struct Shard {
+        std::string buffer;
+    };
+
+    Shard& localShard();
+    void write(std::string& buffer);
+    void flushAll();
+
+    SnapshotWriter writer_;
+    std::mutex writeMutex_;                      // 保护 writer_
+    std::mutex shardsMutex_;                     // 只在登记新分片和结束时使用
+    std::vector<std::unique_ptr<Shard>> shards_;
+    uint64_t instance_;                          // 区分线程缓存属于哪个输出流
+    std::atomic<uint64_t> records_;
+};
+
+#endif // ENTRY_STREAM_H
@@ -0,0 +1,502 @@
+#include "Ext4ImageReader.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+
+// 超级块特性标志
+const uint32_t COMPAT_SPARSE_SUPER2 = 0x0200;
+const uint32_t INCOMPAT_FILETYPE = 0x0002;
+const uint32_t INCOMPAT_META_BG = 0x0010;
+const uint32_t INCOMPAT_64BIT = 0x0080;
+const uint32_t RO_COMPAT_SPARSE_SUPER = 0x0001;
+const uint32_t RO_COMPAT_GDT_CSUM = 0x0010;
+const uint32_t RO_COMPAT_METADATA_CSUM = 0x0400;
+
+// 块组标志
+const uint16_t BG_INODE_UNINIT = 0x0001;
+const uint16_t BG_BLOCK_UNINIT = 0x0002;
+
+// inode 标志和类型
+const uint32_t INODE_EXTENTS_FL = 0x00080000;
+const uint32_t INODE_INLINE_DATA_FL = 0x10000000;
+const uint16_t MODE_TYPE_MASK = 0xF000;
+const uint16_t MODE_DIRECTORY = 0x4000;
+const uint16_t MODE_REGULAR = 0x8000;
+
+const uint16_t EXTENT_MAGIC = 0xF30A;
+const uint32_t ROOT_INODE = 2;
+const uint32_t FIRST_USER_INODE = 11;
+
+bool isPowerOf(uint32_t value, uint32_t base) {
+    while (value > 1 && value % base == 0) {
+        value /= base;
+    }
+    return value == 1;
+}
+
+} // namespace
+
+Ext4ImageReader::Ext4ImageReader(const std::string& path)
+    : ImageReader(path)
+{
+    parseSuperblock();
+}
+
+void Ext4ImageReader::parseSuperblock() {
+    if (size_ < 2048) {
+        throw std::runtime_error("镜像文件太小，不是有效的 ext4 文件系统");
+    }
+    const uint8_t* sb = data_ + 1024;
+    if (le16(sb + 0x38) != 0xEF53) {
+        throw std::runtime_error("不是 ext2/3/4 文件系统镜像（超级块魔数不匹配）");
+    }
+
+    uint32_t logBlockSize = le32(sb + 0x18);
+    if (logBlockSize > 6) {
+        throw std::runtime_error("镜像的块大小无效");
+    }
+    blockSize_ = 1024u << logBlockSize;
+    inodeCount_ = le32(sb + 0x00);
+    firstDataBlock_ = le32(sb + 0x14);
+    blocksPerGroup_ = le32(sb + 0x20);
+    inodesPerGroup_ = le32(sb + 0x28);
+    inodeSize_ = le32(sb + 0x4C) >= 1 ? le16(sb + 0x58) : 128;
+    featureCompat_ = le32(sb + 0x5C);
+    featureIncompat_ = le32(sb + 0x60);
+    featureRoCompat_ = le32(sb + 0x64);
+    reservedGdtBlocks_ = le16(sb + 0xCE);
+
+    blockCount_ = le32(sb + 0x04);
+    descSize_ = 32;
+    if (featureIncompat_ & INCOMPAT_64BIT) {
+        blockCount_ |= static_cast<uint64_t>(le32(sb + 0x150)) << 32;
+        descSize_ = std::max<uint32_t>(32, le16(sb + 0xFE));
+    }
+
+    const char* label = reinterpret_cast<const char*>(sb + 0x78);
+    volumeName_.assign(label, strnlen(label, 16));
+
+    if (blocksPerGroup_ == 0 || inodesPerGroup_ == 0 || inodeSize_ < 128 || blockCount_ <= firstDataBlock_) {
+        throw std::runtime_error("镜像超级块参数无效");
+    }
+    if (featureIncompat_ & INCOMPAT_META_BG) {
+        throw std::runtime_error("暂不支持 meta_bg 布局的 ext4 镜像");
+    }
+    if (blockCount_ * blockSize_ > size_) {
+        throw std::runtime_error("镜像文件被截断：文件系统大小超过镜像文件大小");
+    }
+
+    groupCount_ = static_cast<uint32_t>((blockCount_ - firstDataBlock_ + blocksPerGroup_ - 1) / blocksPerGroup_);
+
+    // 组描述符表紧跟在超级块所在块之后
+    uint64_t gdtOffset = static_cast<uint64_t>(firstDataBlock_ + 1) * blockSize_;
+    if (gdtOffset + static_cast<uint64_t>(groupCount_) * descSize_ > size_) {
+        throw std::runtime_error("镜像中的组描述符表不完整");
+    }
+    groups_.resize(groupCount_);
+    bool wide = descSize_ >= 64;
+    for (uint32_t g = 0; g < groupCount_; g++) {
+        const uint8_t* d = data_ + gdtOffset + static_cast<uint64_t>(g) * descSize_;
+        GroupDesc& desc = groups_[g];
+        desc.blockBitmap = le32(d + 0x00);
+        desc.inodeBitmap = le32(d + 0x04);
+        desc.inodeTable = le32(d + 0x08);
+        desc.flags = le16(d + 0x12);
+        desc.itableUnused = le16(d + 0x1C);
+        if (wide) {
+            desc.blockBitmap |= static_cast<uint64_t>(le32(d + 0x20)) << 32;
+            desc.inodeBitmap |= static_cast<uint64_t>(le32(d + 0x24)) << 32;
+            desc.inodeTable |= static_cast<uint64_t>(le32(d + 0x28)) << 32;
+            desc.itableUnused |= static_cast<uint32_t>(le16(d + 0x32)) << 16;
+        }
+    }
+}
+
+const uint8_t* Ext4ImageReader::block(uint64_t number) const {
+    if (number >= blockCount_ || (number + 1) * blockSize_ > size_) {
+        return nullptr;
+    }
+    return data_ + number * blockSize_;
+}
+
+uint64_t Ext4ImageReader::groupFirstBlock(uint32_t group) const {
+    return firstDataBlock_ + static_cast<uint64_t>(group) * blocksPerGroup_;
+}
+
+bool Ext4ImageReader::groupHasSuperblock(uint32_t group) const {
+    if (featureCompat_ & COMPAT_SPARSE_SUPER2) {
+        return group == 0;  // 备份位置记录在超级块中，这里只保证主超级块
+    }
+    if (!(featureRoCompat_ & RO_COMPAT_SPARSE_SUPER) || group <= 1) {
+        return true;
+    }
+    return isPowerOf(group, 3) || isPowerOf(group, 5) || isPowerOf(group, 7);
+}
+
+void Ext4ImageReader::markGroupMetadata(uint32_t group, std::vector<uint64_t>& bits, uint64_t base) const {
+    // BLOCK_UNINIT 的块组没有写入位图，已用块只有超级块备份、组描述符表
+    // 以及位于本组内的位图和 inode 表
+    uint64_t first = groupFirstBlock(group);
+    uint64_t last = std::min<uint64_t>(first + blocksPerGroup_, blockCount_);
+    auto mark = [&](uint64_t start, uint64_t count) {
+        for (uint64_t b = start; b < start + count; b++) {
+            if (b >= first && b < last) {
+                setBit(bits, base + (b - first));
+            }
+        }
+    };
+    if (groupHasSuperblock(group)) {
+        uint64_t gdtBlocks = (static_cast<uint64_t>(groupCount_) * descSize_ + blockSize_ - 1) / blockSize_;
+        mark(first, 1 + gdtBlocks + reservedGdtBlocks_);
+    }
+    const GroupDesc& desc = groups_[group];
+    uint64_t inodeTableBlocks = (static_cast<uint64_t>(inodesPerGroup_) * inodeSize_ + blockSize_ - 1) / blockSize_;
+    mark(desc.blockBitmap, 1);
+    mark(desc.inodeBitmap, 1);
+    mark(desc.inodeTable, inodeTableBlocks);
+}
+
+void Ext4ImageReader::load(size_t threads) {
+    // 位图按块组相对位置存放：第 g 组第 i 位 = 块 firstDataBlock + g*blocksPerGroup + i。
+    // 每组占用整数个 64 位字时各组可以并行写入互不干扰，否则退化为单线程。
+    uint64_t relativeBits = static_cast<uint64_t>(groupCount_) * blocksPerGroup_;
+    std::vector<uint64_t> bits((relativeBits + 63) / 64, 0);
+    inodes_.assign(groupCount_, {});
+
+    if (blocksPerGroup_ % 64 != 0) {
+        threads = 1;
+    }
+    threads = std::max<size_t>(1, std::min<size_t>(threads, groupCount_));
+
+    std::atomic<uint32_t> nextGroup(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]() {
+        try {
+            for (uint32_t g = nextGroup++; g < groupCount_; g = nextGroup++) {
+                parseGroup(g, bits, inodes_[g]);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+    if (threads == 1) {
+        worker();
+    } else {
+        std::vector<std::thread> pool;
+        for (size_t i = 0; i < threads; i++) {
+            pool.emplace_back(worker);
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    // 换算为按块号索引的位图（1K 块时第 0 块为引导块，始终视为已用）
+    if (firstDataBlock_ == 0) {
+        blockBitmap_ = std::move(bits);
+    } else {
+        blockBitmap_.assign((blockCount_ + 63) / 64, 0);
+        for (uint64_t b = 0; b < firstDataBlock_; b++) {
+            setBit(blockBitmap_, b);
+        }
+        for (uint64_t i = 0; i < relativeBits; i++) {
+            if ((bits[i / 64] >> (i % 64)) & 1) {
+                setBit(blockBitmap_, i + firstDataBlock_);
+            }
+        }
+    }
+    // 清除最后一个块组中超出文件系统大小的填充位
+    blockBitmap_.resize((blockCount_ + 63) / 64);
+    if (blockCount_ % 64 != 0) {
+        blockBitmap_.back() &= (uint64_t(1) << (blockCount_ % 64)) - 1;
+    }
+    usedBlocks_ = countBits(blockBitmap_);
+}
+
+void Ext4ImageReader::parseGroup(uint32_t group, std::vector<uint64_t>& bits, std::vector<Inode>& inodes) const {
+    const GroupDesc& desc = groups_[group];
+    uint64_t base = static_cast<uint64_t>(group) * blocksPerGroup_;
+
+    // 块位图
+    if (desc.flags & BG_BLOCK_UNINIT) {
+        markGroupMetadata(group, bits, base);
+    } else if (const uint8_t* bitmap = block(desc.blockBitmap)) {
+        if (blocksPerGroup_ % 64 == 0) {
+            for (uint32_t w = 0; w < blocksPerGroup_ / 64; w++) {
+                uint64_t word = 0;
+                for (int k = 0; k < 8; k++) {
+                    word |= static_cast<uint64_t>(bitmap[w * 8 + k]) << (8 * k);
+                }
+                bits[base / 64 + w] = word;
+            }
+        } else {
+            for (uint32_t i = 0; i < blocksPerGroup_; i++) {
+                if ((bitmap[i / 8] >> (i % 8)) & 1) {
+                    setBit(bits, base + i);
+                }
+            }
+        }
+    }
+
+    // inode 位图和 inode 表
+    if (desc.flags & BG_INODE_UNINIT) {
+        return;
+    }
+    const uint8_t* inodeBitmap = block(desc.inodeBitmap);
+    if (!inodeBitmap) {
+        return;
+    }
+    uint32_t limit = inodesPerGroup_;
+    if (featureRoCompat_ & (RO_COMPAT_GDT_CSUM | RO_COMPAT_METADATA_CSUM)) {
+        // 启用校验和时，表尾未使用的 inode 可能从未初始化
+        limit = desc.itableUnused < limit ? limit - desc.itableUnused : 0;
+    }
+    for (uint32_t i = 0; i < limit; i++) {
+        if (!((inodeBitmap[i / 8] >> (i % 8)) & 1)) {
+            continue;
+        }
+        uint32_t number = group * inodesPerGroup_ + i + 1;
+        if (number < FIRST_USER_INODE && number != ROOT_INODE) {
+            continue;  // 保留 inode（日志、调整大小等）
+        }
+        uint64_t offset = desc.inodeTable * blockSize_ + static_cast<uint64_t>(i) * inodeSize_;
+        if (offset + inodeSize_ > size_) {
+            break;
+        }
+        const uint8_t* raw = data_ + offset;
+        uint16_t mode = le16(raw + 0x00);
+        uint16_t type = mode & MODE_TYPE_MASK;
+        if (le16(raw + 0x1A) == 0 || (type != MODE_DIRECTORY && type != MODE_REGULAR)) {
+            continue;  // 已删除或不是目录/普通文件
+        }
+
+        Inode inode;
+        inode.number = number;
+        inode.mode = mode;
+        inode.size = le32(raw + 0x04) | (static_cast<uint64_t>(le32(raw + 0x6C)) << 32);
+        inode.mtime = le32(raw + 0x10);
+        uint32_t flags = le32(raw + 0x20);
+        const uint8_t* iblock = raw + 0x28;
+        if (flags & INODE_EXTENTS_FL) {
+            readExtentTree(iblock, 60, 5, inode.extents);
+        } else if (!(flags & INODE_INLINE_DATA_FL)) {
+            readBlockMap(iblock, inode.extents);
+        }
+        if (type == MODE_DIRECTORY) {
+            readDirectory(inode, raw, flags, inode.children);
+        }
+        inodes.push_back(std::move(inode));
+    }
+}
+
+void Ext4ImageReader::readExtentTree(const uint8_t* node, size_t size, int depth, std::vector<ExtentInfo>& out) const {
+    if (!node || size < 12 || le16(node) != EXTENT_MAGIC || depth < 0) {
+        return;
+    }
+    uint16_t entries = le16(node + 2);
+    uint16_t level = le16(node + 6);
+    if (12 + static_cast<size_t>(entries) * 12 > size) {
+        return;
+    }
+    for (uint16_t i = 0; i < entries; i++) {
+        const uint8_t* e = node + 12 + i * 12;
+        if (level == 0) {
+            // 叶子：ee_block, ee_len（> 32768 表示未初始化的预分配 extent）, ee_start_hi, ee_start_lo
+            uint32_t length = le16(e + 4);
+            if (length > 32768) {
+                length -= 32768;
+            }
+            ExtentInfo extent;
+            extent.logicalOffset = le32(e);
+            extent.physicalOffset = (static_cast<uint64_t>(le16(e + 6)) << 32) | le32(e + 8);
+            extent.length = length;
+            if (length > 0) {
+                out.push_back(extent);
+            }
+        } else {
+            // 索引节点：ei_block, ei_leaf_lo, ei_leaf_hi
+            uint64_t child = le32(e + 4) | (static_cast<uint64_t>(le16(e + 8)) << 32);
+            readExtentTree(block(child), blockSize_, depth - 1, out);
+        }
+    }
+}
+
+void Ext4ImageReader::readBlockMap(const uint8_t* iblock, std::vector<ExtentInfo>& out) const {
+    // ext2/ext3 间接块映射：12 个直接块 + 一级/二级/三级间接块
+    uint64_t logical = 0;
+    for (int i = 0; i < 12; i++) {
+        uint32_t physical = le32(iblock + i * 4);
+        if (physical != 0) {
+            if (!out.empty() && out.back().logicalOffset + out.back().length == logical &&
+                out.back().physicalOffset + out.back().length == physical) {
+                out.back().length++;
+            } else {
+                out.push_back({logical, physical, 1});
+            }
+        }
+        logical++;
+    }
+    for (int level = 1; level <= 3; level++) {
+        readIndirect(le32(iblock + (11 + level) * 4), level, logical, out);
+    }
+}
+
+void Ext4ImageReader::readIndirect(uint64_t number, int level, uint64_t& logical, std::vector<ExtentInfo>& out) const {
+    uint64_t pointers = blockSize_ / 4;
+    const uint8_t* data = number != 0 ? block(number) : nullptr;
+    if (!data) {
+        // 空洞：跳过该间接块覆盖的全部逻辑块
+        uint64_t span = 1;
+        for (int i = 0; i < level; i++) {
+            span *= pointers;
+        }
+        logical += span;
+        return;
+    }
+    for (uint64_t i = 0; i < pointers; i++) {
+        uint32_t physical = le32(data + i * 4);
+        if (level > 1) {
+            readIndirect(physical, level - 1, logical, out);
+            continue;
+        }
+        if (physical != 0) {
+            if (!out.empty() && out.back().logicalOffset + out.back().length == logical &&
+                out.back().physicalOffset + out.back().length == physical) {
+                out.back().length++;
+            } else {
+                out.push_back({logical, physical, 1});
+            }
+        }
+        logical++;
+    }
+}
+
+void Ext4ImageReader::readDirectory(const Inode& inode, const uint8_t* raw, uint32_t flags,
+                                    std::vector<DirEntry>& out) const {
+    if (flags & INODE_INLINE_DATA_FL) {
+        // 内联目录：i_block 前 4 字节为父目录 inode，其后是目录项（扩展属性中的部分暂不解析）
+        parseDirBlock(raw + 0x28 + 4, 56, out);
+        return;
+    }
+    // 按线性方式解析所有目录块；htree 的索引块在线性视角下是 inode 为 0 的空目录项，会被自然跳过
+    for (const auto& extent : inode.extents) {
+        for (uint64_t b = 0; b < extent.length; b++) {
+            if ((extent.logicalOffset + b) * blockSize_ >= inode.size) {
+                return;
+            }
+            if (const uint8_t* data = block(extent.physicalOffset + b)) {
+                parseDirBlock(data, blockSize_, out);
+            }
+        }
+    }
+}
+
+void Ext4ImageReader::parseDirBlock(const uint8_t* data, size_t size, std::vector<DirEntry>& out) const {
+    bool hasFileType = (featureIncompat_ & INCOMPAT_FILETYPE) != 0;
+    size_t offset = 0;
+    while (offset + 8 <= size) {
+        const uint8_t* d = data + offset;
+        uint32_t inode = le32(d);
+        size_t recordLength = le16(d + 4);
+        size_t nameLength = hasFileType ? d[6] : le16(d + 6);
+        if (recordLength == 0 && size >= 65536) {
+            recordLength = size - offset;  // 64K 块中 rec_len 的特殊编码
+        }
+        if (recordLength < 8 || offset + recordLength > size) {
+            break;
+        }
+        if (inode != 0 && nameLength > 0 && 8 + nameLength <= recordLength) {
+            std::string name(reinterpret_cast<const char*>(d + 8), nameLength);
+            if (name != "." && name != "..") {
+                out.push_back({inode, std::move(name)});
+            }
+        }
+        offset += recordLength;
+    }
+}
+
+const Ext4ImageReader::Inode* Ext4ImageReader::findInode(uint32_t number) const {
+    if (number == 0 || number > inodeCount_) {
+        return nullptr;
+    }
+    uint32_t group = (number - 1) / inodesPerGroup_;
+    if (group >= inodes_.size()) {
+        return nullptr;
+    }
+    const std::vector<Inode>& list = inodes_[group];
+    auto it = std::lower_bound(list.begin(), list.end(), number,
+                               [](const Inode& inode, uint32_t value) { return inode.number < value; });
+    return it != list.end() && it->number == number ? &*it : nullptr;
+}
+
+void Ext4ImageReader::walk(const Visitor& visitor) const {
+    const Inode* root = findInode(ROOT_INODE);
+    if (!root || (root->mode & MODE_TYPE_MASK) != MODE_DIRECTORY) {
+        throw std::runtime_error("镜像中找不到根目录 inode");
+    }
+
+    auto makeNode = [this](const Inode& inode, uint64_t parent, const std::string& name,
+                           const std::string& path, int depth) {
+        Node node;
+        node.inode = inode.number;
+        node.parentInode = parent;
+        node.name = name;
+        node.path = path;
+        node.directory = (inode.mode & MODE_TYPE_MASK) == MODE_DIRECTORY;
+        node.size = inode.size;
+        node.mtime = inode.mtime;
+        node.depth = depth;
+        node.extents.reserve(inode.extents.size());
+        for (const auto& extent : inode.extents) {
+            node.extents.push_back({extent.logicalOffset * blockSize_,
+                                    extent.physicalOffset * blockSize_,
+                                    extent.length * blockSize_});
+            for (uint64_t b = 0; b < extent.length; b++) {
+                node.blocks.push_back(extent.physicalOffset + b);
+            }
+        }
+        return node;
+    };
+
+    struct Pending {
+        const Inode* inode;
+        std::string path;
+        int depth;
+    };
+    std::deque<Pending> queue;
+    std::unordered_set<uint32_t> visited{ROOT_INODE};
+
+    if (visitor(makeNode(*root, 0, volumeName_.empty() ? "/" : volumeName_, "/", 0))) {
+        queue.push_back({root, "", 0});
+    }
+    while (!queue.empty()) {
+        Pending current = std::move(queue.front());
+        queue.pop_front();
+        for (const auto& child : current.inode->children) {
+            const Inode* inode = findInode(child.inode);
+            if (!inode) {
+                continue;  // 符号链接、设备文件等
+            }
+            std::string path = current.path + "/" + child.name;
+            Node node = makeNode(*inode, current.inode->number, child.name, path, current.depth + 1);
+            bool descend = visitor(node);
+            if (node.directory && descend && visited.insert(inode->number).second) {
+                queue.push_back({inode, path, current.depth + 1});
+            }
+        }
+    }
+}
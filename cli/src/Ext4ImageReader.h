@@ -0,0 +1,76 @@
+#ifndef EXT4_IMAGE_READER_H
+#define EXT4_IMAGE_READER_H
+
+#include "ImageReader.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 离线 ext4（兼容 ext2/ext3）镜像解析器：直接读取超级块、组描述符、
+// 块/inode 位图、inode 表、extent 树（或间接块映射）以及目录块，无需挂载和 root 权限。
+// load() 按块组并行解析，walk() 从根目录（inode 2）按层序遍历目录树。
+class Ext4ImageReader : public ImageReader {
+public:
+    explicit Ext4ImageReader(const std::string& path);
+
+    // 解析块位图和 inode 表（threads 个线程按块组并行）
+    void load(size_t threads) override;
+
+    void walk(const Visitor& visitor) const override;
+
+    FileSystemType fileSystemType() const override { return FileSystemType::Ext4; }
+
+private:
+    struct GroupDesc {
+        uint64_t blockBitmap = 0;
+        uint64_t inodeBitmap = 0;
+        uint64_t inodeTable = 0;
+        uint32_t itableUnused = 0;
+        uint16_t flags = 0;
+    };
+
+    struct DirEntry {
+        uint32_t inode;
+        std::string name;
+    };
+
+    struct Inode {
+        uint32_t number = 0;
+        uint16_t mode = 0;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        std::vector<ExtentInfo> extents;   // 块为单位，walk() 时换算为字节
+        std::vector<DirEntry> children;    // 仅目录
+    };
+
+    void parseSuperblock();
+    void parseGroup(uint32_t group, std::vector<uint64_t>& bits, std::vector<Inode>& inodes) const;
+    void markGroupMetadata(uint32_t group, std::vector<uint64_t>& bits, uint64_t base) const;
+    bool groupHasSuperblock(uint32_t group) const;
+    void readExtentTree(const uint8_t* node, size_t size, int depth, std::vector<ExtentInfo>& out) const;
+    void readBlockMap(const uint8_t* iblock, std::vector<ExtentInfo>& out) const;
+    void readIndirect(uint64_t block, int level, uint64_t& logical, std::vector<ExtentInfo>& out) const;
+    void readDirectory(const Inode& inode, const uint8_t* raw, uint32_t flags, std::vector<DirEntry>& out) const;
+    uint64_t groupFirstBlock(uint32_t group) const;
+    void parseDirBlock(const uint8_t* data, size_t size, std::vector<DirEntry>& out) const;
+    const uint8_t* block(uint64_t number) const;
+    const Inode* findInode(uint32_t number) const;
+
+    // 超级块字段
+    uint32_t inodeCount_;
+    uint32_t firstDataBlock_;
+    uint32_t blocksPerGroup_;
+    uint32_t inodesPerGroup_;
+    uint32_t inodeSize_;
+    uint32_t descSize_;
+    uint32_t groupCount_;
+    uint32_t featureCompat_;
+    uint32_t featureIncompat_;
+    uint32_t featureRoCompat_;
+    uint32_t reservedGdtBlocks_;
+
+    std::vector<GroupDesc> groups_;
+    std::vector<std::vector<Inode>> inodes_;   // 按块组存放已使用的 inode（按编号升序）
+};
+
+#endif // EXT4_IMAGE_READER_H
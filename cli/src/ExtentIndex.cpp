@@ -0,0 +1,304 @@
+#include "ExtentIndex.h"
+#include "BitOps.h"
+#include "SnapshotWriter.h"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+#include <stdexcept>
+
+ExtentIndex::ExtentIndex() : simulatedFiles_(0), built_(false) {}
+
+void ExtentIndex::add(const FileEntry& entry) {
+    if (entry.type != EntryKind::File || entry.extents.empty()) {
+        return;
+    }
+    if (entry.simulatedExtents) {
+        simulatedFiles_++;
+        return;
+    }
+    if (owners_.size() >= UINT32_MAX) {
+        throw std::runtime_error("extent 索引中的文件数超过上限");
+    }
+    uint32_t owner = static_cast<uint32_t>(owners_.size());
+    owners_.push_back({entry.id, entry.physicalPath});
+    for (const auto& extent : entry.extents) {
+        if (extent.length > 0) {
+            extents_.push_back({extent.physicalOffset, extent.length, extent.logicalOffset, owner, extent.shared});
+        }
+    }
+    built_ = false;
+}
+
+void ExtentIndex::build() {
+    if (extents_.size() >= UINT32_MAX) {
+        throw std::runtime_error("extent 数量超过索引上限");
+    }
+    std::sort(extents_.begin(), extents_.end(), [](const Extent& a, const Extent& b) {
+        if (a.physicalOffset != b.physicalOffset) {
+            return a.physicalOffset < b.physicalOffset;
+        }
+        if (a.owner != b.owner) {
+            return a.owner < b.owner;
+        }
+        return a.logicalOffset < b.logicalOffset;
+    });
+
+    prefixMaxEnd_.resize(extents_.size());
+    uint64_t maxEnd = 0;
+    for (size_t i = 0; i < extents_.size(); i++) {
+        maxEnd = std::max(maxEnd, extents_[i].end());
+        prefixMaxEnd_[i] = maxEnd;
+    }
+
+    keys_.assign(extents_.size() + 1, 0);
+    ranks_.assign(extents_.size() + 1, 0);
+    fillEytzinger(1, 0);
+    built_ = true;
+}
+
+size_t ExtentIndex::fillEytzinger(size_t node, size_t next) {
+    // 中序遍历隐式二叉树，依次填入排序后的起点
+    if (node < keys_.size()) {
+        next = fillEytzinger(2 * node, next);
+        keys_[node] = extents_[next].physicalOffset;
+        ranks_[node] = static_cast<uint32_t>(next);
+        next = fillEytzinger(2 * node + 1, next + 1);
+    }
+    return next;
+}
+
+size_t ExtentIndex::upperBound(uint64_t value) const {
+    const size_t n = extents_.size();
+    size_t k = 1;
+    while (k <= n) {
+        // 预取 4 层之后的子孙节点（16 个连续的键正好占满一个 128 字节的区域）
+        if (16 * k <= n) {
+            BitOps::prefetch(keys_.data() + 16 * k);
+        }
+        k = 2 * k + (keys_[k] <= value ? 1 : 0);
+    }
+    // 去掉末尾连续向右走的步数和最后一次向左走，回到最后一个起点 > value 的节点
+    k >>= BitOps::findFirstSet(static_cast<uint64_t>(~k));
+    return k == 0 ? n : ranks_[k];
+}
+
+std::vector<size_t> ExtentIndex::at(uint64_t offset) const {
+    return overlapping(offset, offset == UINT64_MAX ? offset : offset + 1);
+}
+
+std::vector<size_t> ExtentIndex::overlapping(uint64_t start, uint64_t end) const {
+    if (!built_) {
+        throw std::runtime_error("extent 索引尚未建立");
+    }
+    std::vector<size_t> result;
+    if (end <= start) {
+        return result;
+    }
+    // 起点 < end 的 extent 中，从后往前找结束偏移 > start 的；
+    // 前缀最大结束偏移 <= start 时更早的 extent 都不可能相交
+    for (size_t i = upperBound(end - 1); i > 0 && prefixMaxEnd_[i - 1] > start; i--) {
+        if (extents_[i - 1].end() > start) {
+            result.push_back(i - 1);
+        }
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+std::vector<ExtentIndex::SharedRegion> ExtentIndex::sharedRegions() const {
+    std::vector<SharedRegion> regions;
+    // 扫描线：按起点依次加入 extent，用最小堆按结束偏移移出；
+    // 相邻两个边界之间活跃的文件集合不变，文件数 >= 2（或带共享标志）时记为共享区域
+    using End = std::pair<uint64_t, size_t>;
+    std::priority_queue<End, std::vector<End>, std::greater<End>> active;
+    std::map<uint32_t, size_t> owners;   // 活跃文件 -> 活跃 extent 数
+    size_t flagged = 0;                  // 活跃 extent 中带共享标志的数量
+    uint64_t position = 0;
+
+    auto emit = [&](uint64_t until) {
+        if (until > position && (owners.size() >= 2 || (owners.size() == 1 && flagged > 0))) {
+            bool outsideScan = owners.size() == 1;
+            SharedRegion* last = regions.empty() ? nullptr : &regions.back();
+            bool sameOwners = last && last->end == position && last->outsideScan == outsideScan &&
+                              last->owners.size() == owners.size() &&
+                              std::equal(owners.begin(), owners.end(), last->owners.begin(),
+                                         [](const std::pair<const uint32_t, size_t>& a, uint32_t b) {
+                                             return a.first == b;
+                                         });
+            if (sameOwners) {
+                last->end = until;
+            } else {
+                SharedRegion region{position, until, {}, outsideScan};
+                for (const auto& entry : owners) {
+                    region.owners.push_back(entry.first);
+                }
+                regions.push_back(std::move(region));
+            }
+        }
+        position = std::max(position, until);
+    };
+    auto retire = [&](uint64_t until) {
+        while (!active.empty() && active.top().first <= until) {
+            uint64_t end = active.top().first;
+            emit(end);
+            while (!active.empty() && active.top().first == end) {
+                const Extent& extent = extents_[active.top().second];
+                active.pop();
+                if (--owners[extent.owner] == 0) {
+                    owners.erase(extent.owner);
+                }
+                flagged -= extent.shared ? 1 : 0;
+            }
+        }
+    };
+
+    for (size_t i = 0; i < extents_.size(); i++) {
+        const Extent& extent = extents_[i];
+        retire(extent.physicalOffset);
+        if (active.empty()) {
+            position = extent.physicalOffset;
+        } else {
+            emit(extent.physicalOffset);
+        }
+        owners[extent.owner]++;
+        flagged += extent.shared ? 1 : 0;
+        active.push({extent.end(), i});
+    }
+    retire(UINT64_MAX);
+    return regions;
+}
+
+void ExtentIndex::writeReport(const std::string& path, const std::vector<std::pair<uint64_t, uint64_t>>& queries,
+                              const std::vector<SharedRegion>& regions) const {
+    if (!built_) {
+        throw std::runtime_error("extent 索引尚未建立");
+    }
+    SnapshotWriter writer(path, OutputCompressor::fromPath(path));
+    std::string& out = writer.buffer();
+
+    auto appendExtent = [&](const Extent& extent, int depth, bool withShared) {
+        const Owner& owner = owners_[extent.owner];
+        SnapshotWriter::appendIndent(out, depth);
+        out += "{\n";
+        SnapshotWriter::appendKey(out, depth + 1, "fileId");
+        SnapshotWriter::appendString(out, owner.id);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 1, "length");
+        SnapshotWriter::appendUnsigned(out, extent.length);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 1, "logicalOffset");
+        SnapshotWriter::appendUnsigned(out, extent.logicalOffset);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 1, "path");
+        SnapshotWriter::appendString(out, owner.path);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 1, "physicalOffset");
+        SnapshotWriter::appendUnsigned(out, extent.physicalOffset);
+        if (withShared) {
+            out += ",\n";
+            SnapshotWriter::appendKey(out, depth + 1, "shared");
+            out += extent.shared ? "true" : "false";
+        }
+        out += '\n';
+        SnapshotWriter::appendIndent(out, depth);
+        out += '}';
+    };
+    // 写出数组：count 个元素由 appendItem(i) 逐个追加（不含分隔符）
+    auto appendArray = [&](size_t count, int depth, const std::function<void(size_t)>& appendItem) {
+        if (count == 0) {
+            out += "[]";
+            return;
+        }
+        out += "[\n";
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0) {
+                out += ",\n";
+            }
+            appendItem(i);
+            writer.flushIfNeeded();
+        }
+        out += '\n';
+        SnapshotWriter::appendIndent(out, depth);
+        out += ']';
+    };
+
+    uint64_t sharedBytes = 0;
+    for (const auto& region : regions) {
+        sharedBytes += region.end - region.start;
+    }
+
+    out += "{\n";
+    SnapshotWriter::appendKey(out, 1, "extentCount");
+    SnapshotWriter::appendUnsigned(out, extents_.size());
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "fileCount");
+    SnapshotWriter::appendUnsigned(out, owners_.size());
+    out += ",\n";
+
+    SnapshotWriter::appendKey(out, 1, "layout");
+    appendArray(extents_.size(), 1, [&](size_t i) { appendExtent(extents_[i], 2, true); });
+    out += ",\n";
+
+    SnapshotWriter::appendKey(out, 1, "queries");
+    appendArray(queries.size(), 1, [&](size_t q) {
+        std::vector<size_t> hits = overlapping(queries[q].first, queries[q].second);
+        SnapshotWriter::appendIndent(out, 2);
+        out += "{\n";
+        SnapshotWriter::appendKey(out, 3, "end");
+        SnapshotWriter::appendUnsigned(out, queries[q].second);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 3, "extents");
+        appendArray(hits.size(), 3, [&](size_t h) { appendExtent(extents_[hits[h]], 4, false); });
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 3, "start");
+        SnapshotWriter::appendUnsigned(out, queries[q].first);
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 2);
+        out += '}';
+    });
+    out += ",\n";
+
+    SnapshotWriter::appendKey(out, 1, "sharedBytes");
+    SnapshotWriter::appendUnsigned(out, sharedBytes);
+    out += ",\n";
+
+    SnapshotWriter::appendKey(out, 1, "sharedRegions");
+    appendArray(regions.size(), 1, [&](size_t r) {
+        const SharedRegion& region = regions[r];
+        SnapshotWriter::appendIndent(out, 2);
+        out += "{\n";
+        SnapshotWriter::appendKey(out, 3, "end");
+        SnapshotWriter::appendUnsigned(out, region.end);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 3, "files");
+        appendArray(region.owners.size(), 3, [&](size_t o) {
+            const Owner& owner = owners_[region.owners[o]];
+            SnapshotWriter::appendIndent(out, 4);
+            out += "{\n";
+            SnapshotWriter::appendKey(out, 5, "id");
+            SnapshotWriter::appendString(out, owner.id);
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "path");
+            SnapshotWriter::appendString(out, owner.path);
+            out += '\n';
+            SnapshotWriter::appendIndent(out, 4);
+            out += '}';
+        });
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 3, "outsideScan");
+        out += region.outsideScan ? "true" : "false";
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 3, "start");
+        SnapshotWriter::appendUnsigned(out, region.start);
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 2);
+        out += '}';
+    });
+    out += ",\n";
+
+    SnapshotWriter::appendKey(out, 1, "simulatedFiles");
+    SnapshotWriter::appendUnsigned(out, simulatedFiles_);
+    out += "\n}";
+    writer.close();
+}
@@ -0,0 +1,84 @@
+#ifndef EXTENT_INDEX_H
+#define EXTENT_INDEX_H
+
+#include "FileEntry.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 扫描结束后在所有文件的 extent 之上建立的物理区间索引。
+// extent 按物理起点排序存放；起点另外按 Eytzinger（BFS 顺序的隐式二叉树）布局存一份，
+// 二分查找时访问的前几层集中在少数缓存行中；再配合前缀最大结束偏移，
+// 点查询和区间查询为 O(log n + 命中数)。
+// 共享区域（reflink/去重，或镜像中交叉链接的簇）通过扫描线求出：
+// 被两个及以上文件引用的物理区间，以及被内核标记为共享但另一方不在扫描范围内的 extent。
+// 模拟的 extent（FileEntry::simulatedExtents）不是磁盘位置，不进入索引，只计数。
+class ExtentIndex {
+public:
+    struct Extent {
+        uint64_t physicalOffset;
+        uint64_t length;
+        uint64_t logicalOffset;
+        uint32_t owner;       // owners_ 中的下标
+        bool shared;          // FIEMAP_EXTENT_SHARED
+
+        uint64_t end() const {
+            return physicalOffset + length < physicalOffset ? UINT64_MAX : physicalOffset + length;
+        }
+    };
+
+    struct Owner {
+        std::string id;
+        std::string path;
+    };
+
+    // 被多个文件引用的物理区间 [start, end)；outsideScan 表示只有一个文件被内核标记为共享
+    struct SharedRegion {
+        uint64_t start;
+        uint64_t end;
+        std::vector<uint32_t> owners;
+        bool outsideScan;
+    };
+
+    ExtentIndex();
+
+    // 添加一个文件的所有 extent（build 之前调用；模拟的 extent 被跳过）
+    void add(const FileEntry& entry);
+
+    // 排序并建立查找结构
+    void build();
+
+    // 覆盖物理字节偏移 offset 的 extent 下标（按物理起点排序）
+    std::vector<size_t> at(uint64_t offset) const;
+    // 与物理区间 [start, end) 相交的 extent 下标（按物理起点排序）
+    std::vector<size_t> overlapping(uint64_t start, uint64_t end) const;
+
+    // 被多个文件共享的物理区间，按起点排序，相邻且文件集合相同的区间已合并
+    std::vector<SharedRegion> sharedRegions() const;
+
+    size_t size() const { return extents_.size(); }
+    size_t ownerCount() const { return owners_.size(); }
+    size_t simulatedFileCount() const { return simulatedFiles_; }
+    const Extent& extent(size_t index) const { return extents_[index]; }
+    const Owner& owner(uint32_t index) const { return owners_[index]; }
+
+    // 写出 JSON 报告：按物理位置排序的布局、共享区域（regions 为 sharedRegions() 的结果）
+    // 以及 queries 中各区间 [start, end) 的归属
+    void writeReport(const std::string& path, const std::vector<std::pair<uint64_t, uint64_t>>& queries,
+                     const std::vector<SharedRegion>& regions) const;
+
+private:
+    // 物理起点 > value 的第一个 extent 的下标（不存在时为 size()）
+    size_t upperBound(uint64_t value) const;
+    size_t fillEytzinger(size_t node, size_t next);
+
+    std::vector<Extent> extents_;
+    std::vector<Owner> owners_;
+    std::vector<uint64_t> keys_;           // Eytzinger 布局的物理起点，下标从 1 开始
+    std::vector<uint32_t> ranks_;          // keys_[k] 对应的 extents_ 下标
+    std::vector<uint64_t> prefixMaxEnd_;   // extents_[0..i] 中最大的结束偏移
+    size_t simulatedFiles_;                // 因 extent 为模拟结果而跳过的文件数
+    bool built_;
+};
+
+#endif // EXTENT_INDEX_H
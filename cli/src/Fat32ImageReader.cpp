@@ -0,0 +1,416 @@
+#include "Fat32ImageReader.h"
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+
+// FAT 表项（高 4 位保留）
+const uint32_t FAT_ENTRY_MASK = 0x0FFFFFFF;
+const uint32_t FAT_BAD_CLUSTER = 0x0FFFFFF7;       // 之后为链结束标记
+const uint32_t FAT32_MAX_CLUSTERS = 0x0FFFFFF5;  // 簇号 2 .. 0x0FFFFFF6
+
+// 目录项属性
+const uint8_t ATTR_VOLUME_ID = 0x08;
+const uint8_t ATTR_DIRECTORY = 0x10;
+const uint8_t ATTR_LONG_NAME = 0x0F;
+const uint8_t ATTR_LONG_NAME_MASK = 0x3F;
+
+const uint8_t ENTRY_END = 0x00;
+const uint8_t ENTRY_DELETED = 0xE5;
+const uint8_t ENTRY_KANJI_E5 = 0x05;   // 首字节实际为 0xE5
+
+// NTRes 中的小写标志（Windows NT 起用于全小写的 8.3 名称）
+const uint8_t NTRES_LOWER_BASE = 0x08;
+const uint8_t NTRES_LOWER_EXT = 0x10;
+
+const uint64_t ROOT_POSITION = 1;      // 根目录没有目录项，与 Linux 的 MSDOS_ROOT_INO 一致
+
+bool isPowerOfTwo(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+void appendUtf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+// 长文件名为 UCS-2/UTF-16LE，以 0x0000 结束，其余位置用 0xFFFF 填充
+std::string utf16ToUtf8(const std::vector<uint16_t>& units) {
+    std::string out;
+    for (size_t i = 0; i < units.size() && units[i] != 0; i++) {
+        uint32_t code = units[i];
+        if (code >= 0xD800 && code < 0xDC00 && i + 1 < units.size() &&
+            units[i + 1] >= 0xDC00 && units[i + 1] < 0xE000) {
+            code = 0x10000 + ((code - 0xD800) << 10) + (units[i + 1] - 0xDC00);
+            i++;
+        } else if (code >= 0xD800 && code < 0xE000) {
+            code = 0xFFFD;  // 不成对的代理项
+        }
+        appendUtf8(out, code);
+    }
+    return out;
+}
+
+// 8.3 短文件名：代码页未知，非 ASCII 字节替换为 '_' 以保证输出是合法的 UTF-8
+std::string shortName(const uint8_t* entry) {
+    auto part = [entry](size_t begin, size_t end, bool lower) {
+        std::string text;
+        for (size_t i = begin; i < end; i++) {
+            uint8_t c = entry[i];
+            if (i == 0 && c == ENTRY_KANJI_E5) {
+                c = 0xE5;
+            }
+            if (c >= 0x80 || c < 0x20) {
+                c = '_';
+            } else if (lower && c >= 'A' && c <= 'Z') {
+                c = static_cast<uint8_t>(c - 'A' + 'a');
+            }
+            text += static_cast<char>(c);
+        }
+        while (!text.empty() && text.back() == ' ') {
+            text.pop_back();
+        }
+        return text;
+    };
+    std::string name = part(0, 8, (entry[12] & NTRES_LOWER_BASE) != 0);
+    std::string extension = part(8, 11, (entry[12] & NTRES_LOWER_EXT) != 0);
+    return extension.empty() ? name : name + "." + extension;
+}
+
+// 卷标：11 个字符，不分主名和扩展名
+std::string volumeLabel(const uint8_t* raw) {
+    std::string label;
+    for (int i = 0; i < 11 && raw[i] != 0; i++) {
+        label += raw[i] >= 0x80 || raw[i] < 0x20 ? '_' : static_cast<char>(raw[i]);
+    }
+    while (!label.empty() && label.back() == ' ') {
+        label.pop_back();
+    }
+    return label;
+}
+
+uint8_t shortNameChecksum(const uint8_t* entry) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; i++) {
+        sum = static_cast<uint8_t>(((sum & 1) << 7) + (sum >> 1) + entry[i]);
+    }
+    return sum;
+}
+
+// FAT 日期/时间（本地时间，按 UTC 处理）换算为 Unix 时间戳
+int64_t fatTime(uint16_t date, uint16_t time) {
+    if (date == 0) {
+        return 0;
+    }
+    int64_t year = 1980 + (date >> 9);
+    unsigned month = std::max(1u, std::min(12u, static_cast<unsigned>((date >> 5) & 0x0F)));
+    unsigned day = std::max(1u, static_cast<unsigned>(date & 0x1F));
+    // days_from_civil（公历日期到 1970-01-01 的天数）
+    year -= month <= 2;
+    int64_t era = year / 400;
+    unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+    return days * 86400 + (time >> 11) * 3600 + ((time >> 5) & 0x3F) * 60 + (time & 0x1F) * 2;
+}
+
+} // namespace
+
+bool Fat32ImageReader::probe(const uint8_t* boot) {
+    uint32_t bytesPerSector = le16(boot + 11);
+    return (boot[0] == 0xEB || boot[0] == 0xE9) &&
+           bytesPerSector >= 512 && bytesPerSector <= 4096 && isPowerOfTwo(bytesPerSector) &&
+           isPowerOfTwo(boot[13]) && le16(boot + 14) != 0 && boot[16] != 0;
+}
+
+Fat32ImageReader::Fat32ImageReader(const std::string& path)
+    : ImageReader(path)
+    , fat_(nullptr)
+    , bytesPerSector_(0)
+    , sectorsPerCluster_(0)
+    , dataOffset_(0)
+    , clusterCount_(0)
+    , rootCluster_(0)
+    , rootMtime_(0)
+{
+    parseBootSector();
+}
+
+void Fat32ImageReader::parseBootSector() {
+    if (size_ < 512 || !probe(data_)) {
+        throw std::runtime_error("不是有效的 FAT 文件系统镜像（引导扇区参数无效）");
+    }
+    const uint8_t* boot = data_;
+    bytesPerSector_ = le16(boot + 11);
+    sectorsPerCluster_ = boot[13];
+    uint32_t reservedSectors = le16(boot + 14);
+    uint32_t fatCount = boot[16];
+    uint32_t rootEntries = le16(boot + 17);
+    uint32_t fatSize16 = le16(boot + 22);
+    uint32_t fatSize = le32(boot + 36);
+    if (fatSize16 != 0 || fatSize == 0 || rootEntries != 0) {
+        throw std::runtime_error("暂不支持 FAT12/FAT16 镜像，仅支持 FAT32");
+    }
+    uint64_t totalSectors = le16(boot + 19) != 0 ? le16(boot + 19) : le32(boot + 32);
+    uint64_t dataSector = reservedSectors + static_cast<uint64_t>(fatCount) * fatSize;
+    if (totalSectors <= dataSector) {
+        throw std::runtime_error("镜像引导扇区参数无效：数据区为空");
+    }
+
+    // 镜像已关闭 FAT 镜像同步时只有 ExtFlags 指定的那一份有效
+    uint16_t extFlags = le16(boot + 40);
+    uint32_t activeFat = (extFlags & 0x80) ? (extFlags & 0x0F) : 0;
+    if (activeFat >= fatCount) {
+        activeFat = 0;
+    }
+    uint64_t fatOffset = (reservedSectors + static_cast<uint64_t>(activeFat) * fatSize) * bytesPerSector_;
+    uint64_t fatBytes = static_cast<uint64_t>(fatSize) * bytesPerSector_;
+    if (fatOffset + fatBytes > size_) {
+        throw std::runtime_error("镜像文件被截断：FAT 表不完整");
+    }
+    fat_ = data_ + fatOffset;
+
+    // 簇数量同时受数据区大小、FAT 表容量和 FAT32 簇号范围限制
+    uint64_t clusters = (totalSectors - dataSector) / sectorsPerCluster_;
+    clusters = std::min<uint64_t>(clusters, fatBytes / 4 - std::min<uint64_t>(fatBytes / 4, 2));
+    clusters = std::min<uint64_t>(clusters, FAT32_MAX_CLUSTERS);
+    clusterCount_ = static_cast<uint32_t>(clusters);
+    blockSize_ = bytesPerSector_ * sectorsPerCluster_;
+    blockCount_ = static_cast<uint64_t>(clusterCount_) + 2;
+    dataOffset_ = dataSector * bytesPerSector_;
+    if (dataOffset_ + static_cast<uint64_t>(clusterCount_) * blockSize_ > size_) {
+        throw std::runtime_error("镜像文件被截断：文件系统大小超过镜像文件大小");
+    }
+
+    rootCluster_ = le32(boot + 44);
+    if (rootCluster_ < 2 || rootCluster_ > clusterCount_ + 1) {
+        throw std::runtime_error("镜像引导扇区参数无效：根目录簇号越界");
+    }
+
+    volumeName_ = volumeLabel(boot + 71);
+    if (volumeName_ == "NO NAME") {
+        volumeName_.clear();
+    }
+}
+
+uint32_t Fat32ImageReader::fatEntry(uint32_t cluster) const {
+    return le32(fat_ + static_cast<uint64_t>(cluster) * 4) & FAT_ENTRY_MASK;
+}
+
+uint64_t Fat32ImageReader::clusterOffset(uint32_t cluster) const {
+    return dataOffset_ + static_cast<uint64_t>(cluster - 2) * blockSize_;
+}
+
+void Fat32ImageReader::load(size_t threads) {
+    // 表项非 0 即已用（包括坏簇和保留值）。按 64 簇一个字切分给各线程，互不重叠
+    size_t words = static_cast<size_t>((blockCount_ + 63) / 64);
+    std::vector<uint64_t> bits(words, 0);
+    uint64_t lastCluster = static_cast<uint64_t>(clusterCount_) + 1;
+    auto scan = [&](size_t beginWord, size_t endWord) {
+        for (size_t w = beginWord; w < endWord; w++) {
+            uint64_t word = 0;
+            uint64_t first = static_cast<uint64_t>(w) * 64;
+            uint64_t last = std::min<uint64_t>(first + 63, lastCluster);
+            for (uint64_t c = std::max<uint64_t>(first, 2); c <= last; c++) {
+                if (fatEntry(static_cast<uint32_t>(c)) != 0) {
+                    word |= uint64_t(1) << (c - first);
+                }
+            }
+            bits[w] = word;
+        }
+    };
+
+    const size_t minWordsPerThread = 4096;
+    threads = std::max<size_t>(1, std::min(threads, (words + minWordsPerThread - 1) / minWordsPerThread));
+    if (threads == 1) {
+        scan(0, words);
+    } else {
+        std::vector<std::thread> pool;
+        size_t step = (words + threads - 1) / threads;
+        for (size_t begin = 0; begin < words; begin += step) {
+            pool.emplace_back(scan, begin, std::min(words, begin + step));
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+    // 簇 0、1 是保留的 FAT 表项，不对应数据区
+    setBit(bits, 0);
+    setBit(bits, 1);
+    blockBitmap_ = std::move(bits);
+    usedBlocks_ = countBits(blockBitmap_);
+
+    // 根目录中的卷标目录项优先于引导扇区中的卷标
+    std::vector<DirEntry> entries;
+    DirEntry label;
+    readDirectory(rootCluster_, entries, &label);
+    if (!label.name.empty()) {
+        volumeName_ = label.name;
+        rootMtime_ = label.mtime;
+    }
+}
+
+void Fat32ImageReader::readChain(uint32_t first, std::vector<uint32_t>& chain) const {
+    chain.clear();
+    uint64_t lastCluster = static_cast<uint64_t>(clusterCount_) + 1;
+    uint32_t cluster = first;
+    // 合法的链不会比簇总数更长，超过即说明 FAT 中存在环
+    while (cluster >= 2 && cluster <= lastCluster && chain.size() < clusterCount_) {
+        chain.push_back(cluster);
+        uint32_t next = fatEntry(cluster);
+        if (next >= FAT_BAD_CLUSTER) {
+            break;
+        }
+        cluster = next;
+    }
+}
+
+void Fat32ImageReader::readDirectory(uint32_t firstCluster, std::vector<DirEntry>& out, DirEntry* label) const {
+    std::vector<uint32_t> chain;
+    readChain(firstCluster, chain);
+
+    // 长文件名目录项倒序存放在短目录项之前，序号从 N（带 0x40 标志）递减到 1
+    std::vector<uint16_t> longName;
+    int expectedOrder = 0;
+    uint8_t longChecksum = 0;
+    bool longValid = false;
+
+    for (uint32_t cluster : chain) {
+        uint64_t offset = clusterOffset(cluster);
+        for (uint32_t pos = 0; pos + 32 <= blockSize_; pos += 32) {
+            const uint8_t* d = data_ + offset + pos;
+            if (d[0] == ENTRY_END) {
+                return;
+            }
+            if (d[0] == ENTRY_DELETED) {
+                longValid = false;
+                continue;
+            }
+            uint8_t attributes = d[11];
+            if ((attributes & ATTR_LONG_NAME_MASK) == ATTR_LONG_NAME) {
+                int order = d[0] & 0x1F;
+                if (d[0] & 0x40) {
+                    longName.assign(static_cast<size_t>(order) * 13, 0xFFFF);
+                    longChecksum = d[13];
+                    expectedOrder = order;
+                    longValid = order > 0;
+                }
+                if (!longValid || order != expectedOrder || d[13] != longChecksum) {
+                    longValid = false;
+                    continue;
+                }
+                static const int UNIT_OFFSETS[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+                for (int i = 0; i < 13; i++) {
+                    longName[static_cast<size_t>(order - 1) * 13 + i] = le16(d + UNIT_OFFSETS[i]);
+                }
+                expectedOrder--;
+                continue;
+            }
+
+            bool hasLongName = longValid && expectedOrder == 0 && shortNameChecksum(d) == longChecksum;
+            longValid = false;
+            if (attributes & ATTR_VOLUME_ID) {
+                if (label && label->name.empty() && !(attributes & ATTR_DIRECTORY)) {
+                    label->name = volumeLabel(d);
+                    label->mtime = fatTime(le16(d + 24), le16(d + 22));
+                }
+                continue;
+            }
+            if (d[0] == '.' && (d[1] == ' ' || (d[1] == '.' && d[2] == ' '))) {
+                continue;  // "." 和 ".."
+            }
+
+            DirEntry entry;
+            entry.name = hasLongName ? utf16ToUtf8(longName) : shortName(d);
+            entry.directory = (attributes & ATTR_DIRECTORY) != 0;
+            entry.firstCluster = (static_cast<uint32_t>(le16(d + 20)) << 16) | le16(d + 26);
+            entry.size = entry.directory ? 0 : le32(d + 28);
+            entry.mtime = fatTime(le16(d + 24), le16(d + 22));
+            entry.position = (offset + pos) / 32;
+            if (!entry.name.empty()) {
+                out.push_back(std::move(entry));
+            }
+        }
+    }
+}
+
+void Fat32ImageReader::walk(const Visitor& visitor) const {
+    auto makeNode = [this](uint64_t position, uint64_t parent, uint32_t firstCluster, bool directory,
+                           const std::string& name, const std::string& path, int depth) {
+        Node node;
+        node.inode = position;
+        node.parentInode = parent;
+        node.name = name;
+        node.path = path;
+        node.directory = directory;
+        node.depth = depth;
+
+        // 簇链即块列表；物理上相邻的簇合并为一个 extent（字节偏移相对镜像文件起始）
+        std::vector<uint32_t> chain;
+        readChain(firstCluster, chain);
+        node.blocks.assign(chain.begin(), chain.end());
+        for (size_t i = 0; i < chain.size(); i++) {
+            if (i > 0 && chain[i] == chain[i - 1] + 1) {
+                node.extents.back().length += blockSize_;
+            } else {
+                node.extents.push_back({static_cast<unsigned long long>(i) * blockSize_,
+                                        clusterOffset(chain[i]), blockSize_});
+            }
+        }
+        if (!directory && !chain.empty()) {
+            node.allocationAlgorithm = AllocationAlgorithm::Linked;
+        }
+        return node;
+    };
+
+    struct Pending {
+        uint64_t position;
+        uint32_t cluster;
+        std::string path;
+        int depth;
+    };
+    std::deque<Pending> queue;
+    std::unordered_set<uint32_t> visited{rootCluster_};
+
+    Node root = makeNode(ROOT_POSITION, 0, rootCluster_, true, volumeName_.empty() ? "/" : volumeName_, "/", 0);
+    root.mtime = rootMtime_;
+    if (visitor(root)) {
+        queue.push_back({ROOT_POSITION, rootCluster_, "", 0});
+    }
+    std::vector<DirEntry> children;
+    while (!queue.empty()) {
+        Pending current = std::move(queue.front());
+        queue.pop_front();
+        children.clear();
+        readDirectory(current.cluster, children);
+        for (const auto& child : children) {
+            std::string path = current.path + "/" + child.name;
+            Node node = makeNode(child.position, current.position, child.firstCluster, child.directory,
+                                 child.name, path, current.depth + 1);
+            node.size = child.size;
+            node.mtime = child.mtime;
+            bool descend = visitor(node);
+            // 子目录的起始簇为 0 或已访问过时说明目录结构损坏，不再展开
+            if (child.directory && descend && child.firstCluster >= 2 && visited.insert(child.firstCluster).second) {
+                queue.push_back({child.position, child.firstCluster, path, current.depth + 1});
+            }
+        }
+    }
+}
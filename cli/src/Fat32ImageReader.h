@@ -0,0 +1,54 @@
+#ifndef FAT32_IMAGE_READER_H
+#define FAT32_IMAGE_READER_H
+
+#include "ImageReader.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 离线 FAT32 镜像解析器：读取 BPB、文件分配表（FAT）和目录簇，
+// 按 FAT 链给出每个文件真实的簇号序列。块号即簇号（块大小 = 簇大小），
+// 簇 0 和 1 不对应数据区，始终视为已用。
+// load() 多线程扫描 FAT 生成空闲簇位图，walk() 从根目录簇按层序遍历目录树。
+class Fat32ImageReader : public ImageReader {
+public:
+    explicit Fat32ImageReader(const std::string& path);
+
+    // 引导扇区（至少 512 字节）是否为 FAT 的 BPB
+    static bool probe(const uint8_t* bootSector);
+
+    // 扫描 FAT 生成簇分配位图（threads 个线程分段并行）
+    void load(size_t threads) override;
+
+    void walk(const Visitor& visitor) const override;
+
+    FileSystemType fileSystemType() const override { return FileSystemType::FAT32; }
+
+private:
+    struct DirEntry {
+        std::string name;
+        bool directory = false;
+        uint32_t firstCluster = 0;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t position = 0;   // 短目录项在镜像中的字节偏移 / 32
+    };
+
+    void parseBootSector();
+    uint32_t fatEntry(uint32_t cluster) const;
+    // 沿 FAT 链收集簇号，遇到结束标记、坏簇、越界或成环时停止
+    void readChain(uint32_t first, std::vector<uint32_t>& chain) const;
+    // 解析目录的全部目录项；label 非空时顺带返回卷标目录项（仅根目录有）
+    void readDirectory(uint32_t firstCluster, std::vector<DirEntry>& out, DirEntry* label = nullptr) const;
+    uint64_t clusterOffset(uint32_t cluster) const;
+
+    const uint8_t* fat_;         // 当前生效的 FAT 副本
+    uint32_t bytesPerSector_;
+    uint32_t sectorsPerCluster_;
+    uint64_t dataOffset_;        // 数据区（簇 2）在镜像中的字节偏移
+    uint32_t clusterCount_;      // 数据簇数量，有效簇号为 2 .. clusterCount_ + 1
+    uint32_t rootCluster_;
+    int64_t rootMtime_;          // 根目录没有自己的目录项，取卷标目录项的时间
+};
+
+#endif // FAT32_IMAGE_READER_H
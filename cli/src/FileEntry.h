@@ -0,0 +1,63 @@
+#ifndef FILE_ENTRY_H
+#define FILE_ENTRY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 条目类型
+enum class EntryKind : uint8_t { File, Directory };
+
+// 文件的分配算法（目录和空文件为 None，输出为 null）
+enum class AllocationAlgorithm : uint8_t { None, Continuous, Linked, Indexed };
+
+// 快照中的 "type" 字段
+inline const char* entryKindName(EntryKind kind) {
+    return kind == EntryKind::Directory ? "directory" : "file";
+}
+
+// 快照中的 "allocationAlgorithm" 字段（None 为空串）
+inline const char* allocationAlgorithmName(AllocationAlgorithm algorithm) {
+    switch (algorithm) {
+        case AllocationAlgorithm::Continuous:
+            return "continuous";
+        case AllocationAlgorithm::Linked:
+            return "linked";
+        case AllocationAlgorithm::Indexed:
+            return "indexed";
+        default:
+            return "";
+    }
+}
+
+// 文件索引地址结构（extent）
+struct ExtentInfo {
+    unsigned long long logicalOffset;   // 逻辑偏移（文件内的字节偏移）
+    unsigned long long physicalOffset; // 物理偏移（磁盘上的块号）
+    unsigned long long length;         // 长度（字节数）
+    bool shared = false;               // 与其他文件共享物理块（reflink/去重，FIEMAP_EXTENT_SHARED）
+};
+
+struct FileEntry {
+    std::string id;
+    std::string name;
+    EntryKind type = EntryKind::File;
+    size_t size = 0;
+    // 稀疏文件：逻辑大小中只有一部分实际占用磁盘，allocatedSize 为 st_blocks × 512
+    bool sparse = false;
+    size_t allocatedSize = 0;
+    std::vector<int> blocks;
+    std::string parentId;
+    std::string createTime;
+    AllocationAlgorithm allocationAlgorithm = AllocationAlgorithm::None;
+    // 物理地址信息
+    unsigned long long inode = 0;  // inode 号（Linux）或文件索引号（Windows）
+    unsigned long long deviceId = 0; // 设备ID
+    std::string physicalPath;      // 物理路径（完整路径）
+    // 索引地址信息（extent 映射）
+    std::vector<ExtentInfo> extents;  // 文件的 extent 列表
+    // extents 由模拟的块分配生成（未抽中、设备不支持探测或探测失败），物理偏移不是磁盘上的真实位置
+    bool simulatedExtents = false;
+};
+
+#endif // FILE_ENTRY_H
@@ -0,0 +1,153 @@
+#include "FileSystemModel.h"
+#include "BitmapKernels.h"
+#include <stdexcept>
+
+namespace {
+
+// 模拟分配的块依次填入文件的数据区间，物理连续的块合并为一个 extent（最长 Policy::MAX_EXTENT_BLOCKS 块）
+template <typename Policy>
+void mapBlocks(FileEntry& entry, size_t blockSize,
+               const std::pair<uint64_t, uint64_t>* regions, size_t regionCount) {
+    unsigned long long unit = blockSize == 0 ? 4096 : static_cast<unsigned long long>(blockSize);
+    size_t region = 0;
+    unsigned long long regionOffset = 0;
+
+    // 每段连续块的长度由 firstBreak 一次求出
+    const int* blocks = entry.blocks.data();
+    size_t remainingBlocks = entry.blocks.size();
+    while (remainingBlocks > 0 && region < regionCount) {
+        size_t runLength = BitmapKernels::firstBreak(blocks, remainingBlocks);
+        if (Policy::MAX_EXTENT_BLOCKS != 0 && runLength > Policy::MAX_EXTENT_BLOCKS) {
+            runLength = static_cast<size_t>(Policy::MAX_EXTENT_BLOCKS);
+        }
+        unsigned long long runBytes = static_cast<unsigned long long>(runLength) * unit;
+        unsigned long long physicalOffset = static_cast<unsigned long long>(blocks[0]) * unit;
+
+        // 一段连续块跨过空洞时按数据区间拆成多个 extent；
+        // 最后一段只覆盖到文件末尾（索引分配追加的索引块不计入 extent）
+        while (runBytes > 0 && region < regionCount) {
+            unsigned long long remainingSize = regions[region].second - regionOffset;
+            ExtentInfo extent;
+            extent.logicalOffset = regions[region].first + regionOffset;
+            extent.physicalOffset = physicalOffset;
+            extent.length = (remainingSize < runBytes) ? remainingSize : runBytes;
+            entry.extents.push_back(extent);
+
+            physicalOffset += extent.length;
+            runBytes -= extent.length;
+            regionOffset += extent.length;
+            if (regionOffset == regions[region].second) {
+                region++;
+                regionOffset = 0;
+            }
+        }
+        blocks += runLength;
+        remainingBlocks -= runLength;
+    }
+}
+
+AllocationAlgorithm classifyEntry(const FileEntry& entry) {
+    // 目录没有分配算法
+    if (entry.type != EntryKind::File || entry.size == 0) {
+        return AllocationAlgorithm::None;
+    }
+
+    // 优先根据 extent 信息判断
+    if (!entry.extents.empty()) {
+        // 只有一个 extent 时是连续分配（不完全覆盖文件时可能是部分连续，同样按连续处理）
+        if (entry.extents.size() == 1) {
+            return AllocationAlgorithm::Continuous;
+        }
+        // 多个 extent：数量较少（<= 10）视为索引分配，很多时视为链式分配
+        return entry.extents.size() <= 10 ? AllocationAlgorithm::Indexed : AllocationAlgorithm::Linked;
+    }
+
+    // 没有 extent 信息时根据 blocks 是否连续判断
+    if (!entry.blocks.empty()) {
+        if (BitmapKernels::firstBreak(entry.blocks.data(), entry.blocks.size()) == entry.blocks.size()) {
+            return AllocationAlgorithm::Continuous;
+        }
+        return entry.blocks.size() <= 10 ? AllocationAlgorithm::Indexed : AllocationAlgorithm::Linked;
+    }
+
+    // 既没有 extent 也没有 blocks，无法判断
+    return AllocationAlgorithm::None;
+}
+
+template <typename Policy>
+void describeWith(FileEntry& entry, size_t blockSize,
+                  const std::pair<uint64_t, uint64_t>* regions, size_t regionCount) {
+    if (entry.type != EntryKind::File || entry.size == 0) {
+        return;
+    }
+    if (entry.extents.empty() && !entry.blocks.empty()) {
+        mapBlocks<Policy>(entry, blockSize, regions, regionCount);
+        entry.simulatedExtents = true;
+    }
+    entry.allocationAlgorithm = classifyEntry(entry);
+}
+
+// 向下取整到 Policy::TIME_GRANULARITY 的整数倍（早于 1970 年的负值同样向下取整）
+template <typename Policy>
+std::time_t roundTimeWith(std::time_t time) {
+    if (Policy::TIME_GRANULARITY == 1) {
+        return time;
+    }
+    std::time_t remainder = time % Policy::TIME_GRANULARITY;
+    return time - (remainder < 0 ? remainder + Policy::TIME_GRANULARITY : remainder);
+}
+
+} // namespace
+
+bool parseFileSystemType(const std::string& name, FileSystemType& type) {
+    if (name == "FAT32") {
+        type = FileSystemType::FAT32;
+    } else if (name == "Ext4") {
+        type = FileSystemType::Ext4;
+    } else if (name == "NTFS") {
+        type = FileSystemType::NTFS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* fileSystemTypeName(FileSystemType type) {
+    switch (type) {
+        case FileSystemType::Ext4:
+            return "Ext4";
+        case FileSystemType::NTFS:
+            return "NTFS";
+        default:
+            return "FAT32";
+    }
+}
+
+FileSystemModel::FileSystemModel(FileSystemType type) {
+    switch (type) {
+        case FileSystemType::FAT32:
+            bind<Fat32Policy>();
+            break;
+        case FileSystemType::Ext4:
+            bind<Ext4Policy>();
+            break;
+        case FileSystemType::NTFS:
+            bind<NtfsPolicy>();
+            break;
+        default:
+            throw std::runtime_error("不支持的文件系统类型");
+    }
+}
+
+template <typename Policy>
+void FileSystemModel::bind() {
+    type_ = Policy::TYPE;
+    clusterSize_ = Policy::CLUSTER_SIZE;
+    defaultAllocation_ = Policy::ALLOCATION;
+    roundTime_ = &roundTimeWith<Policy>;
+    describeFile_ = &describeWith<Policy>;
+}
+
+AllocationAlgorithm FileSystemModel::classify(const FileEntry& entry) const {
+    return classifyEntry(entry);
+}
@@ -0,0 +1,82 @@
+#ifndef FILE_SYSTEM_MODEL_H
+#define FILE_SYSTEM_MODEL_H
+
+#include "BlockAllocator.h"
+#include "FileEntry.h"
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <utility>
+
+// 模拟的文件系统类型（-t），镜像模式下由镜像内容决定
+enum class FileSystemType { FAT32, Ext4, NTFS };
+
+bool parseFileSystemType(const std::string& name, FileSystemType& type);
+const char* fileSystemTypeName(FileSystemType type);
+
+// 各文件系统的策略：未指定 -b 时的簇/块大小、修改时间的粒度、模拟 extent 的最大长度（块数，0 为不限）
+// 和未指定 --alloc 时的分配方式。FileSystemModel 按类型选定其中一个，以它为模板参数实例化逐条目的操作
+struct Fat32Policy {
+    static constexpr FileSystemType TYPE = FileSystemType::FAT32;
+    static constexpr size_t CLUSTER_SIZE = 32 * 1024;    // 32 GB 以上的卷格式化时的默认簇大小
+    static constexpr std::time_t TIME_GRANULARITY = 2;   // 目录项中的修改时间以 2 秒为单位
+    static constexpr uint64_t MAX_EXTENT_BLOCKS = 0;     // 簇链中连续的簇没有长度限制
+    static constexpr BlockAllocator::Policy ALLOCATION = BlockAllocator::Policy::Linked;  // FAT 中的簇链
+};
+
+struct Ext4Policy {
+    static constexpr FileSystemType TYPE = FileSystemType::Ext4;
+    static constexpr size_t CLUSTER_SIZE = 4096;
+    static constexpr std::time_t TIME_GRANULARITY = 1;   // 纳秒级，快照中的时间精确到秒
+    static constexpr uint64_t MAX_EXTENT_BLOCKS = 32768; // 一个已初始化的 extent 最多 32768 块
+    static constexpr BlockAllocator::Policy ALLOCATION = BlockAllocator::Policy::Continuous;  // 尽量连续
+};
+
+struct NtfsPolicy {
+    static constexpr FileSystemType TYPE = FileSystemType::NTFS;
+    static constexpr size_t CLUSTER_SIZE = 4096;
+    static constexpr std::time_t TIME_GRANULARITY = 1;   // 100 纳秒，快照中的时间精确到秒
+    static constexpr uint64_t MAX_EXTENT_BLOCKS = 0;     // 数据运行的长度字段足够表示任意长度
+    static constexpr BlockAllocator::Policy ALLOCATION = BlockAllocator::Policy::Indexed;  // 簇运行表
+};
+
+// 与文件系统类型相关的行为。扫描器构造时（镜像模式下解析镜像时）按类型创建一次，
+// 逐条目的操作经由以策略实例化的函数完成，路径上没有字符串比较和类型分支
+class FileSystemModel {
+public:
+    explicit FileSystemModel(FileSystemType type);
+
+    FileSystemType type() const { return type_; }
+    const char* name() const { return fileSystemTypeName(type_); }
+
+    // 未指定 -b 时的块大小（字节）
+    size_t clusterSize() const { return clusterSize_; }
+
+    // 未指定 --alloc 时模拟磁盘使用的分配方式（FAT32 链接、Ext4 连续、NTFS 索引）
+    BlockAllocator::Policy defaultAllocation() const { return defaultAllocation_; }
+
+    // 按时间粒度向下取整的修改时间（FAT32 为偶数秒）
+    std::time_t roundTime(std::time_t time) const { return roundTime_(time); }
+
+    // 没有真实 extent 时按 blocks 生成模拟的 extent（块依次填入 regions 给出的数据区间，
+    // 普通文件为 [0, size) 一个区间，超过最大长度的连续块拆成多个 extent），然后判断分配算法
+    void describeFile(FileEntry& entry, size_t blockSize,
+                      const std::pair<uint64_t, uint64_t>* regions, size_t regionCount) const {
+        describeFile_(entry, blockSize, regions, regionCount);
+    }
+
+    // 根据 extent（没有时根据 blocks）判断分配算法；目录、空文件和无法判断时为 None
+    AllocationAlgorithm classify(const FileEntry& entry) const;
+
+private:
+    template <typename Policy>
+    void bind();
+
+    FileSystemType type_;
+    size_t clusterSize_;
+    BlockAllocator::Policy defaultAllocation_;
+    std::time_t (*roundTime_)(std::time_t);
+    void (*describeFile_)(FileEntry&, size_t, const std::pair<uint64_t, uint64_t>*, size_t);
+};
+
+#endif // FILE_SYSTEM_MODEL_H
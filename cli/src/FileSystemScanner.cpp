@@ -1,13 +1,18 @@
 #include "FileSystemScanner.h"
+#include "SnapshotWriter.h"
+#include "ImageReader.h"
+#include "BitmapKernels.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <chrono>
-#include <random>
 #include <algorithm>
 #include <ctime>
 #include <thread>
+#include <climits>
+#include <unordered_map>
+#include <unordered_set>
 #ifdef _WIN32
 #include <windows.h>
 #include <sddl.h>
@@ -17,28 +22,183 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <dirent.h>
 #include <linux/fs.h>
 #include <cstdlib>
 #include <cstring>
 // fiemap.h 已在头文件中包含
 #endif
 
-FileSystemScanner::FileSystemScanner(size_t blockSize, const std::string& fileSystemType)
+namespace {
+
+// 生成 JSON 时每个编码批次的条目数
+const size_t ENCODE_BATCH_SIZE = 1024;
+
+// 目录队列中每项的路径和 ID 字符串按此估算
+const size_t QUEUED_DIRECTORY_STRINGS = 128;
+
+// 离开作用域时关闭描述符（-1 表示没有打开）
+struct DescriptorGuard {
+    int fd;
+    ~DescriptorGuard() {
+#ifndef _WIN32
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+};
+
+#ifndef _WIN32
+// 只读打开普通文件且不更新访问时间；O_NOATIME 只允许文件属主（或有 CAP_FOWNER）使用，
+// 被拒绝时不带它重试
+int openNoAtime(int dirFd, const char* name) {
+    int fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+    }
+    return fd;
+}
+
+// 用 SEEK_DATA/SEEK_HOLE 列出文件的数据区间：每个区间两次 lseek，不需要特权，
+// 不支持的文件系统由内核按整个文件都是数据处理。失败（如 O_PATH 描述符）时返回 false
+bool mapDataRegions(int fd, uint64_t size, std::vector<std::pair<uint64_t, uint64_t>>& regions) {
+    off_t offset = 0;
+    while (static_cast<uint64_t>(offset) < size) {
+        off_t data = lseek(fd, offset, SEEK_DATA);
+        if (data < 0) {
+            if (errno == ENXIO) {
+                break;  // 之后直到文件末尾都是空洞
+            }
+            return false;
+        }
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        if (hole < 0) {
+            return false;
+        }
+        uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(hole), size);
+        if (end <= static_cast<uint64_t>(data)) {
+            break;
+        }
+        regions.emplace_back(static_cast<uint64_t>(data), end - static_cast<uint64_t>(data));
+        offset = hole;
+    }
+    return true;
+}
+
+// 用 FIEMAP 读取整个文件的 extent 映射，每次最多取回 FIEMAP_BATCH 个，直到遇到带 LAST 标志的 extent。
+// 成功返回 0，第一次调用就失败时返回 errno
+int fiemapExtents(int fd, FileEntry& entry) {
+    const unsigned int FIEMAP_BATCH = 64;
+    size_t fiemapSize = sizeof(struct fiemap) + FIEMAP_BATCH * sizeof(struct fiemap_extent);
+    std::vector<char> buffer(fiemapSize);
+    struct fiemap* fiemap = reinterpret_cast<struct fiemap*>(buffer.data());
+    
+    unsigned long long offset = 0;
+    while (offset < entry.size) {
+        memset(fiemap, 0, fiemapSize);
+        fiemap->fm_start = offset;
+        fiemap->fm_length = entry.size - offset;
+        fiemap->fm_flags = FIEMAP_FLAG_SYNC;
+        fiemap->fm_extent_count = FIEMAP_BATCH;
+        
+        if (ioctl(fd, FS_IOC_FIEMAP, fiemap) != 0) {
+            // 中途失败时保留已取得的 extent
+            return (offset == 0 && entry.extents.empty()) ? errno : 0;
+        }
+        if (fiemap->fm_mapped_extents == 0) {
+            break; // 没有更多 extent
+        }
+        
+        bool last = false;
+        for (unsigned int i = 0; i < fiemap->fm_mapped_extents; i++) {
+            const struct fiemap_extent& mapped = fiemap->fm_extents[i];
+            ExtentInfo extent;
+            extent.logicalOffset = mapped.fe_logical;
+            extent.physicalOffset = mapped.fe_physical;
+            extent.length = mapped.fe_length;
+            extent.shared = (mapped.fe_flags & FIEMAP_EXTENT_SHARED) != 0;
+            
+            entry.extents.push_back(extent);
+            offset = mapped.fe_logical + mapped.fe_length;
+            last = last || (mapped.fe_flags & FIEMAP_EXTENT_LAST);
+        }
+        
+        // 返回数量少于请求数量或遇到最后一个 extent 时结束
+        if (last || fiemap->fm_mapped_extents < FIEMAP_BATCH) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// 用 FIBMAP 逐块查询物理块号并合并连续的块（最多检查 100 个块）。
+// 第一次调用就失败时返回 errno，否则返回 0
+int fibmapExtents(int fd, unsigned long blockSize, FileEntry& entry) {
+    unsigned long blockNum = 0;
+    unsigned long long fileOffset = 0;
+    while (fileOffset < entry.size && blockNum < 100) {  // 限制检查的块数
+        int blockIndex = static_cast<int>(fileOffset / blockSize);
+        if (ioctl(fd, FIBMAP, &blockIndex) != 0) {
+            return blockNum == 0 ? errno : 0;
+        }
+        if (blockIndex != 0) {
+            ExtentInfo extent;
+            extent.logicalOffset = fileOffset;
+            extent.physicalOffset = static_cast<unsigned long long>(blockIndex) * blockSize;
+            extent.length = blockSize;
+            
+            // 尝试合并连续的块
+            if (!entry.extents.empty() &&
+                entry.extents.back().physicalOffset + entry.extents.back().length == extent.physicalOffset &&
+                entry.extents.back().logicalOffset + entry.extents.back().length == extent.logicalOffset) {
+                entry.extents.back().length += extent.length;
+            } else {
+                entry.extents.push_back(extent);
+            }
+        }
+        // 块号为 0 是空洞，跳过继续映射后面的块
+        fileOffset += blockSize;
+        blockNum++;
+    }
+    return 0;
+}
+#endif
+
+} // namespace
+
+FileSystemScanner::FileSystemScanner(size_t blockSize, FileSystemType fileSystemType)
     : blockSize_(blockSize)
-    , fileSystemType_(fileSystemType)
+    , model_(fileSystemType)
     , fileCount_(0)
     , directoryCount_(0)
     , totalSize_(0)
     , totalBlocks_(0)
     , nextFileId_(1)
     , nextDirectoryId_(1)
-    , nextBlockIndex_(0)
+    , poolSize_(0)
     , stopWorkers_(false)
-    , numThreads_(std::max(1u, std::thread::hardware_concurrency()))  // 使用CPU核心数
+    , numThreads_(ConcurrencyTuner::effectiveCpuCount())  // 使用有效CPU数（考虑cgroup配额）
+    , pendingDirs_(0)
+    , adaptiveConcurrency_(false)
+    , activeWorkers_(0)
+    , inodeOrder_(false)
+    , outputCompression_(CompressionType::None)
+    , filteredCount_(0)
+    , sparseFileCount_(0)
+    , holeSize_(0)
+    , summaryOnly_(false)
+    , checkpointInterval_(30.0)
+    , resumeCheckpoint_(false)
+    , diskTotalBlocks_(0)
     , progressCallback_(nullptr)
     , autoSuggestRoot_(false)
     , rootSuggestionShown_(false)
 {
+    // 默认分配方式随文件系统类型：FAT32 为 FAT 链（链接分配），NTFS 用簇运行表（索引分配），
+    // Ext4 尽量为文件分配连续的 extent
+    allocator_.setBlockSize(blockSize_);
+    allocator_.setPolicy(model_.defaultAllocation());
 }
 
 void FileSystemScanner::notifyProgress() {
@@ -49,10 +209,28 @@ void FileSystemScanner::notifyProgress() {
 
 void FileSystemScanner::scanDirectory(const std::string& path) {
     fs::path rootPath(path);
+    filter_.setRoot(rootPath.string());
+    if (sampler_) {
+        sampler_->setRoot(fs::absolute(rootPath).string());
+    }
+    {
+        // 输出时编码器在途批次的份额在扫描开始前预留
+        std::lock_guard<std::mutex> lock(blocksMutex_);
+        chargeAuxiliaryMemory();
+    }
     
-    // 创建根目录条目
+    // 从检查点恢复：根目录条目和已完成的目录都已回放，只继续处理剩下的目录
+    std::vector<DirectoryWork> frontier;
+    if (openCheckpoint(frontier)) {
+        scanDirectoryRecursiveParallel(rootPath, idPrefix_ + "root", &frontier);
+        checkpoint_->flush();
+        return;
+    }
+    
+    // 创建根目录条目；同一扫描器的后续根目录（多根扫描中同一设备上的其他路径）使用普通目录 ID
     FileEntry rootDir;
-    rootDir.id = "root";
+    rootDir.id = roots_.empty() ? idPrefix_ + "root" : generateDirectoryIdThreadSafe();
+    roots_.push_back(fs::absolute(rootPath).string());
     rootDir.name = rootPath.filename().string();
     if (rootDir.name.empty()) {
         // Windows和Linux路径处理
@@ -65,22 +243,39 @@ void FileSystemScanner::scanDirectory(const std::string& path) {
         rootDir.name = "/";
         #endif
     }
-    rootDir.type = "directory";
+    rootDir.type = EntryKind::Directory;
     rootDir.size = 0;
     rootDir.parentId = "";
     rootDir.createTime = getFileTime(rootPath);
-    rootDir.allocationAlgorithm = "";
+    rootDir.allocationAlgorithm = AllocationAlgorithm::None;
     rootDir.inode = 0;
     rootDir.deviceId = 0;
     rootDir.physicalPath = fs::absolute(rootPath).string();
     rootDir.extents.clear();
     getPhysicalAddress(rootPath, rootDir);
-    files_.push_back(rootDir);
+    std::string rootId = rootDir.id;
+    if (checkpoint_) {
+        // 第一个单元只含根目录条目，其“子目录”就是根目录自身
+        std::string journal;
+        ScanCheckpoint::encodeEntry(journal, rootDir);
+        checkpoint_->commit("", 0, nextFileId_.load(), nextDirectoryId_.load(), 0, 1, journal,
+                            {{rootPath.string(), rootDir.id, 0}});
+    }
+    if (stream_) {
+        stream_->add(rootDir);
+    }
+    if (keepEntries()) {
+        entries_.add(std::move(rootDir));
+        rollup_.addDirectory(SubtreeRollup::indexOf(rootId), SubtreeRollup::npos, 0);
+    }
     directoryCount_++;
     notifyProgress();
     
     // 使用多线程并行扫描目录
-    scanDirectoryRecursiveParallel(rootPath, "root");
+    scanDirectoryRecursiveParallel(rootPath, rootId);
+    if (checkpoint_) {
+        checkpoint_->flush();
+    }
 }
 
 void FileSystemScanner::scanFile(const std::string& path) {
@@ -88,18 +283,24 @@ void FileSystemScanner::scanFile(const std::string& path) {
     
     // 创建根目录条目
     FileEntry rootDir;
-    rootDir.id = "root";
+    rootDir.id = idPrefix_ + "root";
     #ifdef _WIN32
     rootDir.name = "\\";
     #else
     rootDir.name = "/";
     #endif
-    rootDir.type = "directory";
+    rootDir.type = EntryKind::Directory;
     rootDir.size = 0;
     rootDir.parentId = "";
     rootDir.createTime = getFileTime(filePath.parent_path());
-    rootDir.allocationAlgorithm = "";
-    files_.push_back(rootDir);
+    rootDir.allocationAlgorithm = AllocationAlgorithm::None;
+    if (stream_) {
+        stream_->add(rootDir);
+    }
+    if (keepEntries()) {
+        entries_.add(std::move(rootDir));
+        rollup_.addDirectory(0, SubtreeRollup::npos, 0);
+    }
     directoryCount_++;
     notifyProgress();
     
@@ -107,12 +308,14 @@ void FileSystemScanner::scanFile(const std::string& path) {
     FileEntry file;
     file.id = generateFileId();
     file.name = filePath.filename().string();
-    file.type = "file";
+    file.type = EntryKind::File;
     
+    std::time_t mtime = std::time(nullptr);
     try {
         if (fs::exists(filePath) && fs::is_regular_file(filePath)) {
             file.size = fs::file_size(filePath);
-            file.createTime = getFileTime(filePath);
+            mtime = getFileTimestamp(filePath);
+            file.createTime = formatTime(mtime);
         } else {
             file.size = 0;
             file.createTime = formatTime(fs::file_time_type::clock::now());
@@ -123,29 +326,142 @@ void FileSystemScanner::scanFile(const std::string& path) {
         file.createTime = formatTime(fs::file_time_type::clock::now());
     }
     
-    file.parentId = "root";
-    file.blocks = allocateBlocks(file.size);
+    file.parentId = idPrefix_ + "root";
+    if (!summaryOnly_) {
+        file.blocks = allocateBlocks(file.size);
+    }
     file.inode = 0;
     file.deviceId = 0;
     file.physicalPath = fs::absolute(filePath).string();
     file.extents.clear();
     getPhysicalAddress(filePath, file);
-    if (file.type == "file") {
-        getIndexAddress(filePath, file);
+    if (file.type == EntryKind::File) {
+        indexFile(filePath, file);
         // getIndexAddress 内部会设置 allocationAlgorithm
-        if (file.allocationAlgorithm.empty()) {
-            file.allocationAlgorithm = "continuous";  // 如果无法判断，默认连续
+        if (file.allocationAlgorithm == AllocationAlgorithm::None) {
+            file.allocationAlgorithm = AllocationAlgorithm::Continuous;  // 如果无法判断，默认连续
         }
     } else {
-        file.allocationAlgorithm = "";
+        file.allocationAlgorithm = AllocationAlgorithm::None;
     }
     
-    files_.push_back(file);
-    fileCount_++;
     totalSize_ += file.size;
+    if (aggregator_) {
+        aggregator_->addFile(file.physicalPath, file.name, file.size, file.extents.size(), mtime);
+    }
+    if (stream_) {
+        stream_->add(file);
+    }
+    if (keepEntries()) {
+        rollup_.addFile(0, file.size, file.blocks.size() * blockSize_, file.extents.size());
+        entries_.add(std::move(file));
+    }
+    fileCount_++;
     notifyProgress();
 }
 
+void FileSystemScanner::scanImage(const std::string& imagePath) {
+    std::unique_ptr<ImageReader> image = ImageReader::open(imagePath);
+    image->load(numThreads_);
+    
+    // 磁盘参数和空闲空间全部来自镜像本身（FAT32 的块即簇）
+    blockSize_ = image->blockSize();
+    model_ = FileSystemModel(image->fileSystemType());
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex_);
+        allocator_.adopt(image->takeBlockBitmap());
+        chargeAuxiliaryMemory();
+    }
+    totalBlocks_ = image->usedBlockCount();
+    diskTotalBlocks_ = image->blockCount();
+    
+    std::string imagePrefix = fs::absolute(imagePath).string() + ":";
+    filter_.setRoot("/");
+    std::unordered_map<uint64_t, std::string> directoryIds;
+    size_t directoryIdBytes = 0;  // directoryIds 的估算占用（每项含节点的两个指针）
+    
+    image->walk([&](const ImageReader::Node& node) {
+        FileEntry entry;
+        entry.name = node.name;
+        entry.type = node.directory ? EntryKind::Directory : EntryKind::File;
+        entry.createTime = formatTime(static_cast<std::time_t>(node.mtime));
+        entry.inode = node.inode;
+        entry.deviceId = 0;
+        entry.physicalPath = imagePrefix + node.path;
+        
+        if (node.depth == 0) {
+            entry.id = idPrefix_ + "root";
+            entry.parentId = "";
+        } else {
+            // 与目录扫描相同的过滤规则，被排除的目录不会展开
+            if (filter_.isActive()) {
+                std::string relativePath = filter_.needsRelativePath() ? filter_.relativePath(node.path) : "";
+                if (filter_.isExcluded(node.name, relativePath, node.directory) ||
+                    (!node.directory && (!filter_.isIncludedFile(node.name, relativePath) ||
+                                         filter_.isBelowMinSize(node.size)))) {
+                    filteredCount_++;
+                    return false;
+                }
+            }
+            entry.id = node.directory ? generateDirectoryId() : generateFileId();
+            entry.parentId = directoryIds[node.parentInode];
+        }
+        
+        if (node.directory) {
+            std::string& slot = directoryIds[node.inode];
+            slot = entry.id;
+            directoryIdBytes += sizeof(std::pair<const uint64_t, std::string>) + sizeof(void*) * 2 + slot.capacity();
+            {
+                std::lock_guard<std::mutex> lock(blocksMutex_);
+                chargeAuxiliaryMemory(directoryIdBytes);
+            }
+            if (stream_) {
+                stream_->add(entry);
+            }
+            if (keepEntries()) {
+                rollup_.addDirectory(SubtreeRollup::indexOf(entry.id), SubtreeRollup::indexOf(entry.parentId),
+                                     node.depth);
+                entries_.add(std::move(entry));
+            }
+            directoryCount_++;
+            notifyProgress();
+            return filter_.shouldDescend(node.depth);
+        }
+        
+        // 文件：blocks 和 extents 都是镜像中的真实物理位置（FAT32 的 blocks 按簇链顺序排列）
+        entry.size = node.size;
+        entry.extents = node.extents;
+        entry.blocks.reserve(node.blocks.size());
+        for (uint64_t block : node.blocks) {
+            if (block <= static_cast<uint64_t>(INT_MAX)) {
+                entry.blocks.push_back(static_cast<int>(block));
+            }
+        }
+        entry.allocationAlgorithm = node.allocationAlgorithm == AllocationAlgorithm::None ? model_.classify(entry)
+                                                                                          : node.allocationAlgorithm;
+        if (entry.allocationAlgorithm == AllocationAlgorithm::None) {
+            entry.allocationAlgorithm = AllocationAlgorithm::Continuous;
+        }
+        
+        totalSize_ += entry.size;
+        if (aggregator_) {
+            aggregator_->addFile(entry.physicalPath, entry.name, entry.size, entry.extents.size(),
+                                 static_cast<std::time_t>(node.mtime));
+        }
+        if (stream_) {
+            stream_->add(entry);
+        }
+        if (keepEntries()) {
+            rollup_.addFile(SubtreeRollup::indexOf(entry.parentId), entry.size,
+                            entry.blocks.size() * blockSize_, entry.extents.size());
+            entries_.add(std::move(entry));
+        }
+        fileCount_++;
+        notifyProgress();
+        return false;
+    });
+}
+
 void FileSystemScanner::scanDirectoryRecursive(const fs::path& path, const std::string& parentId) {
     try {
         for (const auto& entry : fs::directory_iterator(path)) {
@@ -155,11 +471,11 @@ void FileSystemScanner::scanDirectoryRecursive(const fs::path& path, const std::
                     FileEntry dir;
                     dir.id = generateDirectoryId();
                     dir.name = entry.path().filename().string();
-                    dir.type = "directory";
+                    dir.type = EntryKind::Directory;
                     dir.size = 0;
                     dir.parentId = parentId;
                     dir.createTime = getFileTime(entry.path());
-                    dir.allocationAlgorithm = "";
+                    dir.allocationAlgorithm = AllocationAlgorithm::None;
                     dir.blocks = {};
                     dir.inode = 0;
                     dir.deviceId = 0;
@@ -167,17 +483,18 @@ void FileSystemScanner::scanDirectoryRecursive(const fs::path& path, const std::
                     dir.extents.clear();
                     getPhysicalAddress(entry.path(), dir);
                     
-                    files_.push_back(dir);
+                    std::string dirId = dir.id;
+                    entries_.add(std::move(dir));
                     directoryCount_++;
                     
                     // 递归扫描子目录
-                    scanDirectoryRecursive(entry.path(), dir.id);
+                    scanDirectoryRecursive(entry.path(), dirId);
                 } else if (entry.is_regular_file()) {
                     // 创建文件条目
                     FileEntry file;
                     file.id = generateFileId();
                     file.name = entry.path().filename().string();
-                    file.type = "file";
+                    file.type = EntryKind::File;
                     
                     try {
                         file.size = fs::file_size(entry.path());
@@ -197,13 +514,13 @@ void FileSystemScanner::scanDirectoryRecursive(const fs::path& path, const std::
                     getPhysicalAddress(entry.path(), file);
                     getIndexAddress(entry.path(), file);
                     // getIndexAddress 内部会设置 allocationAlgorithm
-                    if (file.allocationAlgorithm.empty()) {
-                        file.allocationAlgorithm = "continuous";  // 如果无法判断，默认连续
+                    if (file.allocationAlgorithm == AllocationAlgorithm::None) {
+                        file.allocationAlgorithm = AllocationAlgorithm::Continuous;  // 如果无法判断，默认连续
                     }
                     
-                    files_.push_back(file);
-                    fileCount_++;
                     totalSize_ += file.size;
+                    entries_.add(std::move(file));
+                    fileCount_++;
                 }
             } catch (const std::exception& e) {
                 std::cerr << "警告: 跳过条目 " << entry.path() << ": " << e.what() << "\n";
@@ -214,7 +531,7 @@ void FileSystemScanner::scanDirectoryRecursive(const fs::path& path, const std::
     }
 }
 
-std::vector<int> FileSystemScanner::allocateBlocks(size_t fileSize, const std::string& algorithm) {
+std::vector<int> FileSystemScanner::allocateBlocks(size_t fileSize) {
     size_t requiredBlocks = (fileSize + blockSize_ - 1) / blockSize_;  // 向上取整
     std::vector<int> blocks;
     
@@ -222,82 +539,55 @@ std::vector<int> FileSystemScanner::allocateBlocks(size_t fileSize, const std::s
         return blocks;
     }
     
-    if (algorithm == "continuous") {
-        // 连续分配：从nextBlockIndex_开始分配连续块
-        for (size_t i = 0; i < requiredBlocks; i++) {
-            int blockNum = nextBlockIndex_++;
-            blocks.push_back(blockNum);
-            usedBlocks_[blockNum] = "";  // 文件ID稍后设置
-            totalBlocks_++;
-        }
-    } else if (algorithm == "linked") {
-        // 链接分配：随机分配块
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(0, 10000);
-        
-        for (size_t i = 0; i < requiredBlocks; i++) {
-            int blockNum = nextBlockIndex_++;
-            blocks.push_back(blockNum);
-            usedBlocks_[blockNum] = "";
-            totalBlocks_++;
-        }
-    } else {
-        // 默认使用连续分配
-        for (size_t i = 0; i < requiredBlocks; i++) {
-            int blockNum = nextBlockIndex_++;
-            blocks.push_back(blockNum);
-            usedBlocks_[blockNum] = "";
-            totalBlocks_++;
-        }
-    }
+    // 按所选分配方式和适配策略在模拟磁盘上放置（索引分配时包含索引块）
+    std::lock_guard<std::mutex> lock(blocksMutex_);
+    blocks.reserve(requiredBlocks);
+    allocator_.allocate(requiredBlocks, blocks);
+    totalBlocks_ = static_cast<size_t>(allocator_.usedCount());
+    chargeAuxiliaryMemory();
     
     return blocks;
 }
 
+void FileSystemScanner::chargeAuxiliaryMemory(size_t directoryMapBytes) {
+    if (entries_.getMemoryLimit() == 0) {
+        return;
+    }
+    entries_.setInFlightEntries(ParallelEntryEncoder::maxInFlightBatches(numThreads_) * ENCODE_BATCH_SIZE);
+    entries_.setReservedMemory(allocator_.memoryBytes() + rollup_.memoryBytes() + directoryMapBytes
+                               + pendingDirs_.load() * (sizeof(DirectoryWork) + QUEUED_DIRECTORY_STRINGS));
+}
+
+size_t FileSystemScanner::allocationSize(const FileEntry& entry) {
+    return entry.sparse ? std::min(entry.allocatedSize, entry.size) : entry.size;
+}
+
 double FileSystemScanner::calculateFragmentRate() const {
     size_t currentTotalBlocks = totalBlocks_.load();
-    if (currentTotalBlocks == 0) {
+    if (currentTotalBlocks < 2) {
         return 0.0;
     }
     
     // 计算碎片率：非连续块的数量 / 总块数
-    int fragmentedBlocks = 0;
-    std::vector<int> sortedBlocks;
-    
-    // 需要加锁读取 files_，因为可能正在被其他线程修改
-    std::lock_guard<std::mutex> lock(filesMutex_);
-    for (const auto& file : files_) {
-        if (file.type == "file" && !file.blocks.empty()) {
-            sortedBlocks.insert(sortedBlocks.end(), file.blocks.begin(), file.blocks.end());
-        }
-    }
-    
-    if (sortedBlocks.size() < 2) {
-        return 0.0;
-    }
-    
-    std::sort(sortedBlocks.begin(), sortedBlocks.end());
-    
-    for (size_t i = 1; i < sortedBlocks.size(); i++) {
-        if (sortedBlocks[i] != sortedBlocks[i-1] + 1) {
-            fragmentedBlocks++;
-        }
-    }
+    // 已用块排序后相邻块不连续的次数 = 位图中已用块连续段的数量 - 1
+    std::lock_guard<std::mutex> lock(blocksMutex_);
+    const auto& bitmap = allocator_.bitmap();
+    size_t runs = static_cast<size_t>(BitmapKernels::countRuns(bitmap.data(), bitmap.size()));
     
+    size_t fragmentedBlocks = runs > 0 ? runs - 1 : 0;
     return (fragmentedBlocks * 100.0) / currentTotalBlocks;
 }
 
 std::string FileSystemScanner::generateFileId() {
     std::ostringstream oss;
-    oss << "file-" << nextFileId_;
+    oss << idPrefix_ << "file-" << nextFileId_;
     nextFileId_++;
     return oss.str();
 }
 
 std::string FileSystemScanner::generateDirectoryId() {
     std::ostringstream oss;
-    oss << "dir-" << nextDirectoryId_;
+    oss << idPrefix_ << "dir-" << nextDirectoryId_;
     nextDirectoryId_++;
     return oss.str();
 }
@@ -306,122 +596,154 @@ std::string FileSystemScanner::generateDirectoryId() {
 std::string FileSystemScanner::generateFileIdThreadSafe() {
     int id = nextFileId_.fetch_add(1);
     std::ostringstream oss;
-    oss << "file-" << id;
+    oss << idPrefix_ << "file-" << id;
     return oss.str();
 }
 
 std::string FileSystemScanner::generateDirectoryIdThreadSafe() {
     int id = nextDirectoryId_.fetch_add(1);
     std::ostringstream oss;
-    oss << "dir-" << id;
+    oss << idPrefix_ << "dir-" << id;
     return oss.str();
 }
 
-// 线程安全的块分配
-std::vector<int> FileSystemScanner::allocateBlocksThreadSafe(size_t fileSize, const std::string& algorithm) {
-    size_t requiredBlocks = (fileSize + blockSize_ - 1) / blockSize_;
-    std::vector<int> blocks;
-    
-    if (requiredBlocks == 0) {
-        return blocks;
-    }
-    
-    std::lock_guard<std::mutex> lock(blocksMutex_);
-    
-    if (algorithm == "continuous") {
-        // 连续分配：从nextBlockIndex_开始分配连续块
-        int startIndex = nextBlockIndex_.load();
-        for (size_t i = 0; i < requiredBlocks; i++) {
-            int blockNum = startIndex + static_cast<int>(i);
-            blocks.push_back(blockNum);
-            usedBlocks_[blockNum] = "";  // 文件ID稍后设置
-        }
-        nextBlockIndex_ = startIndex + static_cast<int>(requiredBlocks);
-        totalBlocks_ += requiredBlocks;
-    } else {
-        // 默认使用连续分配
-        int startIndex = nextBlockIndex_.load();
-        for (size_t i = 0; i < requiredBlocks; i++) {
-            int blockNum = startIndex + static_cast<int>(i);
-            blocks.push_back(blockNum);
-            usedBlocks_[blockNum] = "";
-        }
-        nextBlockIndex_ = startIndex + static_cast<int>(requiredBlocks);
-        totalBlocks_ += requiredBlocks;
-    }
-    
-    return blocks;
-}
-
 // 处理单个目录条目（线程安全）
-void FileSystemScanner::processDirectoryEntry(const fs::path& entryPath, const std::string& parentId) {
+void FileSystemScanner::processDirectoryEntry(const DirectoryItem& item, const std::string& parentId, int depth,
+                                              Listing* listing) {
+    const fs::path& entryPath = item.path;
     try {
-        if (fs::is_directory(entryPath)) {
+        // 过滤规则先按名称/相对路径求值，被排除的条目不会产生任何 stat 或 FIEMAP
+        std::string name;
+        std::string relativePath;
+        bool filtering = filter_.isActive();
+        if (filtering) {
+            name = entryPath.filename().string();
+            if (filter_.needsRelativePath()) {
+                relativePath = filter_.relativePath(entryPath.string());
+            }
+            if (filter_.isExcluded(name, relativePath, false)) {
+                countFiltered(listing);
+                return;
+            }
+        }
+        
+        // 后台模式：每个未被过滤的条目（stat 及后续的元数据访问）消耗一个令牌
+        if (throttle_) {
+            throttle_->beforeMetadata();
+        }
+        
+        // 一次 fstatat/openat 得到类型、大小、时间和 inode；普通文件的描述符留给 FIEMAP 复用
+        EntryStat st;
+        if (!statEntry(entryPath, item.dirFd, item.type, st)) {
+            return;
+        }
+        DescriptorGuard descriptor{st.fd};
+        
+        if (st.directory) {
+            // 仅匹配目录的排除规则（如 "node_modules/"）：整个子树不入队
+            if (filtering && filter_.isExcluded(name, relativePath, true)) {
+                countFiltered(listing);
+                return;
+            }
+            
+            // 只输出汇总时目录只需要一个 ID 供子项引用
+            if (summaryOnly_) {
+                std::string dirId = generateDirectoryIdThreadSafe();
+                directoryCount_++;
+                notifyProgress();
+                if (filter_.shouldDescend(depth)) {
+                    enqueueDirectory({entryPath, dirId, depth}, listing);
+                }
+                return;
+            }
+            
             // 创建目录条目
             FileEntry dir;
             dir.id = generateDirectoryIdThreadSafe();
             dir.name = entryPath.filename().string();
-            dir.type = "directory";
+            dir.type = EntryKind::Directory;
             dir.size = 0;
             dir.parentId = parentId;
-            dir.createTime = getFileTime(entryPath);
-            dir.allocationAlgorithm = "";
+            dir.createTime = formatTime(st.mtime);
+            dir.allocationAlgorithm = AllocationAlgorithm::None;
             dir.blocks = {};
-            dir.inode = 0;
-            dir.deviceId = 0;
+            dir.inode = st.inode;
+            dir.deviceId = st.deviceId;
             dir.physicalPath = fs::absolute(entryPath).string();
             dir.extents.clear();
-            getPhysicalAddress(entryPath, dir);
             
-            {
-                std::lock_guard<std::mutex> lock(filesMutex_);
-                files_.push_back(dir);
+            std::string dirId = dir.id;
+            emitEntry(dir, listing);
+            if (keepEntries()) {
+                entries_.add(std::move(dir));
+                rollup_.addDirectory(SubtreeRollup::indexOf(dirId), SubtreeRollup::indexOf(parentId), depth);
             }
             directoryCount_++;
             notifyProgress();
             
+            // 已达到最大深度的目录只记录自身，不再列出其内容
+            if (!filter_.shouldDescend(depth)) {
+                return;
+            }
+            
             // 将子目录添加到工作队列
-            {
-                std::lock_guard<std::mutex> lock(queueMutex_);
-                workQueue_.push({entryPath, dir.id});
+            enqueueDirectory({entryPath, dirId, depth}, listing);
+            
+        } else if (st.regular) {
+            if (filtering && !filter_.isIncludedFile(name, relativePath)) {
+                countFiltered(listing);
+                return;
+            }
+            
+            // 小于 --min-size 的文件在分配 ID、格式化时间、分配块和 FIEMAP 之前丢弃
+            if (filter_.isBelowMinSize(st.size)) {
+                countFiltered(listing);
+                return;
             }
-            queueCondition_.notify_one();
             
-        } else if (fs::is_regular_file(entryPath)) {
             // 创建文件条目
             FileEntry file;
             file.id = generateFileIdThreadSafe();
             file.name = entryPath.filename().string();
-            file.type = "file";
-            
-            try {
-                file.size = fs::file_size(entryPath);
-                file.createTime = getFileTime(entryPath);
-            } catch (const std::exception& e) {
-                std::cerr << "警告: 无法获取文件大小 " << entryPath << ": " << e.what() << "\n";
-                file.size = 0;
-                file.createTime = formatTime(fs::file_time_type::clock::now());
+            file.type = EntryKind::File;
+            file.size = st.size;
+            file.sparse = st.sparse;
+            file.allocatedSize = st.allocatedSize;
+            std::time_t mtime = st.mtime;
+            if (!summaryOnly_) {
+                file.createTime = formatTime(mtime);
             }
             
             file.parentId = parentId;
-            file.blocks = allocateBlocksThreadSafe(file.size);
-            file.inode = 0;
-            file.deviceId = 0;
+            file.inode = st.inode;
+            file.deviceId = st.deviceId;
             file.physicalPath = fs::absolute(entryPath).string();
             file.extents.clear();
-            getPhysicalAddress(entryPath, file);
-            getIndexAddress(entryPath, file);
+            // 只输出汇总时不模拟块分配，extent 数只来自真实探测
+            if (!summaryOnly_) {
+                file.blocks = allocateBlocks(allocationSize(file));
+            }
+            indexFile(entryPath, file, &st);
             // getIndexAddress 内部会设置 allocationAlgorithm
-            if (file.allocationAlgorithm.empty()) {
-                file.allocationAlgorithm = "continuous";  // 如果无法判断，默认连续
+            if (file.allocationAlgorithm == AllocationAlgorithm::None) {
+                file.allocationAlgorithm = AllocationAlgorithm::Continuous;  // 如果无法判断，默认连续
             }
             
-            {
-                std::lock_guard<std::mutex> lock(filesMutex_);
-                files_.push_back(file);
+            totalSize_ += file.size;
+            if (file.sparse) {
+                sparseFileCount_++;
+                holeSize_ += file.size - allocationSize(file);
+            }
+            if (aggregator_) {
+                aggregator_->addFile(file.physicalPath, file.name, file.size, file.extents.size(), mtime);
+            }
+            emitEntry(file, listing);
+            if (keepEntries()) {
+                rollup_.addFile(SubtreeRollup::indexOf(parentId), file.size,
+                                file.blocks.size() * blockSize_, file.extents.size());
+                entries_.add(std::move(file));
             }
             fileCount_++;
-            totalSize_ += file.size;
             notifyProgress();
         }
     } catch (const std::exception& e) {
@@ -429,75 +751,291 @@ void FileSystemScanner::processDirectoryEntry(const fs::path& entryPath, const s
     }
 }
 
+bool FileSystemScanner::statEntry(const fs::path& path, int dirFd, unsigned char type, EntryStat& st) {
+#ifndef _WIN32
+    if (dirFd >= 0) {
+        // 与 fs::is_directory/is_regular_file 一样跟随符号链接
+        std::string name = path.filename().string();
+        struct stat info;
+        int fd = -1;
+        if (type == DT_REG) {
+            // d_type 已说明是普通文件：直接打开，类型和大小由 fstat 得到
+            fd = openNoAtime(dirFd, name.c_str());
+            if (fd < 0 && errno == EACCES) {
+                // 没有读权限时 O_PATH 仍能 fstat，只是不能做 FIEMAP
+                fd = openat(dirFd, name.c_str(), O_PATH | O_CLOEXEC);
+            }
+            if (fd < 0 || fstat(fd, &info) != 0) {
+                int error = errno;
+                if (fd >= 0) {
+                    close(fd);
+                }
+                if (error == ENOENT) {
+                    return false;
+                }
+                throw fs::filesystem_error("openat", path, std::error_code(error, std::generic_category()));
+            }
+        } else if (type == DT_DIR || type == DT_LNK || type == DT_UNKNOWN) {
+            if (fstatat(dirFd, name.c_str(), &info, 0) != 0) {
+                if (errno == ENOENT) {
+                    return false;
+                }
+                throw fs::filesystem_error("fstatat", path, std::error_code(errno, std::generic_category()));
+            }
+            if (S_ISREG(info.st_mode)) {
+                // 打不开时 FIEMAP 再按路径尝试
+                fd = openNoAtime(dirFd, name.c_str());
+            }
+        } else {
+            // 设备、管道、套接字不属于扫描对象
+            return true;
+        }
+        st.directory = S_ISDIR(info.st_mode);
+        st.regular = S_ISREG(info.st_mode);
+        st.size = static_cast<uint64_t>(info.st_size);
+        st.allocatedSize = static_cast<uint64_t>(info.st_blocks) * 512;
+        st.mtime = info.st_mtime;
+        st.inode = static_cast<unsigned long long>(info.st_ino);
+        st.deviceId = static_cast<unsigned long long>(info.st_dev);
+        st.fsBlockSize = static_cast<unsigned long>(info.st_blksize);
+        st.fd = fd;
+        
+        // 占用不小于逻辑大小的文件不可能有空洞，不做额外的 lseek；
+        // 占用更小的还可能是压缩或内联数据，以数据区间为准
+        if (st.regular && fd >= 0 && st.allocatedSize < st.size &&
+            mapDataRegions(fd, st.size, st.dataRegions)) {
+            uint64_t dataBytes = 0;
+            for (const auto& region : st.dataRegions) {
+                dataBytes += region.second;
+            }
+            st.sparse = dataBytes < st.size;
+            if (!st.sparse) {
+                st.dataRegions.clear();
+            }
+        }
+        return true;
+    }
+#else
+    (void)dirFd;
+    (void)type;
+#endif
+    
+    // 没有目录描述符：按路径逐项查询
+    st.directory = fs::is_directory(path);
+    st.regular = !st.directory && fs::is_regular_file(path);
+    if (!st.directory && !st.regular) {
+        return true;
+    }
+    if (st.regular) {
+        try {
+            st.size = fs::file_size(path);
+            st.mtime = getFileTimestamp(path);
+        } catch (const std::exception& e) {
+            std::cerr << "警告: 无法获取文件大小 " << path << ": " << e.what() << "\n";
+            st.size = 0;
+            st.mtime = std::time(nullptr);
+        }
+    } else {
+        st.mtime = getFileTimestamp(path);
+    }
+    FileEntry identity;
+    getPhysicalAddress(path, identity);
+    st.inode = identity.inode;
+    st.deviceId = identity.deviceId;
+    return true;
+}
+
+// 处理一个目录下的所有条目
+void FileSystemScanner::processDirectory(const fs::path& dirPath, const std::string& parentId, int depth) {
+    // 流式输出或写检查点时子目录暂存到列表结束：先写出本线程缓冲区中的记录、
+    // 提交本目录的检查点单元再入队，保证子目录中条目的记录和单元不会先于子目录自身的写出
+    Listing listingState;
+    Listing* listing = (stream_ || checkpoint_) ? &listingState : nullptr;
+    auto process = [this, &parentId, depth, listing](const DirectoryItem& item) {
+        if (tuner_) {
+            auto start = std::chrono::steady_clock::now();
+            processDirectoryEntry(item, parentId, depth + 1, listing);
+            tuner_->recordOperation(std::chrono::steady_clock::now() - start);
+        } else {
+            processDirectoryEntry(item, parentId, depth + 1, listing);
+        }
+    };
+    
+    try {
+        // 列出目录本身也算一次元数据操作
+        if (throttle_) {
+            throttle_->beforeMetadata();
+        }
+#ifdef _WIN32
+        for (const auto& entry : fs::directory_iterator(dirPath)) {
+            process({entry.path(), -1, 0, 0});
+        }
+#else
+        // 目录保持打开直到处理完：条目经 openat/fstatat 相对它解析，内核不必逐级重新查找路径
+        std::unique_ptr<DIR, int (*)(DIR*)> dir(opendir(dirPath.c_str()), closedir);
+        if (!dir) {
+            throw fs::filesystem_error("opendir", dirPath, std::error_code(errno, std::generic_category()));
+        }
+        int dirFd = dirfd(dir.get());
+        std::vector<DirectoryItem> items;
+        while (struct dirent* dent = readdir(dir.get())) {
+            const char* name = dent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            DirectoryItem item{dirPath / name, dirFd, dent->d_type, static_cast<unsigned long long>(dent->d_ino)};
+            if (inodeOrder_) {
+                items.push_back(std::move(item));
+            } else {
+                process(item);
+            }
+        }
+        if (inodeOrder_) {
+            // 局部性模式：先读取完整列表（d_ino 由 getdents 直接返回），再按 inode 顺序 stat/FIEMAP，
+            // 避免按哈希顺序在 inode 表中来回寻道
+            std::sort(items.begin(), items.end(),
+                      [](const DirectoryItem& a, const DirectoryItem& b) { return a.inode < b.inode; });
+            for (const auto& item : items) {
+                process(item);
+            }
+        }
+#endif
+    } catch (const std::exception& e) {
+        std::cerr << "警告: 无法扫描目录 " << dirPath << ": " << e.what() << "\n";
+    }
+    
+    if (!listing) {
+        return;
+    }
+    std::vector<DirectoryWork>& subdirectories = listing->directories;
+    if (checkpoint_) {
+        std::vector<ScanCheckpoint::Directory> pending;
+        pending.reserve(subdirectories.size());
+        for (const auto& work : subdirectories) {
+            pending.push_back({work.path.string(), work.parentId, work.depth});
+        }
+        checkpoint_->commit(parentId, depth + 1, nextFileId_.load(), nextDirectoryId_.load(), listing->filtered,
+                            listing->journalEntries, listing->journal, pending);
+    }
+    if (!subdirectories.empty()) {
+        if (stream_) {
+            stream_->flushLocal();
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            for (auto& work : subdirectories) {
+                workQueue_.push(std::move(work));
+            }
+            pendingDirs_ += subdirectories.size();
+        }
+        queueCondition_.notify_all();
+    }
+}
+
+void FileSystemScanner::enqueueDirectory(DirectoryWork work, Listing* listing) {
+    if (listing) {
+        listing->directories.push_back(std::move(work));
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        workQueue_.push(std::move(work));
+        pendingDirs_++;
+    }
+    // 自适应模式下线程池中有被门控的线程，notify_one 可能恰好唤醒其中一个：它看到谓词为假后继续休眠，
+    // 这次唤醒就丢失了，队列中的目录可能再也没有活跃线程来取。此时唤醒全部线程
+    if (activeWorkers_.load() < poolSize_) {
+        queueCondition_.notify_all();
+    } else {
+        queueCondition_.notify_one();
+    }
+}
+
 // 工作线程函数
-void FileSystemScanner::workerThread() {
+void FileSystemScanner::workerThread(size_t index) {
     while (true) {
         std::unique_lock<std::mutex> lock(queueMutex_);
         
-        // 等待工作或停止信号
-        queueCondition_.wait(lock, [this] {
-            return !workQueue_.empty() || stopWorkers_;
+        // 等待工作或停止信号（自适应模式下超出活跃线程数的线程保持休眠）
+        queueCondition_.wait(lock, [this, index] {
+            return (!workQueue_.empty() && index < activeWorkers_.load()) || stopWorkers_;
         });
         
-        // 如果停止标志被设置且队列为空，退出
-        if (stopWorkers_ && workQueue_.empty()) {
+        // 停止标志只在所有目录处理完毕后设置
+        if (stopWorkers_) {
             break;
         }
         
         // 获取工作项
-        if (!workQueue_.empty()) {
-            auto work = workQueue_.front();
-            workQueue_.pop();
-            lock.unlock();
-            
-            // 处理目录
-            try {
-                for (const auto& entry : fs::directory_iterator(work.first)) {
-                    processDirectoryEntry(entry.path(), work.second);
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "警告: 无法扫描目录 " << work.first << ": " << e.what() << "\n";
-            }
+        auto work = workQueue_.front();
+        workQueue_.pop();
+        lock.unlock();
+        
+        // 处理目录
+        processDirectory(work.path, work.parentId, work.depth);
+        
+        // 子目录已在处理过程中入队，此时才减少计数，保证计数归零即全部完成
+        if (pendingDirs_.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> doneLock(queueMutex_);
+            doneCondition_.notify_all();
         }
     }
 }
 
 // 多线程并行扫描目录
-void FileSystemScanner::scanDirectoryRecursiveParallel(const fs::path& path, const std::string& parentId) {
+void FileSystemScanner::scanDirectoryRecursiveParallel(const fs::path& path, const std::string& parentId,
+                                                       std::vector<DirectoryWork>* frontier) {
+    // 自适应模式：线程池按上限创建，实际活跃线程数由调节器控制
+    size_t poolSize = numThreads_;
+    if (adaptiveConcurrency_) {
+        size_t maxWorkers = std::min<size_t>(256, std::max<size_t>(numThreads_ * 4, 16));
+        tuner_ = std::make_unique<ConcurrencyTuner>(numThreads_, 1, maxWorkers);
+        poolSize = maxWorkers;
+    }
+    activeWorkers_ = adaptiveConcurrency_ ? tuner_->target() : poolSize;
+    poolSize_ = poolSize;
+    
     // 启动工作线程
     stopWorkers_ = false;
     workerThreads_.clear();
-    for (size_t i = 0; i < numThreads_; i++) {
-        workerThreads_.emplace_back(&FileSystemScanner::workerThread, this);
+    for (size_t i = 0; i < poolSize; i++) {
+        workerThreads_.emplace_back(&FileSystemScanner::workerThread, this, i);
     }
     
-    // 处理根目录的条目，并将子目录添加到工作队列
-    try {
-        for (const auto& entry : fs::directory_iterator(path)) {
-            processDirectoryEntry(entry.path(), parentId);
+    if (frontier) {
+        // 恢复的扫描：按原来的入队顺序放回尚未处理的目录
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            for (auto& work : *frontier) {
+                workQueue_.push(std::move(work));
+            }
+            pendingDirs_ += frontier->size();
         }
-    } catch (const std::exception& e) {
-        std::cerr << "警告: 无法扫描目录 " << path << ": " << e.what() << "\n";
+        queueCondition_.notify_all();
+    } else {
+        // 处理根目录的条目，并将子目录添加到工作队列
+        processDirectory(path, parentId, 0);
     }
     
-    // 等待所有工作完成
-    while (true) {
+    // 等待所有工作完成；自适应模式下周期性地根据采样结果调整活跃线程数
+    {
         std::unique_lock<std::mutex> lock(queueMutex_);
-        if (workQueue_.empty()) {
-            // 等待一小段时间确保没有新工作
-            lock.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            lock.lock();
-            if (workQueue_.empty()) {
-                break;
+        while (pendingDirs_.load() != 0) {
+            doneCondition_.wait_for(lock, std::chrono::milliseconds(500));
+            if (tuner_ && pendingDirs_.load() != 0) {
+                size_t pending = workQueue_.size();
+                lock.unlock();
+                size_t target = tuner_->adjust(pending);
+                lock.lock();
+                if (target != activeWorkers_.load()) {
+                    activeWorkers_ = target;
+                    queueCondition_.notify_all();
+                }
             }
         }
-        lock.unlock();
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        // 停止工作线程
+        stopWorkers_ = true;
     }
-    
-    // 停止工作线程
-    stopWorkers_ = true;
     queueCondition_.notify_all();
     
     // 等待所有线程完成
@@ -514,32 +1052,46 @@ std::string FileSystemScanner::formatTime(const fs::file_time_type& time) {
         time - fs::file_time_type::clock::now() + std::chrono::system_clock::now()
     );
     
-    std::time_t tt = std::chrono::system_clock::to_time_t(sctp);
-    std::tm* tm = std::gmtime(&tt);
+    return formatTime(std::chrono::system_clock::to_time_t(sctp));
+}
+
+std::string FileSystemScanner::formatTime(std::time_t time) {
+    // 按文件系统的时间粒度取整（FAT32 只记录偶数秒）
+    time = model_.roundTime(time);
+    
+    // 多个扫描线程同时调用：使用可重入版本，std::gmtime 返回的是共享的静态缓冲区
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &time);
+#else
+    gmtime_r(&time, &tm);
+#endif
     
     std::ostringstream oss;
-    oss << std::put_time(tm, "%Y-%m-%dT%H:%M:%S.000Z");
+    oss << std::put_time(&tm, "%Y-%m-%dT%H:%M:%S.000Z");
     return oss.str();
 }
 
 std::string FileSystemScanner::getFileTime(const fs::path& path) {
+    return formatTime(getFileTimestamp(path));
+}
+
+std::time_t FileSystemScanner::getFileTimestamp(const fs::path& path) {
     try {
         if (fs::exists(path)) {
+            // 与 formatTime(file_time_type) 相同的时钟换算
             auto ftime = fs::last_write_time(path);
-            return formatTime(ftime);
+            auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                ftime - fs::file_time_type::clock::now() + std::chrono::system_clock::now()
+            );
+            return std::chrono::system_clock::to_time_t(sctp);
         }
     } catch (const std::exception& e) {
         // 忽略错误，使用当前时间
     }
     
     // 如果无法获取文件时间，使用当前时间
-    auto now = std::chrono::system_clock::now();
-    auto tt = std::chrono::system_clock::to_time_t(now);
-    std::tm* tm = std::gmtime(&tt);
-    
-    std::ostringstream oss;
-    oss << std::put_time(tm, "%Y-%m-%dT%H:%M:%S.000Z");
-    return oss.str();
+    return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
 }
 
 void FileSystemScanner::getPhysicalAddress(const fs::path& path, FileEntry& entry) {
@@ -581,15 +1133,14 @@ void FileSystemScanner::getPhysicalAddress(const fs::path& path, FileEntry& entr
     }
 }
 
-void FileSystemScanner::getIndexAddress(const fs::path& path, FileEntry& entry) {
-    // 只处理文件，目录没有索引地址
-    if (entry.type != "file" || entry.size == 0) {
-        return;
-    }
-    
+void FileSystemScanner::probeExtents(const fs::path& path, FileEntry& entry, const EntryStat* st) {
     try {
         // 静默失败，不输出警告（某些文件系统不支持 extent 查询是正常的）
 #ifdef _WIN32
+        (void)st;
+        if (throttle_) {
+            throttle_->beforeProbe();
+        }
         // Windows 系统：使用 FSCTL_GET_RETRIEVAL_POINTERS 获取簇映射
         HANDLE hFile = CreateFileW(
             path.wstring().c_str(),
@@ -666,253 +1217,135 @@ void FileSystemScanner::getIndexAddress(const fs::path& path, FileEntry& entry)
             CloseHandle(hFile);
         }
 #else
-        // Linux 系统：使用 FIEMAP ioctl 获取 extent 映射
-        int fd = open(path.c_str(), O_RDONLY);
-        if (fd >= 0) {
-            // 获取文件系统块大小
+        // Linux 系统：按设备选定的策略使用 FIEMAP 或 FIBMAP；扫描时已打开的描述符直接复用
+        int fd = st ? st->fd : -1;
+        DescriptorGuard owned{-1};
+        if (fd < 0) {
+            owned.fd = openNoAtime(AT_FDCWD, path.c_str());
+            fd = owned.fd;
+        }
+        if (fd < 0) {
+            return;
+        }
+        
+        // 获取文件系统块大小和所在设备
+        unsigned long blockSize = st ? st->fsBlockSize : 0;
+        unsigned long long deviceId = st ? st->deviceId : 0;
+        if (!st) {
             struct stat fileStat;
-            if (fstat(fd, &fileStat) == 0) {
-                unsigned long blockSize = fileStat.st_blksize;
-                if (blockSize == 0) {
-                    blockSize = 4096; // 默认 4KB
-                }
-                
-                // 准备 FIEMAP 请求
-                struct fiemap* fiemap = nullptr;
-                size_t fiemapSize = sizeof(struct fiemap) + sizeof(struct fiemap_extent);
-                fiemap = (struct fiemap*)malloc(fiemapSize);
-                if (fiemap) {
-                    memset(fiemap, 0, fiemapSize);
-                    fiemap->fm_start = 0;
-                    fiemap->fm_length = entry.size;
-                    fiemap->fm_flags = FIEMAP_FLAG_SYNC;
-                    fiemap->fm_extent_count = 1;
-                    
-                    // 循环获取所有 extent
-                    unsigned long long offset = 0;
-                    while (offset < entry.size) {
-                        fiemap->fm_start = offset;
-                        fiemap->fm_length = entry.size - offset;
-                        
-                        if (ioctl(fd, FS_IOC_FIEMAP, fiemap) == 0) {
-                            if (fiemap->fm_mapped_extents == 0) {
-                                break; // 没有更多 extent
-                            }
-                            
-                            // 处理获取到的 extent
-                            for (unsigned int i = 0; i < fiemap->fm_mapped_extents; i++) {
-                                ExtentInfo extent;
-                                extent.logicalOffset = fiemap->fm_extents[i].fe_logical;
-                                extent.physicalOffset = fiemap->fm_extents[i].fe_physical;
-                                extent.length = fiemap->fm_extents[i].fe_length;
-                                
-                                entry.extents.push_back(extent);
-                                offset = fiemap->fm_extents[i].fe_logical + fiemap->fm_extents[i].fe_length;
-                            }
-                            
-                            // 如果还有更多 extent，需要重新分配更大的缓冲区
-                            if (fiemap->fm_flags & FIEMAP_FLAG_MORE) {
-                                // 扩展缓冲区以获取更多 extent
-                                size_t newSize = sizeof(struct fiemap) + 
-                                                (fiemap->fm_mapped_extents + 1) * sizeof(struct fiemap_extent);
-                                struct fiemap* newFiemap = (struct fiemap*)realloc(fiemap, newSize);
-                                if (newFiemap) {
-                                    fiemap = newFiemap;
-                                    memset((char*)fiemap + fiemapSize, 0, newSize - fiemapSize);
-                                    fiemap->fm_extent_count = fiemap->fm_mapped_extents + 1;
-                                    fiemapSize = newSize;
-                                } else {
-                                    break; // 内存分配失败
-                                }
-                            } else {
-                                break; // 没有更多 extent
-                            }
-                        } else {
-                            // ioctl 失败，可能不支持 FIEMAP，尝试使用 FIBMAP（较老的方法）
-                            // 注意：FIBMAP 需要 root 权限，在 WSL2 中可能无法使用
-                            if (errno == ENOTTY || errno == EOPNOTSUPP || errno == EPERM) {
-                                // 不支持 FIEMAP 或没有权限，尝试使用 FIBMAP 作为后备方案
-                                // FIBMAP 需要 root 权限
-                                bool permissionIssue = (errno == EPERM && !hasRootPrivileges());
-                                
-                                if (permissionIssue && autoSuggestRoot_ && !rootSuggestionShown_) {
-                                    // 只在第一次遇到权限问题时提示一次
-                                    rootSuggestionShown_ = true;
-                                    std::cerr << "\n提示: 检测到权限不足，无法获取真实的文件物理块映射信息。\n";
-                                    std::cerr << "      使用 sudo 运行程序可获取更准确的信息。\n\n";
-                                }
-                                
-                                unsigned long blockNum = 0;
-                                unsigned long long fileOffset = 0;
-                                bool fibmapWorked = false;
-                                
-                                while (fileOffset < entry.size && blockNum < 100) {  // 限制检查的块数
-                                    int blockIndex = static_cast<int>(fileOffset / blockSize);
-                                    if (ioctl(fd, FIBMAP, &blockIndex) == 0 && blockIndex != 0) {
-                                        fibmapWorked = true;
-                                        ExtentInfo extent;
-                                        extent.logicalOffset = fileOffset;
-                                        extent.physicalOffset = static_cast<unsigned long long>(blockIndex) * blockSize;
-                                        extent.length = blockSize;
-                                        
-                                        // 尝试合并连续的块
-                                        if (!entry.extents.empty() && 
-                                            entry.extents.back().physicalOffset + entry.extents.back().length == extent.physicalOffset &&
-                                            entry.extents.back().logicalOffset + entry.extents.back().length == extent.logicalOffset) {
-                                            entry.extents.back().length += extent.length;
-                                        } else {
-                                            entry.extents.push_back(extent);
-                                        }
-                                    } else {
-                                        // FIBMAP 失败（可能是权限问题），停止尝试
-                                        break;
-                                    }
-                                    fileOffset += blockSize;
-                                    blockNum++;
-                                }
-                            }
-                            // 静默失败，不输出错误（某些文件系统不支持是正常的）
-                            break;
-                        }
-                    }
-                    if (fiemap) {
-                        free(fiemap);
-                        fiemap = nullptr;
-                    }
-                }
+            if (fstat(fd, &fileStat) != 0) {
+                return;
             }
-            close(fd);
+            blockSize = fileStat.st_blksize;
+            deviceId = fileStat.st_dev;
         }
-#endif
-    } catch (const std::exception& e) {
-        // 如果获取失败，保持 extents 为空（静默失败，某些文件系统不支持是正常的）
-        // 不输出警告，因为这在 WSL2/NTFS 等文件系统上是预期的行为
-    }
-    
-    // Fallback: 如果无法获取真实的extent信息，根据blocks数组生成模拟的extent信息
-    // 这对于不支持FIEMAP/FIBMAP的文件系统（如WSL2/NTFS）很有用
-    if (entry.extents.empty() && !entry.blocks.empty() && entry.size > 0) {
-        // 使用块大小（从disk配置或默认值）
-        unsigned long long blockSize = static_cast<unsigned long long>(blockSize_);
         if (blockSize == 0) {
-            blockSize = 4096; // 默认4KB
+            blockSize = 4096; // 默认 4KB
         }
         
-        // 根据blocks数组生成extent信息
-        // 对于连续分配，blocks数组中的值就是物理块号
-        // 对于链式或索引分配，我们假设blocks数组中的值也是物理块号
-        unsigned long long logicalOffset = 0;
+        using Strategy = DeviceCapabilities::Strategy;
+        DeviceCapabilities::Device& device = capabilities_.lookup(deviceId, fd);
+        device.files++;
+        Strategy strategy = DeviceCapabilities::strategyOf(device);
+        if (strategy == Strategy::Simulated) {
+            // 该设备没有可用的 ioctl：不再逐个文件重试，由 getIndexAddress 生成模拟的 extent
+            return;
+        }
+        if (throttle_) {
+            throttle_->beforeProbe();
+        }
         
-        // 优化：合并连续的块为单个extent
-        for (size_t i = 0; i < entry.blocks.size(); i++) {
-            unsigned long long physicalBlock = static_cast<unsigned long long>(entry.blocks[i]);
-            unsigned long long physicalOffset = physicalBlock * blockSize;
-            
-            // 计算这个块的长度
-            unsigned long long remainingSize = entry.size - logicalOffset;
-            unsigned long long blockLength = (remainingSize < blockSize) ? remainingSize : blockSize;
-            
-            // 检查是否可以与上一个extent合并（连续分配且物理块连续）
-            if (!entry.extents.empty()) {
-                ExtentInfo& lastExtent = entry.extents.back();
-                unsigned long long expectedNextPhysical = lastExtent.physicalOffset + lastExtent.length;
-                unsigned long long expectedNextLogical = lastExtent.logicalOffset + lastExtent.length;
-                
-                // 如果物理块和逻辑块都连续，合并extent
-                if (physicalOffset == expectedNextPhysical && logicalOffset == expectedNextLogical) {
-                    lastExtent.length += blockLength;
-                    logicalOffset += blockLength;
-                    continue;
-                }
+        if (strategy == Strategy::Unknown || strategy == Strategy::Fiemap) {
+            int error = fiemapExtents(fd, entry);
+            if (error == 0) {
+                DeviceCapabilities::resolve(device, Strategy::Unknown, Strategy::Fiemap);
+                return;
             }
-            
-            // 创建新的extent
-            ExtentInfo extent;
-            extent.logicalOffset = logicalOffset;
-            extent.physicalOffset = physicalOffset;
-            extent.length = blockLength;
-            entry.extents.push_back(extent);
-            
-            logicalOffset += blockLength;
-            
-            // 如果已经覆盖了整个文件，停止
-            if (logicalOffset >= entry.size) {
-                break;
+            // 其他错误只说明这个文件无法探测（如 O_PATH 描述符），不改变设备的策略
+            if (strategy == Strategy::Fiemap || (error != ENOTTY && error != EOPNOTSUPP && error != EPERM)) {
+                return;
+            }
+            DeviceCapabilities::resolve(device, Strategy::Unknown, Strategy::NoFiemap);
+            strategy = Strategy::NoFiemap;
+        }
+        
+        // 不支持 FIEMAP，尝试使用 FIBMAP（较老的方法）；FIBMAP 需要 root 权限，在 WSL2 中可能无法使用
+        if (strategy == Strategy::NoFiemap && !capabilities_.privileged()) {
+            DeviceCapabilities::resolve(device, Strategy::NoFiemap, Strategy::Simulated);
+            if (autoSuggestRoot_ && !rootSuggestionShown_) {
+                // 只在第一次遇到权限问题时提示一次
+                rootSuggestionShown_ = true;
+                std::cerr << "\n提示: 检测到权限不足，无法获取真实的文件物理块映射信息。\n";
+                std::cerr << "      使用 sudo 运行程序可获取更准确的信息。\n\n";
             }
+            return;
         }
+        int error = fibmapExtents(fd, blockSize, entry);
+        if (strategy == Strategy::NoFiemap && (error == 0 || error == EINVAL || error == ENOTTY || error == EPERM)) {
+            DeviceCapabilities::resolve(device, Strategy::NoFiemap, error == 0 ? Strategy::Fibmap : Strategy::Simulated);
+        }
+#endif
+    } catch (const std::exception& e) {
+        // 如果获取失败，保持 extents 为空（静默失败，某些文件系统不支持是正常的）
+        // 不输出警告，因为这在 WSL2/NTFS 等文件系统上是预期的行为
     }
-    
-    // 根据 extent 信息判断分配算法
-    entry.allocationAlgorithm = determineAllocationAlgorithm(entry);
 }
 
-std::string FileSystemScanner::determineAllocationAlgorithm(const FileEntry& entry) {
-    // 目录没有分配算法
-    if (entry.type != "file" || entry.size == 0) {
-        return "";
+void FileSystemScanner::indexFile(const fs::path& path, FileEntry& entry, const EntryStat* st) {
+    if (!sampler_ || entry.size == 0) {
+        getIndexAddress(path, entry, true, st);
+        return;
     }
     
-    // 优先根据 extent 信息判断
-    if (!entry.extents.empty()) {
-        // 计算 extent 覆盖的总长度
-        unsigned long long totalExtentLength = 0;
-        for (const auto& extent : entry.extents) {
-            totalExtentLength += extent.length;
-        }
-        
-        // 如果只有一个 extent，且覆盖整个文件（或接近），则是连续分配
-        if (entry.extents.size() == 1) {
-            const auto& extent = entry.extents[0];
-            // 检查 extent 是否从文件开头开始，且长度覆盖整个文件（允许小的误差）
-            if (extent.logicalOffset == 0 && 
-                (extent.length >= entry.size || 
-                 (extent.length >= entry.size * 0.95))) {  // 允许5%的误差
-                return "continuous";
-            }
-        }
-        
-        // 如果有多个 extent，则是非连续分配
-        // 根据 extent 数量判断是链式还是索引分配
-        if (entry.extents.size() > 1) {
-            // 如果 extent 数量较少（<= 10），可能是索引分配
-            // 如果 extent 数量很多，可能是链式分配
-            // 这里我们使用一个简单的阈值
-            if (entry.extents.size() <= 10) {
-                return "indexed";
-            } else {
-                return "linked";
-            }
-        }
-        
-        // 如果只有一个 extent 但不完全覆盖，可能是部分连续
-        return "continuous";
+    // 所有文件都计入总体，只有抽中的文件做真实探测并记录结果
+    FragmentationSampler::Stratum* stratum = sampler_->admit(entry);
+    getIndexAddress(path, entry, stratum != nullptr, st);
+    if (stratum) {
+        sampler_->record(stratum, entry);
+    }
+}
+
+void FileSystemScanner::getIndexAddress(const fs::path& path, FileEntry& entry, bool probe,
+                                        const EntryStat* st) {
+    // 只处理文件，目录没有索引地址
+    if (entry.type != EntryKind::File || entry.size == 0) {
+        return;
     }
     
-    // 如果没有 extent 信息，根据 blocks 数组判断
-    if (!entry.blocks.empty()) {
-        // 检查 blocks 数组是否连续
-        bool isContinuous = true;
-        for (size_t i = 1; i < entry.blocks.size(); i++) {
-            if (entry.blocks[i] != entry.blocks[i-1] + 1) {
-                isContinuous = false;
-                break;
-            }
-        }
-        
-        if (isContinuous) {
-            return "continuous";
-        } else {
-            // 根据块数量判断是链式还是索引分配
-            if (entry.blocks.size() <= 10) {
-                return "indexed";
-            } else {
-                return "linked";
-            }
-        }
+    // 抽样模式下未抽中的文件跳过真实探测，直接使用模拟的 extent
+    if (probe) {
+        probeExtents(path, entry, st);
     }
     
-    // 如果既没有 extent 也没有 blocks，无法判断
-    return "";
+    // 无法获取真实的 extent 时（不支持 FIEMAP/FIBMAP 的文件系统，如 WSL2/NTFS）由 blocks 生成模拟的 extent：
+    // 普通文件只有 [0, size) 一个数据区间，稀疏文件跳过空洞；随后根据 extent 判断分配算法
+    std::pair<uint64_t, uint64_t> whole(0, entry.size);
+    if (st && st->sparse) {
+        model_.describeFile(entry, blockSize_, st->dataRegions.data(), st->dataRegions.size());
+    } else {
+        model_.describeFile(entry, blockSize_, &whole, 1);
+    }
+}
+
+void FileSystemScanner::collectExtents(ExtentIndex& index) const {
+    entries_.forEach([&index](const FileEntry& entry) {
+        index.add(entry);
+    });
+}
+
+void FileSystemScanner::setSummaryOnly(bool enable) {
+    summaryOnly_ = enable;
+    if (enable && !aggregator_) {
+        aggregator_ = std::make_unique<ScanAggregator>();
+    }
+}
+
+void FileSystemScanner::writeSummary(const std::string& outputPath, CompressionType compression) const {
+    if (!aggregator_) {
+        throw std::runtime_error("未启用汇总统计");
+    }
+    aggregator_->writeJSON(outputPath, compression, model_.name(), blockSize_,
+                           directoryCount_.load());
 }
 
 bool FileSystemScanner::hasRootPrivileges() {
@@ -961,94 +1394,316 @@ void FileSystemScanner::suggestSudoUsage() {
 #endif
 }
 
-void FileSystemScanner::generateJSON(const std::string& outputPath) {
-    nlohmann::json json;
-    
-    // 设置文件系统类型
-    json["fileSystemType"] = fileSystemType_;
+size_t FileSystemScanner::settleDisk() {
+    // churn 模式中仍存在的临时文件在此删除，只留下空洞
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex_);
+        if (diskTotalBlocks_ == 0) {
+            allocator_.settle();
+            totalBlocks_ = static_cast<size_t>(allocator_.usedCount());
+        }
+    }
     
     // 计算总块数（至少为已使用的块数，可以设置一个合理的上限）
     size_t currentTotalBlocks = totalBlocks_.load();
     size_t calculatedTotalBlocks = std::max(currentTotalBlocks, size_t(1000));
-    if (currentTotalBlocks > 0) {
-        // 添加一些空闲块
+    if (diskTotalBlocks_ > 0) {
+        // 镜像模式：使用文件系统的真实大小
+        calculatedTotalBlocks = static_cast<size_t>(diskTotalBlocks_);
+    } else if (currentTotalBlocks > 0) {
+        // 添加一些空闲块；删除留下的空洞可能使已用区域超过这个大小
         calculatedTotalBlocks = currentTotalBlocks + (currentTotalBlocks / 10);  // 增加10%的空闲块
+        calculatedTotalBlocks = std::max(calculatedTotalBlocks, static_cast<size_t>(allocator_.highWater()));
+    }
+    return calculatedTotalBlocks;
+}
+
+void FileSystemScanner::setStreamOutput(const std::string& path, CompressionType compression) {
+    stream_ = std::make_unique<EntryStream>(path, compression);
+}
+
+void FileSystemScanner::emitEntry(const FileEntry& entry, Listing* listing) {
+    if (stream_) {
+        stream_->add(entry);
+    }
+    if (checkpoint_ && listing) {
+        ScanCheckpoint::encodeEntry(listing->journal, entry);
+        listing->journalEntries++;
+    }
+}
+
+void FileSystemScanner::countFiltered(Listing* listing) {
+    filteredCount_++;
+    if (listing) {
+        listing->filtered++;
+    }
+}
+
+void FileSystemScanner::setCheckpoint(const std::string& path, const std::string& signature,
+                                      double intervalSeconds, bool resume) {
+    checkpointPath_ = path;
+    checkpointSignature_ = signature;
+    checkpointInterval_ = intervalSeconds;
+    resumeCheckpoint_ = resume;
+}
+
+void FileSystemScanner::discardCheckpoint() {
+    if (checkpoint_) {
+        checkpoint_->remove();
+    }
+}
+
+bool FileSystemScanner::openCheckpoint(std::vector<DirectoryWork>& frontier) {
+    if (checkpointPath_.empty()) {
+        return false;
+    }
+    if (!resumeCheckpoint_) {
+        checkpoint_ = std::make_unique<ScanCheckpoint>(checkpointPath_, checkpointSignature_, checkpointInterval_);
+        return false;
     }
     
-    // 生成空闲块列表（需要加锁保护）
-    std::vector<int> freeBlocksList;
-    {
-        std::lock_guard<std::mutex> lock(blocksMutex_);
-        for (int i = 0; i < static_cast<int>(calculatedTotalBlocks); i++) {
-            if (usedBlocks_.find(i) == usedBlocks_.end()) {
-                freeBlocksList.push_back(i);
+    // 已完成目录的子目录按入队顺序记下，回放结束后去掉已完成的，剩下的就是中断时的工作队列
+    std::vector<ScanCheckpoint::Directory> generated;
+    std::unordered_set<std::string> completed;
+    checkpoint_ = std::make_unique<ScanCheckpoint>(
+        checkpointPath_, checkpointSignature_, checkpointInterval_,
+        [this, &generated, &completed](ScanCheckpoint::Unit& unit) {
+            replayUnit(unit);
+            if (!unit.completed.empty()) {
+                completed.insert(unit.completed);
+            }
+            for (auto& directory : unit.directories) {
+                generated.push_back(std::move(directory));
+            }
+        });
+    // 只有文件头（根目录单元还没写出）：按新扫描处理
+    if (checkpoint_->replayedUnits() == 0) {
+        return false;
+    }
+    for (auto& directory : generated) {
+        if (completed.count(directory.id) == 0) {
+            frontier.push_back({fs::path(directory.path), directory.id, directory.depth});
+        }
+    }
+    return true;
+}
+
+void FileSystemScanner::replayUnit(ScanCheckpoint::Unit& unit) {
+    for (auto& entry : unit.entries) {
+        if (entry.type == EntryKind::Directory) {
+            size_t parent = entry.parentId.empty() ? SubtreeRollup::npos : SubtreeRollup::indexOf(entry.parentId);
+            rollup_.addDirectory(SubtreeRollup::indexOf(entry.id), parent, unit.depth);
+            entries_.add(std::move(entry));
+            directoryCount_++;
+            continue;
+        }
+        
+        // 条目中保存的块号就是原来的分配结果；按原顺序重新分配一次，使模拟磁盘的状态
+        // （包括 churn 的临时文件）与中断时一致，后续文件得到与不中断时相同的块
+        allocateBlocks(allocationSize(entry));
+        if (entry.sparse) {
+            sparseFileCount_++;
+            holeSize_ += entry.size - allocationSize(entry);
+        }
+        if (sampler_ && entry.size > 0) {
+            FragmentationSampler::Stratum* stratum = sampler_->admit(entry);
+            if (stratum) {
+                sampler_->record(stratum, entry);
             }
         }
+        if (aggregator_) {
+            std::tm tm{};
+            std::istringstream time(entry.createTime);
+            time >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
+#ifdef _WIN32
+            std::time_t mtime = _mkgmtime(&tm);
+#else
+            std::time_t mtime = timegm(&tm);
+#endif
+            aggregator_->addFile(entry.physicalPath, entry.name, entry.size, entry.extents.size(), mtime);
+        }
+        totalSize_ += entry.size;
+        rollup_.addFile(SubtreeRollup::indexOf(entry.parentId), entry.size,
+                        entry.blocks.size() * blockSize_, entry.extents.size());
+        entries_.add(std::move(entry));
+        fileCount_++;
+    }
+    filteredCount_ += static_cast<size_t>(unit.filtered);
+    
+    // 多线程扫描时单元的提交顺序与 ID 的分配顺序不完全一致，取最大值保证新 ID 不重复
+    nextFileId_ = std::max(nextFileId_.load(), static_cast<int>(unit.nextFileId));
+    nextDirectoryId_ = std::max(nextDirectoryId_.load(), static_cast<int>(unit.nextDirectoryId));
+    notifyProgress();
+}
+
+uint64_t FileSystemScanner::finishStream() {
+    if (!stream_) {
+        throw std::runtime_error("未启用流式输出");
+    }
+    size_t totalBlocks = settleDisk();
+    uint64_t usedInRange = 0;
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex_);
+        const auto& bitmap = allocator_.bitmap();
+        uint64_t limit = std::min<uint64_t>(totalBlocks, static_cast<uint64_t>(bitmap.size()) * 64);
+        usedInRange = BitmapKernels::popcount(bitmap.data(), bitmap.size(), 0, limit);
     }
     
-    // 构建磁盘对象
+    // 尾部记录用 record 字段与条目记录区分：先是磁盘汇总，抽样模式下再附加碎片估计
     nlohmann::json disk;
+    disk["record"] = "disk";
     disk["id"] = "disk-1";
-    disk["totalBlocks"] = calculatedTotalBlocks;
     disk["blockSize"] = static_cast<int>(blockSize_);
+    disk["fileSystemType"] = model_.name();
     disk["fragmentRate"] = calculateFragmentRate();
-    disk["freeBlocks"] = freeBlocksList;
-    disk["usedBlocks"] = nlohmann::json::object();  // 空对象，因为usedBlocks在JSON中不需要
+    disk["totalBlocks"] = totalBlocks;
+    disk["usedBlockCount"] = totalBlocks_.load();
+    disk["freeBlockCount"] = totalBlocks - usedInRange;
+    disk["files"] = fileCount_.load();
+    disk["directories"] = directoryCount_.load();
+    disk["totalSize"] = totalSize_.load();
+    stream_->writeRecord(disk.dump());
+    
+    if (sampler_) {
+        std::string estimate;
+        sampler_->appendJSON(estimate, 0);
+        nlohmann::json sampling = nlohmann::json::parse(estimate);
+        sampling["record"] = "sampling";
+        stream_->writeRecord(sampling.dump());
+    }
+    
+    uint64_t records = stream_->recordCount();
+    stream_->close();
+    return records;
+}
+
+void FileSystemScanner::generateJSON(const std::string& outputPath) {
+    // 流式写出：键顺序和缩进与 nlohmann::json::dump(2) 一致，
+    // 条目从存储中按插入顺序逐条读出（包括已溢出到磁盘的部分），不在内存中构建 JSON 树
+    SnapshotWriter writer(outputPath, outputCompression_);
+    std::string& out = writer.buffer();
+    
+    out += "{\n";
+    SnapshotWriter::appendKey(out, 1, "disk");
+    appendDiskJSON(writer, 1, "disk-1");
+    out += ",\n";
+    
+    SnapshotWriter::appendKey(out, 1, "fileSystemType");
+    SnapshotWriter::appendString(out, model_.name());
+    
+    // 抽样模式：附加碎片统计的估计值及置信区间
+    if (sampler_) {
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 1, "sampling");
+        sampler_->appendJSON(out, 1);
+    }
+    out += "\n}";
+    
+    writer.close();
+}
+
+void FileSystemScanner::appendDiskJSON(SnapshotWriter& writer, int level, const std::string& id) {
+    // 子树汇总：同一深度的目录并行汇总到父目录，逐层向上
+    rollup_.compute(numThreads_);
+    
+    size_t calculatedTotalBlocks = settleDisk();
     
-    // 构建文件数组（需要加锁保护）
-    nlohmann::json filesArray = nlohmann::json::array();
+    std::string& out = writer.buffer();
+    out += "{\n";
+    SnapshotWriter::appendKey(out, level + 1, "blockSize");
+    SnapshotWriter::appendNumber(out, static_cast<int>(blockSize_));
+    out += ",\n";
+    if (!device_.empty()) {
+        SnapshotWriter::appendKey(out, level + 1, "device");
+        SnapshotWriter::appendString(out, device_);
+        out += ",\n";
+    }
+    
+    // 文件数组：按连续分片并行编码，各分片缓冲区按顺序写出，与串行编码逐字节一致
+    SnapshotWriter::appendKey(out, level + 1, "files");
+    size_t writtenEntries = 0;
     {
-        std::lock_guard<std::mutex> lock(filesMutex_);
-        for (const auto& file : files_) {
-            nlohmann::json fileJson;
-            fileJson["id"] = file.id;
-            fileJson["name"] = file.name;
-            fileJson["type"] = file.type;
-            fileJson["size"] = static_cast<int>(file.size);
-            fileJson["blocks"] = file.blocks;
-            fileJson["parentId"] = file.parentId;
-            fileJson["createTime"] = file.createTime;
-            
-            // 添加物理地址信息
-            fileJson["inode"] = file.inode;
-            fileJson["deviceId"] = file.deviceId;
-            fileJson["physicalPath"] = file.physicalPath;
-            
-            // 添加索引地址信息（extent 映射）
-            if (!file.extents.empty()) {
-                nlohmann::json extentsArray = nlohmann::json::array();
-                for (const auto& extent : file.extents) {
-                    nlohmann::json extentJson;
-                    extentJson["logicalOffset"] = extent.logicalOffset;
-                    extentJson["physicalOffset"] = extent.physicalOffset;
-                    extentJson["length"] = extent.length;
-                    extentsArray.push_back(extentJson);
-                }
-                fileJson["extents"] = extentsArray;
-            } else {
-                fileJson["extents"] = nlohmann::json::array();
-            }
-            
-            if (file.type == "file" && !file.allocationAlgorithm.empty()) {
-                fileJson["allocationAlgorithm"] = file.allocationAlgorithm;
-            } else {
-                fileJson["allocationAlgorithm"] = nullptr;
-            }
-            
-            filesArray.push_back(fileJson);
+        ParallelEntryEncoder encoder(writer, numThreads_, level + 2, &rollup_);
+        entries_.forEachBatch(ENCODE_BATCH_SIZE, [&encoder](std::shared_ptr<const EntryBatch> batch) {
+            encoder.submit(std::move(batch));
+        });
+        writtenEntries = encoder.finish();
+    }
+    if (writtenEntries == 0) {
+        out += "[]";
+    } else {
+        out += '\n';
+        SnapshotWriter::appendIndent(out, level + 1);
+        out += ']';
+    }
+    out += ",\n";
+    
+    SnapshotWriter::appendKey(out, level + 1, "fragmentRate");
+    SnapshotWriter::appendDouble(out, calculateFragmentRate());
+    out += ",\n";
+    
+    // 空闲块列表（需要加锁保护）
+    SnapshotWriter::appendKey(out, level + 1, "freeBlocks");
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex_);
+        // 整字已用的区域由 findFreeRun 批量跳过
+        const auto& bitmap = allocator_.bitmap();
+        uint64_t limit = std::min<uint64_t>(calculatedTotalBlocks, static_cast<uint64_t>(INT_MAX) + 1);
+        for (uint64_t i = BitmapKernels::findFreeRun(bitmap.data(), bitmap.size(), 0, 1); i < limit;
+             i = BitmapKernels::findFreeRun(bitmap.data(), bitmap.size(), i + 1, 1)) {
+            out += first ? "[\n" : ",\n";
+            first = false;
+            SnapshotWriter::appendIndent(out, level + 2);
+            SnapshotWriter::appendNumber(out, static_cast<long long>(i));
+            writer.flushIfNeeded();
         }
     }
+    if (first) {
+        out += "[]";
+    } else {
+        out += '\n';
+        SnapshotWriter::appendIndent(out, level + 1);
+        out += ']';
+    }
+    out += ",\n";
     
-    disk["files"] = filesArray;
-    json["disk"] = disk;
+    SnapshotWriter::appendKey(out, level + 1, "id");
+    SnapshotWriter::appendString(out, id);
+    out += ",\n";
     
-    // 写入文件
-    std::ofstream outFile(outputPath);
-    if (!outFile.is_open()) {
-        throw std::runtime_error("无法打开输出文件: " + outputPath);
+    // 多根扫描：每个设备一个磁盘节，附加介质类型、扫描根目录和本设备的抽样估计
+    if (!device_.empty()) {
+        SnapshotWriter::appendKey(out, level + 1, "media");
+        SnapshotWriter::appendString(out, media_);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, level + 1, "roots");
+        for (size_t i = 0; i < roots_.size(); i++) {
+            out += i == 0 ? "[\n" : ",\n";
+            SnapshotWriter::appendIndent(out, level + 2);
+            SnapshotWriter::appendString(out, roots_[i]);
+        }
+        if (roots_.empty()) {
+            out += "[]";
+        } else {
+            out += '\n';
+            SnapshotWriter::appendIndent(out, level + 1);
+            out += ']';
+        }
+        out += ",\n";
+        if (sampler_) {
+            SnapshotWriter::appendKey(out, level + 1, "sampling");
+            sampler_->appendJSON(out, level + 1);
+            out += ",\n";
+        }
     }
     
-    outFile << json.dump(2);  // 缩进2个空格，美化输出
-    outFile.close();
+    SnapshotWriter::appendKey(out, level + 1, "totalBlocks");
+    SnapshotWriter::appendUnsigned(out, calculatedTotalBlocks);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, level + 1, "usedBlocks");
+    out += "{}";  // 空对象，因为usedBlocks在JSON中不需要
+    out += '\n';
+    SnapshotWriter::appendIndent(out, level);
+    out += '}';
 }
-
@@ -13,6 +13,22 @@
 #include <condition_variable>
 #include <future>
 #include <functional>
+#include <memory>
+#include "ConcurrencyTuner.h"
+#include "FileEntry.h"
+#include "EntryStore.h"
+#include "OutputCompressor.h"
+#include "PathFilter.h"
+#include "FragmentationSampler.h"
+#include "SubtreeRollup.h"
+#include "BlockAllocator.h"
+#include "ExtentIndex.h"
+#include "ScanAggregator.h"
+#include "EntryStream.h"
+#include "ScanCheckpoint.h"
+#include "ScanThrottle.h"
+#include "DeviceCapabilities.h"
+#include "FileSystemModel.h"
 #ifdef _WIN32
 #include <windows.h>
 #include <winioctl.h>
@@ -42,36 +58,12 @@
 
 namespace fs = std::filesystem;
 
-// 文件索引地址结构（extent）
-struct ExtentInfo {
-    unsigned long long logicalOffset;   // 逻辑偏移（文件内的字节偏移）
-    unsigned long long physicalOffset; // 物理偏移（磁盘上的块号）
-    unsigned long long length;         // 长度（字节数）
-};
-
-struct FileEntry {
-    std::string id;
-    std::string name;
-    std::string type;  // "file" or "directory"
-    size_t size;
-    std::vector<int> blocks;
-    std::string parentId;
-    std::string createTime;
-    std::string allocationAlgorithm;  // "continuous", "linked", "indexed", or null for directories
-    // 物理地址信息
-    unsigned long long inode;      // inode 号（Linux）或文件索引号（Windows）
-    unsigned long long deviceId;    // 设备ID
-    std::string physicalPath;      // 物理路径（完整路径）
-    // 索引地址信息（extent 映射）
-    std::vector<ExtentInfo> extents;  // 文件的 extent 列表
-};
-
 class FileSystemScanner {
 public:
     // 进度回调函数类型：void callback(size_t files, size_t dirs, size_t totalSize)
     using ProgressCallback = std::function<void(size_t, size_t, size_t)>;
     
-    FileSystemScanner(size_t blockSize, const std::string& fileSystemType);
+    FileSystemScanner(size_t blockSize, FileSystemType fileSystemType);
     
     // 扫描目录
     void scanDirectory(const std::string& path);
@@ -79,9 +71,24 @@ public:
     // 扫描单个文件
     void scanFile(const std::string& path);
     
+    // 离线解析 ext4/FAT32 镜像文件：使用镜像中真实的块位图和 extent 树（FAT32 为簇链），
+    // 块大小和总块数取自超级块/BPB
+    void scanImage(const std::string& imagePath);
+    
     // 生成JSON文件
     void generateJSON(const std::string& outputPath);
     
+    // 把磁盘节（块大小、文件数组、空闲块等）作为一个 JSON 对象追加到 writer，
+    // level 为对象所在的缩进层级；generateJSON 和多根扫描的 disks 数组共用
+    void appendDiskJSON(SnapshotWriter& writer, int level, const std::string& id);
+    
+    // 多根扫描：标记该扫描器负责的设备（如 "8:1"）及介质类型，
+    // 设置后磁盘节附加 device、media、roots 以及本设备的抽样估计
+    void setDevice(const std::string& device, const std::string& media) { device_ = device; media_ = media; }
+    
+    // 条目 ID 的前缀（多根扫描中为 "d<磁盘节序号>:"），使各设备的 ID 在整个快照中唯一
+    void setIdPrefix(const std::string& prefix) { idPrefix_ = prefix; }
+    
     // 设置进度回调
     void setProgressCallback(ProgressCallback callback) { progressCallback_ = callback; }
     
@@ -90,6 +97,8 @@ public:
     size_t getDirectoryCount() const { return directoryCount_.load(); }
     size_t getTotalSize() const { return totalSize_.load(); }
     size_t getTotalBlocks() const { return totalBlocks_.load(); }
+    size_t getBlockSize() const { return blockSize_; }
+    FileSystemType getFileSystemType() const { return model_.type(); }
     
     // 检查是否有 root 权限
     static bool hasRootPrivileges();
@@ -99,13 +108,92 @@ public:
     
     // 设置是否在权限不足时自动提示
     void setAutoSuggestRoot(bool enable) { autoSuggestRoot_ = enable; }
+    
+    // 设置工作线程数（默认为 cgroup 配额/CPU 亲和性允许的有效 CPU 数）
+    void setThreadCount(size_t count) { numThreads_ = std::max<size_t>(1, count); }
+    size_t getThreadCount() const { return numThreads_; }
+    
+    // 启用自适应并发：从有效 CPU 数起步，扫描中根据吞吐量和延迟增减活跃线程数
+    void setAdaptiveConcurrency(bool enable) { adaptiveConcurrency_ = enable; }
+    bool isAdaptiveConcurrency() const { return adaptiveConcurrency_; }
+    
+    // 自适应模式下扫描期间达到的最大/最终活跃线程数
+    size_t getPeakActiveWorkers() const { return tuner_ ? tuner_->peakWorkers() : numThreads_; }
+    size_t getActiveWorkers() const { return activeWorkers_.load(); }
+    
+    // 按 inode 顺序处理目录条目（适用于机械盘和镜像文件后端存储）
+    void setInodeOrder(bool enable) { inodeOrder_ = enable; }
+    
+    // 条目存储的内存上限（字节，0 表示不限制），超出时溢出到临时文件
+    void setMemoryLimit(size_t bytes) { entries_.setMemoryLimit(bytes); }
+    void setSpillDirectory(const std::string& dir) { entries_.setSpillDirectory(dir); }
+    size_t getSpilledChunkCount() const { return entries_.spilledChunkCount(); }
+    
+    // 输出压缩格式（gzip/zstd），压缩在独立线程中与编码并行进行
+    void setOutputCompression(CompressionType type) { outputCompression_ = type; }
+    
+    // 遍历过滤规则（include/exclude/最大深度/最小大小），在扫描开始前设置
+    PathFilter& pathFilter() { return filter_; }
+    size_t getFilteredCount() const { return filteredCount_.load(); }
+    
+    // 各设备的 extent 探测策略
+    const DeviceCapabilities& getCapabilities() const { return capabilities_; }
+    
+    // 稀疏文件数和空洞总字节数（逻辑大小减去实际占用）
+    size_t getSparseFileCount() const { return sparseFileCount_.load(); }
+    size_t getHoleSize() const { return holeSize_.load(); }
+    
+    // 抽样模式：只对按 大小级别 × 一级目录 分层抽中的文件探测真实 extent，
+    // 输出中附加碎片统计的估计值和置信区间（rate 取值 (0, 1]）
+    void setSampleRate(double rate) { sampler_ = std::make_unique<FragmentationSampler>(rate); }
+    size_t getSampledFileCount() const { return sampler_ ? sampler_->sampledCount() : 0; }
+    size_t getSamplePopulation() const { return sampler_ ? sampler_->populationCount() : 0; }
+    
+    // 模拟磁盘的分配方式（默认随文件系统类型）、空闲段适配策略，
+    // 以及 churn 比例（分配时穿插创建并删除临时文件，产生碎片）
+    void setAllocationPolicy(BlockAllocator::Policy policy) { allocator_.setPolicy(policy); }
+    void setAllocationFit(BlockAllocator::Fit fit) { allocator_.setFit(fit); }
+    void setAllocationChurn(double ratio) { allocator_.setChurn(ratio); }
+    
+    // 把所有文件的 extent 加入物理区间索引（扫描结束后调用，调用者随后执行 index.build()）
+    void collectExtents(ExtentIndex& index) const;
+    
+    // 在线汇总统计（最大文件、碎片最多的文件、大小/时间直方图、扩展名），扫描开始前启用
+    void setAggregation(size_t topK) { aggregator_ = std::make_unique<ScanAggregator>(topK); }
+    // 只做汇总统计：不保存条目、不模拟块分配，内存占用与文件数无关（隐含启用汇总统计）
+    void setSummaryOnly(bool enable);
+    bool isSummaryOnly() const { return summaryOnly_; }
+    // 写出汇总统计报告
+    void writeSummary(const std::string& outputPath, CompressionType compression) const;
+    
+    // 流式输出：扫描过程中每个条目立即以一行 JSON 写出（path 为 "-" 时写到标准输出），
+    // 条目不再保存在内存中，因此不能再调用 generateJSON；扫描开始前设置
+    void setStreamOutput(const std::string& path, CompressionType compression);
+    bool isStreaming() const { return stream_ != nullptr; }
+    // 写出磁盘汇总和碎片统计的尾部记录并关闭流（扫描结束后调用），返回写出的记录数
+    uint64_t finishStream();
+    
+    // 检查点：扫描中每处理完一个目录向 path 追加一个单元，按 intervalSeconds 间隔写出；
+    // resume 为 true 时先回放已有检查点，只扫描尚未完成的目录。scanDirectory 之前设置，
+    // 分配策略、抽样等影响结果的选项须与创建检查点时一致（由 signature 校验）
+    void setCheckpoint(const std::string& path, const std::string& signature, double intervalSeconds, bool resume);
+    // 从检查点回放的单元数（未恢复时为 0）
+    uint64_t getResumedUnitCount() const { return checkpoint_ ? checkpoint_->replayedUnits() : 0; }
+    // 结果写出后删除检查点文件
+    void discardCheckpoint();
+    
+    // 后台模式的限速（元数据操作/extent 探测的令牌桶及 I/O 压力退避），多根扫描时各设备共享同一个实例
+    void setThrottle(std::shared_ptr<ScanThrottle> throttle) { throttle_ = std::move(throttle); }
+    
+    // 按插入顺序遍历扫描得到的所有条目（扫描结束后调用）
+    void forEachEntry(const EntryStore::Visitor& visitor) const { entries_.forEach(visitor); }
 
 private:
     // 扫描目录（递归）
     void scanDirectoryRecursive(const fs::path& path, const std::string& parentId);
     
-    // 分配块给文件
-    std::vector<int> allocateBlocks(size_t fileSize, const std::string& algorithm = "continuous");
+    // 在模拟磁盘上为文件分配块（线程安全）
+    std::vector<int> allocateBlocks(size_t fileSize);
     
     // 计算碎片率
     double calculateFragmentRate() const;
@@ -118,41 +206,113 @@ private:
     
     // 格式化时间
     std::string formatTime(const fs::file_time_type& time);
+    std::string formatTime(std::time_t time);
     
     // 获取文件系统时间（兼容不同C++标准）
     std::string getFileTime(const fs::path& path);
+    std::time_t getFileTimestamp(const fs::path& path);
     
     // 获取文件的物理地址信息（inode、设备ID等）
     void getPhysicalAddress(const fs::path& path, FileEntry& entry);
     
-    // 获取文件的索引地址信息（extent 映射）
-    void getIndexAddress(const fs::path& path, FileEntry& entry);
+    // 条目的元数据（一次 fstat/fstatat 得到）；Linux 上普通文件还带有打开的描述符，
+    // 之后的 FIEMAP 复用它，由调用者关闭
+    struct EntryStat {
+        bool directory = false;
+        bool regular = false;
+        uint64_t size = 0;
+        uint64_t allocatedSize = 0;      // st_blocks × 512
+        std::time_t mtime = 0;
+        unsigned long long inode = 0;
+        unsigned long long deviceId = 0;
+        unsigned long fsBlockSize = 0;
+        int fd = -1;
+        bool sparse = false;
+        // 稀疏文件的数据区间（逻辑偏移, 长度），由 SEEK_DATA/SEEK_HOLE 得到；其他文件为空
+        std::vector<std::pair<uint64_t, uint64_t>> dataRegions;
+    };
+    
+    // 获取文件的索引地址信息（extent 映射）；probe 为 false 时只生成模拟的 extent
+    // st 不为空时（Linux）直接在已打开的描述符上探测，模拟的 extent 跳过稀疏文件的空洞
+    void getIndexAddress(const fs::path& path, FileEntry& entry, bool probe = true,
+                         const EntryStat* st = nullptr);
+    
+    // 通过 FIEMAP/FIBMAP（Windows 上为 FSCTL_GET_RETRIEVAL_POINTERS）探测真实 extent
+    void probeExtents(const fs::path& path, FileEntry& entry, const EntryStat* st = nullptr);
+    
+    // 探测文件 extent（抽样模式下只对抽中的文件做真实探测，并记录到估计结果中）
+    void indexFile(const fs::path& path, FileEntry& entry, const EntryStat* st = nullptr);
     
-    // 根据 extent 信息判断分配算法
-    std::string determineAllocationAlgorithm(const FileEntry& entry);
+    // 获取条目的类型、大小、修改时间和 inode。Linux 上相对所在目录的 fd 解析（openat/fstatat，
+    // 与 fs::is_directory 一样跟随符号链接），普通文件以 O_NOATIME 打开，没有读权限时退回 O_PATH；
+    // 占用小于逻辑大小的文件再用 SEEK_DATA/SEEK_HOLE 列出数据区间。
+    // 其他平台按路径查询。条目已不存在时返回 false
+    bool statEntry(const fs::path& path, int dirFd, unsigned char type, EntryStat& st);
+    
+    // 块模型中为文件分配的字节数：稀疏文件只分配实际占用的部分
+    static size_t allocationSize(const FileEntry& entry);
 
 private:
-    // 多线程扫描目录（并行版本）
-    void scanDirectoryRecursiveParallel(const fs::path& path, const std::string& parentId);
+    struct DirectoryWork;
+    struct Listing;
+    
+    // 多线程扫描目录（并行版本）；frontier 不为空时（从检查点恢复）改为把其中的目录放入工作队列
+    void scanDirectoryRecursiveParallel(const fs::path& path, const std::string& parentId,
+                                        std::vector<DirectoryWork>* frontier = nullptr);
+    
+    // 工作线程函数（index 用于自适应模式下的活跃线程门控）
+    void workerThread(size_t index);
+    
+    // 处理一个目录下的所有条目
+    // depth 为该目录的深度（根目录为 0）
+    void processDirectory(const fs::path& dirPath, const std::string& parentId, int depth);
+    
+    // 目录项：路径、所在目录的 fd（Linux，未打开时为 -1）、readdir 返回的 d_type（未知为 0）和 inode 号
+    struct DirectoryItem {
+        fs::path path;
+        int dirFd;
+        unsigned char type;
+        unsigned long long inode;
+    };
+    
+    // 处理单个目录条目；listing 不为空时子目录先暂存，由 processDirectory 统一入队
+    void processDirectoryEntry(const DirectoryItem& item, const std::string& parentId, int depth,
+                               Listing* listing = nullptr);
+    
+    // 把子目录放入工作队列（listing 不为空时只暂存）
+    void enqueueDirectory(DirectoryWork work, Listing* listing);
     
-    // 工作线程函数
-    void workerThread();
+    // 条目写入流式输出和检查点单元（不保存到条目存储）
+    void emitEntry(const FileEntry& entry, Listing* listing);
     
-    // 处理单个目录条目
-    void processDirectoryEntry(const fs::path& entryPath, const std::string& parentId);
+    // 记录一个被过滤的条目
+    void countFiltered(Listing* listing);
+    
+    // 打开检查点；从已有检查点恢复时回放其中的单元，把尚未处理的目录填入 frontier 并返回 true
+    bool openCheckpoint(std::vector<DirectoryWork>& frontier);
+    
+    // 把检查点中的一个单元恢复到扫描状态（条目、统计、模拟磁盘分配、抽样、汇总）
+    void replayUnit(ScanCheckpoint::Unit& unit);
+    
+    // 是否在内存中保存条目（只输出汇总或流式输出时不保存）
+    bool keepEntries() const { return !summaryOnly_ && !stream_; }
+    
+    // 结束模拟磁盘上的分配（删除 churn 临时文件），返回输出使用的总块数
+    size_t settleDisk();
+    
+    // 把条目以外的结构（分配器位图和线段树、子树汇总、目录队列、镜像的目录表 directoryMapBytes）
+    // 以及输出时编码器的在途批次计入内存上限（调用者持有 blocksMutex_）
+    void chargeAuxiliaryMemory(size_t directoryMapBytes = 0);
     
     // 线程安全的ID生成
     std::string generateFileIdThreadSafe();
     std::string generateDirectoryIdThreadSafe();
-    
-    // 线程安全的块分配
-    std::vector<int> allocateBlocksThreadSafe(size_t fileSize, const std::string& algorithm = "continuous");
 
 private:
     size_t blockSize_;              // 块大小（字节）
-    std::string fileSystemType_;    // 文件系统类型
-    std::vector<FileEntry> files_;  // 文件列表
-    std::map<int, std::string> usedBlocks_;  // 已使用的块 -> 文件ID
+    FileSystemModel model_;         // 文件系统类型相关的行为，构造时（镜像模式下解析镜像时）选定
+    EntryStore entries_;            // 文件列表（支持内存预算和溢出到磁盘）
+    BlockAllocator allocator_;      // 模拟磁盘的空闲空间管理（镜像模式下为真实位图）
     std::vector<int> freeBlocks_;  // 空闲块列表
     
     // 统计信息（使用原子变量保证线程安全）
@@ -163,21 +323,84 @@ private:
     std::atomic<int> nextFileId_;
     std::atomic<int> nextDirectoryId_;
     
-    // 块分配状态（使用原子变量保证线程安全）
-    std::atomic<int> nextBlockIndex_;
-    
     // 多线程同步（mutable 允许在 const 函数中使用）
-    mutable std::mutex filesMutex_;          // 保护 files_ 向量
-    mutable std::mutex blocksMutex_;         // 保护 usedBlocks_ 和块分配
+    mutable std::mutex blocksMutex_;         // 保护 allocator_
     std::mutex idMutex_;             // 保护ID生成（如果原子变量不够用）
     
     // 线程池相关
-    std::queue<std::pair<fs::path, std::string>> workQueue_;  // 待处理的目录队列
+    struct DirectoryWork {
+        fs::path path;
+        std::string parentId;
+        int depth;
+    };
+    // 处理一个目录期间暂存的输出：子目录、检查点单元中的条目编码以及被过滤的条目数
+    struct Listing {
+        std::vector<DirectoryWork> directories;
+        std::string journal;
+        uint32_t journalEntries = 0;
+        uint64_t filtered = 0;
+    };
+    std::queue<DirectoryWork> workQueue_;  // 待处理的目录队列
     std::mutex queueMutex_;          // 保护工作队列
     std::condition_variable queueCondition_;  // 工作队列条件变量
     std::vector<std::thread> workerThreads_;  // 工作线程
+    size_t poolSize_;                // 线程池大小（自适应模式下可能大于活跃线程数）
     std::atomic<bool> stopWorkers_;  // 停止工作线程标志
     size_t numThreads_;              // 线程数量
+    std::atomic<size_t> pendingDirs_;  // 已入队但尚未处理完的目录数量
+    std::condition_variable doneCondition_;  // 所有目录处理完成
+    
+    // 自适应并发
+    bool adaptiveConcurrency_;
+    std::unique_ptr<ConcurrencyTuner> tuner_;
+    std::atomic<size_t> activeWorkers_;  // 允许取工作的线程数（index < activeWorkers_）
+    
+    // 按 inode 顺序处理目录条目
+    bool inodeOrder_;
+    
+    // 输出压缩格式
+    CompressionType outputCompression_;
+    
+    // 遍历过滤规则及被过滤的条目数
+    PathFilter filter_;
+    std::atomic<size_t> filteredCount_;
+    std::atomic<size_t> sparseFileCount_;
+    std::atomic<size_t> holeSize_;
+    
+    // 每个设备的 extent 探测策略（按 st_dev 缓存，不支持的 ioctl 不再逐个文件重试）
+    DeviceCapabilities capabilities_;
+    
+    // 抽样模式（未启用时为空）
+    std::unique_ptr<FragmentationSampler> sampler_;
+    
+    // 在线汇总统计（未启用时为空）及只输出汇总的模式
+    std::unique_ptr<ScanAggregator> aggregator_;
+    bool summaryOnly_;
+    
+    // 流式输出（未启用时为空）
+    std::unique_ptr<EntryStream> stream_;
+    
+    // 限速（未启用时为空）
+    std::shared_ptr<ScanThrottle> throttle_;
+    
+    // 检查点（未启用时为空）及 scanDirectory 打开它所需的参数
+    std::unique_ptr<ScanCheckpoint> checkpoint_;
+    std::string checkpointPath_;
+    std::string checkpointSignature_;
+    double checkpointInterval_;
+    bool resumeCheckpoint_;
+    
+    // 已扫描的根目录（绝对路径）及多根扫描中所属的设备和介质类型
+    std::vector<std::string> roots_;
+    std::string device_;
+    std::string media_;
+    std::string idPrefix_;
+    
+    // 目录子树汇总（扫描时累加直接子项，生成JSON前自底向上汇总）
+    SubtreeRollup rollup_;
+    
+    // 镜像模式下文件系统的真实总块数（0 表示使用模拟的磁盘大小）
+    uint64_t diskTotalBlocks_;
     
     // 进度回调
     ProgressCallback progressCallback_;
@@ -0,0 +1,292 @@
+#include "FragmentationSampler.h"
+#include "SnapshotWriter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const size_t MIN_SAMPLES_PER_STRATUM = 2;
+const double Z_95 = 1.959964;   // 95% 置信水平的正态分位数
+
+// 大小级别上界：4K、64K、1M、16M、256M、4G，其余归入最后一级
+const unsigned long long SIZE_CLASS_LIMITS[] = {
+    4ULL << 10, 64ULL << 10, 1ULL << 20, 16ULL << 20, 256ULL << 20, 4ULL << 30
+};
+
+// 分层估计单个变量的总体均值：ȳ = Σ N_h·ȳ_h / N，Var(ȳ) = Σ N_h²·(1 - n_h/N_h)·s_h²/n_h / N²
+template <typename Moments>
+FragmentationSampler::Interval estimateMean(
+    const std::unordered_map<std::string, FragmentationSampler::Stratum>& strata,
+    size_t population, Moments moments)
+{
+    FragmentationSampler::Interval result;
+    if (population == 0) {
+        return result;
+    }
+    // 先累加各层的总量估计 N_h·ȳ_h 再整体除以 N，全量抽样时结果与精确统计一致
+    double total = 0;
+    double totalVariance = 0;
+    for (const auto& item : strata) {
+        const FragmentationSampler::Stratum& stratum = item.second;
+        if (stratum.sampled == 0) {
+            continue;
+        }
+        double sum = 0;
+        double squareSum = 0;
+        moments(stratum, sum, squareSum);
+        double n = static_cast<double>(stratum.sampled);
+        double size = static_cast<double>(stratum.population);
+        double stratumMean = sum / n;
+        total += stratum.sampled == stratum.population ? sum : size * stratumMean;
+        if (stratum.sampled >= 2 && stratum.sampled < stratum.population) {
+            double s2 = std::max(0.0, (squareSum - sum * stratumMean) / (n - 1));
+            double fpc = 1.0 - n / size;
+            totalVariance += size * size * fpc * s2 / n;
+        }
+    }
+    double mean = total / static_cast<double>(population);
+    double margin = Z_95 * std::sqrt(totalVariance) / static_cast<double>(population);
+    result.estimate = mean;
+    result.lower = std::max(0.0, mean - margin);
+    result.upper = mean + margin;
+    return result;
+}
+
+FragmentationSampler::Interval estimateProportion(
+    const std::unordered_map<std::string, FragmentationSampler::Stratum>& strata,
+    size_t population, size_t FragmentationSampler::Stratum::*field)
+{
+    FragmentationSampler::Interval result = estimateMean(strata, population,
+        [field](const FragmentationSampler::Stratum& stratum, double& sum, double& squareSum) {
+            sum = static_cast<double>(stratum.*field);
+            squareSum = sum;  // 取值为 0/1 时 x² = x
+        });
+    result.estimate = std::min(1.0, result.estimate);
+    result.upper = std::min(1.0, result.upper);
+    return result;
+}
+
+void appendInterval(std::string& out, int depth, const char* key,
+                    const FragmentationSampler::Interval& interval, double scale = 1.0) {
+    SnapshotWriter::appendKey(out, depth, key);
+    out += "{\n";
+    SnapshotWriter::appendKey(out, depth + 1, "estimate");
+    SnapshotWriter::appendDouble(out, interval.estimate * scale);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, depth + 1, "lower");
+    SnapshotWriter::appendDouble(out, interval.lower * scale);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, depth + 1, "upper");
+    SnapshotWriter::appendDouble(out, interval.upper * scale);
+    out += '\n';
+    SnapshotWriter::appendIndent(out, depth);
+    out += '}';
+}
+
+} // namespace
+
+FragmentationSampler::FragmentationSampler(double rate)
+    : rate_(std::min(1.0, std::max(0.0, rate)))
+{
+}
+
+void FragmentationSampler::setRoot(const std::string& rootPath) {
+    rootPrefix_ = rootPath;
+    while (rootPrefix_.size() > 1 && (rootPrefix_.back() == '/' || rootPrefix_.back() == '\\')) {
+        rootPrefix_.pop_back();
+    }
+}
+
+int FragmentationSampler::sizeClass(size_t size) {
+    int index = 0;
+    for (unsigned long long limit : SIZE_CLASS_LIMITS) {
+        if (size < limit) {
+            return index;
+        }
+        index++;
+    }
+    return index;
+}
+
+std::string FragmentationSampler::stratumKey(const std::string& path, size_t size) const {
+    // 一级目录：相对扫描根目录路径的第一个组成部分（根目录下的文件归入空字符串）
+    std::string group;
+    if (path.compare(0, rootPrefix_.size(), rootPrefix_) == 0) {
+        size_t start = path.find_first_not_of("/\\", rootPrefix_.size());
+        if (start != std::string::npos) {
+            size_t end = path.find_first_of("/\\", start);
+            if (end != std::string::npos) {
+                group = path.substr(start, end - start);
+            }
+        }
+    }
+    group += '\0';
+    group += static_cast<char>('0' + sizeClass(size));
+    return group;
+}
+
+double FragmentationSampler::hashUnit(const std::string& path) const {
+    // FNV-1a + splitmix64 终结混合，映射到 [0, 1)
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    hash += 0x9E3779B97F4A7C15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    return static_cast<double>(hash >> 11) * (1.0 / 9007199254740992.0);
+}
+
+FragmentationSampler::Stratum* FragmentationSampler::admit(const FileEntry& entry) {
+    std::string key = stratumKey(entry.physicalPath, entry.size);
+    double hash = hashUnit(entry.physicalPath);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stratum& stratum = strata_[key];
+    stratum.population++;
+    if (hash < rate_) {
+        stratum.selected++;
+        return &stratum;
+    }
+
+    // 最终补足的是本层哈希不低于抽样比例的文件中最小的 (最少样本数 - selected) 个；
+    // selected 只增不减，超出这个数量的候选以后也不会用到
+    size_t needed = stratum.selected < MIN_SAMPLES_PER_STRATUM ? MIN_SAMPLES_PER_STRATUM - stratum.selected : 0;
+    std::vector<Candidate>& candidates = stratum.candidates;
+    if (candidates.size() > needed) {
+        candidates.resize(needed);
+    }
+    if (needed == 0 || (candidates.size() == needed && hash >= candidates.back().hash)) {
+        return nullptr;
+    }
+    Candidate candidate;
+    candidate.hash = hash;
+    candidates.insert(std::upper_bound(candidates.begin(), candidates.end(), hash,
+                                       [](double value, const Candidate& c) { return value < c.hash; }),
+                      candidate);
+    if (candidates.size() > needed) {
+        candidates.pop_back();
+    }
+    return &stratum;
+}
+
+void FragmentationSampler::accumulate(Stratum& stratum, size_t extents, AllocationAlgorithm algorithm) {
+    double count = static_cast<double>(extents);
+    stratum.sampled++;
+    stratum.extentSum += count;
+    stratum.extentSquareSum += count * count;
+    if (extents > 1) {
+        stratum.fragmented++;
+    }
+    if (algorithm == AllocationAlgorithm::Indexed) {
+        stratum.indexed++;
+    } else if (algorithm == AllocationAlgorithm::Linked) {
+        stratum.linked++;
+    } else {
+        stratum.continuous++;
+    }
+}
+
+void FragmentationSampler::record(Stratum* stratum, const FileEntry& entry) {
+    double hash = hashUnit(entry.physicalPath);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (hash < rate_) {
+        accumulate(*stratum, entry.extents.size(), entry.allocationAlgorithm);
+        return;
+    }
+    // 候选的结果先保存，最终是否计入由 finalStrata 决定；探测期间已被挤出的候选找不到，直接丢弃
+    for (Candidate& candidate : stratum->candidates) {
+        if (candidate.hash == hash && !candidate.recorded) {
+            candidate.recorded = true;
+            candidate.extents = entry.extents.size();
+            candidate.algorithm = entry.allocationAlgorithm;
+            break;
+        }
+    }
+}
+
+std::unordered_map<std::string, FragmentationSampler::Stratum> FragmentationSampler::finalStrata() const {
+    std::unordered_map<std::string, Stratum> strata = strata_;
+    for (auto& item : strata) {
+        Stratum& stratum = item.second;
+        size_t needed = stratum.selected < MIN_SAMPLES_PER_STRATUM ? MIN_SAMPLES_PER_STRATUM - stratum.selected : 0;
+        for (size_t i = 0; i < needed && i < stratum.candidates.size(); i++) {
+            if (stratum.candidates[i].recorded) {
+                accumulate(stratum, stratum.candidates[i].extents, stratum.candidates[i].algorithm);
+            }
+        }
+        stratum.candidates.clear();
+    }
+    return strata;
+}
+
+size_t FragmentationSampler::populationCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto& item : strata_) {
+        total += item.second.population;
+    }
+    return total;
+}
+
+size_t FragmentationSampler::sampledCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto& item : finalStrata()) {
+        total += item.second.sampled;
+    }
+    return total;
+}
+
+void FragmentationSampler::appendJSON(std::string& out, int depth) const {
+    size_t population = populationCount();
+    size_t sampled = sampledCount();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::unordered_map<std::string, Stratum> strata = finalStrata();
+    Interval extentsPerFile = estimateMean(strata, population,
+        [](const Stratum& stratum, double& sum, double& squareSum) {
+            sum = stratum.extentSum;
+            squareSum = stratum.extentSquareSum;
+        });
+
+    out += "{\n";
+    SnapshotWriter::appendKey(out, depth + 1, "allocationMix");
+    out += "{\n";
+    appendInterval(out, depth + 2, "continuous", estimateProportion(strata, population, &Stratum::continuous));
+    out += ",\n";
+    appendInterval(out, depth + 2, "indexed", estimateProportion(strata, population, &Stratum::indexed));
+    out += ",\n";
+    appendInterval(out, depth + 2, "linked", estimateProportion(strata, population, &Stratum::linked));
+    out += '\n';
+    SnapshotWriter::appendIndent(out, depth + 1);
+    out += "},\n";
+    SnapshotWriter::appendKey(out, depth + 1, "confidenceLevel");
+    SnapshotWriter::appendDouble(out, 0.95);
+    out += ",\n";
+    appendInterval(out, depth + 1, "extentsPerFile", extentsPerFile);
+    out += ",\n";
+    appendInterval(out, depth + 1, "fragmentedFileRatio",
+                   estimateProportion(strata, population, &Stratum::fragmented));
+    out += ",\n";
+    SnapshotWriter::appendKey(out, depth + 1, "population");
+    SnapshotWriter::appendUnsigned(out, population);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, depth + 1, "sampleRate");
+    SnapshotWriter::appendDouble(out, rate_);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, depth + 1, "sampledFiles");
+    SnapshotWriter::appendUnsigned(out, sampled);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, depth + 1, "strata");
+    SnapshotWriter::appendUnsigned(out, strata.size());
+    out += ",\n";
+    // 总 extent 数 = N × 每文件平均 extent 数
+    appendInterval(out, depth + 1, "totalExtents", extentsPerFile, static_cast<double>(population));
+    out += '\n';
+    SnapshotWriter::appendIndent(out, depth);
+    out += '}';
+}
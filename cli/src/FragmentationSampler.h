@@ -0,0 +1,78 @@
+#ifndef FRAGMENTATION_SAMPLER_H
+#define FRAGMENTATION_SAMPLER_H
+
+#include "FileEntry.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 分层抽样：所有文件都枚举元数据，但只对抽中的文件探测真实 extent（FIEMAP）。
+// 分层维度为 大小级别 × 扫描根目录下的一级目录。路径哈希小于抽样比例的文件抽中；
+// 为了估计方差每层至少需要 2 个样本，不足时由该层路径哈希最小的 2 个文件补足。
+// 样本只由路径哈希的排序决定，与遍历顺序无关，相同输入的多次运行抽样结果一致。
+class FragmentationSampler {
+public:
+    // 哈希不低于抽样比例、但暂时属于本层哈希最小的几个文件之一的候选样本。
+    // 遍历到哈希更小的文件时被挤出的候选不计入估计（探测过的 extent 仍然保留在条目中）
+    struct Candidate {
+        double hash = 0;
+        bool recorded = false;
+        size_t extents = 0;
+        AllocationAlgorithm algorithm = AllocationAlgorithm::None;
+    };
+
+    struct Stratum {
+        size_t population = 0;      // 该层文件总数 N_h
+        size_t selected = 0;        // 哈希低于抽样比例而抽中的文件数（含尚未记录结果的）
+        size_t sampled = 0;         // 已记录结果的样本数 n_h
+        double extentSum = 0;       // Σ extent 数
+        double extentSquareSum = 0; // Σ extent 数²
+        size_t fragmented = 0;      // extent 数 > 1 的文件数
+        size_t continuous = 0;
+        size_t indexed = 0;
+        size_t linked = 0;
+        std::vector<Candidate> candidates;   // 按哈希递增，至多为每层的最少样本数
+    };
+
+    // 区间估计：estimate ± z·标准误
+    struct Interval {
+        double estimate = 0;
+        double lower = 0;
+        double upper = 0;
+    };
+
+    explicit FragmentationSampler(double rate);
+
+    // 设置扫描根目录（用于确定文件所属的一级目录）
+    void setRoot(const std::string& rootPath);
+
+    // 统计文件（按 physicalPath 和 size）并决定是否探测 extent；返回 nullptr 表示未抽中（线程安全）
+    Stratum* admit(const FileEntry& entry);
+
+    // 记录抽中文件的探测结果（线程安全）
+    void record(Stratum* stratum, const FileEntry& entry);
+
+    double rate() const { return rate_; }
+    size_t populationCount() const;
+    size_t sampledCount() const;
+
+    // 以 nlohmann::json::dump(2) 的格式写出估计结果对象（depth 为对象所在层级）
+    void appendJSON(std::string& out, int depth) const;
+
+private:
+    static int sizeClass(size_t size);
+    static void accumulate(Stratum& stratum, size_t extents, AllocationAlgorithm algorithm);
+    // 把仍在本层哈希最小之列、用于补足最少样本数的候选并入样本，返回最终参与估计的各层
+    std::unordered_map<std::string, Stratum> finalStrata() const;
+    std::string stratumKey(const std::string& path, size_t size) const;
+    double hashUnit(const std::string& path) const;
+
+    double rate_;
+    std::string rootPrefix_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Stratum> strata_;   // 节点地址在插入后保持不变
+};
+
+#endif // FRAGMENTATION_SAMPLER_H
@@ -0,0 +1,92 @@
+#include "ImageReader.h"
+#include "Ext4ImageReader.h"
+#include "Fat32ImageReader.h"
+#include "BitmapKernels.h"
+#include <cstring>
+#include <stdexcept>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ImageReader::ImageReader(const std::string& path)
+    : path_(path)
+    , data_(nullptr)
+    , size_(0)
+    , blockSize_(0)
+    , blockCount_(0)
+    , usedBlocks_(0)
+{
+#ifdef _WIN32
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("无法打开镜像文件: " + path);
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("无法打开镜像文件: " + path + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        throw std::runtime_error("无法获取镜像文件大小: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("映射镜像文件失败: " + path + ": " + strerror(errno));
+    }
+    data_ = static_cast<const uint8_t*>(mapped);
+#endif
+}
+
+ImageReader::~ImageReader() {
+#ifndef _WIN32
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+}
+
+uint64_t ImageReader::countBits(const std::vector<uint64_t>& bits) {
+    return BitmapKernels::popcount(bits.data(), bits.size(), 0, static_cast<uint64_t>(bits.size()) * 64);
+}
+
+std::unique_ptr<ImageReader> ImageReader::open(const std::string& path) {
+    // 只读取识别所需的头部，再交给具体的解析器完整映射
+    uint8_t header[2048] = {};
+    size_t length = 0;
+#ifdef _WIN32
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("无法打开镜像文件: " + path);
+    }
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    length = static_cast<size_t>(in.gcount());
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("无法打开镜像文件: " + path + ": " + strerror(errno));
+    }
+    ssize_t count = pread(fd, header, sizeof(header), 0);
+    close(fd);
+    length = count > 0 ? static_cast<size_t>(count) : 0;
+#endif
+
+    if (length >= 1024 + 0x3A && le16(header + 1024 + 0x38) == 0xEF53) {
+        return std::unique_ptr<ImageReader>(new Ext4ImageReader(path));
+    }
+    if (length >= 512 && header[510] == 0x55 && header[511] == 0xAA && Fat32ImageReader::probe(header)) {
+        return std::unique_ptr<ImageReader>(new Fat32ImageReader(path));
+    }
+    throw std::runtime_error("无法识别镜像中的文件系统（支持 ext2/3/4 和 FAT32）: " + path);
+}
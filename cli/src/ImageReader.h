@@ -0,0 +1,94 @@
+#ifndef IMAGE_READER_H
+#define IMAGE_READER_H
+
+#include "FileEntry.h"
+#include "FileSystemModel.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 离线文件系统镜像解析器的公共基类：负责 mmap 镜像文件，并提供统一的遍历接口。
+// open() 根据镜像内容识别文件系统类型并创建对应的解析器（ext2/3/4、FAT32）。
+class ImageReader {
+public:
+    // 遍历时的一个条目（目录或普通文件）
+    struct Node {
+        uint64_t inode = 0;         // ext4 为 inode 号；FAT32 为目录项位置（字节偏移 / 32）
+        uint64_t parentInode = 0;   // 根目录为 0
+        std::string name;
+        std::string path;           // 镜像内的绝对路径
+        bool directory = false;
+        uint64_t size = 0;
+        int64_t mtime = 0;          // 秒
+        int depth = 0;              // 根目录为 0
+        std::vector<ExtentInfo> extents;   // 字节为单位，与 FIEMAP 输出一致
+        std::vector<uint64_t> blocks;      // 按文件内顺序排列的块号（FAT32 为簇号链）
+        AllocationAlgorithm allocationAlgorithm = AllocationAlgorithm::None;   // 由文件系统结构决定时填写
+    };
+
+    // 返回 false 表示不进入该目录
+    using Visitor = std::function<bool(const Node& node)>;
+
+    // 识别镜像中的文件系统并创建解析器，无法识别时抛出异常
+    static std::unique_ptr<ImageReader> open(const std::string& path);
+
+    virtual ~ImageReader();
+
+    ImageReader(const ImageReader&) = delete;
+    ImageReader& operator=(const ImageReader&) = delete;
+
+    // 解析分配信息（threads 个线程并行）
+    virtual void load(size_t threads) = 0;
+
+    // 从根目录开始层序遍历，父目录总在子项之前访问
+    virtual void walk(const Visitor& visitor) const = 0;
+
+    // 快照中的 fileSystemType
+    virtual FileSystemType fileSystemType() const = 0;
+
+    uint32_t blockSize() const { return blockSize_; }
+    uint64_t blockCount() const { return blockCount_; }
+    uint64_t usedBlockCount() const { return usedBlocks_; }
+    std::string volumeName() const { return volumeName_; }
+
+    // 真实的块分配位图（第 n 位对应块号 n），load() 之后有效；调用后内部位图被移走
+    std::vector<uint64_t> takeBlockBitmap() { return std::move(blockBitmap_); }
+
+protected:
+    explicit ImageReader(const std::string& path);
+
+    static uint16_t le16(const uint8_t* p) {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    static uint32_t le32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    static void setBit(std::vector<uint64_t>& bits, uint64_t index) {
+        if (index / 64 < bits.size()) {
+            bits[index / 64] |= uint64_t(1) << (index % 64);
+        }
+    }
+
+    // 统计位图中已置位的数量
+    static uint64_t countBits(const std::vector<uint64_t>& bits);
+
+    std::string path_;
+    const uint8_t* data_;
+    size_t size_;
+#ifdef _WIN32
+    std::vector<uint8_t> buffer_;
+#endif
+
+    uint32_t blockSize_;
+    uint64_t blockCount_;
+    std::string volumeName_;
+    std::vector<uint64_t> blockBitmap_;
+    uint64_t usedBlocks_;
+};
+
+#endif // IMAGE_READER_H
@@ -0,0 +1,274 @@
+#include "MultiRootScanner.h"
+#include "ConcurrencyTuner.h"
+#include "SnapshotWriter.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#ifdef _WIN32
+#include <sys/stat.h>
+#include <sys/types.h>
+#else
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+// 设备号："主:次"，与 /sys/dev/block 下的目录名一致
+std::string deviceOf(const std::string& path) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) != 0) {
+        throw std::runtime_error("无法获取路径信息: " + path);
+    }
+    return std::to_string(st.st_dev);
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("无法获取路径信息: " + path);
+    }
+    return std::to_string(major(st.st_dev)) + ":" + std::to_string(minor(st.st_dev));
+#endif
+}
+
+// inner 是否等于 outer 或位于其内部
+bool contains(const std::string& outer, const std::string& inner) {
+    if (inner.compare(0, outer.size(), outer) != 0) {
+        return false;
+    }
+    return inner.size() == outer.size() || outer.back() == fs::path::preferred_separator ||
+           inner[outer.size()] == fs::path::preferred_separator;
+}
+
+std::string readLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+} // namespace
+
+MultiRootScanner::MultiRootScanner(size_t blockSize, FileSystemType fileSystemType, Configure configure)
+    : blockSize_(blockSize)
+    , fileSystemType_(fileSystemType)
+    , configure_(std::move(configure))
+    , threadCount_(0) {
+}
+
+bool MultiRootScanner::addRoot(const std::string& path) {
+    if (!fs::is_directory(path)) {
+        throw std::runtime_error("多根扫描的路径必须是目录: " + path);
+    }
+    std::string root = fs::weakly_canonical(fs::absolute(path)).string();
+
+    // 扫描会进入子目录中的挂载点，嵌套的根目录会被重复扫描：保留外层的根目录
+    for (auto& device : devices_) {
+        for (const auto& existing : device.roots) {
+            if (contains(existing, root)) {
+                std::cerr << "警告: 忽略 " << path << "，已包含在 " << existing << " 中\n";
+                return false;
+            }
+        }
+    }
+    for (auto& device : devices_) {
+        auto& roots = device.roots;
+        roots.erase(std::remove_if(roots.begin(), roots.end(),
+                                   [&root, &path](const std::string& existing) {
+                                       if (!contains(root, existing)) {
+                                           return false;
+                                       }
+                                       std::cerr << "警告: 忽略 " << existing << "，已包含在 " << path << " 中\n";
+                                       return true;
+                                   }),
+                    roots.end());
+    }
+    devices_.erase(std::remove_if(devices_.begin(), devices_.end(),
+                                  [](const Device& device) { return device.roots.empty(); }),
+                   devices_.end());
+
+    std::string id = deviceOf(root);
+    for (auto& device : devices_) {
+        if (device.id == id) {
+            device.roots.push_back(root);
+            return true;
+        }
+    }
+    Device device;
+    device.id = id;
+    device.media = detectMedia(id);
+    device.threads = threadCount_ > 0 ? threadCount_ : threadsForMedia(device.media);
+    device.roots.push_back(root);
+    devices_.push_back(std::move(device));
+    return true;
+}
+
+std::vector<std::string> MultiRootScanner::readManifest(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("无法打开根目录清单: " + path);
+    }
+    std::vector<std::string> roots;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+        size_t end = line.find_last_not_of(" \t\r");
+        roots.push_back(line.substr(begin, end - begin + 1));
+    }
+    return roots;
+}
+
+std::string MultiRootScanner::detectMedia(const std::string& deviceId) {
+#ifdef _WIN32
+    (void)deviceId;
+    return "unknown";
+#else
+    // 主设备号 0 是没有块设备的文件系统（tmpfs、overlay、btrfs 子卷等）
+    if (deviceId.compare(0, 2, "0:") == 0) {
+        return "unknown";
+    }
+    // 分区没有自己的 queue 目录，使用所在磁盘的
+    std::string base = "/sys/dev/block/" + deviceId;
+    std::string rotational = readLine(base + "/queue/rotational");
+    if (rotational.empty()) {
+        rotational = readLine(base + "/../queue/rotational");
+    }
+    if (rotational == "1") {
+        return "hdd";
+    }
+    if (rotational == "0") {
+        std::error_code ec;
+        std::string name = fs::canonical(base, ec).filename().string();
+        return name.compare(0, 4, "nvme") == 0 ? "nvme" : "ssd";
+    }
+    return "unknown";
+#endif
+}
+
+size_t MultiRootScanner::threadsForMedia(const std::string& media) {
+    size_t cpus = ConcurrencyTuner::effectiveCpuCount();
+    if (media == "hdd") {
+        // 机械盘的瓶颈是寻道，更多并发请求只会让磁头来回移动
+        return 2;
+    }
+    if (media == "nvme") {
+        // NVMe 有多个硬件队列，元数据请求多为等待 I/O，适当超过 CPU 数
+        return std::min<size_t>(cpus * 2, 64);
+    }
+    return cpus;
+}
+
+void MultiRootScanner::scan(const FileSystemScanner::ProgressCallback& progress) {
+    for (size_t i = 0; i < devices_.size(); i++) {
+        Device& device = devices_[i];
+        device.scanner = std::make_unique<FileSystemScanner>(blockSize_, fileSystemType_);
+        configure_(*device.scanner);
+        device.scanner->setThreadCount(device.threads);
+        if (device.media == "hdd") {
+            device.scanner->setInodeOrder(true);
+        }
+        device.scanner->setDevice(device.id, device.media);
+        // 各设备的扫描器独立编号，ID 加上磁盘节序号前缀（与 "disk-<序号>" 对应）以免重复
+        device.scanner->setIdPrefix("d" + std::to_string(i + 1) + ":");
+        if (progress) {
+            device.scanner->setProgressCallback([this, &progress](size_t, size_t, size_t) {
+                progress(getFileCount(), getDirectoryCount(), getTotalSize());
+            });
+        }
+    }
+
+    // 每个设备一个驱动线程；任一设备出错时等其他设备结束后抛出第一个错误
+    std::vector<std::exception_ptr> errors(devices_.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < devices_.size(); i++) {
+        threads.emplace_back([this, i, &errors] {
+            try {
+                for (const auto& root : devices_[i].roots) {
+                    devices_[i].scanner->scanDirectory(root);
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void MultiRootScanner::generateJSON(const std::string& outputPath, CompressionType compression) {
+    SnapshotWriter writer(outputPath, compression);
+    std::string& out = writer.buffer();
+
+    out += "{\n";
+    SnapshotWriter::appendKey(out, 1, "disks");
+    out += devices_.empty() ? "[" : "[\n";
+    for (size_t i = 0; i < devices_.size(); i++) {
+        if (i > 0) {
+            out += ",\n";
+        }
+        SnapshotWriter::appendIndent(out, 2);
+        devices_[i].scanner->appendDiskJSON(writer, 2, "disk-" + std::to_string(i + 1));
+    }
+    if (!devices_.empty()) {
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 1);
+    }
+    out += "],\n";
+    SnapshotWriter::appendKey(out, 1, "fileSystemType");
+    SnapshotWriter::appendString(out, fileSystemTypeName(fileSystemType_));
+    out += "\n}";
+
+    writer.close();
+}
+
+size_t MultiRootScanner::getFileCount() const {
+    size_t total = 0;
+    for (const auto& device : devices_) {
+        total += device.scanner ? device.scanner->getFileCount() : 0;
+    }
+    return total;
+}
+
+size_t MultiRootScanner::getDirectoryCount() const {
+    size_t total = 0;
+    for (const auto& device : devices_) {
+        total += device.scanner ? device.scanner->getDirectoryCount() : 0;
+    }
+    return total;
+}
+
+size_t MultiRootScanner::getTotalSize() const {
+    size_t total = 0;
+    for (const auto& device : devices_) {
+        total += device.scanner ? device.scanner->getTotalSize() : 0;
+    }
+    return total;
+}
+
+size_t MultiRootScanner::getTotalBlocks() const {
+    size_t total = 0;
+    for (const auto& device : devices_) {
+        total += device.scanner ? device.scanner->getTotalBlocks() : 0;
+    }
+    return total;
+}
+
+size_t MultiRootScanner::getFilteredCount() const {
+    size_t total = 0;
+    for (const auto& device : devices_) {
+        total += device.scanner ? device.scanner->getFilteredCount() : 0;
+    }
+    return total;
+}
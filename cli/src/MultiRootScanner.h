@@ -0,0 +1,65 @@
+#ifndef MULTI_ROOT_SCANNER_H
+#define MULTI_ROOT_SCANNER_H
+
+#include "FileSystemScanner.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 多根扫描：把多个根目录按所在设备（st_dev）分组，每个设备一个独立的 FileSystemScanner
+// 及其工作线程池，线程数按介质类型决定（机械盘少量线程并按 inode 顺序访问，SSD/NVMe 更多线程）。
+// 不同设备的扫描完全并行，互不争用同一个磁盘队列；同一设备上的多个根目录在该设备的线程池中依次扫描。
+// 结果写入一个快照，disks 数组中每个设备一个磁盘节。
+class MultiRootScanner {
+public:
+    // 对每个新建的扫描器应用命令行中的公共设置（过滤规则、分配策略、压缩等）
+    using Configure = std::function<void(FileSystemScanner&)>;
+
+    struct Device {
+        std::string id;                      // 设备号 "主:次"（Windows 上为驱动器号）
+        std::string media;                   // hdd / ssd / nvme / unknown
+        size_t threads = 0;
+        std::vector<std::string> roots;
+        std::unique_ptr<FileSystemScanner> scanner;
+    };
+
+    MultiRootScanner(size_t blockSize, FileSystemType fileSystemType, Configure configure);
+
+    // 添加一个根目录；与已添加的根目录重复或位于其内部时忽略并返回 false
+    bool addRoot(const std::string& path);
+
+    // 读取清单文件：每行一个路径，忽略空行和以 # 开头的注释行
+    static std::vector<std::string> readManifest(const std::string& path);
+
+    // 固定每个设备的线程数（0 表示按介质类型决定）；在 addRoot 之前调用
+    void setThreadCount(size_t count) { threadCount_ = count; }
+
+    // 每个设备一个线程驱动其扫描器，全部完成后返回；progress 收到所有设备的合计
+    void scan(const FileSystemScanner::ProgressCallback& progress);
+
+    // 生成包含所有设备磁盘节的快照
+    void generateJSON(const std::string& outputPath, CompressionType compression);
+
+    const std::vector<Device>& devices() const { return devices_; }
+    size_t getFileCount() const;
+    size_t getDirectoryCount() const;
+    size_t getTotalSize() const;
+    size_t getTotalBlocks() const;
+    size_t getFilteredCount() const;
+
+    // 识别设备的介质类型（读取 /sys/dev/block/<主:次>/queue/rotational）
+    static std::string detectMedia(const std::string& deviceId);
+
+    // 介质类型对应的默认线程数
+    static size_t threadsForMedia(const std::string& media);
+
+private:
+    size_t blockSize_;
+    FileSystemType fileSystemType_;
+    Configure configure_;
+    size_t threadCount_;
+    std::vector<Device> devices_;
+};
+
+#endif // MULTI_ROOT_SCANNER_H
@@ -0,0 +1,255 @@
+#include "OutputCompressor.h"
+#include <stdexcept>
+#include <vector>
+#ifdef FCON_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef FCON_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+const size_t OUTPUT_CHUNK = 1 << 18;  // 压缩输出缓冲区 256KB
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() &&
+           value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+// 压缩器接口：compress() 处理一块输入，finish() 输出流尾
+class OutputCompressor::Codec {
+public:
+    virtual ~Codec() = default;
+    virtual void compress(const std::string& input, const Sink& sink) = 0;
+    virtual void finish(const Sink& sink) = 0;
+};
+
+namespace {
+
+#ifdef FCON_HAVE_ZLIB
+class GzipCodec : public OutputCompressor::Codec {
+public:
+    explicit GzipCodec(int level) : out_(OUTPUT_CHUNK) {
+        stream_ = {};
+        // windowBits 15 + 16：输出 gzip 头和尾，而不是裸 zlib 流
+        if (deflateInit2(&stream_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("初始化 gzip 压缩失败");
+        }
+    }
+    ~GzipCodec() override { deflateEnd(&stream_); }
+
+    void compress(const std::string& input, const OutputCompressor::Sink& sink) override {
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream_.avail_in = static_cast<uInt>(input.size());
+        run(Z_NO_FLUSH, sink);
+    }
+
+    void finish(const OutputCompressor::Sink& sink) override {
+        stream_.next_in = nullptr;
+        stream_.avail_in = 0;
+        run(Z_FINISH, sink);
+    }
+
+private:
+    void run(int flush, const OutputCompressor::Sink& sink) {
+        int ret;
+        do {
+            stream_.next_out = out_.data();
+            stream_.avail_out = static_cast<uInt>(out_.size());
+            ret = deflate(&stream_, flush);
+            if (ret == Z_STREAM_ERROR) {
+                throw std::runtime_error("gzip 压缩失败");
+            }
+            size_t produced = out_.size() - stream_.avail_out;
+            if (produced > 0) {
+                sink(reinterpret_cast<const char*>(out_.data()), produced);
+            }
+        } while (stream_.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+    }
+
+    z_stream stream_;
+    std::vector<Bytef> out_;
+};
+#endif
+
+#ifdef FCON_HAVE_ZSTD
+class ZstdCodec : public OutputCompressor::Codec {
+public:
+    explicit ZstdCodec(int level) : context_(ZSTD_createCCtx()), out_(ZSTD_CStreamOutSize()) {
+        if (!context_) {
+            throw std::runtime_error("初始化 zstd 压缩失败");
+        }
+        ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, level);
+        ZSTD_CCtx_setParameter(context_, ZSTD_c_checksumFlag, 1);
+    }
+    ~ZstdCodec() override { ZSTD_freeCCtx(context_); }
+
+    void compress(const std::string& input, const OutputCompressor::Sink& sink) override {
+        ZSTD_inBuffer in = {input.data(), input.size(), 0};
+        while (in.pos < in.size) {
+            run(in, ZSTD_e_continue, sink);
+        }
+    }
+
+    void finish(const OutputCompressor::Sink& sink) override {
+        ZSTD_inBuffer in = {nullptr, 0, 0};
+        while (run(in, ZSTD_e_end, sink) != 0) {
+        }
+    }
+
+private:
+    size_t run(ZSTD_inBuffer& in, ZSTD_EndDirective mode, const OutputCompressor::Sink& sink) {
+        ZSTD_outBuffer out = {out_.data(), out_.size(), 0};
+        size_t remaining = ZSTD_compressStream2(context_, &out, &in, mode);
+        if (ZSTD_isError(remaining)) {
+            throw std::runtime_error(std::string("zstd 压缩失败: ") + ZSTD_getErrorName(remaining));
+        }
+        if (out.pos > 0) {
+            sink(out_.data(), out.pos);
+        }
+        return remaining;
+    }
+
+    ZSTD_CCtx* context_;
+    std::vector<char> out_;
+};
+#endif
+
+} // namespace
+
+OutputCompressor::OutputCompressor(CompressionType type, int level, Sink sink)
+    : sink_(std::move(sink))
+    , maxQueued_(8)
+    , finishing_(false)
+{
+    switch (type) {
+#ifdef FCON_HAVE_ZLIB
+        case CompressionType::Gzip:
+            codec_.reset(new GzipCodec(level > 0 ? level : 6));
+            break;
+#endif
+#ifdef FCON_HAVE_ZSTD
+        case CompressionType::Zstd:
+            codec_.reset(new ZstdCodec(level > 0 ? level : 3));
+            break;
+#endif
+        default:
+            throw std::runtime_error(std::string("不支持的压缩格式: ") + name(type));
+    }
+    thread_ = std::thread(&OutputCompressor::compressLoop, this);
+}
+
+OutputCompressor::~OutputCompressor() {
+    try {
+        finish();
+    } catch (const std::exception&) {
+        // 析构中忽略错误，正常路径应显式调用 finish()
+    }
+}
+
+void OutputCompressor::push(std::string data) {
+    if (data.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    spaceCondition_.wait(lock, [this] { return queue_.size() < maxQueued_ || error_; });
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    queue_.push(std::move(data));
+    dataCondition_.notify_one();
+}
+
+void OutputCompressor::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+    }
+    dataCondition_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void OutputCompressor::compressLoop() {
+    try {
+        while (true) {
+            std::string data;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                dataCondition_.wait(lock, [this] { return !queue_.empty() || finishing_; });
+                if (queue_.empty()) {
+                    break;
+                }
+                data = std::move(queue_.front());
+                queue_.pop();
+            }
+            spaceCondition_.notify_one();
+            codec_->compress(data, sink_);
+        }
+        codec_->finish(sink_);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+        spaceCondition_.notify_all();
+    }
+}
+
+CompressionType OutputCompressor::fromPath(const std::string& path) {
+    if (endsWith(path, ".gz")) {
+        return CompressionType::Gzip;
+    }
+    if (endsWith(path, ".zst")) {
+        return CompressionType::Zstd;
+    }
+    return CompressionType::None;
+}
+
+bool OutputCompressor::parse(const std::string& value, CompressionType& type) {
+    if (value == "gzip" || value == "gz") {
+        type = CompressionType::Gzip;
+    } else if (value == "zstd" || value == "zst") {
+        type = CompressionType::Zstd;
+    } else if (value == "none") {
+        type = CompressionType::None;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool OutputCompressor::isSupported(CompressionType type) {
+    switch (type) {
+        case CompressionType::None:
+            return true;
+        case CompressionType::Gzip:
+#ifdef FCON_HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case CompressionType::Zstd:
+#ifdef FCON_HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+const char* OutputCompressor::name(CompressionType type) {
+    switch (type) {
+        case CompressionType::Gzip: return "gzip";
+        case CompressionType::Zstd: return "zstd";
+        default: return "none";
+    }
+}
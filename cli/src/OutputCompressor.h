@@ -0,0 +1,65 @@
+#ifndef OUTPUT_COMPRESSOR_H
+#define OUTPUT_COMPRESSOR_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+
+// 输出压缩格式
+enum class CompressionType {
+    None,
+    Gzip,  // zlib（FCON_HAVE_ZLIB）
+    Zstd   // libzstd（FCON_HAVE_ZSTD，配置时检测到才可用）
+};
+
+// 流式压缩流水线：数据块进入有界队列，由独立线程压缩并写出，
+// 压缩与 JSON 编码并行进行。
+class OutputCompressor {
+public:
+    // sink: 写出压缩后的数据（在压缩线程中调用）
+    using Sink = std::function<void(const char* data, size_t size)>;
+
+    OutputCompressor(CompressionType type, int level, Sink sink);
+    ~OutputCompressor();
+
+    OutputCompressor(const OutputCompressor&) = delete;
+    OutputCompressor& operator=(const OutputCompressor&) = delete;
+
+    // 提交一块未压缩数据（队列满时阻塞）
+    void push(std::string data);
+
+    // 结束压缩流并等待全部写出，压缩线程中的错误在此抛出
+    void finish();
+
+    // 根据文件扩展名推断压缩格式（.gz / .zst）
+    static CompressionType fromPath(const std::string& path);
+    // 解析 gzip/zstd/none
+    static bool parse(const std::string& name, CompressionType& type);
+    static bool isSupported(CompressionType type);
+    static const char* name(CompressionType type);
+
+    // 压缩算法实现（内部使用）
+    class Codec;
+
+private:
+    void compressLoop();
+
+    std::unique_ptr<Codec> codec_;
+    Sink sink_;
+
+    std::mutex mutex_;
+    std::condition_variable dataCondition_;
+    std::condition_variable spaceCondition_;
+    std::queue<std::string> queue_;
+    size_t maxQueued_;
+    bool finishing_;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+#endif // OUTPUT_COMPRESSOR_H
@@ -0,0 +1,239 @@
+#include "PathFilter.h"
+#include <algorithm>
+
+namespace {
+
+bool hasWildcard(const std::string& text) {
+    return text.find_first_of("*?[") != std::string::npos;
+}
+
+bool startsWith(const std::string& value, const std::string& prefix) {
+    return value.size() >= prefix.size() && value.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() &&
+           value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+GlobSet::Pattern GlobSet::compile(const std::string& pattern, bool& directoryOnly) {
+    Pattern compiled;
+    std::string text = pattern;
+    directoryOnly = false;
+    if (text.size() > 1 && text.back() == '/') {
+        directoryOnly = true;
+        text.pop_back();
+    }
+    compiled.directoryOnly = directoryOnly;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '*') {
+            Token token;
+            if (i + 1 < text.size() && text[i + 1] == '*') {
+                token.kind = Token::DoubleStar;
+                i++;
+                // "**/" 可以匹配零层目录
+                if (i + 1 < text.size() && text[i + 1] == '/') {
+                    i++;
+                    token.text = "/";
+                }
+            } else {
+                token.kind = Token::Star;
+            }
+            compiled.tokens.push_back(token);
+        } else if (c == '?') {
+            Token token;
+            token.kind = Token::AnyChar;
+            compiled.tokens.push_back(token);
+        } else if (c == '[' && text.find(']', i + 1) != std::string::npos) {
+            Token token;
+            token.kind = Token::CharClass;
+            size_t j = i + 1;
+            if (j < text.size() && (text[j] == '!' || text[j] == '^')) {
+                token.negated = true;
+                j++;
+            }
+            size_t start = j;
+            for (; j < text.size() && (text[j] != ']' || j == start); j++) {
+                if (j + 2 < text.size() && text[j + 1] == '-' && text[j + 2] != ']') {
+                    for (int ch = static_cast<unsigned char>(text[j]);
+                         ch <= static_cast<unsigned char>(text[j + 2]); ch++) {
+                        token.text += static_cast<char>(ch);
+                    }
+                    j += 2;
+                } else {
+                    token.text += text[j];
+                }
+            }
+            i = j;
+            compiled.tokens.push_back(token);
+        } else {
+            if (c == '\\' && i + 1 < text.size()) {
+                c = text[++i];
+            }
+            if (compiled.tokens.empty() || compiled.tokens.back().kind != Token::Literal) {
+                Token token;
+                token.kind = Token::Literal;
+                compiled.tokens.push_back(token);
+            }
+            compiled.tokens.back().text += c;
+        }
+    }
+    return compiled;
+}
+
+void GlobSet::add(const std::string& pattern) {
+    if (pattern.empty()) {
+        return;
+    }
+    count_++;
+
+    std::string body = pattern;
+    bool directoryOnly = false;
+    if (body.size() > 1 && body.back() == '/') {
+        directoryOnly = true;
+        body.pop_back();
+    }
+
+    if (body.find('/') != std::string::npos) {
+        // 路径模式：去掉开头的 '/'（表示锚定在扫描根目录）
+        std::string anchored = body[0] == '/' ? body.substr(1) : body;
+        bool ignored = false;
+        Pattern compiled = compile(anchored, ignored);
+        compiled.directoryOnly = directoryOnly;
+        pathPatterns_.push_back(compiled);
+        return;
+    }
+
+    int slot = directoryOnly ? 1 : 0;
+    std::string inner = body.size() > 1 ? body.substr(1) : std::string();
+    std::string head = body.size() > 1 ? body.substr(0, body.size() - 1) : std::string();
+    if (!hasWildcard(body)) {
+        exactNames_[slot].insert(body);
+    } else if (body[0] == '*' && !inner.empty() && !hasWildcard(inner)) {
+        suffixes_[slot].push_back(inner);
+    } else if (body.back() == '*' && !head.empty() && !hasWildcard(head)) {
+        prefixes_[slot].push_back(head);
+    } else {
+        bool ignored = false;
+        Pattern compiled = compile(body, ignored);
+        compiled.directoryOnly = directoryOnly;
+        namePatterns_.push_back(compiled);
+    }
+}
+
+bool GlobSet::matchTokens(const std::vector<Token>& tokens, size_t ti, const std::string& text, size_t si) {
+    while (ti < tokens.size()) {
+        const Token& token = tokens[ti];
+        switch (token.kind) {
+            case Token::Literal:
+                if (text.compare(si, token.text.size(), token.text) != 0) {
+                    return false;
+                }
+                si += token.text.size();
+                ti++;
+                break;
+            case Token::AnyChar:
+                if (si >= text.size() || text[si] == '/') {
+                    return false;
+                }
+                si++;
+                ti++;
+                break;
+            case Token::CharClass: {
+                if (si >= text.size() || text[si] == '/') {
+                    return false;
+                }
+                bool found = token.text.find(text[si]) != std::string::npos;
+                if (found == token.negated) {
+                    return false;
+                }
+                si++;
+                ti++;
+                break;
+            }
+            case Token::Star:
+                // 尝试所有不跨越 '/' 的长度
+                for (size_t end = si; ; end++) {
+                    if (matchTokens(tokens, ti + 1, text, end)) {
+                        return true;
+                    }
+                    if (end >= text.size() || text[end] == '/') {
+                        return false;
+                    }
+                }
+            case Token::DoubleStar:
+                // "**/" 匹配零层或多层目录（只能在目录边界结束）；"**" 匹配任意字符
+                for (size_t end = si; end <= text.size(); end++) {
+                    if (token.text.empty()) {
+                        if (matchTokens(tokens, ti + 1, text, end)) {
+                            return true;
+                        }
+                    } else if (end == si || text[end - 1] == '/') {
+                        if (matchTokens(tokens, ti + 1, text, end)) {
+                            return true;
+                        }
+                    }
+                }
+                return false;
+        }
+    }
+    return si == text.size();
+}
+
+bool GlobSet::matchAny(const std::vector<Pattern>& patterns, const std::string& text, bool isDirectory) {
+    for (const auto& pattern : patterns) {
+        if (pattern.directoryOnly && !isDirectory) {
+            continue;
+        }
+        if (matchTokens(pattern.tokens, 0, text, 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GlobSet::matches(const std::string& name, const std::string& relativePath, bool isDirectory) const {
+    if (count_ == 0) {
+        return false;
+    }
+    for (int slot = 0; slot < (isDirectory ? 2 : 1); slot++) {
+        if (exactNames_[slot].count(name) > 0) {
+            return true;
+        }
+        for (const auto& suffix : suffixes_[slot]) {
+            if (endsWith(name, suffix)) {
+                return true;
+            }
+        }
+        for (const auto& prefix : prefixes_[slot]) {
+            if (startsWith(name, prefix)) {
+                return true;
+            }
+        }
+    }
+    return matchAny(namePatterns_, name, isDirectory) ||
+           (!pathPatterns_.empty() && matchAny(pathPatterns_, relativePath, isDirectory));
+}
+
+void PathFilter::setRoot(const std::string& rootPath) {
+    rootPrefix_ = rootPath;
+    while (rootPrefix_.size() > 1 && (rootPrefix_.back() == '/' || rootPrefix_.back() == '\\')) {
+        rootPrefix_.pop_back();
+    }
+}
+
+std::string PathFilter::relativePath(const std::string& fullPath) const {
+    if (!startsWith(fullPath, rootPrefix_)) {
+        return fullPath;
+    }
+    std::string relative = fullPath.substr(rootPrefix_.size());
+    // 去掉开头的分隔符，并统一使用 '/'
+    size_t start = relative.find_first_not_of("/\\");
+    relative = start == std::string::npos ? std::string() : relative.substr(start);
+    std::replace(relative.begin(), relative.end(), '\\', '/');
+    return relative;
+}
@@ -0,0 +1,88 @@
+#ifndef PATH_FILTER_H
+#define PATH_FILTER_H
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// 编译后的 glob 模式集合。
+// 支持 *（不跨目录）、**（可跨目录）、?、[abc]/[a-z]/[!abc]。
+// 不含 '/' 的模式匹配条目名称；含 '/' 的模式匹配相对扫描根目录的路径；
+// 以 '/' 结尾的模式只匹配目录。
+// 纯字面量、"*后缀"、"前缀*" 形式的模式编译为哈希/前后缀快速路径，其余走通用匹配器。
+class GlobSet {
+public:
+    void add(const std::string& pattern);
+    bool empty() const { return count_ == 0; }
+    bool needsRelativePath() const { return !pathPatterns_.empty(); }
+
+    // name: 条目名称；relativePath: 相对扫描根目录的路径（needsRelativePath() 为 false 时可为空）
+    bool matches(const std::string& name, const std::string& relativePath, bool isDirectory) const;
+
+private:
+    struct Token {
+        enum Kind { Literal, AnyChar, Star, DoubleStar, CharClass } kind;
+        std::string text;   // Literal 的内容或 CharClass 的字符集合（已展开区间）
+        bool negated = false;
+    };
+
+    struct Pattern {
+        std::vector<Token> tokens;
+        bool directoryOnly = false;
+    };
+
+    static Pattern compile(const std::string& pattern, bool& directoryOnly);
+    static bool matchTokens(const std::vector<Token>& tokens, size_t ti, const std::string& text, size_t si);
+    static bool matchAny(const std::vector<Pattern>& patterns, const std::string& text, bool isDirectory);
+
+    // 名称模式的快速路径
+    std::unordered_set<std::string> exactNames_[2];    // [0] 任意类型, [1] 仅目录
+    std::vector<std::string> suffixes_[2];
+    std::vector<std::string> prefixes_[2];
+    std::vector<Pattern> namePatterns_;
+    std::vector<Pattern> pathPatterns_;
+    size_t count_ = 0;
+};
+
+// 遍历过滤规则：在 stat/FIEMAP 之前于工作线程中求值，被排除的子目录不会入队也不会被列出
+class PathFilter {
+public:
+    void addInclude(const std::string& pattern) { includes_.add(pattern); }
+    void addExclude(const std::string& pattern) { excludes_.add(pattern); }
+    void setMaxDepth(int depth) { maxDepth_ = depth; }
+    void setMinSize(size_t bytes) { minSize_ = bytes; }
+
+    // 设置扫描根目录（用于计算相对路径）
+    void setRoot(const std::string& rootPath);
+
+    bool isActive() const {
+        return !includes_.empty() || !excludes_.empty() || maxDepth_ >= 0 || minSize_ > 0;
+    }
+    bool needsRelativePath() const { return includes_.needsRelativePath() || excludes_.needsRelativePath(); }
+
+    // 计算条目相对扫描根目录的路径
+    std::string relativePath(const std::string& fullPath) const;
+
+    // 是否排除该条目（目录被排除时整个子树都不会被扫描）
+    bool isExcluded(const std::string& name, const std::string& relativePath, bool isDirectory) const {
+        return excludes_.matches(name, relativePath, isDirectory);
+    }
+
+    // 文件是否满足 include 规则（没有 include 规则时全部满足）
+    bool isIncludedFile(const std::string& name, const std::string& relativePath) const {
+        return includes_.empty() || includes_.matches(name, relativePath, false);
+    }
+
+    // depth 为条目深度（根目录的直接子项为 1）；-1 表示不限制
+    bool shouldDescend(int depth) const { return maxDepth_ < 0 || depth < maxDepth_; }
+    bool isBelowMinSize(size_t size) const { return size < minSize_; }
+
+private:
+    GlobSet includes_;
+    GlobSet excludes_;
+    int maxDepth_ = -1;
+    size_t minSize_ = 0;
+    std::string rootPrefix_;
+};
+
+#endif // PATH_FILTER_H
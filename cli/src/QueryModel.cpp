@@ -0,0 +1,355 @@
+#include "QueryModel.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// 读取请求中的整数字段，缺省时返回 fallback，并限制在 [low, high] 范围内
+int64_t intField(const nlohmann::json& request, const char* key, int64_t fallback, int64_t low, int64_t high) {
+    auto it = request.find(key);
+    if (it == request.end()) {
+        return fallback;
+    }
+    if (!it->is_number_integer()) {
+        throw std::runtime_error(std::string(key) + " 必须是整数");
+    }
+    return std::min(std::max(it->get<int64_t>(), low), high);
+}
+
+} // namespace
+
+QueryModel::QueryModel() : root_(npos), blockSize_(0), totalSize_(0), fileCount_(0) {}
+
+void QueryModel::add(const FileEntry& entry) {
+    if (nodes_.size() >= npos - 1) {
+        throw std::runtime_error("条目数超过查询模型的上限");
+    }
+    Node node{};
+    node.size = entry.size;
+    node.text = pool_.size();
+    node.parent = npos;
+    node.extents = static_cast<uint32_t>(std::min<size_t>(entry.extents.size(), UINT32_MAX));
+    node.blocks = static_cast<uint32_t>(std::min<size_t>(entry.blocks.size(), UINT32_MAX));
+    node.rollup = npos;
+    node.directory = entry.type == EntryKind::Directory ? 1 : 0;
+    node.algorithm = static_cast<uint8_t>(entry.allocationAlgorithm);
+    pool_ += entry.id;
+    pool_ += '\0';
+    pool_ += entry.name;
+    pool_ += '\0';
+    pool_ += entry.createTime;
+    pool_ += '\0';
+
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    indexById_[entry.id] = index;
+    parentIds_.push_back(entry.parentId);
+    if (entry.parentId.empty() && root_ == npos) {
+        root_ = index;
+    }
+    nodes_.push_back(node);
+}
+
+const char* QueryModel::name(const Node& node) const {
+    const char* text = id(node);
+    return text + std::strlen(text) + 1;
+}
+
+const char* QueryModel::createTime(const Node& node) const {
+    const char* text = name(node);
+    return text + std::strlen(text) + 1;
+}
+
+void QueryModel::finish(const std::string& rootPath, const std::string& fileSystemType, size_t blockSize) {
+    if (root_ == npos) {
+        throw std::runtime_error("扫描结果中没有根目录");
+    }
+    rootPath_ = rootPath;
+    fileSystemType_ = fileSystemType;
+    blockSize_ = blockSize;
+
+    // 父节点：找不到父目录的条目挂到根目录下
+    std::vector<uint32_t> childCounts(nodes_.size(), 0);
+    for (uint32_t i = 0; i < nodes_.size(); i++) {
+        if (i == root_) {
+            continue;
+        }
+        auto it = indexById_.find(parentIds_[i]);
+        uint32_t parent = it != indexById_.end() && it->second != i ? it->second : root_;
+        nodes_[i].parent = parent;
+        childCounts[parent]++;
+    }
+    std::vector<std::string>().swap(parentIds_);
+    std::unordered_map<std::string, uint32_t>().swap(indexById_);
+
+    // 子节点连续存放，按名称排序以便二分查找
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < nodes_.size(); i++) {
+        nodes_[i].firstChild = offset;
+        nodes_[i].childCount = 0;
+        offset += childCounts[i];
+    }
+    children_.assign(offset, 0);
+    for (uint32_t i = 0; i < nodes_.size(); i++) {
+        if (i != root_) {
+            Node& parent = nodes_[nodes_[i].parent];
+            children_[parent.firstChild + parent.childCount++] = i;
+        }
+    }
+    for (const Node& node : nodes_) {
+        auto begin = children_.begin() + node.firstChild;
+        std::sort(begin, begin + node.childCount, [this](uint32_t a, uint32_t b) {
+            return std::strcmp(name(nodes_[a]), name(nodes_[b])) < 0;
+        });
+    }
+
+    // 迭代的深度优先遍历：进入时分配先序编号，离开时把子树汇总累加到父目录
+    uint32_t counter = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> stack;   // (节点, 下一个要访问的子节点序号)
+    stack.push_back({root_, 0});
+    nodes_[root_].preorder = counter++;
+    nodes_[root_].rollup = 0;
+    rollups_.emplace_back();
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const Node& node = nodes_[top.first];
+        if (top.second < node.childCount) {
+            uint32_t child = children_[node.firstChild + top.second++];
+            nodes_[child].preorder = counter++;
+            if (nodes_[child].directory) {
+                nodes_[child].rollup = static_cast<uint32_t>(rollups_.size());
+                rollups_.emplace_back();
+            }
+            stack.push_back({child, 0});
+            continue;
+        }
+        uint32_t index = top.first;
+        stack.pop_back();
+        Node& current = nodes_[index];
+        current.preorderEnd = counter;
+        if (current.parent == npos || nodes_[current.parent].rollup == npos) {
+            continue;
+        }
+        Rollup& parent = rollups_[nodes_[current.parent].rollup];
+        if (current.directory) {
+            const Rollup& child = rollups_[current.rollup];
+            parent.bytes += child.bytes;
+            parent.allocated += child.allocated;
+            parent.files += child.files;
+            parent.dirs += child.dirs + 1;
+            parent.extents += child.extents;
+            parent.maxDepth = std::max(parent.maxDepth, child.maxDepth + 1);
+        } else {
+            parent.bytes += current.size;
+            parent.allocated += static_cast<uint64_t>(current.blocks) * blockSize_;
+            parent.files++;
+            parent.extents += current.extents;
+            parent.maxDepth = std::max<uint32_t>(parent.maxDepth, 1);
+        }
+    }
+
+    // 预先排好的 top-N 顺序（相同时按先序编号，结果稳定）
+    for (uint32_t i = 0; i < nodes_.size(); i++) {
+        if (nodes_[i].directory) {
+            bySubtree_.push_back(i);
+        } else {
+            bySize_.push_back(i);
+            totalSize_ += nodes_[i].size;
+        }
+    }
+    fileCount_ = bySize_.size();
+    byExtents_ = bySize_;
+    std::sort(bySize_.begin(), bySize_.end(), [this](uint32_t a, uint32_t b) {
+        const Node& x = nodes_[a];
+        const Node& y = nodes_[b];
+        return x.size != y.size ? x.size > y.size : x.preorder < y.preorder;
+    });
+    std::sort(byExtents_.begin(), byExtents_.end(), [this](uint32_t a, uint32_t b) {
+        const Node& x = nodes_[a];
+        const Node& y = nodes_[b];
+        return x.extents != y.extents ? x.extents > y.extents : x.preorder < y.preorder;
+    });
+    std::sort(bySubtree_.begin(), bySubtree_.end(), [this](uint32_t a, uint32_t b) {
+        uint64_t x = rollups_[nodes_[a].rollup].bytes;
+        uint64_t y = rollups_[nodes_[b].rollup].bytes;
+        return x != y ? x > y : nodes_[a].preorder < nodes_[b].preorder;
+    });
+}
+
+std::string QueryModel::path(uint32_t index) const {
+    std::vector<const char*> parts;
+    for (uint32_t i = index; i != root_ && i != npos; i = nodes_[i].parent) {
+        parts.push_back(name(nodes_[i]));
+    }
+    if (parts.empty()) {
+        return "/";
+    }
+    std::string result;
+    for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+        result += '/';
+        result += *it;
+    }
+    return result;
+}
+
+uint32_t QueryModel::findChild(uint32_t parent, const std::string& childName) const {
+    const Node& node = nodes_[parent];
+    auto begin = children_.begin() + node.firstChild;
+    auto end = begin + node.childCount;
+    auto it = std::lower_bound(begin, end, childName, [this](uint32_t child, const std::string& target) {
+        return std::strcmp(name(nodes_[child]), target.c_str()) < 0;
+    });
+    return it != end && childName == name(nodes_[*it]) ? *it : npos;
+}
+
+uint32_t QueryModel::lookup(const std::string& text) const {
+    std::string relative = text;
+    if (!rootPath_.empty() && relative.compare(0, rootPath_.size(), rootPath_) == 0 &&
+        (relative.size() == rootPath_.size() || relative[rootPath_.size()] == '/')) {
+        relative = relative.substr(rootPath_.size());
+    }
+    uint32_t current = root_;
+    size_t start = 0;
+    while (start <= relative.size() && current != npos) {
+        size_t slash = relative.find('/', start);
+        std::string part = relative.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+        if (!part.empty() && part != ".") {
+            current = nodes_[current].directory ? findChild(current, part) : npos;
+        }
+        if (slash == std::string::npos) {
+            break;
+        }
+        start = slash + 1;
+    }
+    return current;
+}
+
+uint32_t QueryModel::resolve(const nlohmann::json& request) const {
+    auto it = request.find("path");
+    if (it == request.end()) {
+        return root_;
+    }
+    if (!it->is_string()) {
+        throw std::runtime_error("path 必须是字符串");
+    }
+    uint32_t index = lookup(it->get<std::string>());
+    if (index == npos) {
+        throw std::runtime_error("路径不存在: " + it->get<std::string>());
+    }
+    return index;
+}
+
+nlohmann::json QueryModel::rollupJSON(const Rollup& rollup) const {
+    return {{"allocated", rollup.allocated}, {"bytes", rollup.bytes}, {"dirs", rollup.dirs},
+            {"extents", rollup.extents}, {"files", rollup.files}, {"maxDepth", rollup.maxDepth}};
+}
+
+nlohmann::json QueryModel::describe(uint32_t index) const {
+    const Node& node = nodes_[index];
+    nlohmann::json result = {
+        {"id", id(node)},
+        {"name", name(node)},
+        {"path", path(index)},
+        {"type", entryKindName(node.directory ? EntryKind::Directory : EntryKind::File)},
+        {"size", node.size},
+        {"createTime", createTime(node)},
+    };
+    if (node.directory) {
+        result["childCount"] = node.childCount;
+        result["subtree"] = rollupJSON(rollups_[node.rollup]);
+    } else {
+        result["allocationAlgorithm"] = allocationAlgorithmName(static_cast<AllocationAlgorithm>(node.algorithm));
+        result["blocks"] = node.blocks;
+        result["extents"] = node.extents;
+    }
+    return result;
+}
+
+nlohmann::json QueryModel::stat() const {
+    return {{"root", rootPath_},
+            {"fileSystemType", fileSystemType_},
+            {"blockSize", blockSize_},
+            {"files", fileCount_},
+            {"directories", nodes_.size() - fileCount_},
+            {"totalSize", totalSize_}};
+}
+
+nlohmann::json QueryModel::top(const nlohmann::json& request) const {
+    std::string by = request.value("by", std::string("size"));
+    const std::vector<uint32_t>* order = nullptr;
+    if (by == "size") {
+        order = &bySize_;
+    } else if (by == "extents") {
+        order = &byExtents_;
+    } else if (by == "subtree") {
+        order = &bySubtree_;
+    } else {
+        throw std::runtime_error("by 只支持 size、extents 和 subtree: " + by);
+    }
+    size_t limit = static_cast<size_t>(intField(request, "n", 10, 1, 10000));
+    uint32_t scope = resolve(request);
+    const Node& scopeNode = nodes_[scope];
+
+    // 按预先排好的顺序取出位于 scope 子树内的前 limit 个（不含 scope 本身）
+    nlohmann::json items = nlohmann::json::array();
+    for (uint32_t index : *order) {
+        const Node& node = nodes_[index];
+        if (node.preorder > scopeNode.preorder && node.preorder < scopeNode.preorderEnd) {
+            items.push_back(describe(index));
+            if (items.size() >= limit) {
+                break;
+            }
+        }
+    }
+    return {{"by", by}, {"path", path(scope)}, {"items", std::move(items)}};
+}
+
+nlohmann::json QueryModel::children(const nlohmann::json& request) const {
+    uint32_t index = resolve(request);
+    const Node& node = nodes_[index];
+    if (!node.directory) {
+        throw std::runtime_error("不是目录: " + path(index));
+    }
+    size_t offset = static_cast<size_t>(intField(request, "offset", 0, 0, INT64_MAX));
+    size_t limit = static_cast<size_t>(intField(request, "limit", 100, 1, 10000));
+    nlohmann::json items = nlohmann::json::array();
+    for (size_t i = offset; i < node.childCount && i < offset + limit; i++) {
+        items.push_back(describe(children_[node.firstChild + i]));
+    }
+    return {{"path", path(index)}, {"total", node.childCount}, {"offset", offset}, {"items", std::move(items)}};
+}
+
+nlohmann::json QueryModel::handle(const nlohmann::json& request) const {
+    nlohmann::json response;
+    try {
+        if (!request.is_object()) {
+            throw std::runtime_error("请求必须是 JSON 对象");
+        }
+        auto op = request.find("op");
+        if (op == request.end() || !op->is_string()) {
+            throw std::runtime_error("缺少 op 字段");
+        }
+        const std::string& name = op->get_ref<const std::string&>();
+        if (name == "stat") {
+            response = stat();
+        } else if (name == "lookup") {
+            response = describe(resolve(request));
+        } else if (name == "subtree") {
+            uint32_t index = resolve(request);
+            if (!nodes_[index].directory) {
+                throw std::runtime_error("不是目录: " + path(index));
+            }
+            response = {{"path", path(index)}, {"subtree", rollupJSON(rollups_[nodes_[index].rollup])}};
+        } else if (name == "top") {
+            response = top(request);
+        } else if (name == "children") {
+            response = children(request);
+        } else {
+            throw std::runtime_error("未知操作: " + name);
+        }
+        response["ok"] = true;
+    } catch (const std::exception& e) {
+        response = {{"ok", false}, {"error", e.what()}};
+    }
+    return response;
+}
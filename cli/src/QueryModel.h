@@ -0,0 +1,94 @@
+#ifndef QUERY_MODEL_H
+#define QUERY_MODEL_H
+
+#include "FileEntry.h"
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// fcon serve 常驻内存的只读模型。
+// 扫描结果被压缩为定长节点数组 + 字符串池：子节点按名称排序连续存放（CSR），
+// 每个节点带先序编号区间以 O(1) 判断祖先关系，目录带预先计算好的子树汇总，
+// 文件按大小、extent 数以及目录按子树大小的降序排列也预先排好。
+// finish() 之后模型不再修改，任意多个线程可以同时查询而无需加锁。
+class QueryModel {
+public:
+    QueryModel();
+
+    // 添加扫描得到的条目（finish 之前调用，顺序任意）
+    void add(const FileEntry& entry);
+
+    // 建立父子关系、子树汇总和排序索引；rootPath 为扫描根目录的物理路径
+    void finish(const std::string& rootPath, const std::string& fileSystemType, size_t blockSize);
+
+    // 处理一个请求（JSON 对象，op 字段指定操作），返回响应对象；请求错误时返回 ok=false
+    nlohmann::json handle(const nlohmann::json& request) const;
+
+    size_t nodeCount() const { return nodes_.size(); }
+
+private:
+    struct Node {
+        uint64_t size;
+        uint64_t text;          // pool_ 中 "id\0name\0createTime\0" 的起点
+        uint32_t parent;        // 根节点为 npos
+        uint32_t firstChild;    // children_ 中的起点
+        uint32_t childCount;
+        uint32_t extents;
+        uint32_t blocks;
+        uint32_t preorder;      // 先序编号；子孙节点的编号位于 [preorder, preorderEnd)
+        uint32_t preorderEnd;
+        uint32_t rollup;        // 目录在 rollups_ 中的下标，文件为 npos
+        uint8_t directory;
+        uint8_t algorithm;      // AllocationAlgorithm 的值
+    };
+
+    struct Rollup {
+        uint64_t bytes = 0;
+        uint64_t allocated = 0;
+        uint64_t files = 0;
+        uint64_t dirs = 0;
+        uint64_t extents = 0;
+        uint32_t maxDepth = 0;
+    };
+
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    const char* id(const Node& node) const { return pool_.data() + node.text; }
+    const char* name(const Node& node) const;
+    const char* createTime(const Node& node) const;
+    std::string path(uint32_t index) const;
+
+    // 按相对根目录的路径（或以扫描根目录开头的绝对路径）查找节点，找不到时返回 npos
+    uint32_t lookup(const std::string& path) const;
+    uint32_t findChild(uint32_t parent, const std::string& name) const;
+    uint32_t resolve(const nlohmann::json& request) const;   // 取请求中的 path 字段，默认为根目录
+
+    nlohmann::json describe(uint32_t index) const;
+    nlohmann::json rollupJSON(const Rollup& rollup) const;
+
+    nlohmann::json stat() const;
+    nlohmann::json top(const nlohmann::json& request) const;
+    nlohmann::json children(const nlohmann::json& request) const;
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> children_;
+    std::vector<Rollup> rollups_;
+    std::string pool_;
+    std::vector<uint32_t> bySize_;       // 文件，按大小降序
+    std::vector<uint32_t> byExtents_;    // 文件，按 extent 数降序
+    std::vector<uint32_t> bySubtree_;    // 目录，按子树文件总大小降序
+    uint32_t root_;
+    std::string rootPath_;
+    std::string fileSystemType_;
+    size_t blockSize_;
+    uint64_t totalSize_;
+    uint64_t fileCount_;
+
+    // 构建期间使用，finish() 后释放
+    std::vector<std::string> parentIds_;
+    std::unordered_map<std::string, uint32_t> indexById_;
+};
+
+#endif // QUERY_MODEL_H
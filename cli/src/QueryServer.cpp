@@ -0,0 +1,199 @@
+#include "QueryServer.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0   // macOS 没有该标志，run() 中已忽略 SIGPIPE
+#endif
+#endif
+
+namespace {
+
+const size_t kMaxRequestLine = 1 << 20;   // 单个请求行的上限
+
+#ifndef _WIN32
+std::atomic<bool> stopRequested{false};
+
+void onStopSignal(int) {
+    stopRequested.store(true);
+}
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("套接字路径过长: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+QueryServer::QueryServer(const QueryModel& model, const std::string& socketPath)
+    : model_(model), socketPath_(socketPath), listener_(-1) {
+#ifdef _WIN32
+    throw std::runtime_error("serve 模式仅支持 Linux/Unix");
+#else
+    sockaddr_un address = socketAddress(socketPath_);
+    listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener_ < 0) {
+        throw std::runtime_error(std::string("无法创建套接字: ") + std::strerror(errno));
+    }
+    // 只清理无人监听的残留套接字，避免误删正在运行的另一个实例
+    if (access(socketPath_.c_str(), F_OK) == 0) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool alive = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (alive) {
+            close(listener_);
+            throw std::runtime_error("套接字已被另一个 fcon serve 使用: " + socketPath_);
+        }
+        unlink(socketPath_.c_str());
+    }
+    if (bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener_, 64) != 0) {
+        int error = errno;
+        close(listener_);
+        throw std::runtime_error("无法监听套接字 " + socketPath_ + ": " + std::strerror(error));
+    }
+#endif
+}
+
+QueryServer::~QueryServer() {
+#ifndef _WIN32
+    if (listener_ >= 0) {
+        close(listener_);
+        unlink(socketPath_.c_str());
+    }
+#endif
+}
+
+void QueryServer::run() {
+#ifndef _WIN32
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+    while (!stopRequested.load()) {
+        // 带超时的 poll，以便及时响应停止信号
+        pollfd entry{listener_, POLLIN, 0};
+        int ready = poll(&entry, 1, 200);
+        if (ready <= 0) {
+            continue;
+        }
+        int client = accept(listener_, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        std::thread([this, client] { serve(client); }).detach();
+    }
+#endif
+}
+
+void QueryServer::serve(int client) const {
+#ifndef _WIN32
+    std::string pending;
+    char buffer[65536];
+    for (;;) {
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        pending.append(buffer, static_cast<size_t>(n));
+        size_t start = 0;
+        size_t newline;
+        bool ok = true;
+        while (ok && (newline = pending.find('\n', start)) != std::string::npos) {
+            std::string line = pending.substr(start, newline - start);
+            start = newline + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            nlohmann::json response;
+            nlohmann::json request = nlohmann::json::parse(line, nullptr, false);
+            if (request.is_discarded()) {
+                response = {{"ok", false}, {"error", "请求不是合法的 JSON"}};
+            } else {
+                response = model_.handle(request);
+            }
+            ok = sendAll(client, response.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + "\n");
+        }
+        pending.erase(0, start);
+        if (!ok || pending.size() > kMaxRequestLine) {
+            if (ok) {
+                sendAll(client, nlohmann::json({{"ok", false}, {"error", "请求行过长"}}).dump() + "\n");
+            }
+            break;
+        }
+    }
+    close(client);
+#else
+    (void)client;
+#endif
+}
+
+std::string QueryServer::request(const std::string& socketPath, const std::string& line) {
+#ifdef _WIN32
+    (void)socketPath;
+    (void)line;
+    throw std::runtime_error("query 模式仅支持 Linux/Unix");
+#else
+    sockaddr_un address = socketAddress(socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        int error = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::runtime_error("无法连接到 " + socketPath + ": " + std::strerror(error));
+    }
+    std::string response;
+    if (sendAll(fd, line + "\n")) {
+        char buffer[65536];
+        ssize_t n;
+        while (response.find('\n') == std::string::npos &&
+               ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0 || (n < 0 && errno == EINTR))) {
+            if (n > 0) {
+                response.append(buffer, static_cast<size_t>(n));
+            }
+        }
+    }
+    close(fd);
+    if (response.empty()) {
+        throw std::runtime_error("服务端没有返回响应");
+    }
+    return response.substr(0, response.find('\n'));
+#endif
+}
@@ -0,0 +1,33 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include "QueryModel.h"
+#include <atomic>
+#include <string>
+
+// fcon serve 的 Unix 域套接字服务端。
+// 协议：每行一个 JSON 请求，服务端对每个请求回复一行 JSON 响应，连接可以连续发送多个请求。
+// 每个连接由独立线程处理；模型只读，连接之间没有任何锁，慢客户端不会阻塞其他客户端。
+class QueryServer {
+public:
+    QueryServer(const QueryModel& model, const std::string& socketPath);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // 监听并处理连接，直到收到 SIGINT/SIGTERM；退出时删除套接字文件
+    void run();
+
+    // 连接到 socketPath，发送一个请求并返回响应行（fcon query 使用）
+    static std::string request(const std::string& socketPath, const std::string& line);
+
+private:
+    void serve(int client) const;
+
+    const QueryModel& model_;
+    std::string socketPath_;
+    int listener_;
+};
+
+#endif // QUERY_SERVER_H
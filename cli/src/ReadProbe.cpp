@@ -0,0 +1,463 @@
+#include "ReadProbe.h"
+#include "SnapshotWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint64_t MIN_SIZE = 1 << 20;          // 更小的文件读取时间主要是打开和首次寻道，看不出碎片的影响
+const size_t REQUEST_SIZE = 1 << 20;        // 每次读取请求 1MB
+const size_t ALIGNMENT = 4096;              // O_DIRECT 要求缓冲区、偏移和长度按逻辑块对齐
+
+// extent 数分桶的下界；10 与 determineAllocationAlgorithm 区分 indexed/linked 的阈值一致
+const size_t BUCKET_BOUNDS[] = {1, 2, 4, 10, 32, 100};
+const size_t BUCKET_COUNT = sizeof(BUCKET_BOUNDS) / sizeof(BUCKET_BOUNDS[0]);
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// 保留两位小数，报告中的数字更易读
+double rounded(double value) {
+    return std::round(value * 100) / 100;
+}
+
+double megabytesPerSecond(uint64_t bytes, double seconds) {
+    return seconds > 0 ? static_cast<double>(bytes) / (1 << 20) / seconds : 0;
+}
+
+struct AlignedFree {
+    void operator()(char* buffer) const {
+#ifdef _WIN32
+        _aligned_free(buffer);
+#else
+        std::free(buffer);
+#endif
+    }
+};
+
+std::unique_ptr<char, AlignedFree> allocateAligned(size_t size) {
+#ifdef _WIN32
+    return std::unique_ptr<char, AlignedFree>(static_cast<char*>(_aligned_malloc(size, ALIGNMENT)));
+#else
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, ALIGNMENT, size) != 0) {
+        buffer = nullptr;
+    }
+    return std::unique_ptr<char, AlignedFree>(static_cast<char*>(buffer));
+#endif
+}
+
+// 冷读用的文件：优先 O_DIRECT；文件系统不支持时（tmpfs、部分 FUSE）退回普通读取，
+// 并在读取前丢弃该文件的页缓存
+class ColdFile {
+public:
+    ColdFile(const std::string& path, bool direct) : direct_(direct) {
+#ifdef _WIN32
+        direct_ = false;
+        in_.open(path, std::ios::binary);
+#else
+        int flags = O_RDONLY | O_CLOEXEC | O_NOATIME | (direct ? O_DIRECT : 0);
+        fd_ = open(path.c_str(), flags);
+        if (fd_ < 0 && errno == EPERM) {
+            fd_ = open(path.c_str(), flags & ~O_NOATIME);
+        }
+        if (fd_ >= 0 && !direct_) {
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+        }
+#endif
+    }
+
+    ~ColdFile() {
+#ifndef _WIN32
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+#endif
+    }
+
+    ColdFile(const ColdFile&) = delete;
+    ColdFile& operator=(const ColdFile&) = delete;
+
+#ifdef _WIN32
+    bool isOpen() const { return in_.is_open(); }
+#else
+    bool isOpen() const { return fd_ >= 0; }
+#endif
+    bool direct() const { return direct_; }
+
+    // 读取一次请求；返回读到的字节数，出错返回 -1（errno 保留）
+    long long readAt(uint64_t offset, char* buffer, size_t length) {
+#ifdef _WIN32
+        in_.seekg(static_cast<std::streamoff>(offset));
+        in_.read(buffer, static_cast<std::streamsize>(length));
+        long long count = static_cast<long long>(in_.gcount());
+        in_.clear();
+        return count;
+#else
+        for (;;) {
+            ssize_t count = pread(fd_, buffer, length, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            return static_cast<long long>(count);
+        }
+#endif
+    }
+
+private:
+    bool direct_;
+#ifdef _WIN32
+    std::ifstream in_;
+#else
+    int fd_ = -1;
+#endif
+};
+
+std::string deviceName(unsigned long long id) {
+#ifdef _WIN32
+    return std::to_string(id);
+#else
+    return std::to_string(major(id)) + ":" + std::to_string(minor(id));
+#endif
+}
+
+} // namespace
+
+ReadProbe::ReadProbe(size_t samplesPerBucket, uint64_t maxRead)
+    : samplesPerBucket_(std::max<size_t>(1, samplesPerBucket))
+    , maxRead_(std::max<uint64_t>(REQUEST_SIZE, maxRead))
+    , random_(0x5eed)
+    , simulatedFiles_(0) {
+}
+
+size_t ReadProbe::bucketOf(size_t extents) {
+    size_t bucket = 0;
+    while (bucket + 1 < BUCKET_COUNT && extents >= BUCKET_BOUNDS[bucket + 1]) {
+        bucket++;
+    }
+    return bucket;
+}
+
+void ReadProbe::add(const FileEntry& entry) {
+    // 稀疏文件的空洞读取时不产生 I/O，会夸大吞吐量
+    if (entry.type != EntryKind::File || entry.size < MIN_SIZE || entry.sparse || entry.extents.empty()) {
+        return;
+    }
+    // 模拟的 extent 数（未抽中或设备不支持探测）不反映真实布局，不能作为分桶依据
+    if (entry.simulatedExtents) {
+        simulatedFiles_++;
+        return;
+    }
+    // 只统计实际读取范围内的 extent
+    uint64_t length = std::min<uint64_t>(entry.size, maxRead_);
+    size_t extents = 0;
+    for (const auto& extent : entry.extents) {
+        if (extent.logicalOffset < length) {
+            extents++;
+        }
+    }
+    if (extents == 0) {
+        return;
+    }
+
+    Reservoir& reservoir = reservoirs_[{entry.deviceId, bucketOf(extents)}];
+    reservoir.seen++;
+    size_t slot = reservoir.samples.size();
+    if (slot >= samplesPerBucket_) {
+        slot = static_cast<size_t>(random_() % reservoir.seen);
+        if (slot >= samplesPerBucket_) {
+            return;
+        }
+    }
+    Sample sample;
+    sample.id = entry.id;
+    sample.path = entry.physicalPath;
+    sample.size = entry.size;
+    sample.deviceId = entry.deviceId;
+    sample.inode = entry.inode;
+    sample.extents = extents;
+    if (slot == reservoir.samples.size()) {
+        reservoir.samples.push_back(std::move(sample));
+    } else {
+        reservoir.samples[slot] = std::move(sample);
+    }
+}
+
+void ReadProbe::run() {
+    auto buffer = allocateAligned(REQUEST_SIZE);
+    if (!buffer) {
+        throw std::runtime_error("无法分配读取缓冲区");
+    }
+
+    // reservoirs_ 按 (设备, 桶) 有序，样本和设备的顺序因此是确定的
+    for (auto& item : reservoirs_) {
+        unsigned long long deviceId = item.first.first;
+        if (devices_.empty() || devices_.back().id != deviceId) {
+            Device device;
+            device.id = deviceId;
+            device.name = deviceName(deviceId);
+            devices_.push_back(std::move(device));
+        }
+        Bucket bucket;
+        size_t index = item.first.second;
+        bucket.minExtents = BUCKET_BOUNDS[index];
+        bucket.maxExtents = index + 1 < BUCKET_COUNT ? BUCKET_BOUNDS[index + 1] - 1 : 0;
+
+        // 桶内按 inode 顺序读取，和扫描时一样减少来回寻道
+        std::vector<Sample>& candidates = item.second.samples;
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Sample& a, const Sample& b) { return a.inode < b.inode; });
+        std::vector<double> throughputs;
+        double latencySum = 0;
+        double firstLatencySum = 0;
+        size_t requests = 0;
+        for (Sample& sample : candidates) {
+            if (!measure(sample, buffer.get())) {
+                sample.failed = true;
+            } else {
+                bucket.bytes += sample.bytesRead;
+                bucket.seconds += sample.seconds;
+                latencySum += sample.requestSeconds;
+                firstLatencySum += sample.firstLatency;
+                requests += sample.requests;
+                bucket.maxLatency = std::max(bucket.maxLatency, sample.maxLatency);
+                throughputs.push_back(megabytesPerSecond(sample.bytesRead, sample.seconds));
+                if (!sample.direct) {
+                    devices_.back().direct = false;
+                }
+                bucket.samples.push_back(samples_.size());
+            }
+            samples_.push_back(std::move(sample));
+        }
+        candidates.clear();
+        if (throughputs.empty()) {
+            continue;
+        }
+
+        std::sort(throughputs.begin(), throughputs.end());
+        size_t middle = throughputs.size() / 2;
+        bucket.medianThroughput = throughputs.size() % 2 == 1 ? throughputs[middle]
+                                                              : (throughputs[middle - 1] + throughputs[middle]) / 2;
+        bucket.throughput = megabytesPerSecond(bucket.bytes, bucket.seconds);
+        bucket.meanLatency = requests > 0 ? latencySum / requests * 1000 : 0;
+        bucket.firstLatency = firstLatencySum / throughputs.size() * 1000;
+        bucket.maxLatency *= 1000;
+        devices_.back().buckets.push_back(std::move(bucket));
+    }
+
+    // 以 extent 数最少的桶为基准
+    for (Device& device : devices_) {
+        if (device.buckets.empty()) {
+            continue;
+        }
+        double baseline = device.buckets.front().throughput;
+        for (Bucket& bucket : device.buckets) {
+            bucket.relative = baseline > 0 ? bucket.throughput / baseline : 0;
+        }
+    }
+    devices_.erase(std::remove_if(devices_.begin(), devices_.end(),
+                                  [](const Device& device) { return device.buckets.empty(); }),
+                   devices_.end());
+}
+
+bool ReadProbe::measure(Sample& sample, char* buffer) {
+    Clock::time_point start = Clock::now();
+    auto file = std::make_unique<ColdFile>(sample.path, true);
+#ifndef _WIN32
+    if (!file->isOpen() && errno == EINVAL) {
+        file = std::make_unique<ColdFile>(sample.path, false);
+    }
+#endif
+    if (!file->isOpen()) {
+        return false;
+    }
+
+    uint64_t length = std::min<uint64_t>(sample.size, maxRead_);
+    uint64_t offset = 0;
+    while (offset < length) {
+        Clock::time_point issued = Clock::now();
+        long long count = file->readAt(offset, buffer, REQUEST_SIZE);
+#ifndef _WIN32
+        // 有的文件系统接受 O_DIRECT 打开但拒绝直接读取
+        if (count < 0 && errno == EINVAL && file->direct() && offset == 0) {
+            file = std::make_unique<ColdFile>(sample.path, false);
+            if (!file->isOpen()) {
+                return false;
+            }
+            start = Clock::now();
+            continue;
+        }
+#endif
+        if (count < 0) {
+            return false;
+        }
+        double latency = secondsSince(issued);
+        if (sample.requests == 0) {
+            sample.firstLatency = latency;
+        }
+        sample.maxLatency = std::max(sample.maxLatency, latency);
+        sample.requestSeconds += latency;
+        sample.requests++;
+        if (count == 0) {
+            break;    // 扫描后文件变短
+        }
+        uint64_t useful = std::min<uint64_t>(static_cast<uint64_t>(count), length - offset);
+        sample.bytesRead += useful;
+        offset += static_cast<uint64_t>(count);
+        if (static_cast<size_t>(count) < REQUEST_SIZE) {
+            break;    // 已到文件末尾
+        }
+    }
+    sample.seconds = secondsSince(start);
+    sample.direct = file->direct();
+    return sample.bytesRead > 0;
+}
+
+size_t ReadProbe::failedCount() const {
+    return static_cast<size_t>(std::count_if(samples_.begin(), samples_.end(),
+                                             [](const Sample& sample) { return sample.failed; }));
+}
+
+std::string ReadProbe::formatBucket(const Bucket& bucket) {
+    if (bucket.maxExtents == 0) {
+        return std::to_string(bucket.minExtents) + "+";
+    }
+    if (bucket.maxExtents == bucket.minExtents) {
+        return std::to_string(bucket.minExtents);
+    }
+    return std::to_string(bucket.minExtents) + "-" + std::to_string(bucket.maxExtents);
+}
+
+void ReadProbe::writeReport(const std::string& path) const {
+    SnapshotWriter writer(path, OutputCompressor::fromPath(path));
+    std::string& out = writer.buffer();
+
+    out += "{\n";
+    SnapshotWriter::appendKey(out, 1, "devices");
+    out += devices_.empty() ? "[" : "[\n";
+    for (size_t d = 0; d < devices_.size(); d++) {
+        const Device& device = devices_[d];
+        if (d > 0) {
+            out += ",\n";
+        }
+        SnapshotWriter::appendIndent(out, 2);
+        out += "{\n";
+        SnapshotWriter::appendKey(out, 3, "buckets");
+        out += "[\n";
+        for (size_t b = 0; b < device.buckets.size(); b++) {
+            const Bucket& bucket = device.buckets[b];
+            if (b > 0) {
+                out += ",\n";
+            }
+            SnapshotWriter::appendIndent(out, 4);
+            out += "{\n";
+            SnapshotWriter::appendKey(out, 5, "bytes");
+            SnapshotWriter::appendUnsigned(out, bucket.bytes);
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "extents");
+            SnapshotWriter::appendString(out, formatBucket(bucket));
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "files");
+            SnapshotWriter::appendUnsigned(out, bucket.samples.size());
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "firstLatencyMs");
+            SnapshotWriter::appendDouble(out, rounded(bucket.firstLatency));
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "maxLatencyMs");
+            SnapshotWriter::appendDouble(out, rounded(bucket.maxLatency));
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "meanLatencyMs");
+            SnapshotWriter::appendDouble(out, rounded(bucket.meanLatency));
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "medianThroughputMBps");
+            SnapshotWriter::appendDouble(out, rounded(bucket.medianThroughput));
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "relativeThroughput");
+            SnapshotWriter::appendDouble(out, rounded(bucket.relative));
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 5, "samples");
+            out += "[\n";
+            for (size_t s = 0; s < bucket.samples.size(); s++) {
+                const Sample& sample = samples_[bucket.samples[s]];
+                if (s > 0) {
+                    out += ",\n";
+                }
+                SnapshotWriter::appendIndent(out, 6);
+                out += "{\n";
+                SnapshotWriter::appendKey(out, 7, "bytesRead");
+                SnapshotWriter::appendUnsigned(out, sample.bytesRead);
+                out += ",\n";
+                SnapshotWriter::appendKey(out, 7, "extents");
+                SnapshotWriter::appendUnsigned(out, sample.extents);
+                out += ",\n";
+                SnapshotWriter::appendKey(out, 7, "id");
+                SnapshotWriter::appendString(out, sample.id);
+                out += ",\n";
+                SnapshotWriter::appendKey(out, 7, "maxLatencyMs");
+                SnapshotWriter::appendDouble(out, rounded(sample.maxLatency * 1000));
+                out += ",\n";
+                SnapshotWriter::appendKey(out, 7, "path");
+                SnapshotWriter::appendString(out, sample.path);
+                out += ",\n";
+                SnapshotWriter::appendKey(out, 7, "throughputMBps");
+                SnapshotWriter::appendDouble(out, rounded(megabytesPerSecond(sample.bytesRead, sample.seconds)));
+                out += '\n';
+                SnapshotWriter::appendIndent(out, 6);
+                out += '}';
+            }
+            out += '\n';
+            SnapshotWriter::appendIndent(out, 5);
+            out += "],\n";
+            SnapshotWriter::appendKey(out, 5, "throughputMBps");
+            SnapshotWriter::appendDouble(out, rounded(bucket.throughput));
+            out += '\n';
+            SnapshotWriter::appendIndent(out, 4);
+            out += '}';
+        }
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 3);
+        out += "],\n";
+        SnapshotWriter::appendKey(out, 3, "device");
+        SnapshotWriter::appendString(out, device.name);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, 3, "directIO");
+        out += device.direct ? "true" : "false";
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 2);
+        out += '}';
+        writer.flushIfNeeded();
+    }
+    if (!devices_.empty()) {
+        out += '\n';
+        SnapshotWriter::appendIndent(out, 1);
+    }
+    out += "],\n";
+
+    SnapshotWriter::appendKey(out, 1, "failed");
+    SnapshotWriter::appendUnsigned(out, failedCount());
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "maxReadBytes");
+    SnapshotWriter::appendUnsigned(out, maxRead_);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "simulatedFiles");
+    SnapshotWriter::appendUnsigned(out, simulatedFiles_);
+    out += '\n';
+    out += "}";
+
+    writer.close();
+}
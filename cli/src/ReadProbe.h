@@ -0,0 +1,96 @@
+#ifndef READ_PROBE_H
+#define READ_PROBE_H
+
+#include "FileEntry.h"
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 扫描结束后实测碎片对读取性能的影响：按设备和 extent 数分桶，每桶随机抽取若干文件，
+// 用 O_DIRECT 和对齐的缓冲区冷读（不经过页缓存），统计吞吐量和每次请求的延迟。
+// 同一时刻只读一个文件，避免并发读取互相干扰测量结果。
+class ReadProbe {
+public:
+    // 单个抽样文件的测量结果
+    struct Sample {
+        std::string id;
+        std::string path;
+        uint64_t size = 0;
+        unsigned long long deviceId = 0;
+        unsigned long long inode = 0;
+        size_t extents = 0;          // 读取范围内的 extent 数
+        uint64_t bytesRead = 0;
+        double seconds = 0;          // 打开到最后一次读取完成
+        double firstLatency = 0;     // 第一次请求的延迟（含寻道）
+        double maxLatency = 0;
+        double requestSeconds = 0;   // 各次请求延迟之和
+        size_t requests = 0;
+        bool direct = false;         // 是否绕过了页缓存（不支持 O_DIRECT 时退回普通读取并先丢弃缓存）
+        bool failed = false;
+    };
+
+    // 一个设备上一个 extent 数区间的汇总
+    struct Bucket {
+        size_t minExtents = 0;
+        size_t maxExtents = 0;       // 0 表示无上限
+        std::vector<size_t> samples; // samples_ 中的下标
+        uint64_t bytes = 0;
+        double seconds = 0;
+        double throughput = 0;       // 总字节数 / 总时间，MB/s
+        double medianThroughput = 0; // 各文件吞吐量的中位数，MB/s
+        double meanLatency = 0;      // 每次请求的平均延迟，毫秒
+        double firstLatency = 0;     // 第一次请求的平均延迟，毫秒
+        double maxLatency = 0;
+        double relative = 0;         // 相对该设备 extent 数最少的桶的吞吐量
+    };
+
+    struct Device {
+        unsigned long long id = 0;
+        std::string name;            // "主:次"
+        bool direct = true;          // 所有样本都使用了 O_DIRECT
+        std::vector<Bucket> buckets; // 只含有样本的桶，按 extent 数递增
+    };
+
+    // samplesPerBucket: 每个设备每个桶最多抽取的文件数；maxRead: 每个文件最多读取的字节数
+    ReadProbe(size_t samplesPerBucket, uint64_t maxRead);
+
+    // 添加一个文件条目（run 之前调用；只考虑不小于 1MB、extent 经过真实探测的非稀疏文件）
+    void add(const FileEntry& entry);
+
+    // 依次读取抽中的文件并汇总
+    void run();
+
+    const std::vector<Device>& devices() const { return devices_; }
+    const Sample& sample(size_t index) const { return samples_[index]; }
+    size_t sampleCount() const { return samples_.size(); }
+    size_t failedCount() const;
+    size_t simulatedFileCount() const { return simulatedFiles_; }
+
+    // 写出 JSON 报告
+    void writeReport(const std::string& path) const;
+
+    static std::string formatBucket(const Bucket& bucket);
+
+private:
+    // 水塘抽样：每个 (设备, 桶) 保留至多 samplesPerBucket_ 个候选
+    struct Reservoir {
+        uint64_t seen = 0;
+        std::vector<Sample> samples;
+    };
+
+    static size_t bucketOf(size_t extents);
+    bool measure(Sample& sample, char* buffer);
+
+    size_t samplesPerBucket_;
+    uint64_t maxRead_;
+    std::mt19937_64 random_;
+    std::map<std::pair<unsigned long long, size_t>, Reservoir> reservoirs_;
+    std::vector<Sample> samples_;
+    std::vector<Device> devices_;
+    size_t simulatedFiles_;   // 因 extent 为模拟结果而跳过的文件数
+};
+
+#endif // READ_PROBE_H
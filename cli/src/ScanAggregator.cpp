@@ -0,0 +1,315 @@
+#include "ScanAggregator.h"
+#include "SnapshotWriter.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+const size_t DEFAULT_TOP_K = 20;
+const size_t MAX_EXTENSION_LENGTH = 16;   // 更长的后缀通常不是扩展名，按无扩展名统计
+
+std::atomic<uint64_t> nextInstance{1};
+
+// 排名更靠前：key 更大，key 相同时路径字典序更小（保证多线程合并的结果确定）
+bool ranksBefore(const ScanAggregator::RankedFile& a, const ScanAggregator::RankedFile& b) {
+    return a.key != b.key ? a.key > b.key : a.path < b.path;
+}
+
+// 值的二进制位数：0 → 0，[2^(b-1), 2^b) → b
+int bitWidth(uint64_t value) {
+    int width = 0;
+    while (value != 0) {
+        value >>= 1;
+        width++;
+    }
+    return width;
+}
+
+// 第 b 桶的下界 2^(b-1)（第 0 桶为 0）；b 为 64 时上界溢出，取 UINT64_MAX
+uint64_t bucketMin(int bucket) {
+    return bucket == 0 ? 0 : uint64_t(1) << (bucket - 1);
+}
+uint64_t bucketMax(int bucket) {
+    return bucket >= 64 ? UINT64_MAX : uint64_t(1) << bucket;
+}
+
+std::string extensionOf(const std::string& name) {
+    size_t dot = name.rfind('.');
+    // 没有点、以点开头的隐藏文件（如 .bashrc）或以点结尾都视为无扩展名
+    if (dot == std::string::npos || dot == 0 || dot + 1 == name.size() ||
+        name.size() - dot - 1 > MAX_EXTENSION_LENGTH) {
+        return std::string();
+    }
+    std::string extension = name.substr(dot + 1);
+    for (char& c : extension) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return extension;
+}
+
+void appendRanked(std::string& out, int depth, const char* key,
+                  const std::vector<ScanAggregator::RankedFile>& files) {
+    SnapshotWriter::appendKey(out, depth, key);
+    if (files.empty()) {
+        out += "[]";
+        return;
+    }
+    out += "[\n";
+    for (size_t i = 0; i < files.size(); i++) {
+        SnapshotWriter::appendIndent(out, depth + 1);
+        out += "{\n";
+        SnapshotWriter::appendKey(out, depth + 2, "extents");
+        SnapshotWriter::appendUnsigned(out, files[i].extents);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 2, "path");
+        SnapshotWriter::appendString(out, files[i].path);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 2, "size");
+        SnapshotWriter::appendUnsigned(out, files[i].size);
+        out += '\n';
+        SnapshotWriter::appendIndent(out, depth + 1);
+        out += i + 1 < files.size() ? "},\n" : "}\n";
+    }
+    SnapshotWriter::appendIndent(out, depth);
+    out += ']';
+}
+
+// 只写出非空的桶；minKey/maxKey 为桶边界的键名（上界不含）
+void appendHistogram(std::string& out, int depth, const char* key, const ScanAggregator::Bucket* buckets,
+                     int count, const char* maxKey, const char* minKey) {
+    SnapshotWriter::appendKey(out, depth, key);
+    bool first = true;
+    for (int b = 0; b < count; b++) {
+        if (buckets[b].files == 0) {
+            continue;
+        }
+        out += first ? "[\n" : ",\n";
+        first = false;
+        SnapshotWriter::appendIndent(out, depth + 1);
+        out += "{\n";
+        SnapshotWriter::appendKey(out, depth + 2, "bytes");
+        SnapshotWriter::appendUnsigned(out, buckets[b].bytes);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 2, "files");
+        SnapshotWriter::appendUnsigned(out, buckets[b].files);
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 2, maxKey);
+        SnapshotWriter::appendUnsigned(out, bucketMax(b));
+        out += ",\n";
+        SnapshotWriter::appendKey(out, depth + 2, minKey);
+        SnapshotWriter::appendUnsigned(out, bucketMin(b));
+        out += '\n';
+        SnapshotWriter::appendIndent(out, depth + 1);
+        out += '}';
+    }
+    if (first) {
+        out += "[]";
+    } else {
+        out += '\n';
+        SnapshotWriter::appendIndent(out, depth);
+        out += ']';
+    }
+}
+
+void appendBucket(std::string& out, int depth, const char* key, const ScanAggregator::Bucket& bucket) {
+    SnapshotWriter::appendKey(out, depth, key);
+    out += "{\n";
+    SnapshotWriter::appendKey(out, depth + 1, "bytes");
+    SnapshotWriter::appendUnsigned(out, bucket.bytes);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, depth + 1, "files");
+    SnapshotWriter::appendUnsigned(out, bucket.files);
+    out += '\n';
+    SnapshotWriter::appendIndent(out, depth);
+    out += '}';
+}
+
+} // namespace
+
+struct ScanAggregator::Shard {
+    std::vector<RankedFile> largest;      // 按 ranksBefore 组织的堆，堆顶是排名最后的文件
+    std::vector<RankedFile> fragmented;
+    Bucket sizes[SIZE_BUCKETS];
+    Bucket ages[AGE_BUCKETS];
+    std::unordered_map<std::string, Bucket> extensions;
+    Bucket otherExtensions;
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+};
+
+ScanAggregator::ScanAggregator(size_t topK)
+    : topK_(topK == 0 ? DEFAULT_TOP_K : topK)
+    , referenceTime_(std::time(nullptr))
+    , instance_(nextInstance.fetch_add(1)) {
+}
+
+ScanAggregator::~ScanAggregator() = default;
+
+ScanAggregator::Shard& ScanAggregator::localShard() {
+    thread_local uint64_t cachedInstance = 0;
+    thread_local Shard* cachedShard = nullptr;
+    if (cachedInstance != instance_) {
+        std::lock_guard<std::mutex> lock(shardsMutex_);
+        shards_.push_back(std::make_unique<Shard>());
+        cachedShard = shards_.back().get();
+        cachedInstance = instance_;
+    }
+    return *cachedShard;
+}
+
+void ScanAggregator::offer(std::vector<RankedFile>& heap, size_t limit, uint64_t key, uint64_t size,
+                           uint64_t extents, const std::string& path) {
+    // 先只比较 key，堆已满且明显排不进前 K 时不复制路径
+    if (heap.size() >= limit) {
+        const RankedFile& last = heap.front();
+        if (key < last.key || (key == last.key && !(path < last.path))) {
+            return;
+        }
+        std::pop_heap(heap.begin(), heap.end(), ranksBefore);
+        heap.back() = RankedFile{key, size, extents, path};
+    } else {
+        heap.push_back(RankedFile{key, size, extents, path});
+    }
+    std::push_heap(heap.begin(), heap.end(), ranksBefore);
+}
+
+void ScanAggregator::addFile(const std::string& path, const std::string& name, uint64_t size,
+                             uint64_t extents, std::time_t mtime) {
+    Shard& shard = localShard();
+    shard.files++;
+    shard.bytes += size;
+
+    offer(shard.largest, topK_, size, size, extents, path);
+    if (extents > 1) {
+        offer(shard.fragmented, topK_, extents, size, extents, path);
+    }
+
+    Bucket& sizeBucket = shard.sizes[bitWidth(size)];
+    sizeBucket.files++;
+    sizeBucket.bytes += size;
+
+    uint64_t days = mtime < referenceTime_ ? static_cast<uint64_t>(referenceTime_ - mtime) / 86400 : 0;
+    Bucket& ageBucket = shard.ages[std::min(bitWidth(days), AGE_BUCKETS - 1)];
+    ageBucket.files++;
+    ageBucket.bytes += size;
+
+    std::string extension = extensionOf(name);
+    auto it = shard.extensions.find(extension);
+    if (it == shard.extensions.end() && shard.extensions.size() < MAX_EXTENSIONS) {
+        it = shard.extensions.emplace(std::move(extension), Bucket()).first;
+    }
+    Bucket& extensionBucket = it != shard.extensions.end() ? it->second : shard.otherExtensions;
+    extensionBucket.files++;
+    extensionBucket.bytes += size;
+}
+
+void ScanAggregator::writeJSON(const std::string& path, CompressionType compression,
+                               const std::string& fileSystemType, size_t blockSize,
+                               uint64_t directories) const {
+    // 合并各线程的分片：堆直接拼接后排序截取前 K 个，计数逐项相加
+    Shard total;
+    std::vector<RankedFile> largest;
+    std::vector<RankedFile> fragmented;
+    {
+        std::lock_guard<std::mutex> lock(shardsMutex_);
+        for (const auto& shard : shards_) {
+            largest.insert(largest.end(), shard->largest.begin(), shard->largest.end());
+            fragmented.insert(fragmented.end(), shard->fragmented.begin(), shard->fragmented.end());
+            for (int b = 0; b < SIZE_BUCKETS; b++) {
+                total.sizes[b].files += shard->sizes[b].files;
+                total.sizes[b].bytes += shard->sizes[b].bytes;
+            }
+            for (int b = 0; b < AGE_BUCKETS; b++) {
+                total.ages[b].files += shard->ages[b].files;
+                total.ages[b].bytes += shard->ages[b].bytes;
+            }
+            for (const auto& item : shard->extensions) {
+                Bucket& bucket = total.extensions[item.first];
+                bucket.files += item.second.files;
+                bucket.bytes += item.second.bytes;
+            }
+            total.otherExtensions.files += shard->otherExtensions.files;
+            total.otherExtensions.bytes += shard->otherExtensions.bytes;
+            total.files += shard->files;
+            total.bytes += shard->bytes;
+        }
+    }
+    for (auto* ranked : {&largest, &fragmented}) {
+        std::sort(ranked->begin(), ranked->end(), ranksBefore);
+        if (ranked->size() > topK_) {
+            ranked->resize(topK_);
+        }
+    }
+    // 扩展名按字节数降序，相同时按名称
+    std::vector<std::pair<std::string, Bucket>> extensions(total.extensions.begin(), total.extensions.end());
+    std::sort(extensions.begin(), extensions.end(), [](const auto& a, const auto& b) {
+        return a.second.bytes != b.second.bytes ? a.second.bytes > b.second.bytes : a.first < b.first;
+    });
+
+    std::ostringstream referenceTime;
+    referenceTime << std::put_time(std::gmtime(&referenceTime_), "%Y-%m-%dT%H:%M:%S.000Z");
+
+    SnapshotWriter writer(path, compression);
+    std::string& out = writer.buffer();
+    out += "{\n";
+    appendHistogram(out, 1, "ageHistogram", total.ages, AGE_BUCKETS, "maxDays", "minDays");
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "blockSize");
+    SnapshotWriter::appendUnsigned(out, blockSize);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "directories");
+    SnapshotWriter::appendUnsigned(out, directories);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "extensions");
+    if (extensions.empty()) {
+        out += "[]";
+    } else {
+        out += "[\n";
+        for (size_t i = 0; i < extensions.size(); i++) {
+            SnapshotWriter::appendIndent(out, 2);
+            out += "{\n";
+            SnapshotWriter::appendKey(out, 3, "bytes");
+            SnapshotWriter::appendUnsigned(out, extensions[i].second.bytes);
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 3, "extension");
+            SnapshotWriter::appendString(out, extensions[i].first);
+            out += ",\n";
+            SnapshotWriter::appendKey(out, 3, "files");
+            SnapshotWriter::appendUnsigned(out, extensions[i].second.files);
+            out += '\n';
+            SnapshotWriter::appendIndent(out, 2);
+            out += i + 1 < extensions.size() ? "},\n" : "}\n";
+            writer.flushIfNeeded();
+        }
+        SnapshotWriter::appendIndent(out, 1);
+        out += ']';
+    }
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "fileSystemType");
+    SnapshotWriter::appendString(out, fileSystemType);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "files");
+    SnapshotWriter::appendUnsigned(out, total.files);
+    out += ",\n";
+    appendRanked(out, 1, "largestFiles", largest);
+    out += ",\n";
+    appendRanked(out, 1, "mostFragmented", fragmented);
+    out += ",\n";
+    appendBucket(out, 1, "otherExtensions", total.otherExtensions);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "referenceTime");
+    SnapshotWriter::appendString(out, referenceTime.str());
+    out += ",\n";
+    appendHistogram(out, 1, "sizeHistogram", total.sizes, SIZE_BUCKETS, "maxSize", "minSize");
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "topK");
+    SnapshotWriter::appendUnsigned(out, topK_);
+    out += ",\n";
+    SnapshotWriter::appendKey(out, 1, "totalSize");
+    SnapshotWriter::appendUnsigned(out, total.bytes);
+    out += "\n}";
+    writer.close();
+}
@@ -0,0 +1,69 @@
+#ifndef SCAN_AGGREGATOR_H
+#define SCAN_AGGREGATOR_H
+
+#include "OutputCompressor.h"
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 扫描过程中在线计算的汇总统计：最大的 K 个文件、extent 最多的 K 个文件、
+// 按 2 的幂分桶的大小/修改时间直方图，以及按扩展名的文件数和字节数。
+// 每个扫描线程第一次调用时分配自己的分片，之后的累加都只写本线程的分片，不加锁；
+// 写出时才把所有分片合并。内存占用只与 K、桶数和不同扩展名的个数有关，与文件数无关。
+class ScanAggregator {
+public:
+    struct RankedFile {
+        uint64_t key;        // 排序依据（大小或 extent 数）
+        uint64_t size;
+        uint64_t extents;
+        std::string path;
+    };
+
+    struct Bucket {
+        uint64_t files = 0;
+        uint64_t bytes = 0;
+    };
+
+    // 每个分片最多记录的不同扩展名数，超出部分计入 otherExtensions
+    static const size_t MAX_EXTENSIONS = 4096;
+    // 大小直方图：第 0 桶为空文件，第 b 桶为 [2^(b-1), 2^b)
+    static const int SIZE_BUCKETS = 65;
+    // 修改时间直方图：第 0 桶为不足 1 天（含时间在未来的文件），第 b 桶为 [2^(b-1), 2^b) 天
+    static const int AGE_BUCKETS = 24;
+
+    // topK 为 0 时使用默认值 20；参考时间（计算文件年龄）为构造时刻
+    explicit ScanAggregator(size_t topK = 0);
+    ~ScanAggregator();
+
+    ScanAggregator(const ScanAggregator&) = delete;
+    ScanAggregator& operator=(const ScanAggregator&) = delete;
+
+    // 累加一个文件（线程安全）；name 用于提取扩展名，mtime 为修改时间
+    void addFile(const std::string& path, const std::string& name, uint64_t size,
+                 uint64_t extents, std::time_t mtime);
+
+    size_t topK() const { return topK_; }
+
+    // 合并所有分片，以 nlohmann::json::dump(2) 的格式写出汇总报告
+    void writeJSON(const std::string& path, CompressionType compression, const std::string& fileSystemType,
+                   size_t blockSize, uint64_t directories) const;
+
+private:
+    struct Shard;
+
+    Shard& localShard();
+    static void offer(std::vector<RankedFile>& heap, size_t limit, uint64_t key, uint64_t size,
+                      uint64_t extents, const std::string& path);
+
+    size_t topK_;
+    std::time_t referenceTime_;
+    uint64_t instance_;                          // 区分线程缓存属于哪个聚合器
+    mutable std::mutex shardsMutex_;             // 只在登记新分片和合并时使用
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+#endif // SCAN_AGGREGATOR_H
@@ -0,0 +1,289 @@
+#include "ScanCheckpoint.h"
+#include "EntryStore.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = {'F', 'C', 'O', 'N', 'C', 'K', 'P', '4'};
+const size_t WRITE_THRESHOLD = 16 << 20;   // 未写出的单元超过 16MB 时不等时间间隔直接写出
+
+void putU64(std::string& out, uint64_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putU32(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(std::string& out, const std::string& value) {
+    putU32(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+bool getU64(std::istream& in, uint64_t& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool getU32(std::istream& in, uint32_t& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool getString(std::istream& in, std::string& value) {
+    uint32_t length = 0;
+    if (!getU32(in, length)) {
+        return false;
+    }
+    value.resize(length);
+    return length == 0 || static_cast<bool>(in.read(&value[0], length));
+}
+
+// FNV-1a，用于识别进程被杀时写了一半的单元
+uint32_t checksum(const std::string& data) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+bool decodeUnit(const std::string& payload, ScanCheckpoint::Unit& unit) {
+    std::istringstream in(payload);
+    uint32_t depth = 0;
+    uint32_t count = 0;
+    if (!getString(in, unit.completed) || !getU32(in, depth) || !getU64(in, unit.nextFileId) ||
+        !getU64(in, unit.nextDirectoryId) || !getU64(in, unit.filtered) || !getU32(in, count)) {
+        return false;
+    }
+    unit.depth = static_cast<int>(depth);
+    unit.entries.resize(count);
+    for (auto& entry : unit.entries) {
+        if (!EntryStore::deserialize(in, entry)) {
+            return false;
+        }
+    }
+    if (!getU32(in, count)) {
+        return false;
+    }
+    unit.directories.resize(count);
+    for (auto& directory : unit.directories) {
+        if (!getString(in, directory.path) || !getString(in, directory.id) || !getU32(in, depth)) {
+            return false;
+        }
+        directory.depth = static_cast<int>(depth);
+    }
+    return true;
+}
+
+} // namespace
+
+ScanCheckpoint::ScanCheckpoint(const std::string& path, const std::string& signature, double intervalSeconds)
+    : path_(path)
+    , interval_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(intervalSeconds)))
+    , fd_(-1)
+    , replayedUnits_(0)
+    , lastWrite_(std::chrono::steady_clock::now())
+{
+    open(true);
+    std::string header(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    putString(header, signature);
+    pending_ = std::move(header);
+    writeOut(true);
+}
+
+ScanCheckpoint::ScanCheckpoint(const std::string& path, const std::string& signature, double intervalSeconds,
+                               const std::function<void(Unit&)>& replay)
+    : path_(path)
+    , interval_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(intervalSeconds)))
+    , fd_(-1)
+    , replayedUnits_(0)
+    , lastWrite_(std::chrono::steady_clock::now())
+{
+    std::ifstream in(path_, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("无法打开检查点: " + path_);
+    }
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    std::string saved;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+        !getString(in, saved)) {
+        throw std::runtime_error("不是有效的检查点文件: " + path_);
+    }
+    if (saved != signature) {
+        throw std::runtime_error("检查点的扫描参数与当前命令行不一致（检查点: " + saved + "）");
+    }
+
+    // 逐个读取完整的单元；长度或校验和不对说明写入时进程被终止，从该处截断
+    uint64_t validEnd = static_cast<uint64_t>(in.tellg());
+    std::string payload;
+    for (;;) {
+        uint32_t length = 0;
+        uint32_t sum = 0;
+        if (!getU32(in, length) || !getU32(in, sum)) {
+            break;
+        }
+        payload.resize(length);
+        if (length > 0 && !in.read(&payload[0], length)) {
+            break;
+        }
+        Unit unit;
+        if (checksum(payload) != sum || !decodeUnit(payload, unit)) {
+            break;
+        }
+        replay(unit);
+        replayedUnits_++;
+        validEnd += sizeof(length) + sizeof(sum) + length;
+    }
+    in.close();
+
+    std::error_code ec;
+    if (std::filesystem::file_size(path_, ec) != validEnd) {
+        std::filesystem::resize_file(path_, validEnd, ec);
+        if (ec) {
+            throw std::runtime_error("无法截断检查点 " + path_ + ": " + ec.message());
+        }
+    }
+    open(false);
+}
+
+ScanCheckpoint::~ScanCheckpoint() {
+    try {
+        if (fd_ >= 0) {
+            writeOut(true);
+        }
+    } catch (const std::exception&) {
+        // 析构中忽略写出错误
+    }
+#ifdef _WIN32
+    if (fd_ >= 0) {
+        _close(fd_);
+    }
+#else
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#endif
+}
+
+void ScanCheckpoint::open(bool truncate) {
+#ifdef _WIN32
+    int flags = _O_WRONLY | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : _O_APPEND);
+    fd_ = _open(path_.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : O_APPEND);
+    fd_ = ::open(path_.c_str(), flags, 0644);
+#endif
+    if (fd_ < 0) {
+        throw std::runtime_error("无法打开检查点 " + path_ + ": " + std::strerror(errno));
+    }
+}
+
+void ScanCheckpoint::encodeEntry(std::string& out, const FileEntry& entry) {
+    EntryStore::serialize(out, entry);
+}
+
+void ScanCheckpoint::commit(const std::string& completed, int depth, uint64_t nextFileId,
+                            uint64_t nextDirectoryId, uint64_t filtered, uint32_t entryCount,
+                            const std::string& encodedEntries, const std::vector<Directory>& directories) {
+    // 单元在锁外编码，锁内只做一次追加
+    std::string payload;
+    payload.reserve(encodedEntries.size() + 64 + directories.size() * 64);
+    putString(payload, completed);
+    putU32(payload, static_cast<uint32_t>(depth));
+    putU64(payload, nextFileId);
+    putU64(payload, nextDirectoryId);
+    putU64(payload, filtered);
+    putU32(payload, entryCount);
+    payload += encodedEntries;
+    putU32(payload, static_cast<uint32_t>(directories.size()));
+    for (const auto& directory : directories) {
+        putString(payload, directory.path);
+        putString(payload, directory.id);
+        putU32(payload, static_cast<uint32_t>(directory.depth));
+    }
+    std::string frame;
+    putU32(frame, static_cast<uint32_t>(payload.size()));
+    putU32(frame, checksum(payload));
+
+    bool due = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ += frame;
+        pending_ += payload;
+        due = pending_.size() >= WRITE_THRESHOLD || std::chrono::steady_clock::now() - lastWrite_ >= interval_;
+    }
+    // 已有线程在写出时直接返回，本次提交留到下一次写出
+    if (due) {
+        std::unique_lock<std::mutex> writeLock(writeMutex_, std::try_to_lock);
+        if (writeLock.owns_lock()) {
+            writeOut(true);
+        }
+    }
+}
+
+void ScanCheckpoint::flush() {
+    std::lock_guard<std::mutex> writeLock(writeMutex_);
+    writeOut(true);
+}
+
+// 调用者持有 writeMutex_（构造和析构时除外）
+void ScanCheckpoint::writeOut(bool sync) {
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        data.swap(pending_);
+        lastWrite_ = std::chrono::steady_clock::now();
+    }
+    const char* cursor = data.data();
+    size_t remaining = data.size();
+    while (remaining > 0) {
+#ifdef _WIN32
+        int written = _write(fd_, cursor, static_cast<unsigned>(remaining));
+#else
+        ssize_t written = ::write(fd_, cursor, remaining);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("写入检查点失败: " + path_ + ": " + std::strerror(errno));
+        }
+        cursor += written;
+        remaining -= static_cast<size_t>(written);
+    }
+    if (sync && !data.empty()) {
+#ifdef _WIN32
+        _commit(fd_);
+#else
+        ::fdatasync(fd_);
+#endif
+    }
+}
+
+void ScanCheckpoint::remove() {
+    std::lock_guard<std::mutex> writeLock(writeMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.clear();
+    }
+#ifdef _WIN32
+    _close(fd_);
+#else
+    ::close(fd_);
+#endif
+    fd_ = -1;
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+}
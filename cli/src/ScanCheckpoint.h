@@ -0,0 +1,82 @@
+#ifndef SCAN_CHECKPOINT_H
+#define SCAN_CHECKPOINT_H
+
+#include "FileEntry.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 长时间扫描的检查点：只追加的日志文件。
+// 每处理完一个目录提交一个单元：该目录列出的所有条目、新发现的子目录以及提交时的 ID 计数器。
+// 子目录要等父目录的单元提交后才进入工作队列，因此日志中子目录的单元总在父目录之后。
+// 提交只是在内存缓冲区末尾追加（短暂加锁），缓冲区按时间间隔由提交线程交换出来写入文件，
+// 其他线程继续提交，不需要全局暂停。进程被杀时末尾不完整的单元在恢复时被丢弃，
+// 对应的目录重新扫描。
+class ScanCheckpoint {
+public:
+    // 待处理的目录（工作队列中的一项）
+    struct Directory {
+        std::string path;
+        std::string id;
+        int depth;
+    };
+
+    // 一个提交单元
+    struct Unit {
+        std::string completed;              // 已处理完的目录 ID；只含根目录条目的单元为空
+        int depth = 0;                      // entries 中条目的深度
+        uint64_t nextFileId = 0;            // 提交时的 ID 计数器
+        uint64_t nextDirectoryId = 0;
+        uint64_t filtered = 0;              // 列出该目录时被过滤的条目数
+        std::vector<FileEntry> entries;
+        std::vector<Directory> directories; // 新发现的子目录
+    };
+
+    // 创建新的检查点（覆盖已有文件）；signature 描述扫描参数，恢复时必须一致
+    ScanCheckpoint(const std::string& path, const std::string& signature, double intervalSeconds);
+
+    // 打开已有检查点并按提交顺序回放所有完整的单元，之后的提交追加在最后一个完整单元之后
+    ScanCheckpoint(const std::string& path, const std::string& signature, double intervalSeconds,
+                   const std::function<void(Unit&)>& replay);
+
+    ~ScanCheckpoint();
+
+    ScanCheckpoint(const ScanCheckpoint&) = delete;
+    ScanCheckpoint& operator=(const ScanCheckpoint&) = delete;
+
+    // 扫描线程把条目逐个编码到自己的缓冲区，列完目录后整体提交
+    static void encodeEntry(std::string& out, const FileEntry& entry);
+
+    // 提交一个单元（线程安全）；距上次写出超过时间间隔时由当前线程写出
+    void commit(const std::string& completed, int depth, uint64_t nextFileId, uint64_t nextDirectoryId,
+                uint64_t filtered, uint32_t entryCount, const std::string& encodedEntries,
+                const std::vector<Directory>& directories);
+
+    // 写出所有已提交的单元并同步到磁盘
+    void flush();
+
+    // 扫描成功完成后删除检查点文件
+    void remove();
+
+    uint64_t replayedUnits() const { return replayedUnits_; }
+    const std::string& path() const { return path_; }
+
+private:
+    void open(bool truncate);
+    void writeOut(bool sync);
+
+    std::string path_;
+    std::chrono::steady_clock::duration interval_;
+    int fd_;
+    uint64_t replayedUnits_;
+
+    std::mutex mutex_;               // 保护 pending_ 和 lastWrite_
+    std::mutex writeMutex_;          // 同一时间只有一个线程写文件，保证单元按提交顺序落盘
+    std::string pending_;
+    std::chrono::steady_clock::time_point lastWrite_;
+};
+
+#endif // SCAN_CHECKPOINT_H
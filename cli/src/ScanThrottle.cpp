@@ -0,0 +1,153 @@
+#include "ScanThrottle.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* PRESSURE_PATH = "/proc/pressure/io";
+const int64_t PRESSURE_INTERVAL_NS = 250000000;   // 压力读数的刷新间隔
+const auto PRESSURE_SLEEP = std::chrono::milliseconds(250);
+
+#ifndef _WIN32
+// <linux/ioprio.h> 并不总是随内核头文件安装，按 ABI 定义
+const int IOPRIO_CLASS_IDLE = 3;
+const int IOPRIO_CLASS_SHIFT = 13;
+const int IOPRIO_WHO_PROCESS = 1;
+#endif
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+ScanThrottle::TokenBucket::TokenBucket(double rate)
+    : rate_(rate)
+    , burst_(std::max(1.0, rate / 10))   // 最多攒下 100ms 的令牌，避免空闲后突发
+    , tokens_(burst_)
+    , last_(std::chrono::steady_clock::now()) {
+}
+
+std::chrono::nanoseconds ScanThrottle::TokenBucket::reserve() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    tokens_ = std::min(burst_, tokens_ + std::chrono::duration<double>(now - last_).count() * rate_);
+    last_ = now;
+    tokens_ -= 1;
+    if (tokens_ >= 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(-tokens_ / rate_));
+}
+
+ScanThrottle::ScanThrottle(double opsPerSecond, double probesPerSecond, double pressureLimit)
+    : metadata_(opsPerSecond)
+    , probes_(probesPerSecond)
+    , pressureLimit_(pressureLimit)
+    , nextPressureCheck_(0)
+    , pressure_(0)
+    , throttledNs_(0)
+    , pressureNs_(0) {
+}
+
+std::string ScanThrottle::enterBackgroundMode() {
+    std::ostringstream applied;
+#ifdef _WIN32
+    // 后台处理模式同时降低 CPU、I/O 和内存页优先级
+    if (SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN)) {
+        applied << "后台处理模式";
+    }
+#else
+    // which 为 0 表示调用线程；此时还没有创建工作线程，之后的线程都会继承
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == 0) {
+        applied << "I/O 类 idle";
+    }
+    struct sched_param param{};
+    param.sched_priority = 0;
+    if (sched_setscheduler(0, SCHED_IDLE, &param) == 0) {
+        applied << (applied.tellp() > 0 ? ", " : "") << "SCHED_IDLE";
+    } else if (setpriority(PRIO_PROCESS, 0, 19) == 0) {
+        applied << (applied.tellp() > 0 ? ", " : "") << "nice 19";
+    }
+#endif
+    return applied.str();
+}
+
+bool ScanThrottle::pressureAvailable() {
+    std::ifstream in(PRESSURE_PATH);
+    std::string word;
+    return static_cast<bool>(in >> word) && word == "some";
+}
+
+void ScanThrottle::beforeMetadata() {
+    waitForPressure();
+    acquire(metadata_);
+}
+
+void ScanThrottle::beforeProbe() {
+    waitForPressure();
+    acquire(probes_);
+}
+
+void ScanThrottle::acquire(TokenBucket& bucket) {
+    if (!bucket.enabled()) {
+        return;
+    }
+    std::chrono::nanoseconds wait = bucket.reserve();
+    if (wait.count() > 0) {
+        std::this_thread::sleep_for(wait);
+        throttledNs_ += static_cast<uint64_t>(wait.count());
+    }
+}
+
+void ScanThrottle::waitForPressure() {
+    if (pressureLimit_ <= 0) {
+        return;
+    }
+    while (readPressure() > pressureLimit_) {
+        std::this_thread::sleep_for(PRESSURE_SLEEP);
+        pressureNs_ += static_cast<uint64_t>(std::chrono::nanoseconds(PRESSURE_SLEEP).count());
+    }
+}
+
+double ScanThrottle::readPressure() {
+    // 到期后只有抢到更新权的线程读取文件，其余线程使用上一次的读数
+    int64_t now = nowNs();
+    int64_t due = nextPressureCheck_.load(std::memory_order_relaxed);
+    if (now < due || !nextPressureCheck_.compare_exchange_strong(due, now + PRESSURE_INTERVAL_NS)) {
+        return pressure_.load(std::memory_order_relaxed);
+    }
+    // 格式: some avg10=1.23 avg60=... avg300=... total=...
+    std::ifstream in(PRESSURE_PATH);
+    std::string kind;
+    std::string field;
+    double value = 0;
+    if (in >> kind >> field && kind == "some" && field.compare(0, 6, "avg10=") == 0) {
+        try {
+            value = std::stod(field.substr(6));
+        } catch (const std::exception&) {
+            value = 0;
+        }
+    }
+    pressure_.store(value, std::memory_order_relaxed);
+    return value;
+}
+
+double ScanThrottle::throttledSeconds() const {
+    return static_cast<double>(throttledNs_.load()) / 1e9;
+}
+
+double ScanThrottle::pressureSeconds() const {
+    return static_cast<double>(pressureNs_.load()) / 1e9;
+}
@@ -0,0 +1,67 @@
+#ifndef SCAN_THROTTLE_H
+#define SCAN_THROTTLE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// 后台扫描的限速：对元数据操作（stat）和 extent 探测（FIEMAP）分别做令牌桶限速，
+// 并在系统 I/O 压力（/proc/pressure/io 的 some avg10）超过阈值时让扫描线程暂停，
+// 直到压力回落。所有扫描线程（多根扫描时所有设备）共享同一个实例。
+class ScanThrottle {
+public:
+    // 速率为 0 表示不限速；pressureLimit 为 PSI 百分比阈值，0 表示不根据压力退避
+    ScanThrottle(double opsPerSecond, double probesPerSecond, double pressureLimit);
+
+    // 降低整个进程的优先级：I/O 调度类设为 idle（ioprio_set），CPU 调度策略设为 SCHED_IDLE，
+    // 不允许时退回 nice 19；之后创建的线程继承这些设置。Windows 上使用后台处理模式。
+    // 返回实际生效的设置说明，全部失败时返回空字符串
+    static std::string enterBackgroundMode();
+
+    // 当前系统是否提供 PSI（/proc/pressure/io）
+    static bool pressureAvailable();
+
+    // 每次元数据操作 / extent 探测之前调用，按需阻塞当前线程
+    void beforeMetadata();
+    void beforeProbe();
+
+    // 因限速和 I/O 压力累计等待的时间（所有线程之和）
+    double throttledSeconds() const;
+    double pressureSeconds() const;
+
+private:
+    // 令牌桶：令牌不足时预支并睡到令牌补齐的时刻，多线程按到达顺序均匀排开
+    class TokenBucket {
+    public:
+        explicit TokenBucket(double rate);
+        // 返回需要等待的时长（已预支令牌）
+        std::chrono::nanoseconds reserve();
+        bool enabled() const { return rate_ > 0; }
+
+    private:
+        double rate_;
+        double burst_;
+        double tokens_;
+        std::chrono::steady_clock::time_point last_;
+        std::mutex mutex_;
+    };
+
+    void acquire(TokenBucket& bucket);
+    void waitForPressure();
+    double readPressure();
+
+    TokenBucket metadata_;
+    TokenBucket probes_;
+    double pressureLimit_;
+
+    // 压力读数最多每 250ms 由一个线程刷新一次
+    std::atomic<int64_t> nextPressureCheck_;
+    std::atomic<double> pressure_;
+
+    std::atomic<uint64_t> throttledNs_;
+    std::atomic<uint64_t> pressureNs_;
+};
+
+#endif // SCAN_THROTTLE_H
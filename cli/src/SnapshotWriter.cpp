@@ -0,0 +1,566 @@
+#include "SnapshotWriter.h"
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+namespace {
+
+const size_t FLUSH_THRESHOLD = 1 << 20;  // 缓冲区超过 1MB 时写出
+
+// 判断字符串是否可以原样输出（可打印 ASCII 且不含需要转义的字符）
+bool isPlainAscii(const std::string& value) {
+    for (unsigned char c : value) {
+        if (c < 0x20 || c >= 0x7F || c == '"' || c == '\\') {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+SnapshotWriter::SnapshotWriter(const std::string& path, CompressionType compression)
+#ifdef _WIN32
+    : out_(path == "-" ? std::string() : path, std::ios::binary | std::ios::trunc)   // 不支持标准输出
+    , path_(path)
+#else
+    : fd_(path == "-" ? ::fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0)
+                      : ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+    , path_(path)
+#endif
+{
+#ifdef _WIN32
+    if (!out_.is_open()) {
+#else
+    if (fd_ < 0) {
+#endif
+        throw std::runtime_error("无法打开输出文件: " + path);
+    }
+    buffer_.reserve(FLUSH_THRESHOLD * 2);
+    if (compression != CompressionType::None) {
+        compressor_.reset(new OutputCompressor(compression, 0, [this](const char* data, size_t size) {
+            writeRaw(data, size);
+        }));
+    }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // 析构中忽略写出错误，正常路径应显式调用 close()
+    }
+}
+
+void SnapshotWriter::flushIfNeeded() {
+    if (buffer_.size() >= FLUSH_THRESHOLD) {
+        flush();
+    }
+}
+
+void SnapshotWriter::flush() {
+    if (!buffer_.empty()) {
+        writeBuffers({&buffer_});
+        buffer_.clear();
+    }
+}
+
+void SnapshotWriter::writeBuffers(const std::vector<const std::string*>& buffers) {
+    if (compressor_) {
+        for (const std::string* data : buffers) {
+            compressor_->push(*data);
+        }
+        return;
+    }
+    writeRaw(buffers);
+}
+
+void SnapshotWriter::writeBuffers(std::vector<std::string>& buffers) {
+    if (compressor_) {
+        for (auto& data : buffers) {
+            compressor_->push(std::move(data));
+        }
+        return;
+    }
+    std::vector<const std::string*> pointers;
+    pointers.reserve(buffers.size());
+    for (const auto& data : buffers) {
+        pointers.push_back(&data);
+    }
+    writeRaw(pointers);
+}
+
+void SnapshotWriter::writeRaw(const char* data, size_t size) {
+#ifdef _WIN32
+    out_.write(data, static_cast<std::streamsize>(size));
+    if (!out_) {
+        throw std::runtime_error("写入输出文件失败: " + path_);
+    }
+#else
+    while (size > 0) {
+        ssize_t written = ::write(fd_, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("写入输出文件失败: " + path_ + ": " + std::strerror(errno));
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+#endif
+}
+
+void SnapshotWriter::writeRaw(const std::vector<const std::string*>& buffers) {
+#ifdef _WIN32
+    for (const std::string* data : buffers) {
+        out_.write(data->data(), static_cast<std::streamsize>(data->size()));
+    }
+    if (!out_) {
+        throw std::runtime_error("写入输出文件失败: " + path_);
+    }
+#else
+    // 大块顺序写：一次 writev 提交多个缓冲区，处理部分写入
+    std::vector<struct iovec> iov;
+    iov.reserve(buffers.size());
+    for (const std::string* data : buffers) {
+        if (!data->empty()) {
+            iov.push_back({const_cast<char*>(data->data()), data->size()});
+        }
+    }
+    size_t index = 0;
+    while (index < iov.size()) {
+        int count = static_cast<int>(std::min<size_t>(iov.size() - index, IOV_MAX));
+        ssize_t written = ::writev(fd_, &iov[index], count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("写入输出文件失败: " + path_ + ": " + std::strerror(errno));
+        }
+        size_t remaining = static_cast<size_t>(written);
+        while (index < iov.size() && remaining >= iov[index].iov_len) {
+            remaining -= iov[index].iov_len;
+            index++;
+        }
+        if (remaining > 0) {
+            iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + remaining;
+            iov[index].iov_len -= remaining;
+        }
+    }
+#endif
+}
+
+void SnapshotWriter::close() {
+#ifdef _WIN32
+    if (out_.is_open()) {
+        flush();
+        if (compressor_) {
+            compressor_->finish();
+            compressor_.reset();
+        }
+        out_.close();
+    }
+#else
+    if (fd_ >= 0) {
+        flush();
+        if (compressor_) {
+            compressor_->finish();
+            compressor_.reset();
+        }
+        int fd = fd_;
+        fd_ = -1;
+        if (::close(fd) != 0) {
+            throw std::runtime_error("关闭输出文件失败: " + path_);
+        }
+    }
+#endif
+}
+
+void SnapshotWriter::appendIndent(std::string& out, int depth) {
+    out.append(static_cast<size_t>(depth) * 2, ' ');
+}
+
+void SnapshotWriter::appendKey(std::string& out, int depth, const char* key) {
+    appendIndent(out, depth);
+    out += '"';
+    out += key;
+    out += "\": ";
+}
+
+void SnapshotWriter::appendString(std::string& out, const std::string& value) {
+    if (isPlainAscii(value)) {
+        out += '"';
+        out += value;
+        out += '"';
+    } else {
+        // 含转义字符或非 ASCII 字符时交给 nlohmann 处理，保证转义规则和 UTF-8 校验一致
+        out += nlohmann::json(value).dump();
+    }
+}
+
+void SnapshotWriter::appendNumber(std::string& out, long long value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+void SnapshotWriter::appendUnsigned(std::string& out, unsigned long long value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+void SnapshotWriter::appendDouble(std::string& out, double value) {
+    // 浮点数格式（最短表示、".0" 后缀）与 nlohmann 保持一致
+    out += nlohmann::json(value).dump();
+}
+
+void SnapshotWriter::encodeEntry(std::string& out, const FileEntry& entry, int depth,
+                                 const SubtreeRollup* rollup) {
+    const int inner = depth + 1;
+    out += "{\n";
+
+    // 只有稀疏文件输出实际占用，普通文件的占用就是 size 按块向上取整
+    if (entry.sparse) {
+        appendKey(out, inner, "allocatedSize");
+        appendUnsigned(out, entry.allocatedSize);
+        out += ",\n";
+    }
+
+    appendKey(out, inner, "allocationAlgorithm");
+    if (entry.type == EntryKind::File && entry.allocationAlgorithm != AllocationAlgorithm::None) {
+        appendString(out, allocationAlgorithmName(entry.allocationAlgorithm));
+    } else {
+        out += "null";
+    }
+    out += ",\n";
+
+    appendKey(out, inner, "blocks");
+    if (entry.blocks.empty()) {
+        out += "[]";
+    } else {
+        out += "[\n";
+        for (size_t i = 0; i < entry.blocks.size(); i++) {
+            if (i > 0) {
+                out += ",\n";
+            }
+            appendIndent(out, inner + 1);
+            appendNumber(out, entry.blocks[i]);
+        }
+        out += '\n';
+        appendIndent(out, inner);
+        out += ']';
+    }
+    out += ",\n";
+
+    appendKey(out, inner, "createTime");
+    appendString(out, entry.createTime);
+    out += ",\n";
+
+    appendKey(out, inner, "deviceId");
+    appendUnsigned(out, entry.deviceId);
+    out += ",\n";
+
+    appendKey(out, inner, "extents");
+    if (entry.extents.empty()) {
+        out += "[]";
+    } else {
+        out += "[\n";
+        for (size_t i = 0; i < entry.extents.size(); i++) {
+            const ExtentInfo& extent = entry.extents[i];
+            if (i > 0) {
+                out += ",\n";
+            }
+            appendIndent(out, inner + 1);
+            out += "{\n";
+            appendKey(out, inner + 2, "length");
+            appendUnsigned(out, extent.length);
+            out += ",\n";
+            appendKey(out, inner + 2, "logicalOffset");
+            appendUnsigned(out, extent.logicalOffset);
+            out += ",\n";
+            appendKey(out, inner + 2, "physicalOffset");
+            appendUnsigned(out, extent.physicalOffset);
+            if (extent.shared) {
+                out += ",\n";
+                appendKey(out, inner + 2, "shared");
+                out += "true";
+            }
+            out += '\n';
+            appendIndent(out, inner + 1);
+            out += '}';
+        }
+        out += '\n';
+        appendIndent(out, inner);
+        out += ']';
+    }
+    out += ",\n";
+
+    appendKey(out, inner, "id");
+    appendString(out, entry.id);
+    out += ",\n";
+
+    appendKey(out, inner, "inode");
+    appendUnsigned(out, entry.inode);
+    out += ",\n";
+
+    appendKey(out, inner, "name");
+    appendString(out, entry.name);
+    out += ",\n";
+
+    appendKey(out, inner, "parentId");
+    appendString(out, entry.parentId);
+    out += ",\n";
+
+    appendKey(out, inner, "physicalPath");
+    appendString(out, entry.physicalPath);
+    out += ",\n";
+
+    // 与原输出保持一致：size 以 int 输出
+    appendKey(out, inner, "size");
+    appendNumber(out, static_cast<int>(entry.size));
+    out += ",\n";
+
+    // 目录的子树汇总（du 风格），消费者无需再遍历 files 数组
+    SubtreeRollup::Stats subtree;
+    if (rollup && entry.type == EntryKind::Directory && rollup->find(entry.id, subtree)) {
+        appendKey(out, inner, "subtree");
+        out += "{\n";
+        appendKey(out, inner + 1, "allocated");
+        appendUnsigned(out, subtree.allocated);
+        out += ",\n";
+        appendKey(out, inner + 1, "bytes");
+        appendUnsigned(out, subtree.bytes);
+        out += ",\n";
+        appendKey(out, inner + 1, "dirs");
+        appendUnsigned(out, subtree.dirs);
+        out += ",\n";
+        appendKey(out, inner + 1, "extents");
+        appendUnsigned(out, subtree.extents);
+        out += ",\n";
+        appendKey(out, inner + 1, "files");
+        appendUnsigned(out, subtree.files);
+        out += ",\n";
+        appendKey(out, inner + 1, "maxDepth");
+        appendNumber(out, subtree.maxDepth);
+        out += '\n';
+        appendIndent(out, inner);
+        out += "},\n";
+    }
+
+    appendKey(out, inner, "type");
+    appendString(out, entryKindName(entry.type));
+    out += '\n';
+
+    appendIndent(out, depth);
+    out += '}';
+}
+
+void SnapshotWriter::encodeEntryCompact(std::string& out, const FileEntry& entry) {
+    out += '{';
+    if (entry.sparse) {
+        out += "\"allocatedSize\":";
+        appendUnsigned(out, entry.allocatedSize);
+        out += ',';
+    }
+    out += "\"allocationAlgorithm\":";
+    if (entry.type == EntryKind::File && entry.allocationAlgorithm != AllocationAlgorithm::None) {
+        appendString(out, allocationAlgorithmName(entry.allocationAlgorithm));
+    } else {
+        out += "null";
+    }
+    out += ",\"blocks\":[";
+    for (size_t i = 0; i < entry.blocks.size(); i++) {
+        if (i > 0) {
+            out += ',';
+        }
+        appendNumber(out, entry.blocks[i]);
+    }
+    out += "],\"createTime\":";
+    appendString(out, entry.createTime);
+    out += ",\"deviceId\":";
+    appendUnsigned(out, entry.deviceId);
+    out += ",\"extents\":[";
+    for (size_t i = 0; i < entry.extents.size(); i++) {
+        const ExtentInfo& extent = entry.extents[i];
+        out += i > 0 ? ",{\"length\":" : "{\"length\":";
+        appendUnsigned(out, extent.length);
+        out += ",\"logicalOffset\":";
+        appendUnsigned(out, extent.logicalOffset);
+        out += ",\"physicalOffset\":";
+        appendUnsigned(out, extent.physicalOffset);
+        out += extent.shared ? ",\"shared\":true}" : "}";
+    }
+    out += "],\"id\":";
+    appendString(out, entry.id);
+    out += ",\"inode\":";
+    appendUnsigned(out, entry.inode);
+    out += ",\"name\":";
+    appendString(out, entry.name);
+    out += ",\"parentId\":";
+    appendString(out, entry.parentId);
+    out += ",\"physicalPath\":";
+    appendString(out, entry.physicalPath);
+    out += ",\"size\":";
+    appendNumber(out, static_cast<int>(entry.size));
+    out += ",\"type\":";
+    appendString(out, entryKindName(entry.type));
+    out += '}';
+}
+
+ParallelEntryEncoder::ParallelEntryEncoder(SnapshotWriter& writer, size_t threads, int depth,
+                                           const SubtreeRollup* rollup)
+    : writer_(writer)
+    , depth_(depth)
+    , rollup_(rollup)
+    , maxInFlight_(maxInFlightBatches(threads))
+    , nextSequence_(0)
+    , nextToWrite_(0)
+    , entryCount_(0)
+    , finishing_(false)
+{
+    // 之前追加的内容（数组之前的部分）必须先写出
+    writer_.flush();
+    threads = std::max<size_t>(1, threads);
+    for (size_t i = 0; i < threads; i++) {
+        encoders_.emplace_back(&ParallelEntryEncoder::encodeLoop, this);
+    }
+    writerThread_ = std::thread(&ParallelEntryEncoder::writeLoop, this);
+}
+
+ParallelEntryEncoder::~ParallelEntryEncoder() {
+    try {
+        finish();
+    } catch (const std::exception&) {
+        // 析构中忽略错误，正常路径应显式调用 finish()
+    }
+}
+
+void ParallelEntryEncoder::submit(std::shared_ptr<const EntryBatch> batch) {
+    if (!batch || batch->items.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    spaceCondition_.wait(lock, [this] {
+        return nextSequence_ - nextToWrite_ < maxInFlight_ || error_;
+    });
+    if (error_) {
+        return;  // 错误在 finish() 中抛出
+    }
+    entryCount_ += batch->items.size();
+    tasks_.push({nextSequence_++, std::move(batch)});
+    taskCondition_.notify_one();
+}
+
+size_t ParallelEntryEncoder::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finishing_ && encoders_.empty()) {
+            return entryCount_;
+        }
+        finishing_ = true;
+    }
+    taskCondition_.notify_all();
+    doneCondition_.notify_all();
+    for (auto& thread : encoders_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    encoders_.clear();
+    if (writerThread_.joinable()) {
+        writerThread_.join();
+    }
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    return entryCount_;
+}
+
+void ParallelEntryEncoder::encodeLoop() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            taskCondition_.wait(lock, [this] { return !tasks_.empty() || finishing_ || error_; });
+            if (tasks_.empty() || error_) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+
+        std::string out;
+        try {
+            out.reserve(task.batch->items.size() * 512);
+            for (size_t i = 0; i < task.batch->items.size(); i++) {
+                // 第一个批次的第一个条目负责打开数组，其余条目以逗号分隔
+                out += (task.sequence == 0 && i == 0) ? "[\n" : ",\n";
+                SnapshotWriter::appendIndent(out, depth_);
+                SnapshotWriter::encodeEntry(out, *task.batch->items[i], depth_, rollup_);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+            taskCondition_.notify_all();
+            doneCondition_.notify_all();
+            spaceCondition_.notify_all();
+            return;
+        }
+        task.batch.reset();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        encoded_.emplace(task.sequence, std::move(out));
+        doneCondition_.notify_one();
+    }
+}
+
+void ParallelEntryEncoder::writeLoop() {
+    while (true) {
+        std::vector<std::string> ready;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            doneCondition_.wait(lock, [this] {
+                return encoded_.count(nextToWrite_) > 0 || error_ ||
+                       (finishing_ && tasks_.empty() && nextToWrite_ == nextSequence_);
+            });
+            if (error_ || (encoded_.count(nextToWrite_) == 0)) {
+                return;
+            }
+            // 取出所有按序就绪的缓冲区，一次写出
+            auto it = encoded_.find(nextToWrite_);
+            while (it != encoded_.end() && it->first == nextToWrite_ + ready.size()) {
+                ready.push_back(std::move(it->second));
+                it = encoded_.erase(it);
+            }
+        }
+
+        try {
+            writer_.writeBuffers(ready);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+            taskCondition_.notify_all();
+            spaceCondition_.notify_all();
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        nextToWrite_ += ready.size();
+        spaceCondition_.notify_all();
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef SNAPSHOT_WRITER_H
+#define SNAPSHOT_WRITER_H
+
+#include "FileEntry.h"
+#include "EntryStore.h"
+#include "OutputCompressor.h"
+#include "SubtreeRollup.h"
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 快照 JSON 流式写出器。
+// 编码结果与 nlohmann::json::dump(2) 逐字节一致（键按字典序、2 空格缩进），
+// 但无需在内存中构建整棵 JSON 树，条目可以边遍历边写出。
+class SnapshotWriter {
+public:
+    // compression 不为 None 时，写出的数据经独立的压缩线程流式压缩后再写入文件；
+    // path 为 "-" 时写到标准输出
+    explicit SnapshotWriter(const std::string& path, CompressionType compression = CompressionType::None);
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // 写缓冲区：调用者追加内容后调用 flushIfNeeded()
+    std::string& buffer() { return buffer_; }
+    void flushIfNeeded();
+    void flush();
+    void close();
+    
+    // 按顺序一次写出多个缓冲区（Linux 上使用 writev）
+    void writeBuffers(const std::vector<const std::string*>& buffers);
+    void writeBuffers(std::vector<std::string>& buffers);  // 压缩时缓冲区内容会被移走
+
+    // 编码工具
+    static void appendIndent(std::string& out, int depth);
+    static void appendKey(std::string& out, int depth, const char* key);
+    static void appendString(std::string& out, const std::string& value);
+    static void appendNumber(std::string& out, long long value);
+    static void appendUnsigned(std::string& out, unsigned long long value);
+    static void appendDouble(std::string& out, double value);
+
+    // 编码 files 数组中的一个条目（depth 为对象自身所在层级，不含前导缩进）；
+    // rollup 不为空时目录条目附带 subtree 汇总
+    static void encodeEntry(std::string& out, const FileEntry& entry, int depth,
+                            const SubtreeRollup* rollup = nullptr);
+    // 以 nlohmann::json::dump() 的紧凑格式编码一个条目（单行，字段与 encodeEntry 相同，不含 subtree）
+    static void encodeEntryCompact(std::string& out, const FileEntry& entry);
+
+private:
+    // 直接写入文件（未压缩数据或压缩线程的输出）
+    void writeRaw(const std::vector<const std::string*>& buffers);
+    void writeRaw(const char* data, size_t size);
+
+#ifdef _WIN32
+    std::ofstream out_;
+#else
+    int fd_;
+#endif
+    std::unique_ptr<OutputCompressor> compressor_;
+    std::string buffer_;
+    std::string path_;
+};
+
+// 并行编码 files 数组：每个批次（连续的一段条目）由编码线程编码到独立缓冲区，
+// 写出线程按批次顺序把缓冲区写入文件，编码与写出重叠进行。
+// 输出与逐条串行编码逐字节一致。
+class ParallelEntryEncoder {
+public:
+    ParallelEntryEncoder(SnapshotWriter& writer, size_t threads, int depth,
+                         const SubtreeRollup* rollup = nullptr);
+    ~ParallelEntryEncoder();
+
+    ParallelEntryEncoder(const ParallelEntryEncoder&) = delete;
+    ParallelEntryEncoder& operator=(const ParallelEntryEncoder&) = delete;
+
+    // threads 个编码线程时最多同时在途的批次数（submit 超过时阻塞）
+    static size_t maxInFlightBatches(size_t threads) { return std::max<size_t>(1, threads) * 4; }
+
+    // 提交一个批次（在途批次过多时阻塞，限制内存占用）
+    void submit(std::shared_ptr<const EntryBatch> batch);
+
+    // 等待所有批次写出，返回写出的条目总数
+    size_t finish();
+
+private:
+    struct Task {
+        size_t sequence;
+        std::shared_ptr<const EntryBatch> batch;
+    };
+
+    void encodeLoop();
+    void writeLoop();
+
+    SnapshotWriter& writer_;
+    int depth_;
+    const SubtreeRollup* rollup_;
+    size_t maxInFlight_;
+
+    std::mutex mutex_;
+    std::condition_variable taskCondition_;    // 有新任务或结束
+    std::condition_variable doneCondition_;    // 有批次编码完成
+    std::condition_variable spaceCondition_;   // 在途批次减少
+    std::queue<Task> tasks_;
+    std::map<size_t, std::string> encoded_;    // 已编码、等待按序写出的缓冲区
+    size_t nextSequence_;    // 下一个提交批次的序号
+    size_t nextToWrite_;     // 下一个要写出的批次序号
+    size_t entryCount_;
+    bool finishing_;
+    std::exception_ptr error_;
+
+    std::vector<std::thread> encoders_;
+    std::thread writerThread_;
+};
+
+#endif // SNAPSHOT_WRITER_H
@@ -0,0 +1,195 @@
+#include "SubtreeRollup.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+struct SubtreeRollup::Node {
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> allocated{0};
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint64_t> dirs{0};
+    std::atomic<uint64_t> extents{0};
+    std::atomic<int> maxDepth{0};
+    size_t parent = SubtreeRollup::npos;
+    int depth = 0;
+    std::atomic<bool> present{false};
+};
+
+namespace {
+
+void updateMax(std::atomic<int>& target, int value) {
+    int current = target.load(std::memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+SubtreeRollup::SubtreeRollup()
+    : chunks_(new std::atomic<Node*>[MAX_CHUNKS])
+    , maxIndex_(0)
+    , chunkCount_(0)
+    , computed_(false)
+{
+    for (size_t i = 0; i < MAX_CHUNKS; i++) {
+        chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+SubtreeRollup::~SubtreeRollup() {
+    for (size_t i = 0; i < MAX_CHUNKS; i++) {
+        delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+}
+
+size_t SubtreeRollup::indexOf(const std::string& id) {
+    // 多根扫描的 ID 带有 "d<序号>:" 前缀，每个扫描器有自己的汇总表，前缀不参与编号
+    size_t start = id.find(':');
+    start = start == std::string::npos ? 0 : start + 1;
+    if (id.compare(start, std::string::npos, "root") == 0) {
+        return 0;
+    }
+    if (id.compare(start, 4, "dir-") != 0 || id.size() == start + 4) {
+        return npos;
+    }
+    size_t index = 0;
+    for (size_t i = start + 4; i < id.size(); i++) {
+        if (id[i] < '0' || id[i] > '9') {
+            return npos;
+        }
+        index = index * 10 + static_cast<size_t>(id[i] - '0');
+    }
+    return index;
+}
+
+SubtreeRollup::Node* SubtreeRollup::node(size_t index, bool create) {
+    size_t chunkIndex = index >> CHUNK_BITS;
+    if (chunkIndex >= MAX_CHUNKS) {
+        if (create) {
+            throw std::runtime_error("目录数量超出子树汇总表容量");
+        }
+        return nullptr;
+    }
+    Node* chunk = chunks_[chunkIndex].load(std::memory_order_acquire);
+    if (!chunk && create) {
+        // 多个线程同时创建同一块时只保留一个
+        Node* fresh = new Node[CHUNK_SIZE];
+        if (chunks_[chunkIndex].compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) {
+            chunk = fresh;
+            chunkCount_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            delete[] fresh;
+        }
+    }
+    return chunk ? &chunk[index & (CHUNK_SIZE - 1)] : nullptr;
+}
+
+void SubtreeRollup::addDirectory(size_t index, size_t parentIndex, int depth) {
+    if (index == npos) {
+        return;
+    }
+    Node* entry = node(index, true);
+    entry->parent = parentIndex;
+    entry->depth = depth;
+    entry->present.store(true, std::memory_order_release);
+
+    size_t current = maxIndex_.load(std::memory_order_relaxed);
+    while (current < index && !maxIndex_.compare_exchange_weak(current, index, std::memory_order_relaxed)) {
+    }
+}
+
+void SubtreeRollup::addFile(size_t parentIndex, uint64_t bytes, uint64_t allocated, uint64_t extents) {
+    if (parentIndex == npos) {
+        return;
+    }
+    // 父目录总是在其子项被处理之前登记
+    Node* parent = node(parentIndex, false);
+    if (!parent) {
+        return;
+    }
+    parent->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    parent->allocated.fetch_add(allocated, std::memory_order_relaxed);
+    parent->files.fetch_add(1, std::memory_order_relaxed);
+    parent->extents.fetch_add(extents, std::memory_order_relaxed);
+    updateMax(parent->maxDepth, 1);
+}
+
+void SubtreeRollup::compute(size_t threads) {
+    if (computed_) {
+        return;
+    }
+    computed_ = true;
+    
+    // 按深度分组（计数排序），保证处理某一层时其所有子目录已经汇总完毕
+    size_t count = maxIndex_.load() + 1;
+    std::vector<std::vector<size_t>> levels;
+    for (size_t i = 0; i < count; i++) {
+        Node* entry = node(i, false);
+        if (!entry || !entry->present.load(std::memory_order_acquire)) {
+            continue;
+        }
+        size_t depth = static_cast<size_t>(std::max(0, entry->depth));
+        if (levels.size() <= depth) {
+            levels.resize(depth + 1);
+        }
+        levels[depth].push_back(i);
+    }
+
+    auto propagate = [this](const std::vector<size_t>& level, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Node* child = node(level[i], false);
+            Node* parent = child->parent == npos ? nullptr : node(child->parent, false);
+            if (!parent || !parent->present.load(std::memory_order_acquire)) {
+                continue;
+            }
+            parent->bytes.fetch_add(child->bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            parent->allocated.fetch_add(child->allocated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            parent->files.fetch_add(child->files.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            parent->dirs.fetch_add(child->dirs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            parent->extents.fetch_add(child->extents.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            updateMax(parent->maxDepth, child->maxDepth.load(std::memory_order_relaxed) + 1);
+        }
+    };
+
+    const size_t minPerThread = 4096;  // 较小的层直接串行处理，避免线程开销
+    for (size_t depth = levels.size(); depth-- > 1;) {
+        const std::vector<size_t>& level = levels[depth];
+        size_t workers = std::min(std::max<size_t>(1, threads), (level.size() + minPerThread - 1) / minPerThread);
+        if (workers <= 1) {
+            propagate(level, 0, level.size());
+            continue;
+        }
+        std::vector<std::thread> pool;
+        size_t step = (level.size() + workers - 1) / workers;
+        for (size_t begin = 0; begin < level.size(); begin += step) {
+            pool.emplace_back(propagate, std::cref(level), begin, std::min(level.size(), begin + step));
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+}
+
+bool SubtreeRollup::find(const std::string& id, Stats& stats) const {
+    size_t index = indexOf(id);
+    if (index == npos) {
+        return false;
+    }
+    Node* entry = const_cast<SubtreeRollup*>(this)->node(index, false);
+    if (!entry || !entry->present.load(std::memory_order_acquire)) {
+        return false;
+    }
+    stats.bytes = entry->bytes.load(std::memory_order_relaxed);
+    stats.allocated = entry->allocated.load(std::memory_order_relaxed);
+    stats.files = entry->files.load(std::memory_order_relaxed);
+    stats.dirs = entry->dirs.load(std::memory_order_relaxed);
+    stats.extents = entry->extents.load(std::memory_order_relaxed);
+    stats.maxDepth = entry->maxDepth.load(std::memory_order_relaxed);
+    return true;
+}
+
+size_t SubtreeRollup::memoryBytes() const {
+    return MAX_CHUNKS * sizeof(std::atomic<Node*>)
+        + chunkCount_.load(std::memory_order_relaxed) * CHUNK_SIZE * sizeof(Node);
+}
@@ -0,0 +1,63 @@
+#ifndef SUBTREE_ROLLUP_H
+#define SUBTREE_ROLLUP_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// 目录子树汇总（du 风格）：扫描时按目录累加直接子项的统计，
+// 扫描结束后按深度自底向上并行汇总到父目录，生成 JSON 时直接查表写出。
+// 目录以 ID 的数字部分为下标（"root" 为 0，"dir-N" 为 N），存储在分块数组中，
+// 扫描期间的登记和累加都是无锁的。
+class SubtreeRollup {
+public:
+    struct Stats {
+        uint64_t bytes = 0;       // 文件大小总和
+        uint64_t allocated = 0;   // 已分配块占用的字节数
+        uint64_t files = 0;
+        uint64_t dirs = 0;        // 子孙目录数（不含自身）
+        uint64_t extents = 0;
+        int maxDepth = 0;         // 子树相对该目录的最大深度（空目录为 0）
+    };
+
+    SubtreeRollup();
+    ~SubtreeRollup();
+
+    SubtreeRollup(const SubtreeRollup&) = delete;
+    SubtreeRollup& operator=(const SubtreeRollup&) = delete;
+
+    // 由目录 ID 得到下标，无法识别时返回 npos
+    static size_t indexOf(const std::string& id);
+    static const size_t npos = static_cast<size_t>(-1);
+
+    // 登记目录（线程安全；root 的 parentIndex 为 npos）
+    void addDirectory(size_t index, size_t parentIndex, int depth);
+
+    // 累加一个文件到其所在目录的直接统计（线程安全）
+    void addFile(size_t parentIndex, uint64_t bytes, uint64_t allocated, uint64_t extents);
+
+    // 自底向上汇总：同一深度的目录由多个线程并行处理，处理完一层再处理上一层（只执行一次）
+    void compute(size_t threads);
+
+    // 查询目录的子树汇总（compute 之后调用）；未登记时返回 false
+    bool find(const std::string& id, Stats& stats) const;
+
+    // 块表和已分配的块占用的堆内存（线程安全）
+    size_t memoryBytes() const;
+
+private:
+    struct Node;
+    static const size_t CHUNK_BITS = 12;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static const size_t MAX_CHUNKS = size_t(1) << 18;
+
+    Node* node(size_t index, bool create);
+
+    std::unique_ptr<std::atomic<Node*>[]> chunks_;
+    std::atomic<size_t> maxIndex_;
+    std::atomic<size_t> chunkCount_;
+    bool computed_;
+};
+
+#endif // SUBTREE_ROLLUP_H
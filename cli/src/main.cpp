@@ -8,18 +8,167 @@
 #include <sstream>
 #include <thread>
 #include <cstdlib>
+#include <cctype>
+#include <climits>
+#include <cstdint>
 #include "FileSystemScanner.h"
+#include "MultiRootScanner.h"
 #include "ProgressBar.h"
+#include "ConcurrencyTuner.h"
+#include "OutputCompressor.h"
+#include "QueryModel.h"
+#include "QueryServer.h"
+#include "DuplicateFinder.h"
+#include "ReadProbe.h"
 
 namespace fs = std::filesystem;
 
+// 解析带单位的大小（K/M/G/T，不区分大小写），无单位时按字节计算
+bool parseSize(const std::string& text, size_t& bytes) {
+    size_t pos = 0;
+    double value = 0.0;
+    try {
+        value = std::stod(text, &pos);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (value <= 0.0) {
+        return false;
+    }
+    double multiplier = 1.0;
+    if (pos < text.size()) {
+        switch (std::toupper(static_cast<unsigned char>(text[pos]))) {
+            case 'K': multiplier = 1024.0; break;
+            case 'M': multiplier = 1024.0 * 1024; break;
+            case 'G': multiplier = 1024.0 * 1024 * 1024; break;
+            case 'T': multiplier = 1024.0 * 1024 * 1024 * 1024; break;
+            default: return false;
+        }
+    }
+    bytes = static_cast<size_t>(value * multiplier);
+    return true;
+}
+
+// 解析每秒次数（允许小数，必须大于 0）
+bool parseRate(const std::string& text, double& rate) {
+    size_t pos = 0;
+    try {
+        rate = std::stod(text, &pos);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return pos == text.size() && rate > 0;
+}
+
+// 解析物理偏移（支持 0x 前缀和 K/M/G/T 单位，允许为 0）
+bool parseOffset(const std::string& text, uint64_t& offset) {
+    if (text.empty() || text[0] == '-' || text[0] == '+') {
+        return false;
+    }
+    size_t pos = 0;
+    unsigned long long value = 0;
+    try {
+        value = std::stoull(text, &pos, 0);
+    } catch (const std::exception&) {
+        return false;
+    }
+    unsigned shift = 0;
+    if (pos < text.size()) {
+        switch (std::toupper(static_cast<unsigned char>(text[pos]))) {
+            case 'K': shift = 10; break;
+            case 'M': shift = 20; break;
+            case 'G': shift = 30; break;
+            case 'T': shift = 40; break;
+            default: return false;
+        }
+        if (pos + 1 != text.size() || value > (UINT64_MAX >> shift)) {
+            return false;
+        }
+    }
+    offset = static_cast<uint64_t>(value) << shift;
+    return true;
+}
+
+// 解析 --who-owns 的参数：单个偏移，或 起始-结束（不含结束）
+bool parseOffsetRange(const std::string& text, std::pair<uint64_t, uint64_t>& range) {
+    size_t dash = text.find('-');
+    if (dash == std::string::npos) {
+        if (!parseOffset(text, range.first)) {
+            return false;
+        }
+        range.second = range.first == UINT64_MAX ? range.first : range.first + 1;
+        return true;
+    }
+    return parseOffset(text.substr(0, dash), range.first) && parseOffset(text.substr(dash + 1), range.second) &&
+           range.second > range.first;
+}
+
+// 输出各设备选定的 extent 探测策略
+void printProbeStrategies(const DeviceCapabilities& capabilities) {
+    for (const auto& device : capabilities.report()) {
+        std::cout << "  extent 探测: 设备 " << device.device << " (" << device.fileSystem << ") "
+                  << device.strategy << ", " << device.files << " 个文件\n";
+    }
+}
+
 void printUsage(const char* programName) {
-    std::cout << "用法: " << programName << " <目录或文件路径> [选项]\n\n";
+    std::cout << "用法: " << programName << " <目录或文件路径> [选项]\n";
+    std::cout << "      " << programName << " <目录1> <目录2> ... [选项]\n";
+    std::cout << "      " << programName << " --image <镜像文件> [选项]\n";
+    std::cout << "      " << programName << " serve <目录|--image 镜像> [--socket <路径>] [选项]\n";
+    std::cout << "      " << programName << " query [--socket <路径>] '<JSON 请求>'\n\n";
     std::cout << "选项:\n";
     std::cout << "  -o, --output <文件>    指定输出JSON文件路径 (默认: filesystem.json)\n";
-    std::cout << "  -b, --block-size <大小> 指定块大小，单位KB (默认: 4)\n";
+    std::cout << "                         以 .gz/.zst 结尾时自动启用对应的流式压缩\n";
+    std::cout << "  -b, --block-size <大小> 指定块大小，单位KB (默认随 -t: FAT32 为 32，Ext4/NTFS 为 4)\n";
     std::cout << "  -t, --type <类型>      指定文件系统类型 (FAT32/Ext4/NTFS, 默认: FAT32)\n";
     std::cout << "  -r, --require-root     提示需要 root 权限以获取更准确的文件分配信息\n";
+    std::cout << "  -j, --threads <数量|auto> 工作线程数 (默认: cgroup 配额下的有效CPU数)\n";
+    std::cout << "                         auto: 自适应，根据扫描吞吐量和延迟动态调整线程数\n";
+    std::cout << "      --inode-order      按 inode 顺序处理目录条目 (机械盘/镜像文件存储可减少寻道)\n";
+    std::cout << "      --memory-limit <大小> 扫描的内存上限 (如 512M、4G)，扣除块位图、子树汇总和输出缓冲后\n";
+    std::cout << "                         剩余部分给条目存储，超出部分溢出到临时文件\n";
+    std::cout << "      --spill-dir <目录>  溢出文件目录 (默认: 系统临时目录)\n";
+    std::cout << "      --compress <格式>  输出压缩格式 (gzip/zstd/none, 默认根据输出文件扩展名)\n";
+    std::cout << "      --include <模式>   只保留匹配 glob 模式的文件 (可重复，如 '*.log'、'src/**/*.cpp')\n";
+    std::cout << "      --exclude <模式>   跳过匹配 glob 模式的文件和目录，被排除的目录不会被遍历\n";
+    std::cout << "                         (可重复，以 / 结尾只匹配目录，如 'node_modules/'、'.git/')\n";
+    std::cout << "      --max-depth <层数> 最大遍历深度 (根目录的直接子项为第 1 层)\n";
+    std::cout << "      --min-size <大小>  忽略小于该大小的文件 (如 1M)\n";
+    std::cout << "      --sample-rate <比例> 抽样模式：只对分层抽中的文件探测 extent (如 0.01 或 1%)，\n";
+    std::cout << "                         输出附加碎片率和分配算法占比的估计值及 95% 置信区间\n";
+    std::cout << "      --alloc <方式>     模拟磁盘的分配方式 (continuous/linked/indexed)，\n";
+    std::cout << "                         默认随 -t：FAT32 为 linked，NTFS 为 indexed，Ext4 为 continuous\n";
+    std::cout << "      --fit <策略>       空闲段适配策略 (first/next/best, 默认: first)\n";
+    std::cout << "      --churn <比例>     分配时按该概率穿插创建并随机删除临时文件以产生碎片 (0~1, 默认: 0)\n";
+    std::cout << "      --image <文件>     离线解析 ext4/FAT32 镜像文件 (无需挂载和 root 权限)，\n";
+    std::cout << "                         使用镜像中真实的块位图/extent 树或 FAT 簇链，块大小取自超级块/BPB\n";
+    std::cout << "      --who-owns <偏移>  扫描后查询占用该物理字节偏移的文件 (可重复)，\n";
+    std::cout << "                         也可指定区间 起始-结束 (不含结束)，支持 0x 前缀和 K/M/G/T 单位\n";
+    std::cout << "      --extent-report <文件> 扫描后写出 extent 报告：按物理位置排序的布局、\n";
+    std::cout << "                         被多个文件共享的区域 (reflink/去重) 和 --who-owns 的查询结果\n";
+    std::cout << "      --hash <文件>      扫描后查找内容重复的文件并写出报告：先按大小分组，再对大小相同的文件\n";
+    std::cout << "                         哈希首尾 4KB，最后只完整读取仍然相同的文件；大小唯一的文件不会被读取\n";
+    std::cout << "      --hash-threads <数量> 重复文件检测的读取线程数 (默认: 4)\n";
+    std::cout << "      --probe-read <文件> 扫描后按设备和 extent 数分桶抽样，用 O_DIRECT 冷读测量吞吐量和延迟，\n";
+    std::cout << "                         写出报告，用于判断哪些文件值得整理碎片\n";
+    std::cout << "      --probe-samples <数量> 读取探测时每个设备每个分桶抽取的文件数 (默认: 8)\n";
+    std::cout << "      --socket <路径>    serve/query 使用的 Unix 域套接字 (默认: fcon.sock)\n";
+    std::cout << "      --summary <文件>   扫描时在线汇总并写出报告：最大/碎片最多的文件、大小和修改时间直方图、扩展名统计\n";
+    std::cout << "      --summary-only     只输出汇总报告 (写入 -o，默认 summary.json)，不保存条目，内存占用恒定\n";
+    std::cout << "      --top-k <数量>     汇总报告中最大/碎片最多文件的个数 (默认: 20)\n";
+    std::cout << "      --stream           扫描过程中每个条目立即输出一行 JSON (NDJSON)，写到 -o 指定的文件，\n";
+    std::cout << "                         未指定 -o 时写到标准输出 (此时提示信息改写到标准错误)\n";
+    std::cout << "      --roots <清单>     从清单文件读取要扫描的目录 (每行一个)，可与命令行中的目录合用\n";
+    std::cout << "                         多个目录按所在设备分组，每个设备独立的线程池并行扫描，\n";
+    std::cout << "                         结果写入一个快照，disks 中每个设备一个磁盘节\n";
+    std::cout << "      --background       后台模式：I/O 调度类设为 idle，工作线程使用 SCHED_IDLE (不允许时 nice 19)\n";
+    std::cout << "      --max-ops <次/秒>  限制每秒的元数据操作数 (stat/列目录)，所有线程共享\n";
+    std::cout << "      --max-probes <次/秒> 限制每秒的 extent 探测数 (FIEMAP)\n";
+    std::cout << "      --psi-limit <百分比> 系统 I/O 压力 (/proc/pressure/io 的 some avg10) 超过该值时暂停扫描\n";
+    std::cout << "      --checkpoint <文件> 扫描时把进度追加写入检查点，进程中断后可用 --resume 继续\n";
+    std::cout << "      --checkpoint-interval <秒> 检查点写盘间隔 (默认: 30)\n";
+    std::cout << "      --resume <文件>    从检查点继续中断的扫描 (其余参数须与原命令一致)，完成后删除检查点\n";
     std::cout << "  -h, --help             显示此帮助信息\n\n";
     std::cout << "示例:\n";
     #ifdef _WIN32
@@ -40,14 +189,84 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // 子命令：serve 扫描后常驻并回答查询，query 向运行中的 serve 发送一个请求
+    int firstArg = 1;
+    bool serveMode = false;
+    std::string socketPath = "fcon.sock";
+    if (std::string(argv[1]) == "query") {
+        std::string request;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--socket" && i + 1 < argc) {
+                socketPath = argv[++i];
+            } else {
+                request = arg;
+            }
+        }
+        if (request.empty()) {
+            std::cerr << "错误: query 需要一个 JSON 请求，如 '{\"op\":\"stat\"}'\n";
+            return 1;
+        }
+        try {
+            std::string response = QueryServer::request(socketPath, request);
+            std::cout << response << "\n";
+            return response.find("\"ok\":true") != std::string::npos ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "错误: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    if (std::string(argv[1]) == "serve") {
+        serveMode = true;
+        firstArg = 2;
+    }
+
     std::string inputPath;
+    std::vector<std::string> inputPaths;
+    std::string manifestPath;
+    bool threadsSpecified = false;
     std::string outputPath = "filesystem.json";
-    int blockSizeKB = 4;
-    std::string fileSystemType = "FAT32";
+    bool outputSpecified = false;
+    int blockSizeKB = 0;  // 0 表示使用文件系统类型的默认簇大小
+    FileSystemType fileSystemType = FileSystemType::FAT32;
     bool requireRoot = false;
+    size_t threadCount = ConcurrencyTuner::effectiveCpuCount();
+    bool adaptiveThreads = false;
+    bool inodeOrder = false;
+    size_t memoryLimit = 0;
+    std::string spillDir;
+    bool compressionSpecified = false;
+    CompressionType compression = CompressionType::None;
+    std::vector<std::string> includePatterns;
+    std::vector<std::string> excludePatterns;
+    int maxDepth = -1;
+    size_t minSize = 0;
+    double sampleRate = 0;
+    bool allocationSpecified = false;
+    BlockAllocator::Policy allocationPolicy = BlockAllocator::Policy::Continuous;
+    BlockAllocator::Fit allocationFit = BlockAllocator::Fit::First;
+    double churn = 0;
+    std::string imagePath;
+    std::vector<std::pair<uint64_t, uint64_t>> ownerQueries;
+    std::string extentReportPath;
+    std::string summaryPath;
+    std::string hashReportPath;
+    size_t hashThreads = 4;
+    std::string probeReportPath;
+    size_t probeSamples = 8;
+    bool summaryOnly = false;
+    size_t topK = 0;
+    bool streamMode = false;
+    std::string checkpointPath;
+    double checkpointInterval = 30.0;
+    bool resume = false;
+    bool backgroundMode = false;
+    double maxOps = 0;
+    double maxProbes = 0;
+    double psiLimit = 0;
 
     // 解析命令行参数
-    for (int i = 1; i < argc; i++) {
+    for (int i = firstArg; i < argc; i++) {
         std::string arg = argv[i];
         
         if (arg == "-h" || arg == "--help") {
@@ -56,6 +275,7 @@ int main(int argc, char* argv[]) {
         } else if (arg == "-o" || arg == "--output") {
             if (i + 1 < argc) {
                 outputPath = argv[++i];
+                outputSpecified = true;
             } else {
                 std::cerr << "错误: -o 选项需要指定输出文件路径\n";
                 return 1;
@@ -73,9 +293,9 @@ int main(int argc, char* argv[]) {
             }
         } else if (arg == "-t" || arg == "--type") {
             if (i + 1 < argc) {
-                fileSystemType = argv[++i];
-                if (fileSystemType != "FAT32" && fileSystemType != "Ext4" && fileSystemType != "NTFS") {
-                    std::cerr << "错误: 不支持的文件系统类型: " << fileSystemType << "\n";
+                std::string name = argv[++i];
+                if (!parseFileSystemType(name, fileSystemType)) {
+                    std::cerr << "错误: 不支持的文件系统类型: " << name << "\n";
                     std::cerr << "支持的类型: FAT32, Ext4, NTFS\n";
                     return 1;
                 }
@@ -85,13 +305,311 @@ int main(int argc, char* argv[]) {
             }
         } else if (arg == "-r" || arg == "--require-root") {
             requireRoot = true;
+        } else if (arg == "-j" || arg == "--threads") {
+            if (i + 1 < argc) {
+                std::string value = argv[++i];
+                if (value == "auto") {
+                    adaptiveThreads = true;
+                } else {
+                    int count = std::stoi(value);
+                    if (count <= 0) {
+                        std::cerr << "错误: 线程数必须大于0\n";
+                        return 1;
+                    }
+                    threadCount = static_cast<size_t>(count);
+                }
+                threadsSpecified = true;
+            } else {
+                std::cerr << "错误: -j 选项需要指定线程数或 auto\n";
+                return 1;
+            }
+        } else if (arg == "--inode-order") {
+            inodeOrder = true;
+        } else if (arg == "--memory-limit") {
+            if (i + 1 < argc) {
+                if (!parseSize(argv[++i], memoryLimit)) {
+                    std::cerr << "错误: 无效的内存上限: " << argv[i] << "\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "错误: --memory-limit 选项需要指定大小\n";
+                return 1;
+            }
+        } else if (arg == "--compress") {
+            if (i + 1 < argc) {
+                if (!OutputCompressor::parse(argv[++i], compression)) {
+                    std::cerr << "错误: 不支持的压缩格式: " << argv[i] << "\n";
+                    std::cerr << "支持的格式: gzip, zstd, none\n";
+                    return 1;
+                }
+                compressionSpecified = true;
+            } else {
+                std::cerr << "错误: --compress 选项需要指定压缩格式\n";
+                return 1;
+            }
+        } else if (arg == "--spill-dir") {
+            if (i + 1 < argc) {
+                spillDir = argv[++i];
+            } else {
+                std::cerr << "错误: --spill-dir 选项需要指定目录\n";
+                return 1;
+            }
+        } else if (arg == "--include" || arg == "--exclude") {
+            if (i + 1 < argc) {
+                (arg == "--include" ? includePatterns : excludePatterns).push_back(argv[++i]);
+            } else {
+                std::cerr << "错误: " << arg << " 选项需要指定 glob 模式\n";
+                return 1;
+            }
+        } else if (arg == "--max-depth") {
+            if (i + 1 < argc) {
+                maxDepth = std::stoi(argv[++i]);
+                if (maxDepth <= 0) {
+                    std::cerr << "错误: 最大深度必须大于0\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "错误: --max-depth 选项需要指定层数\n";
+                return 1;
+            }
+        } else if (arg == "--min-size") {
+            if (i + 1 < argc) {
+                if (!parseSize(argv[++i], minSize)) {
+                    std::cerr << "错误: 无效的文件大小: " << argv[i] << "\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "错误: --min-size 选项需要指定大小\n";
+                return 1;
+            }
+        } else if (arg == "--sample-rate") {
+            if (i + 1 < argc) {
+                std::string value = argv[++i];
+                bool percent = !value.empty() && value.back() == '%';
+                if (percent) {
+                    value.pop_back();
+                }
+                try {
+                    sampleRate = std::stod(value) / (percent ? 100.0 : 1.0);
+                } catch (const std::exception&) {
+                    sampleRate = 0;
+                }
+                if (!(sampleRate > 0 && sampleRate <= 1)) {
+                    std::cerr << "错误: 抽样比例必须在 (0, 1] 范围内: " << argv[i] << "\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "错误: --sample-rate 选项需要指定抽样比例\n";
+                return 1;
+            }
+        } else if (arg == "--alloc") {
+            if (i + 1 < argc) {
+                if (!BlockAllocator::parsePolicy(argv[++i], allocationPolicy)) {
+                    std::cerr << "错误: 不支持的分配方式: " << argv[i] << "\n";
+                    std::cerr << "支持的方式: continuous, linked, indexed\n";
+                    return 1;
+                }
+                allocationSpecified = true;
+            } else {
+                std::cerr << "错误: --alloc 选项需要指定分配方式\n";
+                return 1;
+            }
+        } else if (arg == "--fit") {
+            if (i + 1 < argc) {
+                if (!BlockAllocator::parseFit(argv[++i], allocationFit)) {
+                    std::cerr << "错误: 不支持的适配策略: " << argv[i] << "\n";
+                    std::cerr << "支持的策略: first, next, best\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "错误: --fit 选项需要指定适配策略\n";
+                return 1;
+            }
+        } else if (arg == "--churn") {
+            if (i + 1 < argc) {
+                try {
+                    churn = std::stod(argv[++i]);
+                } catch (const std::exception&) {
+                    churn = -1;
+                }
+                if (!(churn >= 0 && churn <= 1)) {
+                    std::cerr << "错误: churn 比例必须在 [0, 1] 范围内: " << argv[i] << "\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "错误: --churn 选项需要指定比例\n";
+                return 1;
+            }
+        } else if (arg == "--image") {
+            if (i + 1 < argc) {
+                imagePath = argv[++i];
+            } else {
+                std::cerr << "错误: --image 选项需要指定镜像文件路径\n";
+                return 1;
+            }
+        } else if (arg == "--who-owns") {
+            if (i + 1 < argc) {
+                std::pair<uint64_t, uint64_t> range;
+                if (!parseOffsetRange(argv[++i], range)) {
+                    std::cerr << "错误: 无效的物理偏移或区间: " << argv[i] << "\n";
+                    return 1;
+                }
+                ownerQueries.push_back(range);
+            } else {
+                std::cerr << "错误: --who-owns 选项需要指定物理偏移\n";
+                return 1;
+            }
+        } else if (arg == "--socket") {
+            if (i + 1 < argc) {
+                socketPath = argv[++i];
+            } else {
+                std::cerr << "错误: --socket 选项需要指定套接字路径\n";
+                return 1;
+            }
+        } else if (arg == "--extent-report") {
+            if (i + 1 < argc) {
+                extentReportPath = argv[++i];
+            } else {
+                std::cerr << "错误: --extent-report 选项需要指定输出文件路径\n";
+                return 1;
+            }
+        } else if (arg == "--hash") {
+            if (i + 1 < argc) {
+                hashReportPath = argv[++i];
+            } else {
+                std::cerr << "错误: --hash 选项需要指定报告文件路径\n";
+                return 1;
+            }
+        } else if (arg == "--hash-threads") {
+            if (i + 1 < argc) {
+                int count = std::stoi(argv[++i]);
+                if (count <= 0) {
+                    std::cerr << "错误: 线程数必须大于0\n";
+                    return 1;
+                }
+                hashThreads = static_cast<size_t>(count);
+            } else {
+                std::cerr << "错误: --hash-threads 选项需要指定线程数\n";
+                return 1;
+            }
+        } else if (arg == "--probe-read") {
+            if (i + 1 < argc) {
+                probeReportPath = argv[++i];
+            } else {
+                std::cerr << "错误: --probe-read 选项需要指定报告文件路径\n";
+                return 1;
+            }
+        } else if (arg == "--probe-samples") {
+            if (i + 1 < argc) {
+                int count = std::stoi(argv[++i]);
+                if (count <= 0) {
+                    std::cerr << "错误: 抽样文件数必须大于0\n";
+                    return 1;
+                }
+                probeSamples = static_cast<size_t>(count);
+            } else {
+                std::cerr << "错误: --probe-samples 选项需要指定文件数\n";
+                return 1;
+            }
+        } else if (arg == "--summary") {
+            if (i + 1 < argc) {
+                summaryPath = argv[++i];
+            } else {
+                std::cerr << "错误: --summary 选项需要指定输出文件路径\n";
+                return 1;
+            }
+        } else if (arg == "--stream") {
+            streamMode = true;
+        } else if (arg == "--roots") {
+            if (i + 1 < argc) {
+                manifestPath = argv[++i];
+            } else {
+                std::cerr << "错误: --roots 选项需要指定清单文件路径\n";
+                return 1;
+            }
+        } else if (arg == "--checkpoint" || arg == "--resume") {
+            if (i + 1 < argc) {
+                checkpointPath = argv[++i];
+                resume = resume || arg == "--resume";
+            } else {
+                std::cerr << "错误: " << arg << " 选项需要指定检查点文件路径\n";
+                return 1;
+            }
+        } else if (arg == "--checkpoint-interval") {
+            if (i + 1 < argc) {
+                try {
+                    checkpointInterval = std::stod(argv[++i]);
+                } catch (const std::exception&) {
+                    checkpointInterval = -1;
+                }
+                if (!(checkpointInterval >= 0)) {
+                    std::cerr << "错误: 无效的检查点间隔: " << argv[i] << "\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "错误: --checkpoint-interval 选项需要指定秒数\n";
+                return 1;
+            }
+        } else if (arg == "--background") {
+            backgroundMode = true;
+        } else if (arg == "--max-ops" || arg == "--max-probes" || arg == "--psi-limit") {
+            if (i + 1 < argc) {
+                double& value = arg == "--max-ops" ? maxOps : (arg == "--max-probes" ? maxProbes : psiLimit);
+                if (!parseRate(argv[++i], value) || (arg == "--psi-limit" && value >= 100)) {
+                    std::cerr << "错误: " << arg << " 的值无效: " << argv[i] << "\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "错误: " << arg << " 选项需要指定数值\n";
+                return 1;
+            }
+        } else if (arg == "--summary-only") {
+            summaryOnly = true;
+        } else if (arg == "--top-k") {
+            if (i + 1 < argc) {
+                int count = std::stoi(argv[++i]);
+                if (count <= 0) {
+                    std::cerr << "错误: top-k 必须大于0\n";
+                    return 1;
+                }
+                topK = static_cast<size_t>(count);
+            } else {
+                std::cerr << "错误: --top-k 选项需要指定数量\n";
+                return 1;
+            }
         } else if (arg[0] != '-') {
-            // 第一个非选项参数作为输入路径
-            if (inputPath.empty()) {
-                inputPath = arg;
+            // 非选项参数作为输入路径，多个路径时为多根扫描
+            inputPaths.push_back(arg);
+        }
+    }
+
+    // 未指定 -b 时使用 -t 对应文件系统的默认簇大小
+    if (blockSizeKB == 0) {
+        blockSizeKB = static_cast<int>(FileSystemModel(fileSystemType).clusterSize() / 1024);
+    }
+
+    if (!manifestPath.empty()) {
+        try {
+            for (const auto& root : MultiRootScanner::readManifest(manifestPath)) {
+                inputPaths.push_back(root);
             }
+        } catch (const std::exception& e) {
+            std::cerr << "错误: " << e.what() << "\n";
+            return 1;
         }
     }
+    if (!inputPaths.empty()) {
+        inputPath = inputPaths.front();
+    }
+    bool multiRoot = inputPaths.size() > 1;
+
+    if (!imagePath.empty()) {
+        if (!inputPath.empty()) {
+            std::cerr << "错误: --image 模式不能同时指定目录或文件路径\n";
+            return 1;
+        }
+        inputPath = imagePath;
+    }
 
     if (inputPath.empty()) {
         std::cerr << "错误: 未指定输入路径\n\n";
@@ -99,18 +617,207 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // 只输出汇总时报告写入 -o；条目不保存，依赖条目的功能无法使用
+    if (summaryOnly) {
+        if (serveMode || !ownerQueries.empty() || !extentReportPath.empty() || !summaryPath.empty() ||
+            !hashReportPath.empty() || !probeReportPath.empty()) {
+            std::cerr << "错误: --summary-only 不能与 serve、--who-owns、--extent-report、--summary、--hash 或 --probe-read 同时使用\n";
+            return 1;
+        }
+        if (!outputSpecified) {
+            outputPath = "summary.json";
+        }
+    }
+
+    // 流式输出不保存条目，同样不能使用依赖条目的功能；未指定 -o 时写到标准输出
+    if (streamMode) {
+        if (serveMode || summaryOnly || !ownerQueries.empty() || !extentReportPath.empty() ||
+            !hashReportPath.empty() || !probeReportPath.empty()) {
+            std::cerr << "错误: --stream 不能与 serve、--summary-only、--who-owns、--extent-report、--hash 或 --probe-read 同时使用\n";
+            return 1;
+        }
+        if (!outputSpecified) {
+            outputPath = "-";
+        }
+    }
+
+    // 多根扫描只生成快照，依赖单个扫描器的功能无法使用
+    if (multiRoot && (serveMode || summaryOnly || streamMode || !checkpointPath.empty() || !summaryPath.empty() ||
+                      !ownerQueries.empty() || !extentReportPath.empty() || !hashReportPath.empty() ||
+                      !probeReportPath.empty())) {
+        std::cerr << "错误: 多个扫描路径不能与 serve、--summary-only、--stream、--checkpoint/--resume、"
+                  << "--summary、--who-owns、--extent-report、--hash 或 --probe-read 同时使用\n";
+        return 1;
+    }
+
+    // 镜像中的文件不能按路径读取
+    if ((!hashReportPath.empty() || !probeReportPath.empty()) && !imagePath.empty()) {
+        std::cerr << "错误: --hash 和 --probe-read 不能与 --image 同时使用\n";
+        return 1;
+    }
+
+    // 检查点记录已保存的条目，只适用于把结果写成快照的目录扫描
+    if (!checkpointPath.empty() && (serveMode || summaryOnly || streamMode || !imagePath.empty())) {
+        std::cerr << "错误: --checkpoint/--resume 不能与 serve、--summary-only、--stream 或 --image 同时使用\n";
+        return 1;
+    }
+
+    if (!compressionSpecified) {
+        compression = OutputCompressor::fromPath(outputPath);
+    }
+    if (!OutputCompressor::isSupported(compression)) {
+        std::cerr << "错误: 当前构建不支持 " << OutputCompressor::name(compression) << " 压缩"
+                  << "（编译时未找到对应的库）\n";
+        return 1;
+    }
+
     // 检查输入路径是否存在
-    if (!fs::exists(inputPath)) {
-        std::cerr << "错误: 路径不存在: " << inputPath << "\n";
+    for (const auto& path : multiRoot ? inputPaths : std::vector<std::string>{inputPath}) {
+        if (!fs::exists(path)) {
+            std::cerr << "错误: 路径不存在: " << path << "\n";
+            return 1;
+        }
+        if (multiRoot && !fs::is_directory(path)) {
+            std::cerr << "错误: 多根扫描的路径必须是目录: " << path << "\n";
+            return 1;
+        }
+    }
+
+    if (!checkpointPath.empty() && !fs::is_directory(inputPath)) {
+        std::cerr << "错误: --checkpoint/--resume 只能用于目录扫描\n";
         return 1;
     }
 
+    // 记录写到标准输出时，进度和提示信息全部改写到标准错误
+    if (streamMode && outputPath == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
     try {
-        std::cout << "正在扫描文件系统: " << inputPath << "\n";
-        std::cout << "块大小: " << blockSizeKB << " KB\n";
-        std::cout << "文件系统类型: " << fileSystemType << "\n";
-        std::cout << "输出文件: " << outputPath << "\n";
-        std::cout << "使用多线程加速 (线程数: " << std::thread::hardware_concurrency() << ")\n";
+        if (!imagePath.empty()) {
+            std::cout << "正在解析镜像: " << imagePath << "\n";
+            std::cout << "块大小: 由镜像超级块决定\n";
+            std::cout << "文件系统类型: 由镜像内容识别 (ext2/3/4 或 FAT32)\n";
+        } else {
+            std::cout << "正在扫描文件系统: ";
+            for (size_t i = 0; i < inputPaths.size(); i++) {
+                std::cout << (i > 0 ? ", " : "") << inputPaths[i];
+            }
+            std::cout << "\n";
+            std::cout << "块大小: " << blockSizeKB << " KB\n";
+            std::cout << "文件系统类型: " << fileSystemTypeName(fileSystemType) << "\n";
+        }
+        if (summaryOnly) {
+            std::cout << "汇总报告: " << outputPath;
+            if (compression != CompressionType::None) {
+                std::cout << " (" << OutputCompressor::name(compression) << " 压缩)";
+            }
+            std::cout << "\n";
+        } else if (streamMode) {
+            std::cout << "流式输出: " << (outputPath == "-" ? std::string("标准输出") : outputPath);
+            if (compression != CompressionType::None) {
+                std::cout << " (" << OutputCompressor::name(compression) << " 压缩)";
+            }
+            std::cout << "\n";
+        } else if (!serveMode || outputSpecified) {
+            std::cout << "输出文件: " << outputPath;
+            if (compression != CompressionType::None) {
+                std::cout << " (" << OutputCompressor::name(compression) << " 压缩)";
+            }
+            std::cout << "\n";
+        }
+        if (serveMode) {
+            std::cout << "查询套接字: " << socketPath << "\n";
+        }
+        if (!checkpointPath.empty()) {
+            std::cout << (resume ? "从检查点继续: " : "检查点: ") << checkpointPath << "\n";
+        }
+        
+        // 后台模式在创建任何工作线程之前设置，之后的线程都继承进程的 I/O 类和调度策略
+        if (backgroundMode) {
+            std::string applied = ScanThrottle::enterBackgroundMode();
+            if (applied.empty()) {
+                std::cerr << "警告: 无法降低进程的 I/O 和 CPU 优先级\n";
+            } else {
+                std::cout << "后台模式: " << applied << "\n";
+            }
+        }
+        std::shared_ptr<ScanThrottle> throttle;
+        if (psiLimit > 0 && !ScanThrottle::pressureAvailable()) {
+            std::cerr << "警告: 系统不提供 /proc/pressure/io，忽略 --psi-limit\n";
+            psiLimit = 0;
+        }
+        if (maxOps > 0 || maxProbes > 0 || psiLimit > 0) {
+            throttle = std::make_shared<ScanThrottle>(maxOps, maxProbes, psiLimit);
+            std::cout << "限速:";
+            if (maxOps > 0) {
+                std::cout << " 元数据 " << maxOps << " 次/秒";
+            }
+            if (maxProbes > 0) {
+                std::cout << " extent 探测 " << maxProbes << " 次/秒";
+            }
+            if (psiLimit > 0) {
+                std::cout << " I/O 压力超过 " << psiLimit << "% 时暂停";
+            }
+            std::cout << "\n";
+        }
+        
+        // 公共设置，多根扫描时应用到每个设备的扫描器
+        auto configureScanner = [&](FileSystemScanner& scanner) {
+            // 设置是否自动提示 root 权限（如果使用 --require-root 选项）
+            scanner.setAutoSuggestRoot(requireRoot);
+            
+            // 设置并发度
+            scanner.setThreadCount(threadCount);
+            scanner.setAdaptiveConcurrency(adaptiveThreads);
+            scanner.setInodeOrder(inodeOrder);
+            scanner.setMemoryLimit(memoryLimit);
+            scanner.setSpillDirectory(spillDir);
+            scanner.setOutputCompression(compression);
+            
+            // 设置遍历过滤规则
+            for (const auto& pattern : includePatterns) {
+                scanner.pathFilter().addInclude(pattern);
+            }
+            for (const auto& pattern : excludePatterns) {
+                scanner.pathFilter().addExclude(pattern);
+            }
+            scanner.pathFilter().setMaxDepth(maxDepth);
+            scanner.pathFilter().setMinSize(minSize);
+            if (sampleRate > 0) {
+                scanner.setSampleRate(sampleRate);
+            }
+            
+            // 模拟磁盘的块分配方式（镜像模式使用真实分配信息，不受影响）
+            if (allocationSpecified) {
+                scanner.setAllocationPolicy(allocationPolicy);
+            }
+            scanner.setAllocationFit(allocationFit);
+            scanner.setAllocationChurn(churn);
+            scanner.setThrottle(throttle);
+        };
+        
+        // 多根扫描：按设备分组，未指定 -j 时每个设备的线程数按介质类型决定
+        std::unique_ptr<MultiRootScanner> multiScanner;
+        if (multiRoot) {
+            multiScanner = std::make_unique<MultiRootScanner>(blockSizeKB * 1024, fileSystemType, configureScanner);
+            multiScanner->setThreadCount(threadsSpecified ? threadCount : 0);
+            for (const auto& path : inputPaths) {
+                multiScanner->addRoot(path);
+            }
+            for (const auto& device : multiScanner->devices()) {
+                std::cout << "设备 " << device.id << " (" << device.media << ", "
+                          << (adaptiveThreads ? "自适应, 初始线程数: " : "线程数: ") << device.threads << "):";
+                for (const auto& root : device.roots) {
+                    std::cout << " " << root;
+                }
+                std::cout << "\n";
+            }
+        } else if (adaptiveThreads) {
+            std::cout << "使用多线程加速 (自适应, 初始线程数: " << threadCount << ")\n";
+        } else {
+            std::cout << "使用多线程加速 (线程数: " << threadCount << ")\n";
+        }
         
         // 检查 root 权限并提示
         if (requireRoot) {
@@ -123,11 +830,73 @@ int main(int argc, char* argv[]) {
         ProgressBar progressBar("扫描进度");
         progressBar.showSpinner();  // 初始显示旋转指示器
         
+        if (multiScanner) {
+            multiScanner->scan([&progressBar](size_t files, size_t dirs, size_t) {
+                progressBar.setCurrent(files + dirs);
+            });
+            progressBar.finish();
+            
+            ProgressBar jsonProgressBar("生成JSON");
+            jsonProgressBar.update(0.0);
+            multiScanner->generateJSON(outputPath, compression);
+            jsonProgressBar.update(1.0);
+            jsonProgressBar.finish();
+            
+            std::cout << "\n✓ 成功生成文件系统JSON: " << outputPath << " (" << multiScanner->devices().size()
+                      << " 个设备)\n";
+            for (const auto& device : multiScanner->devices()) {
+                std::cout << "  设备 " << device.id << ": " << device.scanner->getFileCount() << " 个文件, "
+                          << device.scanner->getDirectoryCount() << " 个目录, "
+                          << device.scanner->getTotalSize() / 1024 << " KB\n";
+            }
+            for (const auto& device : multiScanner->devices()) {
+                printProbeStrategies(device.scanner->getCapabilities());
+            }
+            std::cout << "  总文件数: " << multiScanner->getFileCount() << "\n";
+            std::cout << "  总目录数: " << multiScanner->getDirectoryCount() << "\n";
+            std::cout << "  总大小: " << multiScanner->getTotalSize() / 1024 << " KB\n";
+            std::cout << "  总块数: " << multiScanner->getTotalBlocks() << "\n";
+            if (multiScanner->getFilteredCount() > 0) {
+                std::cout << "  已过滤条目: " << multiScanner->getFilteredCount() << "\n";
+            }
+            if (throttle) {
+                std::cout << "  限速等待: " << throttle->throttledSeconds() << " 秒, I/O 压力暂停: "
+                          << throttle->pressureSeconds() << " 秒 (各线程累计)\n";
+            }
+            return 0;
+        }
+        
         // 创建扫描器
         FileSystemScanner scanner(blockSizeKB * 1024, fileSystemType);
+        configureScanner(scanner);
         
-        // 设置是否自动提示 root 权限（如果使用 --require-root 选项）
-        scanner.setAutoSuggestRoot(requireRoot);
+        // 在线汇总统计
+        if (summaryOnly || !summaryPath.empty()) {
+            scanner.setAggregation(topK);
+        }
+        scanner.setSummaryOnly(summaryOnly);
+        if (streamMode) {
+            scanner.setStreamOutput(outputPath, compression);
+        }
+        
+        // 检查点：签名包含所有影响条目内容和模拟分配结果的参数，恢复时必须一致
+        if (!checkpointPath.empty()) {
+            std::ostringstream signature;
+            signature << fs::absolute(inputPath).string() << " -b " << blockSizeKB << " -t " << fileSystemTypeName(fileSystemType)
+                      << " --fit " << static_cast<int>(allocationFit) << " --churn " << churn;
+            if (allocationSpecified) {
+                signature << " --alloc " << static_cast<int>(allocationPolicy);
+            }
+            for (const auto& pattern : includePatterns) {
+                signature << " --include " << pattern;
+            }
+            for (const auto& pattern : excludePatterns) {
+                signature << " --exclude " << pattern;
+            }
+            signature << " --max-depth " << maxDepth << " --min-size " << minSize
+                      << " --sample-rate " << sampleRate;
+            scanner.setCheckpoint(checkpointPath, signature.str(), checkpointInterval, resume);
+        }
         
         // 设置进度回调
         scanner.setProgressCallback([&progressBar](size_t files, size_t dirs, size_t totalSize) {
@@ -136,7 +905,9 @@ int main(int argc, char* argv[]) {
         });
         
         // 扫描文件系统
-        if (fs::is_directory(inputPath)) {
+        if (!imagePath.empty()) {
+            scanner.scanImage(imagePath);
+        } else if (fs::is_directory(inputPath)) {
             scanner.scanDirectory(inputPath);
         } else if (fs::is_regular_file(inputPath)) {
             scanner.scanFile(inputPath);
@@ -147,19 +918,180 @@ int main(int argc, char* argv[]) {
         
         // 完成扫描进度条
         progressBar.finish();
+        if (scanner.getResumedUnitCount() > 0) {
+            std::cout << "  已从检查点恢复 " << scanner.getResumedUnitCount() << " 个目录单元\n";
+        }
 
-        // 生成JSON
-        ProgressBar jsonProgressBar("生成JSON");
-        jsonProgressBar.update(0.0);
-        scanner.generateJSON(outputPath);
-        jsonProgressBar.update(1.0);
-        jsonProgressBar.finish();
+        // 生成JSON（serve 模式只在显式指定 -o 时生成）
+        if (summaryOnly) {
+            scanner.writeSummary(outputPath, compression);
+            std::cout << "\n✓ 成功生成汇总报告: " << outputPath << "\n";
+        } else if (streamMode) {
+            uint64_t records = scanner.finishStream();
+            std::cout << "\n✓ 已流式写出 " << records << " 条记录: "
+                      << (outputPath == "-" ? std::string("标准输出") : outputPath) << "\n";
+        } else if (!serveMode || outputSpecified) {
+            ProgressBar jsonProgressBar("生成JSON");
+            jsonProgressBar.update(0.0);
+            scanner.generateJSON(outputPath);
+            jsonProgressBar.update(1.0);
+            jsonProgressBar.finish();
 
-        std::cout << "\n✓ 成功生成文件系统JSON: " << outputPath << "\n";
+            std::cout << "\n✓ 成功生成文件系统JSON: " << outputPath << "\n";
+            if (!checkpointPath.empty()) {
+                scanner.discardCheckpoint();
+            }
+        } else {
+            std::cout << "\n✓ 扫描完成\n";
+        }
         std::cout << "  总文件数: " << scanner.getFileCount() << "\n";
         std::cout << "  总目录数: " << scanner.getDirectoryCount() << "\n";
         std::cout << "  总大小: " << scanner.getTotalSize() / 1024 << " KB\n";
-        std::cout << "  总块数: " << scanner.getTotalBlocks() << "\n";
+        if (!summaryOnly) {
+            std::cout << "  总块数: " << scanner.getTotalBlocks() << "\n";
+        }
+        if (scanner.getFilteredCount() > 0) {
+            std::cout << "  已过滤条目: " << scanner.getFilteredCount() << "\n";
+        }
+        if (scanner.getSparseFileCount() > 0) {
+            std::cout << "  稀疏文件: " << scanner.getSparseFileCount() << " (空洞 "
+                      << scanner.getHoleSize() / 1024 << " KB)\n";
+        }
+        printProbeStrategies(scanner.getCapabilities());
+        if (sampleRate > 0) {
+            std::cout << "  抽样探测: " << scanner.getSampledFileCount() << " / "
+                      << scanner.getSamplePopulation() << " 个文件\n";
+        }
+        if (scanner.getSpilledChunkCount() > 0) {
+            std::cout << "  溢出块数: " << scanner.getSpilledChunkCount() << "\n";
+        }
+        if (adaptiveThreads) {
+            std::cout << "  自适应线程数: 最终 " << scanner.getActiveWorkers()
+                      << ", 峰值 " << scanner.getPeakActiveWorkers() << "\n";
+        }
+        if (throttle) {
+            std::cout << "  限速等待: " << throttle->throttledSeconds() << " 秒, I/O 压力暂停: "
+                      << throttle->pressureSeconds() << " 秒 (各线程累计)\n";
+        }
+        
+        if (!summaryPath.empty()) {
+            scanner.writeSummary(summaryPath, OutputCompressor::fromPath(summaryPath));
+            std::cout << "\n✓ 成功生成汇总报告: " << summaryPath << "\n";
+        }
+        
+        // 物理 extent 索引：块归属查询、共享区域和物理布局报告
+        if (!ownerQueries.empty() || !extentReportPath.empty()) {
+            ExtentIndex extentIndex;
+            scanner.collectExtents(extentIndex);
+            extentIndex.build();
+            std::vector<ExtentIndex::SharedRegion> regions = extentIndex.sharedRegions();
+            uint64_t sharedBytes = 0;
+            for (const auto& region : regions) {
+                sharedBytes += region.end - region.start;
+            }
+            std::cout << "  extent 数: " << extentIndex.size() << " (" << extentIndex.ownerCount() << " 个文件)\n";
+            std::cout << "  共享区域: " << regions.size() << " 个, 共 " << sharedBytes / 1024 << " KB\n";
+            if (extentIndex.simulatedFileCount() > 0) {
+                std::cout << "  跳过模拟 extent 的文件: " << extentIndex.simulatedFileCount()
+                          << " 个 (未真实探测，物理偏移不是磁盘位置)\n";
+            }
+            
+            for (const auto& query : ownerQueries) {
+                std::cout << "\n物理偏移 " << query.first;
+                if (query.second != query.first + 1) {
+                    std::cout << " - " << query.second;
+                }
+                std::cout << ":\n";
+                std::vector<size_t> hits = extentIndex.overlapping(query.first, query.second);
+                if (hits.empty()) {
+                    std::cout << "  未被任何文件占用\n";
+                }
+                for (size_t hit : hits) {
+                    const ExtentIndex::Extent& extent = extentIndex.extent(hit);
+                    const ExtentIndex::Owner& owner = extentIndex.owner(extent.owner);
+                    std::cout << "  " << owner.id << " " << owner.path << " (extent 物理偏移 "
+                              << extent.physicalOffset << ", 长度 " << extent.length << ", 逻辑偏移 "
+                              << extent.logicalOffset << (extent.shared ? ", 共享" : "") << ")\n";
+                }
+            }
+            
+            if (!extentReportPath.empty()) {
+                extentIndex.writeReport(extentReportPath, ownerQueries, regions);
+                std::cout << "\n✓ 成功生成 extent 报告: " << extentReportPath << "\n";
+            }
+        }
+        
+        // 重复文件检测：按大小、首尾 4KB、完整内容三级筛选，只读取大小相同的文件
+        if (!hashReportPath.empty()) {
+            DuplicateFinder finder(hashThreads);
+            scanner.forEachEntry([&finder](const FileEntry& entry) {
+                finder.add(entry);
+            });
+            finder.find();
+            const DuplicateFinder::Stats& stats = finder.stats();
+            std::cout << "  重复文件: " << finder.groups().size() << " 组, " << finder.redundantFileCount()
+                      << " 个多余副本, 可回收 " << finder.reclaimableBytes() / 1024 << " KB\n";
+            std::cout << "  哈希读取: " << stats.candidates << " 个文件读取首尾, " << stats.fullyHashed
+                      << " 个完整读取, 共 " << stats.bytesRead / 1024 << " KB";
+            if (stats.hardLinks > 0) {
+                std::cout << ", 跳过硬链接 " << stats.hardLinks << " 个";
+            }
+            if (stats.unreadable > 0) {
+                std::cout << ", 无法读取 " << stats.unreadable << " 个";
+            }
+            std::cout << "\n";
+            finder.writeReport(hashReportPath);
+            std::cout << "\n✓ 成功生成重复文件报告: " << hashReportPath << "\n";
+        }
+
+        // 读取探测：按 extent 数分桶抽样冷读，测量碎片对吞吐量和延迟的实际影响
+        if (!probeReportPath.empty()) {
+            ReadProbe probe(probeSamples, 64ULL << 20);
+            scanner.forEachEntry([&probe](const FileEntry& entry) {
+                probe.add(entry);
+            });
+            probe.run();
+            std::cout << "  读取探测: " << probe.sampleCount() << " 个文件";
+            if (probe.failedCount() > 0) {
+                std::cout << ", 无法读取 " << probe.failedCount() << " 个";
+            }
+            if (probe.simulatedFileCount() > 0) {
+                std::cout << ", 跳过模拟 extent 的文件 " << probe.simulatedFileCount() << " 个";
+            }
+            std::cout << "\n";
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(1);
+            for (const auto& device : probe.devices()) {
+                std::cout << "    设备 " << device.name << (device.direct ? " (O_DIRECT)" : " (页缓存已丢弃)") << ":\n";
+                for (const auto& bucket : device.buckets) {
+                    line.str("");
+                    line << "      extent " << ReadProbe::formatBucket(bucket) << ": " << bucket.samples.size()
+                         << " 个文件, " << bucket.throughput << " MB/s (相对 " << bucket.relative * 100
+                         << "%), 平均延迟 " << bucket.meanLatency << " ms, 首次 " << bucket.firstLatency
+                         << " ms, 最大 " << bucket.maxLatency << " ms\n";
+                    std::cout << line.str();
+                }
+            }
+            probe.writeReport(probeReportPath);
+            std::cout << "\n✓ 成功生成读取探测报告: " << probeReportPath << "\n";
+        }
+
+        
+        // 常驻查询服务：把扫描结果压缩为只读模型，通过 Unix 域套接字回答查询
+        if (serveMode) {
+            QueryModel model;
+            scanner.forEachEntry([&model](const FileEntry& entry) {
+                model.add(entry);
+            });
+            model.finish(imagePath.empty() ? fs::absolute(inputPath).string() : std::string(),
+                         fileSystemTypeName(scanner.getFileSystemType()), scanner.getBlockSize());
+            QueryServer server(model, socketPath);
+            std::cout << "\n查询服务已启动: " << socketPath << " (" << model.nodeCount() << " 个条目, Ctrl+C 退出)\n";
+            std::cout << "示例: " << argv[0] << " query --socket " << socketPath
+                      << " '{\"op\":\"top\",\"by\":\"size\",\"n\":10}'\n" << std::flush;
+            server.run();
+            std::cout << "\n查询服务已停止\n";
+        }
 
     } catch (const std::exception& e) {
         std::cerr << "\n错误: " << e.what() << "\n";
@@ -0,0 +1,30 @@
+# 回归测试：自适应并发 (-j auto) 下扫描大量空的小目录不应挂起。
+# 线程池中被门控的线程可能吞掉 notify_one 的唤醒，导致入队的目录无人处理。
+# 用法: cmake -DFCON=<fcon 路径> -DWORK_DIR=<临时目录> [-DRUNS=40] -P adaptive_tiny_dirs.cmake
+if(NOT FCON OR NOT WORK_DIR)
+    message(FATAL_ERROR "需要指定 FCON 和 WORK_DIR")
+endif()
+if(NOT RUNS)
+    set(RUNS 40)
+endif()
+
+set(ROOT "${WORK_DIR}/tiny")
+file(REMOVE_RECURSE "${WORK_DIR}")
+foreach(i RANGE 1 50)
+    file(MAKE_DIRECTORY "${ROOT}/d${i}")
+endforeach()
+
+foreach(run RANGE 1 ${RUNS})
+    execute_process(
+        COMMAND "${FCON}" "${ROOT}" -j auto -o "${WORK_DIR}/out.json"
+        RESULT_VARIABLE result
+        OUTPUT_QUIET
+        ERROR_QUIET
+        TIMEOUT 20
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "第 ${run} 次扫描失败或超时: ${result}")
+    endif()
+endforeach()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
@@ -0,0 +1,193 @@
+// 位图内核的交叉校验：在 CPU 支持的每个级别（scalar/sse4.2/avx2）上把各内核与逐位的参考实现对比，
+// 不一致时打印错误并以非零状态退出。由 ctest 运行，不依赖 FCON_BUILD_BENCH
+#include "BitOps.h"
+#include "BitmapKernels.h"
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+bool failed = false;
+
+uint64_t lcg(uint64_t& state) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// ---- 逐位的参考实现 ----
+
+bool bitAt(const std::vector<uint64_t>& words, uint64_t b) {
+    return (words[b / 64] >> (b % 64)) & 1;
+}
+
+uint64_t referencePopcount(const std::vector<uint64_t>& words, uint64_t first, uint64_t last) {
+    uint64_t count = 0;
+    for (uint64_t b = first; b < last && b < words.size() * 64; b++) {
+        count += bitAt(words, b);
+    }
+    return count;
+}
+
+uint64_t referenceRuns(const std::vector<uint64_t>& words) {
+    uint64_t runs = 0;
+    bool previous = false;
+    for (uint64_t b = 0; b < words.size() * 64; b++) {
+        bool current = bitAt(words, b);
+        runs += current && !previous;
+        previous = current;
+    }
+    return runs;
+}
+
+uint64_t referenceFreeRun(const std::vector<uint64_t>& words, uint64_t from, uint64_t length) {
+    uint64_t total = words.size() * 64;
+    if (from >= total) {
+        return from;
+    }
+    length = length == 0 ? 1 : length;
+    uint64_t start = 0;
+    uint64_t run = 0;
+    for (uint64_t b = from; b < total; b++) {
+        if (bitAt(words, b)) {
+            run = 0;
+            continue;
+        }
+        start = run == 0 ? b : start;
+        if (++run >= length) {
+            return start;
+        }
+    }
+    return run > 0 ? start : total;
+}
+
+size_t referenceFirstBreak(const std::vector<int>& blocks) {
+    for (size_t i = 1; i < blocks.size(); i++) {
+        if (static_cast<uint32_t>(blocks[i]) != static_cast<uint32_t>(blocks[i - 1]) + 1) {
+            return i;
+        }
+    }
+    return blocks.size();
+}
+
+size_t referenceCountBreaks(const std::vector<int>& blocks) {
+    size_t breaks = 0;
+    for (size_t i = 1; i < blocks.size(); i++) {
+        breaks += static_cast<uint32_t>(blocks[i]) != static_cast<uint32_t>(blocks[i - 1]) + 1;
+    }
+    return breaks;
+}
+
+// 随机位图：按给定密度逐段生成已用/空闲段，段长覆盖字内和跨字的情况
+std::vector<uint64_t> randomBitmap(uint64_t& state, size_t count, unsigned density) {
+    std::vector<uint64_t> words(count, 0);
+    uint64_t b = 0;
+    while (b < count * 64) {
+        uint64_t length = 1 + lcg(state) % (lcg(state) % 4 == 0 ? 700 : 12);
+        bool used = lcg(state) % 100 < density;
+        for (uint64_t i = b; i < b + length && i < count * 64; i++) {
+            if (used) {
+                words[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+        b += length;
+    }
+    return words;
+}
+
+void check(bool ok, const char* kernel, BitmapKernels::Level level, uint64_t seed) {
+    if (!ok) {
+        std::fprintf(stderr, "  错误: %s 的 %s 实现与参考结果不一致（种子 %llu）\n", kernel,
+                     BitmapKernels::levelName(level), static_cast<unsigned long long>(seed));
+        failed = true;
+    }
+}
+
+// 在每个可用级别上把各内核与逐位参考实现对比，返回校验次数
+uint64_t verifyKernels() {
+    const unsigned densities[] = {0, 3, 50, 97, 100};
+    uint64_t checks = 0;
+    BitmapKernels::Level original = BitmapKernels::active();
+    for (int l = 0; l <= static_cast<int>(BitmapKernels::supported()); l++) {
+        auto level = static_cast<BitmapKernels::Level>(l);
+        BitmapKernels::setLevel(level);
+        uint64_t state = 7;
+        for (uint64_t seed = 0; seed < 600; seed++) {
+            size_t count = static_cast<size_t>(lcg(state) % 70);
+            auto words = randomBitmap(state, count, densities[seed % 5]);
+            uint64_t total = count * 64;
+
+            check(BitmapKernels::countRuns(words.data(), count) == referenceRuns(words), "countRuns", level, seed);
+            for (int i = 0; i < 8; i++) {
+                uint64_t first = lcg(state) % (total + 70);
+                uint64_t last = first + lcg(state) % (total + 70);
+                check(BitmapKernels::popcount(words.data(), count, first, last) ==
+                      referencePopcount(words, first, last), "popcount", level, seed);
+                uint64_t from = lcg(state) % (total + 10);
+                uint64_t length = lcg(state) % (i < 4 ? 8 : 400);
+                check(BitmapKernels::findFreeRun(words.data(), count, from, length) ==
+                      referenceFreeRun(words, from, length), "findFreeRun", level, seed);
+                checks += 3;
+            }
+
+            std::vector<int> blocks(static_cast<size_t>(lcg(state) % 90));
+            int next = lcg(state) % 8 == 0 ? INT_MAX - 20 : static_cast<int>(lcg(state) % 100000);
+            unsigned breakEvery = 1 + static_cast<unsigned>(lcg(state) % 40);
+            for (auto& block : blocks) {
+                if (lcg(state) % breakEvery == 0) {
+                    next = static_cast<int>(lcg(state) % 100000);
+                }
+                block = next;
+                next = static_cast<int>(static_cast<uint32_t>(next) + 1);
+            }
+            check(BitmapKernels::firstBreak(blocks.data(), blocks.size()) == referenceFirstBreak(blocks),
+                  "firstBreak", level, seed);
+            check(BitmapKernels::countBreaks(blocks.data(), blocks.size()) == referenceCountBreaks(blocks),
+                  "countBreaks", level, seed);
+            checks += 3;
+        }
+    }
+    BitmapKernels::setLevel(original);
+    return checks;
+}
+
+// BitOps 的各函数与逐位循环对比（稀疏、稠密和单个置位的值），返回校验次数
+uint64_t verifyBitOps() {
+    uint64_t checks = 0;
+    uint64_t state = 13;
+    for (int i = 0; i < 3000; i++) {
+        uint64_t v = (lcg(state) << 33) ^ lcg(state);
+        if (i % 3 == 1) {
+            v &= (lcg(state) << 33) ^ lcg(state);
+        } else if (i % 3 == 2) {
+            v = uint64_t(1) << (i % 64);
+        }
+        unsigned bits = 0, lowest = 64, highest = 64;
+        for (unsigned b = 0; b < 64; b++) {
+            if ((v >> b) & 1) {
+                bits++;
+                lowest = lowest == 64 ? b : lowest;
+                highest = b;
+            }
+        }
+        bool ok = BitOps::popcount(v) == bits && BitOps::findFirstSet(v) == (v == 0 ? 0 : lowest + 1);
+        if (v != 0) {
+            ok = ok && BitOps::countTrailingZeros(v) == lowest && BitOps::countLeadingZeros(v) == 63 - highest;
+        }
+        if (!ok) {
+            std::fprintf(stderr, "  错误: BitOps 与逐位结果不一致（%016llx）\n", static_cast<unsigned long long>(v));
+            failed = true;
+        }
+        checks++;
+    }
+    return checks;
+}
+
+} // namespace
+
+int main() {
+    uint64_t checks = verifyBitOps() + verifyKernels();
+    std::printf("%llu checks, %s\n", static_cast<unsigned long long>(checks), failed ? "FAILED" : "ok");
+    return failed ? 1 : 0;
+}